@@ -0,0 +1,31 @@
+/*
+ *  Benchmark helpers
+ *  Shared by the programs in bench/, included after the library header:
+ *  the wall clock every measurement uses, the generator the corpora are
+ *  built from (set seed to start a corpus over) and MB for the reports.
+ */
+#ifndef WS_JSON_BENCH_H
+#define WS_JSON_BENCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+static inline double now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t seed = 1;
+
+static inline uint32_t next(void) {
+    seed = seed * 1664525u + 1013904223u;
+    return seed >> 8;
+}
+
+static inline double toMegabytes(double bytes) {
+    return bytes / (1024.0 * 1024.0);
+}
+
+#endif // WS_JSON_BENCH_H
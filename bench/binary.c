@@ -0,0 +1,129 @@
+/*
+ *  Binary format benchmark
+ *  Payload size, encode and decode time of json text, MessagePack and CBOR
+ *  for an api message, a numeric point cloud and a batch of log entries.
+ *  Decoding runs on the heap and with an arena and views.
+ */
+#define WS_JSON_IMPLEMENTATION
+#include "../src/wsJson.h"
+#include "bench.h"
+
+#include <stdio.h>
+
+#define TARGET_BYTES (64 * 1024 * 1024)
+#define BUFFER_SIZE (8 * 1024 * 1024)
+
+typedef enum { FORMAT_TEXT, FORMAT_MSGPACK, FORMAT_CBOR } Format;
+static const char* formatNames[] = { "text", "msgpack", "cbor" };
+
+static wsJson* buildMessage(void) {
+    wsJson* root = wsJsonInitObject(NULL);
+    wsJsonAddString(root, "type", "order.updated");
+    wsJsonAddInteger(root, "timestamp", 1700000000123);
+    wsJson* order = wsJsonInitObject("order");
+    wsJsonAddInteger(order, "id", 48213377);
+    wsJsonAddString(order, "status", "shipped");
+    wsJsonAddNumber(order, "total", 129.95);
+    wsJsonAddString(order, "currency", "EUR");
+    wsJson* items = wsJsonInitArray("items");
+    for (int32_t i = 0; i < 12; i++) {
+        wsJson* item = wsJsonInitObject(NULL);
+        wsJsonAddString(item, "sku", "SKU-000123-XL");
+        wsJsonAddInteger(item, "quantity", i % 3 + 1);
+        wsJsonAddNumber(item, "price", 9.99 + i);
+        wsJsonAddBool(item, "gift", i % 4 == 0);
+        wsJsonAddElement(items, item);
+    }
+    wsJsonAddField(order, items);
+    wsJsonAddField(root, order);
+    wsJsonAddNull(root, "coupon");
+    return root;
+}
+
+static wsJson* buildPoints(void) {
+    wsJson* root = wsJsonInitObject(NULL);
+    wsJson* points = wsJsonInitArray("points");
+    for (int32_t i = 0; i < 10000; i++) {
+        wsJson* point = wsJsonInitArray(NULL);
+        wsJsonAddElement(point, wsJsonInitNumber(NULL, i * 0.001));
+        wsJsonAddElement(point, wsJsonInitNumber(NULL, 1.0 / (i + 1)));
+        wsJsonAddElement(point, wsJsonInitNumber(NULL, i * 0.5));
+        wsJsonAddElement(points, point);
+    }
+    wsJsonAddField(root, points);
+    return root;
+}
+
+static wsJson* buildLogs(void) {
+    wsJson* root = wsJsonInitObject(NULL);
+    wsJson* entries = wsJsonInitArray("entries");
+    for (int32_t i = 0; i < 2000; i++) {
+        wsJson* entry = wsJsonInitObject(NULL);
+        wsJsonAddString(entry, "level", i % 10 ? "info" : "error");
+        wsJsonAddString(entry, "logger", "service.http.handler");
+        wsJsonAddString(entry, "message", "request finished: GET /api/v1/users/search?q=abc \\\"quoted\\\" 200");
+        wsJsonAddInteger(entry, "durationUs", 1500 + i);
+        wsJsonAddElement(entries, entry);
+    }
+    wsJsonAddField(root, entries);
+    return root;
+}
+
+static size_t encode(Format format, wsJson* doc, char* buffer) {
+    if (format == FORMAT_TEXT) return (size_t)wsJsonToString(doc, buffer, BUFFER_SIZE);
+    wsJsonWriter writer;
+    wsJsonWriterInitFixed(&writer, buffer, BUFFER_SIZE);
+    if (format == FORMAT_MSGPACK) wsJsonWriteMsgPack(&writer, doc);
+    else wsJsonWriteCbor(&writer, doc);
+    return writer.length;
+}
+
+static wsJson* decode(Format format, const char* data, size_t length, uint32_t flags) {
+    if (format == FORMAT_MSGPACK) return wsJsonParseMsgPack(data, length, flags);
+    if (format == FORMAT_CBOR) return wsJsonParseCbor(data, length, flags);
+    if (flags) return wsJsonParse(data, length, flags);
+    const char* cursor = data;
+    return wsStringToJson(&cursor);
+}
+
+static void run(const char* name, wsJson* doc) {
+    char* buffer = malloc(BUFFER_SIZE);
+    printf("%s\n", name);
+    for (Format format = FORMAT_TEXT; format <= FORMAT_CBOR; format++) {
+        size_t length = encode(format, doc, buffer);
+        int32_t rounds = (int32_t)(TARGET_BYTES / length) + 1;
+
+        double start = now();
+        for (int32_t r = 0; r < rounds; r++) encode(format, doc, buffer);
+        double encodeSeconds = now() - start;
+
+        start = now();
+        for (int32_t r = 0; r < rounds; r++) wsJsonFree(decode(format, buffer, length, 0));
+        double heapSeconds = now() - start;
+
+        wsJsonArena* arena = wsJsonArenaInit(0);
+        wsJsonSetArena(arena);
+        start = now();
+        for (int32_t r = 0; r < rounds; r++) {
+            decode(format, buffer, length, WS_JSON_PARSE_VIEWS);
+            wsJsonArenaReset(arena);
+        }
+        double arenaSeconds = now() - start;
+        wsJsonSetArena(NULL);
+        wsJsonArenaFree(arena);
+
+        printf("  %-8s %9zu bytes  encode %9.2f us  decode heap %9.2f us  arena+views %9.2f us\n", formatNames[format], length,
+               encodeSeconds / rounds * 1e6, heapSeconds / rounds * 1e6, arenaSeconds / rounds * 1e6);
+    }
+    free(buffer);
+}
+
+int main(void) {
+    wsJson* docs[] = { buildMessage(), buildPoints(), buildLogs() };
+    const char* names[] = { "api message", "point cloud (10k x 3 doubles)", "log batch (2k entries)" };
+    for (int32_t i = 0; i < 3; i++) {
+        run(names[i], docs[i]);
+        wsJsonFree(docs[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,207 @@
+/*
+ *  Struct binding benchmark
+ *  A trade message with a nested instrument and an unknown field, decoded
+ *  into a struct through its binding against wsStringToJson followed by
+ *  wsJsonGet* for every member, and written back out from the struct
+ *  against building a tree and serializing it. Edge cases of the binding
+ *  (strings too long for their member, unknown and missing fields, output
+ *  that has to parse again) are checked first, exits with 1 on a failure.
+ */
+#define WS_JSON_IMPLEMENTATION
+#include "../src/wsJson.h"
+#include "bench.h"
+
+#include <stdio.h>
+
+#define MESSAGES 4096
+#define ROUNDS 50
+
+#define INSTRUMENT_FIELDS(X) \
+    X(STRING(16), symbol, "symbol") \
+    X(STRING(8), venue, "venue") \
+    X(INTEGER, lotSize, "lotSize")
+WS_JSON_STRUCT(Instrument, INSTRUMENT_FIELDS);
+WS_JSON_BINDING(instrumentBinding, Instrument, INSTRUMENT_FIELDS);
+
+#define TRADE_FIELDS(X) \
+    X(INTEGER, id, "id") \
+    X(INTEGER, timestamp, "timestamp") \
+    X(STRING(8), side, "side") \
+    X(NUMBER, price, "price") \
+    X(INTEGER, quantity, "quantity") \
+    X(BOOL, aggressor, "aggressor") \
+    X(STRING(32), account, "account") \
+    X(OBJECT(Instrument, instrumentBinding), instrument, "instrument")
+WS_JSON_STRUCT(Trade, TRADE_FIELDS);
+WS_JSON_BINDING(tradeBinding, Trade, TRADE_FIELDS);
+
+static void getString(wsJson* obj, const char* key, char* out, size_t size) {
+    const char* value = wsJsonGetString(obj, key);
+    snprintf(out, size, "%s", value ? value : "");
+}
+
+// Same result as wsJsonBindParse, member by member through the tree
+static bool parseTree(const char* text, Trade* trade) {
+    const char* cursor = text;
+    wsJson* root = wsStringToJson(&cursor);
+    if (!root) return false;
+    trade->id = wsJsonGetInteger(root, "id");
+    trade->timestamp = wsJsonGetInteger(root, "timestamp");
+    getString(root, "side", trade->side, sizeof(trade->side));
+    trade->price = wsJsonGetNumber(root, "price");
+    trade->quantity = wsJsonGetInteger(root, "quantity");
+    trade->aggressor = wsJsonGetBool(root, "aggressor");
+    getString(root, "account", trade->account, sizeof(trade->account));
+    getString(root, "instrument.symbol", trade->instrument.symbol, sizeof(trade->instrument.symbol));
+    getString(root, "instrument.venue", trade->instrument.venue, sizeof(trade->instrument.venue));
+    trade->instrument.lotSize = wsJsonGetInteger(root, "instrument.lotSize");
+    wsJsonFree(root);
+    return true;
+}
+
+static void writeTree(wsJsonWriter* writer, const Trade* trade) {
+    wsJson* root = wsJsonInitObject(NULL);
+    wsJsonAddInteger(root, "id", trade->id);
+    wsJsonAddInteger(root, "timestamp", trade->timestamp);
+    wsJsonAddString(root, "side", trade->side);
+    wsJsonAddNumber(root, "price", trade->price);
+    wsJsonAddInteger(root, "quantity", trade->quantity);
+    wsJsonAddBool(root, "aggressor", trade->aggressor);
+    wsJsonAddString(root, "account", trade->account);
+    wsJson* instrument = wsJsonInitObject("instrument");
+    wsJsonAddString(instrument, "symbol", trade->instrument.symbol);
+    wsJsonAddString(instrument, "venue", trade->instrument.venue);
+    wsJsonAddInteger(instrument, "lotSize", trade->instrument.lotSize);
+    wsJsonAddField(root, instrument);
+    wsJsonWrite(writer, root);
+    wsJsonFree(root);
+}
+
+static bool check(bool ok, const char* what) {
+    if (!ok) printf("binding check failed: %s\n", what);
+    return ok;
+}
+
+static int32_t checkEdgeCases(void) {
+    int32_t failed = 0;
+    Trade trade = { 0 };
+
+    const char* tooLong = "{\"id\": 1, \"side\": \"buy-and-then-some\"}";
+    failed += !check(wsJsonBindParse(&tradeBinding, tooLong, strlen(tooLong), &trade) == WS_ERROR, "string longer than its member is rejected");
+    const char* fits = "{\"side\": \"1234567\"}";
+    failed += !check(wsJsonBindParse(&tradeBinding, fits, strlen(fits), &trade) == WS_OK && strcmp(trade.side, "1234567") == 0,
+                     "string that just fits with its terminator is kept");
+    const char* nestedTooLong = "{\"instrument\": {\"venue\": \"XNAS-EXTRA\"}}";
+    failed += !check(wsJsonBindParse(&tradeBinding, nestedTooLong, strlen(nestedTooLong), &trade) == WS_ERROR,
+                     "string longer than a nested member is rejected");
+    const char* overflow = "{\"price\": 1e999}";
+    failed += !check(wsJsonBindParse(&tradeBinding, overflow, strlen(overflow), &trade) == WS_ERROR, "number too big for a double is rejected");
+    const char* escaped = "{\"side\": \"\\u0041\\u0042\\\"\\n\"}";
+    failed += !check(wsJsonBindParse(&tradeBinding, escaped, strlen(escaped), &trade) == WS_OK && strcmp(trade.side, "AB\"\n") == 0,
+                     "escapes are decoded, a string that only fits decoded is kept");
+
+    // Unknown fields of every kind are skipped, the known ones around them still land
+    const char* unknown = "{\"extra\": {\"a\": [1, {\"b\": \"}]\\\"\"}]}, \"id\": 7, \"list\": [[], {}], \"flag\": false, "
+                          "\"none\": null, \"instrument\": {\"other\": 1.5e3, \"lotSize\": 10}, \"price\": 2.5}";
+    memset(&trade, 0, sizeof(trade));
+    failed += !check(wsJsonBindParse(&tradeBinding, unknown, strlen(unknown), &trade) == WS_OK && trade.id == 7 &&
+                     trade.instrument.lotSize == 10 && trade.price == 2.5, "unknown fields are skipped");
+
+    // Members the input doesn't have keep their value, null zeroes them
+    Trade kept = { .id = 3, .quantity = 9, .aggressor = true, .side = "sell", .instrument = { .symbol = "ABC", .lotSize = 5 } };
+    const char* partial = "{\"quantity\": 12, \"side\": null, \"instrument\": {\"symbol\": \"XYZ\"}}";
+    failed += !check(wsJsonBindParse(&tradeBinding, partial, strlen(partial), &kept) == WS_OK && kept.id == 3 && kept.quantity == 12 &&
+                     kept.aggressor && kept.side[0] == '\0' && strcmp(kept.instrument.symbol, "XYZ") == 0 && kept.instrument.lotSize == 5,
+                     "missing members keep their value");
+
+    // The output parses again, as a tree and through the binding (structs start zeroed for memcmp)
+    const char* full = "{\"id\": -42, \"timestamp\": 1700000000123, \"side\": \"b\\\"q\", \"price\": 0.1, \"quantity\": 3, "
+                       "\"aggressor\": true, \"account\": \"desk-0001\", "
+                       "\"instrument\": {\"symbol\": \"SYM0001\", \"venue\": \"XNAS\", \"lotSize\": 100}}";
+    Trade written = { 0 }, reparsed = { 0 };
+    wsJsonWriter writer;
+    wsJsonWriterInitGrowable(&writer, 0);
+    bool writeOk = wsJsonBindParse(&tradeBinding, full, strlen(full), &written) == WS_OK &&
+                   wsJsonBindWrite(&writer, &tradeBinding, &written) == WS_OK;
+    wsJson* tree = writeOk ? wsJsonParse(writer.buffer, writer.used, 0) : NULL;
+    failed += !check(tree && wsJsonGetInteger(tree, "id") == -42 && wsJsonGetNumber(tree, "price") == 0.1 &&
+                     wsJsonGetInteger(tree, "instrument.lotSize") == 100 && wsJsonGetBool(tree, "aggressor"),
+                     "written output parses as a tree");
+    failed += !check(writeOk && wsJsonBindParse(&tradeBinding, writer.buffer, writer.used, &reparsed) == WS_OK &&
+                     memcmp(&reparsed, &written, sizeof(Trade)) == 0, "written output parses back into the same struct");
+    failed += !check(strcmp(written.side, "b\"q") == 0, "escaped quote is decoded");
+    wsJsonFree(tree);
+
+    // Text set in C gets escaped on the way out
+    Trade plain = { .side = "q\"u\\\t", .account = "line\nbreak\x01" }, plainParsed = { 0 };
+    writer.used = 0;
+    writeOk = wsJsonBindWrite(&writer, &tradeBinding, &plain) == WS_OK;
+    tree = writeOk ? wsJsonParse(writer.buffer, writer.used, 0) : NULL;
+    failed += !check(tree && wsJsonBindParse(&tradeBinding, writer.buffer, writer.used, &plainParsed) == WS_OK &&
+                     strcmp(plainParsed.side, plain.side) == 0 && strcmp(plainParsed.account, plain.account) == 0,
+                     "quotes, backslashes and control characters are escaped");
+    wsJsonFree(tree);
+    wsJsonWriterFree(&writer);
+    return failed;
+}
+
+int main(void) {
+    if (checkEdgeCases()) return 1;
+
+    static char* messages[MESSAGES];
+    static Trade trades[MESSAGES];
+    size_t bytes = 0;
+    for (int32_t i = 0; i < MESSAGES; i++) {
+        char text[512];
+        int32_t length = snprintf(text, sizeof(text),
+            "{\"id\": %d, \"timestamp\": %lld, \"side\": \"%s\", \"price\": %d.%02d, \"quantity\": %d, "
+            "\"aggressor\": %s, \"account\": \"desk-%04d\", \"meta\": {\"source\": \"feed-a\", \"seq\": [%d, %d]}, "
+            "\"instrument\": {\"symbol\": \"SYM%04d\", \"venue\": \"XNAS\", \"lotSize\": 100}}",
+            i, 1700000000000LL + i * 17, i & 1 ? "buy" : "sell", 100 + i % 50, i % 100, 1 + i % 900,
+            i % 3 ? "true" : "false", i % 64, i, i + 1, i % 500);
+        messages[i] = malloc(length + 1);
+        memcpy(messages[i], text, length + 1);
+        bytes += length;
+    }
+
+    // Both ways have to agree before anything gets timed
+    for (int32_t i = 0; i < MESSAGES; i++) {
+        Trade bound = { 0 }, tree = { 0 };
+        if (wsJsonBindParse(&tradeBinding, messages[i], strlen(messages[i]), &bound) != WS_OK || !parseTree(messages[i], &tree) ||
+            memcmp(&bound, &tree, sizeof(Trade)) != 0) {
+            printf("message %d decodes differently\n", i);
+            return 1;
+        }
+    }
+
+    double treeSeconds = 0, bindSeconds = 0, treeWriteSeconds = 0, bindWriteSeconds = 0;
+    wsJsonWriter writer;
+    wsJsonWriterInitGrowable(&writer, 0);
+    for (int32_t r = 0; r < ROUNDS; r++) {
+        double start = now();
+        for (int32_t i = 0; i < MESSAGES; i++) parseTree(messages[i], &trades[i]);
+        double parsed = now();
+        for (int32_t i = 0; i < MESSAGES; i++) wsJsonBindParse(&tradeBinding, messages[i], strlen(messages[i]), &trades[i]);
+        double bound = now();
+        writer.used = 0;
+        for (int32_t i = 0; i < MESSAGES; i++) writeTree(&writer, &trades[i]);
+        double treeWritten = now();
+        writer.used = 0;
+        for (int32_t i = 0; i < MESSAGES; i++) wsJsonBindWrite(&writer, &tradeBinding, &trades[i]);
+        double bindWritten = now();
+        treeSeconds += parsed - start;
+        bindSeconds += bound - parsed;
+        treeWriteSeconds += treeWritten - bound;
+        bindWriteSeconds += bindWritten - treeWritten;
+    }
+
+    double count = (double)MESSAGES * ROUNDS;
+    printf("%d messages, %zu bytes on average\n", MESSAGES, bytes / MESSAGES);
+    printf("wsStringToJson + wsJsonGet*  %8.1f ns/msg\n", treeSeconds / count * 1e9);
+    printf("wsJsonBindParse              %8.1f ns/msg  (%.1fx)\n", bindSeconds / count * 1e9, treeSeconds / bindSeconds);
+    printf("tree + wsJsonWrite           %8.1f ns/msg\n", treeWriteSeconds / count * 1e9);
+    printf("wsJsonBindWrite              %8.1f ns/msg  (%.1fx)\n", bindWriteSeconds / count * 1e9, treeWriteSeconds / bindWriteSeconds);
+    wsJsonWriterFree(&writer);
+    for (int32_t i = 0; i < MESSAGES; i++) free(messages[i]);
+    return 0;
+}
@@ -0,0 +1,170 @@
+/*
+ *  Cached serialization benchmark
+ *  A state object of about 10 MB (a few thousand sessions) that gets a
+ *  handful of wsJsonSet* changes before every write, written in full with
+ *  wsJsonWrite against the update of a wsJsonCache. Every output of the
+ *  cache is compared with the full one, after a small document has gone
+ *  through every kind of change once. Exits with 1 when an output differs.
+ */
+#define WS_JSON_IMPLEMENTATION
+#include "../src/wsJson.h"
+#include "bench.h"
+
+#include <stdio.h>
+
+#define SESSIONS 50000
+#define CHANGES 8
+#define ROUNDS 100
+
+static wsJson* buildState(void) {
+    wsJson* root = wsJsonInitObject(NULL);
+    wsJsonAddInteger(root, "tick", 0);
+    wsJson* sessions = wsJsonInitObject("sessions");
+    char key[32];
+    for (int32_t i = 0; i < SESSIONS; i++) {
+        snprintf(key, sizeof(key), "s%05d", i);
+        wsJson* session = wsJsonInitObject(key);
+        wsJsonAddString(session, "user", "someone@example.com");
+        wsJsonAddInteger(session, "lastSeen", 1700000000123 + i);
+        wsJsonAddNumber(session, "score", (next() % 100000) / 100.0);
+        wsJsonAddBool(session, "active", next() & 1);
+        wsJson* position = wsJsonInitObject("position");
+        wsJsonAddNumber(position, "x", (next() % 10000) / 10.0);
+        wsJsonAddNumber(position, "y", (next() % 10000) / 10.0);
+        wsJsonAddField(session, position);
+        wsJson* history = wsJsonInitArray("history");
+        for (int32_t h = 0; h < 20; h++) wsJsonAddElement(history, wsJsonInitInteger(NULL, next() % 1000));
+        wsJsonAddField(session, history);
+        wsJsonAddField(sessions, session);
+    }
+    wsJsonAddField(root, sessions);
+    return root;
+}
+
+static wsJson* parseText(const char* text) {
+    return wsJsonParse(text, strlen(text), 0);
+}
+
+// Applies change step to doc, returns its name or NULL after the last one
+static const char* applyChange(wsJson* doc, int32_t step) {
+    switch (step) {
+        case 0: wsJsonSetString(doc, "user.name", "a much longer name than before"); return "wsJsonSetString longer";
+        case 1: wsJsonSetString(doc, "user.name", "x"); return "wsJsonSetString shorter";
+        case 2: wsJsonSetNumber(doc, "user.score", 12.75); return "wsJsonSetNumber";
+        case 3: wsJsonSetInteger(doc, "tick", 1700000000123); return "wsJsonSetInteger";
+        case 4: wsJsonSetBool(doc, "user.active", false); return "wsJsonSetBool";
+        case 5: wsJsonSetNullToString(doc, "nothing", "something"); return "wsJsonSetNullToString";
+        case 6: wsJsonSetNullToObject(doc, "empty", parseText("{\"a\": [1, 2], \"b\": {}}")); return "wsJsonSetNullToObject";
+        case 7: wsJsonSetNullToArray(doc, "user.missing", parseText("[true, {\"c\": 3}]")); return "wsJsonSetNullToArray";
+        case 8: wsJsonSetElement(doc, "list", 1, parseText("{\"replaced\": [0]}")); return "wsJsonSetElement";
+        case 9: wsJsonAddString(wsJsonGet(doc, "user"), "email", "someone@example.com"); return "wsJsonAddField nested";
+        case 10: wsJsonAddElement(wsJsonGet(doc, "list"), wsJsonInitInteger(NULL, 4)); return "wsJsonAddElement";
+        case 11: {
+            wsJson* added = wsJsonInitObject("added");
+            wsJson* x = wsJsonInitArray("x");
+            wsJsonAddElement(x, wsJsonInitInteger(NULL, 1));
+            wsJsonAddField(added, x);
+            wsJsonAddField(doc, added);
+            return "wsJsonAddField object";
+        }
+        case 12: wsJsonAddInteger(wsJsonGet(doc, "added"), "y", 2); return "wsJsonAddField into an added object";
+        case 13: {
+            char key[16];
+            wsJson* user = wsJsonGet(doc, "user");
+            for (int32_t i = 0; i < 20; i++) {
+                snprintf(key, sizeof(key), "k%d", i);
+                wsJsonAddInteger(user, key, i);
+            }
+            return "wsJsonAddField past the index threshold";
+        }
+        case 14: wsJsonRemove(doc, "user.k7"); return "wsJsonRemove member";
+        case 15: wsJsonRemove(doc, "empty"); return "wsJsonRemove container";
+        case 16: wsJsonRemove(doc, "list"); return "wsJsonRemove array";
+        case 17: {
+            wsJson* patch = parseText("{\"user\": {\"name\": \"merged\", \"k3\": null}, \"tick\": 2}");
+            wsJsonMergePatch(doc, patch);
+            wsJsonFree(patch);
+            return "wsJsonMergePatch";
+        }
+        case 18: {
+            wsJson* patch = parseText("[{\"op\": \"add\", \"path\": \"/added/x/0\", \"value\": \"first\"}, "
+                                      "{\"op\": \"move\", \"from\": \"/user/k1\", \"path\": \"/moved\"}]");
+            wsJsonApplyPatch(doc, patch);
+            wsJsonFree(patch);
+            return "wsJsonApplyPatch";
+        }
+        default: return NULL;
+    }
+}
+
+static int32_t checkChanges(void) {
+    wsJson* doc = parseText("{\"tick\": 0, \"user\": {\"name\": \"someone\", \"score\": 1.5, \"active\": true, "
+                            "\"missing\": null}, \"nothing\": null, \"empty\": null, \"list\": [1, [2], 3]}");
+    wsJsonCache* cache = wsJsonCacheInit(doc);
+    wsJsonWriter full;
+    wsJsonWriterInitGrowable(&full, 0);
+    int32_t failed = 0;
+    const char* name = "start";
+    for (int32_t step = 0; name; name = applyChange(doc, step++)) {
+        full.used = 0;
+        wsJsonWrite(&full, doc);
+        wsJsonCacheUpdate(cache);
+        const wsJsonWriter* cached = &cache->outputs[cache->current];
+        if (cached->used != full.used || memcmp(cached->buffer, full.buffer, full.used) != 0) {
+            printf("cached output is DIFFERENT after %s\n", name);
+            failed++;
+        }
+    }
+    wsJsonCacheFree(cache);
+    wsJsonWriterFree(&full);
+    wsJsonFree(doc);
+    return failed;
+}
+
+int main(void) {
+    int32_t failed = checkChanges();
+    wsJson* state = buildState();
+    wsJsonCache* cache = wsJsonCacheInit(state);
+    wsJsonWriter full;
+    wsJsonWriterInitGrowable(&full, 0);
+
+    char key[64];
+    double fullSeconds = 0, cachedSeconds = 0, firstSeconds = 0;
+    int32_t mismatches = 0;
+    for (int32_t r = 0; r <= ROUNDS; r++) {
+        wsJsonSetInteger(state, "tick", r);
+        for (int32_t c = 0; c < CHANGES; c++) {
+            int32_t session = next() % SESSIONS;
+            snprintf(key, sizeof(key), "sessions.s%05d.position.x", session);
+            wsJsonSetNumber(state, key, (next() % 10000) / 10.0);
+            snprintf(key, sizeof(key), "sessions.s%05d.lastSeen", session);
+            wsJsonSetInteger(state, key, 1700000000123 + r);
+        }
+
+        full.used = 0;
+        double start = now();
+        wsJsonWrite(&full, state);
+        double written = now();
+        wsJsonCacheUpdate(cache);
+        double updated = now();
+        if (r == 0) {
+            firstSeconds = updated - written; // builds the records
+        }
+        else {
+            fullSeconds += written - start;
+            cachedSeconds += updated - written;
+        }
+
+        const wsJsonWriter* cached = &cache->outputs[cache->current];
+        if (cached->used != full.used || memcmp(cached->buffer, full.buffer, full.used) != 0) mismatches++;
+    }
+
+    printf("%.1f MB, %d changes per write\n", toMegabytes(full.used), CHANGES * 2 + 1);
+    printf("wsJsonWrite      %8.3f ms\n", fullSeconds / ROUNDS * 1e3);
+    printf("wsJsonCache      %8.3f ms  (first %.3f ms, %zu records)  %s\n", cachedSeconds / ROUNDS * 1e3, firstSeconds * 1e3,
+           cache->recordCount, mismatches ? "DIFFERENT" : "same output");
+    wsJsonCacheFree(cache);
+    wsJsonWriterFree(&full);
+    wsJsonFree(state);
+    return failed || mismatches ? 1 : 0;
+}
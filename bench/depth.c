@@ -0,0 +1,96 @@
+/*
+ *  Nesting benchmark
+ *  Parse, compact and pretty write and free of a wide document (one array
+ *  of small objects) and a deep one (a list of values nested
+ *  WS_JSON_MAX_DEPTH levels deep, alternating arrays and objects). The
+ *  indentation of the deep document would be gigabytes, so it is only
+ *  written compact.
+ */
+#define WS_JSON_IMPLEMENTATION
+#include "../src/wsJson.h"
+#include "bench.h"
+
+#include <stdio.h>
+
+#define TARGET_BYTES (32 * 1024 * 1024)
+#define ROUNDS 5
+
+static char* buildWide(size_t* length) {
+    char* data = malloc(TARGET_BYTES + 1024);
+    size_t used = sprintf(data, "{\"items\":[");
+    for (int32_t i = 0; used < TARGET_BYTES; i++) {
+        used += sprintf(data + used, "%s{\"id\":%d,\"name\":\"item\",\"score\":%d.5,\"ok\":true}", i ? "," : "", i, i % 1000);
+    }
+    used += sprintf(data + used, "]}");
+    *length = used;
+    return data;
+}
+
+static char* buildDeep(size_t* length) {
+    char* data = malloc(TARGET_BYTES + 64 * WS_JSON_MAX_DEPTH);
+    size_t used = sprintf(data, "{\"chains\":[");
+    for (int32_t chain = 0; used < TARGET_BYTES; chain++) {
+        if (chain) data[used++] = ',';
+        for (int32_t level = 1; level < WS_JSON_MAX_DEPTH - 1; level++) {
+            used += sprintf(data + used, level % 2 ? "{\"n\":%d,\"next\":" : "[%d,", level);
+        }
+        data[used++] = '0';
+        for (int32_t level = WS_JSON_MAX_DEPTH - 2; level >= 1; level--) data[used++] = level % 2 ? '}' : ']';
+    }
+    used += sprintf(data + used, "]}");
+    *length = used;
+    return data;
+}
+
+static void run(const char* name, const char* data, size_t length, bool pretty) {
+    wsJsonWriter writer;
+    wsJsonWriterInitGrowable(&writer, length * 2);
+    double parseSeconds = 0, writeSeconds = 0, prettySeconds = 0, freeSeconds = 0;
+    size_t prettyLength = 0;
+    for (int32_t r = 0; r < ROUNDS; r++) {
+        double start = now();
+        wsJson* root = wsJsonParse(data, length, 0);
+        double parsed = now();
+        if (!root) {
+            printf("%s: parse failed\n", name);
+            return;
+        }
+
+        writer.used = 0;
+        double written = now();
+        wsJsonWrite(&writer, root);
+        double compact = now();
+        if (pretty) {
+            writer.used = 0;
+            wsJsonWritePretty(&writer, root);
+            prettyLength = writer.used;
+        }
+        double indented = now();
+
+        wsJsonFree(root);
+        double freed = now();
+        parseSeconds += parsed - start;
+        writeSeconds += compact - written;
+        prettySeconds += indented - compact;
+        freeSeconds += freed - indented;
+    }
+    wsJsonWriterFree(&writer);
+
+    double megabytes = toMegabytes(length);
+    printf("%-5s %5.1f MB  parse %7.1f MB/s  write %7.1f MB/s", name, megabytes, megabytes * ROUNDS / parseSeconds,
+           megabytes * ROUNDS / writeSeconds);
+    if (pretty) printf("  pretty %7.1f MB/s (%.1f MB)", megabytes * ROUNDS / prettySeconds, toMegabytes(prettyLength));
+    printf("  free %7.2f ms\n", freeSeconds / ROUNDS * 1e3);
+}
+
+int main(void) {
+    size_t length;
+    char* wide = buildWide(&length);
+    run("wide", wide, length, true);
+    free(wide);
+
+    char* deep = buildDeep(&length);
+    run("deep", deep, length, false);
+    free(deep);
+    return 0;
+}
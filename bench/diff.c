@@ -0,0 +1,175 @@
+/*
+ *  Diff benchmark
+ *  A generated order history of about 10 MB and a copy with about 1% of
+ *  its values changed (prices, flags, added and removed orders). Times
+ *  wsJsonDiff and wsJsonDiffMerge against writing the whole document and
+ *  compares the size of the patches with the full output. The patch is
+ *  applied to a copy of the old document once to check it, small pairs
+ *  check both patch kinds on arrays that change length, removed keys and
+ *  type changes first. Exits with 1 when a patch is wrong.
+ */
+#define WS_JSON_IMPLEMENTATION
+#include "../src/wsJson.h"
+#include "bench.h"
+
+#include <stdio.h>
+
+#define TARGET_BYTES (10 * 1024 * 1024)
+#define CHANGE_PERCENT 1
+#define ROUNDS 5
+
+static wsJson* buildOrder(int32_t id) {
+    static const char* states[] = { "open", "paid", "shipped", "returned" };
+    wsJson* order = wsJsonInitObject(NULL);
+    wsJsonAddInteger(order, "id", id);
+    wsJsonAddString(order, "customer", "Jane Doe, 42 Long Street, Springfield");
+    wsJsonAddString(order, "state", states[next() & 3]);
+    wsJsonAddBool(order, "gift", next() & 1);
+    wsJson* items = wsJsonInitArray("items");
+    for (int32_t i = 0; i < 3; i++) {
+        wsJson* item = wsJsonInitObject(NULL);
+        wsJsonAddInteger(item, "sku", next() % 100000);
+        wsJsonAddNumber(item, "price", (next() % 10000) / 100.0);
+        wsJsonAddInteger(item, "quantity", 1 + next() % 5);
+        wsJsonAddElement(items, item);
+    }
+    wsJsonAddField(order, items);
+    return order;
+}
+
+static wsJson* buildHistory(void) {
+    wsJson* root = wsJsonInitObject(NULL);
+    wsJsonAddString(root, "shop", "example");
+    wsJson* orders = wsJsonInitArray("orders");
+    wsJsonAddField(root, orders);
+    for (int32_t id = 0; wsJsonToString(orders, NULL, 0) < TARGET_BYTES; id++) {
+        for (int32_t i = 0; i < 1000; i++) wsJsonAddElement(orders, buildOrder(id * 1000 + i));
+    }
+    return root;
+}
+
+// Changes about CHANGE_PERCENT of the orders, a new order at the end for every removed one
+static int32_t mutate(wsJson* root) {
+    wsJson* orders = wsJsonGet(root, "orders");
+    int32_t count = orders->array.elementCount;
+    int32_t changes = 0;
+    for (int32_t i = 0; i < count; i++) {
+        if (next() % 100 >= CHANGE_PERCENT) continue;
+        wsJson* order = orders->array.elements[i];
+        switch (next() % 3) {
+            case 0:
+                wsJsonSetString(order, "state", "refunded");
+                break;
+            case 1:
+                wsJsonSetNumber(wsJsonGet(order, "items")->array.elements[1], "price", 0.99);
+                break;
+            default:
+                wsJsonAddString(order, "note", "leave at the door");
+                break;
+        }
+        changes++;
+    }
+    char operation[96];
+    for (int32_t i = 0; i < count / 1000; i++) {
+        int32_t length = snprintf(operation, sizeof(operation), "[{\"op\": \"remove\", \"path\": \"/orders/%u\"}]", next() % (count - i));
+        wsJson* patch = wsJsonParse(operation, (size_t)length, 0);
+        wsJsonApplyPatch(root, patch);
+        wsJsonFree(patch);
+        wsJsonAddElement(orders, buildOrder(count + i));
+        changes += 2;
+    }
+    return changes;
+}
+
+// Pairs the generated history doesn't cover, b has no nulls as merge patches use them for removal
+static const char* cases[][2] = {
+    { "{\"a\": [1, 2, 3], \"b\": {\"c\": 1, \"d\": 2}}", "{\"a\": [1, 2], \"b\": {\"c\": 1}}" },
+    { "{\"a\": [1]}", "{\"a\": [1, 2, 3, {\"x\": true}], \"n\": \"new\"}" },
+    { "{\"a\": [1, 2, 3, 4, 5]}", "{\"a\": []}" },
+    { "{\"a\": []}", "{\"a\": [[1], [2, [3]]]}" },
+    { "{\"a\": {\"deep\": {\"k\": \"v\", \"gone\": 1}}, \"b\": [{\"x\": 1}, {\"y\": 2}]}",
+      "{\"a\": {\"deep\": {\"k\": \"w\"}}, \"b\": [{\"y\": 2}]}" },
+    { "{\"a\": 1, \"b\": \"s\", \"c\": null}", "{}" },
+    { "{\"t\": {\"x\": 1}, \"u\": [1, 2]}", "{\"t\": [1, 2], \"u\": {\"x\": 1}}" },
+    { "{\"k0\": 0, \"k1\": 1, \"k2\": 2, \"k3\": 3, \"k4\": 4, \"k5\": 5, \"k6\": 6, \"k7\": 7, \"k8\": 8, "
+      "\"k9\": 9, \"k10\": 10, \"k11\": 11, \"k12\": 12, \"k13\": 13, \"k14\": 14, \"k15\": 15, \"k16\": 16}",
+      "{\"k0\": 0, \"k2\": 2, \"k4\": 4, \"k6\": 6, \"k8\": 8, \"k10\": 10, \"k12\": 12, \"k14\": 14, \"k16\": 16, \"k17\": 17}" },
+    { "[1, 2, 3]", "[3]" },
+};
+
+static int32_t checkCases(void) {
+    int32_t failed = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        wsJson* a = wsJsonParse(cases[i][0], strlen(cases[i][0]), 0);
+        wsJson* b = wsJsonParse(cases[i][1], strlen(cases[i][1]), 0);
+
+        wsJson* patch = wsJsonDiff(a, b);
+        wsJson* check = wsJsonClone(a);
+        bool patched = patch && wsJsonApplyPatch(check, patch) == WS_OK && wsJsonEqual(check, b);
+        wsJsonFree(check);
+        wsJson* merge = wsJsonDiffMerge(a, b);
+        check = wsJsonClone(a);
+        bool merged = merge && wsJsonMergePatch(check, merge) == WS_OK && wsJsonEqual(check, b);
+        wsJsonFree(check);
+
+        if (!patched) printf("diff does NOT turn %s into %s\n", cases[i][0], cases[i][1]);
+        if (!merged) printf("diff merge does NOT turn %s into %s\n", cases[i][0], cases[i][1]);
+        failed += !patched + !merged;
+        wsJsonFree(patch);
+        wsJsonFree(merge);
+        wsJsonFree(a);
+        wsJsonFree(b);
+    }
+    return failed;
+}
+
+int main(void) {
+    int32_t failed = checkCases();
+    wsJson* before = buildHistory();
+    wsJson* after = wsJsonClone(before);
+    int32_t changes = mutate(after);
+
+    wsJsonWriter writer;
+    wsJsonWriterInitGrowable(&writer, 0);
+    double writeSeconds = 0, diffSeconds = 0, mergeSeconds = 0;
+    size_t patchLength = 0, mergeLength = 0;
+    int32_t operations = 0;
+    for (int32_t r = 0; r < ROUNDS; r++) {
+        writer.used = 0;
+        double start = now();
+        wsJsonWrite(&writer, after);
+        double written = now();
+        wsJson* patch = wsJsonDiff(before, after);
+        double diffed = now();
+        wsJson* merge = wsJsonDiffMerge(before, after);
+        double merged = now();
+        writeSeconds += written - start;
+        diffSeconds += diffed - written;
+        mergeSeconds += merged - diffed;
+
+        operations = patch->array.elementCount;
+        patchLength = wsJsonToString(patch, NULL, 0);
+        mergeLength = wsJsonToString(merge, NULL, 0);
+        if (r == 0) {
+            wsJson* check = wsJsonClone(before);
+            bool same = wsJsonApplyPatch(check, patch) == WS_OK && wsJsonEqual(check, after);
+            if (!same) {
+                printf("patch does NOT turn the old document into the new one\n");
+                failed++;
+            }
+            wsJsonFree(check);
+        }
+        wsJsonFree(patch);
+        wsJsonFree(merge);
+    }
+
+    double megabytes = toMegabytes(writer.used);
+    printf("%.1f MB, %d changes\n", megabytes, changes);
+    printf("write       %8.2f ms  %9zu bytes\n", writeSeconds / ROUNDS * 1e3, writer.used);
+    printf("diff        %8.2f ms  %9zu bytes  %d operations\n", diffSeconds / ROUNDS * 1e3, patchLength, operations);
+    printf("diff merge  %8.2f ms  %9zu bytes\n", mergeSeconds / ROUNDS * 1e3, mergeLength);
+    wsJsonWriterFree(&writer);
+    wsJsonFree(before);
+    wsJsonFree(after);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,104 @@
+/*
+ *  Frozen snapshot benchmark
+ *  Cold start of a generated product catalog: reading and parsing the json
+ *  file against mapping its frozen snapshot, each followed by the same
+ *  lookups. The page cache is warm for both, so the numbers show the cost
+ *  of getting to the first query.
+ */
+#define WS_JSON_IMPLEMENTATION
+#include "../src/wsJson.h"
+#include "bench.h"
+
+#include <stdio.h>
+
+#define PRODUCTS 200000
+#define LOOKUPS 1000
+#define ROUNDS 5
+
+static wsJson* buildCatalog(void) {
+    static const char* categories[] = { "tools", "garden", "kitchen", "office", "toys" };
+    wsJson* root = wsJsonInitObject(NULL);
+    wsJsonAddString(root, "name", "catalog");
+    wsJsonAddInteger(root, "generated", 1700000000123);
+    wsJson* products = wsJsonInitObject("products");
+    char key[32];
+    uint32_t seed = 1;
+    for (int32_t i = 0; i < PRODUCTS; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        snprintf(key, sizeof(key), "sku-%07d", i);
+        wsJson* product = wsJsonInitObject(key);
+        wsJsonAddInteger(product, "id", i);
+        wsJsonAddString(product, "title", "Cordless drill with two batteries and a case");
+        wsJsonAddString(product, "category", categories[seed >> 29 & 3]);
+        wsJsonAddNumber(product, "price", (seed % 100000) / 100.0);
+        wsJsonAddBool(product, "inStock", seed & 1);
+        wsJson* sizes = wsJsonInitArray("sizes");
+        for (int32_t s = 0; s < 3; s++) wsJsonAddElement(sizes, wsJsonInitInteger(NULL, 10 + s));
+        wsJsonAddField(product, sizes);
+        wsJsonAddField(products, product);
+    }
+    wsJsonAddField(root, products);
+    return root;
+}
+
+static void writeFile(const char* path, const char* data, size_t length) {
+    FILE* file = fopen(path, "wb");
+    fwrite(data, 1, length, file);
+    fclose(file);
+}
+
+int main(void) {
+    const char* jsonPath = "/tmp/wsJson-catalog.json";
+    const char* frozenPath = "/tmp/wsJson-catalog.frozen";
+    wsJson* catalog = buildCatalog();
+
+    wsJsonWriter writer;
+    wsJsonWriterInitGrowable(&writer, 0);
+    wsJsonWrite(&writer, catalog);
+    writeFile(jsonPath, writer.buffer, writer.used);
+    size_t jsonLength = writer.used;
+    wsJsonWriterFree(&writer);
+
+    wsJsonWriterInitGrowable(&writer, 0);
+    double start = now();
+    wsJsonFreeze(&writer, catalog);
+    double freezeSeconds = now() - start;
+    writeFile(frozenPath, writer.buffer, writer.used);
+    size_t frozenLength = writer.used;
+    wsJsonWriterFree(&writer);
+    wsJsonFree(catalog);
+    printf("%d products  json %.1f MB  frozen %.1f MB  (freeze %.1f ms)\n", PRODUCTS, toMegabytes(jsonLength),
+           toMegabytes(frozenLength), freezeSeconds * 1e3);
+
+    char keys[LOOKUPS][48];
+    for (int32_t i = 0; i < LOOKUPS; i++) snprintf(keys[i], sizeof(keys[i]), "products.sku-%07d.price", (i * 7919) % PRODUCTS);
+
+    double parseSeconds = 0, parseLookupSeconds = 0, openSeconds = 0, frozenLookupSeconds = 0;
+    double checkParsed = 0, checkFrozen = 0;
+    for (int32_t r = 0; r < ROUNDS; r++) {
+        start = now();
+        wsJsonFile* file = wsJsonParseFile(jsonPath, WS_JSON_PARSE_VIEWS);
+        double parsed = now();
+        for (int32_t i = 0; i < LOOKUPS; i++) checkParsed += wsJsonGetNumber(file->root, keys[i]);
+        double done = now();
+        parseSeconds += parsed - start;
+        parseLookupSeconds += done - parsed;
+        wsJsonFileFree(file);
+
+        start = now();
+        wsJsonFrozenFile* frozen = wsJsonFrozenOpen(frozenPath);
+        double opened = now();
+        for (int32_t i = 0; i < LOOKUPS; i++) checkFrozen += wsJsonFrozenGetNumber(frozen->root, keys[i]);
+        done = now();
+        openSeconds += opened - start;
+        frozenLookupSeconds += done - opened;
+        wsJsonFrozenClose(frozen);
+    }
+
+    printf("parse   open %9.3f ms  %d lookups %7.3f ms\n", parseSeconds / ROUNDS * 1e3, LOOKUPS, parseLookupSeconds / ROUNDS * 1e3);
+    printf("frozen  open %9.3f ms  %d lookups %7.3f ms  %s\n", openSeconds / ROUNDS * 1e3, LOOKUPS, frozenLookupSeconds / ROUNDS * 1e3,
+           checkParsed == checkFrozen ? "same results" : "DIFFERENT");
+    remove(jsonPath);
+    remove(frozenPath);
+    return 0;
+}
@@ -0,0 +1,135 @@
+/*
+ *  Node layout benchmark
+ *  Compares the old node layout (inline 64 byte key buffer) against the 
+ *  current one: node size, nodes per cache line and tree walk throughput.
+ */
+#define WS_JSON_IMPLEMENTATION
+#include "../src/wsJson.h"
+#include "bench.h"
+
+#define CACHE_LINE 64
+#define ARRAY_SIZE (1 << 20)
+#define ROW_COUNT (1 << 17)
+#define WALK_ROUNDS 10
+
+// Replica of the node before the compact layout
+typedef struct legacyJson {
+    char key[WS_JSON_MAX_KEY_SIZE];
+    wsJsonType type;
+    union {
+        char* stringValue;
+        double numberValue;
+        bool boolValue;
+        struct {
+            struct legacyJson** children;
+            int32_t childCount;
+            int32_t childCapacity;
+        } object;
+    };
+} legacyJson;
+
+static legacyJson* legacyInit(wsJsonType type, const char* key) {
+    legacyJson* node = calloc(1, sizeof(legacyJson));
+    node->type = type;
+    if (key) strncpy(node->key, key, sizeof(node->key) - 1);
+    return node;
+}
+
+static void legacyAdd(legacyJson* parent, legacyJson* child) {
+    if (parent->object.childCount >= parent->object.childCapacity) {
+        parent->object.childCapacity = parent->object.childCapacity ? parent->object.childCapacity * 2 : 4;
+        parent->object.children = realloc(parent->object.children, sizeof(legacyJson*) * parent->object.childCapacity);
+    }
+    parent->object.children[parent->object.childCount++] = child;
+}
+
+static void legacyFree(legacyJson* node) {
+    if (node->type == WS_JSON_OBJECT || node->type == WS_JSON_ARRAY) {
+        for (int32_t i = 0; i < node->object.childCount; i++) legacyFree(node->object.children[i]);
+        free(node->object.children);
+    }
+    free(node);
+}
+
+static double legacyWalk(legacyJson* node) {
+    if (node->type == WS_JSON_NUMBER) return node->numberValue + node->key[0];
+    double sum = 0;
+    if (node->type == WS_JSON_OBJECT || node->type == WS_JSON_ARRAY) {
+        for (int32_t i = 0; i < node->object.childCount; i++) sum += legacyWalk(node->object.children[i]);
+    }
+    return sum;
+}
+
+static double walk(wsJson* node) {
+    if (node->type == WS_JSON_NUMBER) return node->numberValue + node->key[0];
+    double sum = 0;
+    if (node->type == WS_JSON_OBJECT) {
+        for (int32_t i = 0; i < node->object.childCount; i++) sum += walk(node->object.children[i]);
+    }
+    else if (node->type == WS_JSON_ARRAY) {
+        for (int32_t i = 0; i < node->array.elementCount; i++) sum += walk(node->array.elements[i]);
+    }
+    return sum;
+}
+
+static void report(const char* name, int64_t nodes, double legacySeconds, double seconds) {
+    printf("%-16s legacy %8.1f Mnodes/s   compact %8.1f Mnodes/s   (%.2fx)\n", name,
+           nodes * WALK_ROUNDS / legacySeconds * 1e-6, nodes * WALK_ROUNDS / seconds * 1e-6, legacySeconds / seconds);
+}
+
+int main(void) {
+    printf("node size        legacy %4zu bytes (%.2f per cache line)   compact %4zu bytes (%.2f per cache line)\n",
+           sizeof(legacyJson), (double)CACHE_LINE / sizeof(legacyJson), sizeof(wsJson), (double)CACHE_LINE / sizeof(wsJson));
+
+    volatile double sink = 0;
+
+    // Flat number array
+    legacyJson* legacyArray = legacyInit(WS_JSON_ARRAY, NULL);
+    wsJson* array = wsJsonInitArray(NULL);
+    for (int32_t i = 0; i < ARRAY_SIZE; i++) {
+        legacyJson* number = legacyInit(WS_JSON_NUMBER, NULL);
+        number->numberValue = i;
+        legacyAdd(legacyArray, number);
+        wsJsonAddElement(array, wsJsonInitNumber(NULL, i));
+    }
+
+    double start = now();
+    for (int32_t r = 0; r < WALK_ROUNDS; r++) sink += legacyWalk(legacyArray);
+    double legacySeconds = now() - start;
+    start = now();
+    for (int32_t r = 0; r < WALK_ROUNDS; r++) sink += walk(array);
+    report("number array", ARRAY_SIZE + 1, legacySeconds, now() - start);
+
+    legacyFree(legacyArray);
+    wsJsonFree(array);
+
+    // Array of small keyed objects
+    static const char* keys[] = { "id", "x", "y", "timestamp" };
+    legacyJson* legacyRows = legacyInit(WS_JSON_ARRAY, NULL);
+    wsJson* rows = wsJsonInitArray(NULL);
+    for (int32_t i = 0; i < ROW_COUNT; i++) {
+        legacyJson* legacyRow = legacyInit(WS_JSON_OBJECT, NULL);
+        wsJson* row = wsJsonInitObject(NULL);
+        for (int32_t k = 0; k < 4; k++) {
+            legacyJson* field = legacyInit(WS_JSON_NUMBER, keys[k]);
+            field->numberValue = i + k;
+            legacyAdd(legacyRow, field);
+            wsJsonAddNumber(row, keys[k], i + k);
+        }
+        legacyAdd(legacyRows, legacyRow);
+        wsJsonAddElement(rows, row);
+    }
+
+    start = now();
+    for (int32_t r = 0; r < WALK_ROUNDS; r++) sink += legacyWalk(legacyRows);
+    legacySeconds = now() - start;
+    start = now();
+    for (int32_t r = 0; r < WALK_ROUNDS; r++) sink += walk(rows);
+    report("object rows", (int64_t)ROW_COUNT * 5 + 1, legacySeconds, now() - start);
+
+    legacyFree(legacyRows);
+    wsJsonFree(rows);
+
+    (void)sink;
+    return 0;
+}
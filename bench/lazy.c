@@ -0,0 +1,91 @@
+/*
+ *  Lazy document benchmark
+ *  Cost per message when only a few fields are read: full parse (heap and 
+ *  arena with views) followed by wsJsonGet against lazy lookups, for 
+ *  messages between 5 and 50 KB.
+ */
+#define WS_JSON_IMPLEMENTATION
+#include "../src/wsJson.h"
+#include "bench.h"
+
+#define TARGET_BYTES (128 * 1024 * 1024)
+
+// Header fields first, a large payload in the middle and a trailer field at the end
+static char* buildMessage(int32_t payloadItems, size_t* length) {
+    wsJson* root = wsJsonInitObject(NULL);
+    wsJsonAddString(root, "type", "update");
+    wsJson* user = wsJsonInitObject("user");
+    wsJsonAddInteger(user, "id", 123456789);
+    wsJsonAddString(user, "name", "someone");
+    wsJsonAddField(root, user);
+
+    wsJson* payload = wsJsonInitArray("payload");
+    for (int32_t i = 0; i < payloadItems; i++) {
+        wsJson* item = wsJsonInitObject(NULL);
+        wsJsonAddInteger(item, "id", i);
+        wsJsonAddString(item, "label", "some text that nobody reads in this code path");
+        wsJsonAddNumber(item, "value", i * 1.5);
+        wsJson* flags = wsJsonInitArray("flags");
+        wsJsonAddElement(flags, wsJsonInitBool(NULL, true));
+        wsJsonAddElement(flags, wsJsonInitNull(NULL));
+        wsJsonAddField(item, flags);
+        wsJsonAddElement(payload, item);
+    }
+    wsJsonAddField(root, payload);
+    wsJsonAddInteger(root, "sequence", 99);
+
+    wsJsonWriter writer;
+    wsJsonWriterInitGrowable(&writer, 0);
+    wsJsonWrite(&writer, root);
+    wsJsonFree(root);
+    *length = writer.used;
+    return writer.buffer;
+}
+
+static void run(int32_t payloadItems) {
+    size_t length;
+    char* message = buildMessage(payloadItems, &length);
+    int32_t rounds = (int32_t)(TARGET_BYTES / length) + 1;
+    double check = 0.0;
+
+    double start = now();
+    for (int32_t r = 0; r < rounds; r++) {
+        wsJson* doc = wsJsonParse(message, length, 0);
+        check += wsJsonGetInteger(doc, "user.id") + wsJsonGetInteger(doc, "sequence") + wsJsonGetString(doc, "type")[0];
+        wsJsonFree(doc);
+    }
+    double fullSeconds = now() - start;
+
+    wsJsonArena* arena = wsJsonArenaInit(0);
+    wsJsonSetArena(arena);
+    start = now();
+    for (int32_t r = 0; r < rounds; r++) {
+        wsJson* doc = wsJsonParse(message, length, WS_JSON_PARSE_VIEWS);
+        size_t typeLength;
+        check += wsJsonGetInteger(doc, "user.id") + wsJsonGetInteger(doc, "sequence") + wsJsonGetStringView(doc, "type", &typeLength)[0];
+        wsJsonArenaReset(arena);
+    }
+    double arenaSeconds = now() - start;
+    wsJsonSetArena(NULL);
+    wsJsonArenaFree(arena);
+
+    start = now();
+    for (int32_t r = 0; r < rounds; r++) {
+        wsJsonLazy doc;
+        wsJsonLazyInit(&doc, message, length, 0);
+        size_t typeLength;
+        check += wsJsonLazyGetInteger(&doc, "user.id") + wsJsonLazyGetInteger(&doc, "sequence") + wsJsonLazyGetStringView(&doc, "type", &typeLength)[0];
+    }
+    double lazySeconds = now() - start;
+
+    printf("%6.1f KB  full %8.2f us  arena+views %8.2f us  lazy %8.2f us per message (check %g)\n", length / 1024.0,
+           fullSeconds / rounds * 1e6, arenaSeconds / rounds * 1e6, lazySeconds / rounds * 1e6, check);
+    free(message);
+}
+
+int main(void) {
+    run(50);
+    run(200);
+    run(500);
+    return 0;
+}
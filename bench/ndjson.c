@@ -0,0 +1,75 @@
+/*
+ *  NDJSON batch benchmark
+ *  Parses a generated log file of 256 MB (one json document per line)
+ *  with 1, 2, 4 and 8 threads, keeping every record (wsJsonParseLines) and
+ *  streaming them to a callback (wsJsonEachLine).
+ */
+#define WS_JSON_IMPLEMENTATION
+#include "../src/wsJson.h"
+#include "bench.h"
+
+#include <stdio.h>
+
+#define TARGET_BYTES (256 * 1024 * 1024)
+
+static char* buildLog(size_t* length, size_t* lines) {
+    static const char* levels[] = { "debug", "info", "warning", "error" };
+    static const char* paths[] = { "/api/v1/users", "/api/v1/orders/search", "/health", "/static/app.js" };
+
+    char* data = malloc(TARGET_BYTES + 1024);
+    size_t used = 0;
+    *lines = 0;
+    uint32_t seed = 1;
+    while (used < TARGET_BYTES) {
+        seed = seed * 1664525u + 1013904223u;
+        used += sprintf(data + used,
+            "{\"ts\":%lld,\"level\":\"%s\",\"request\":{\"method\":\"GET\",\"path\":\"%s\",\"status\":%u,\"ms\":%.3f},"
+            "\"user\":{\"id\":%u,\"tags\":[\"a\",\"b\",\"c\"]},\"message\":\"request finished in the usual amount of time\"}\n",
+            1700000000000LL + *lines, levels[seed >> 30], paths[(seed >> 28) & 3], 200 + (seed >> 24) % 300,
+            (seed >> 8) % 100000 / 1000.0, seed % 1000000);
+        (*lines)++;
+    }
+    *length = used;
+    return data;
+}
+
+static int32_t countStatus(void* user, wsJson* record, size_t offset, int32_t worker) {
+    (void)offset;
+    int64_t* sums = user;
+    if (record) sums[worker * 8] += wsJsonGetInteger(record, "request.status");
+    return WS_OK;
+}
+
+int main(void) {
+    size_t length, lines;
+    char* data = buildLog(&length, &lines);
+    wsJsonPool* cpus = wsJsonPoolInit(0);
+    printf("%zu records, %.1f MB, %d cpus online\n", lines, toMegabytes(length), cpus->threadCount);
+    wsJsonPoolFree(cpus);
+
+    int32_t threadCounts[] = { 1, 2, 4, 8 };
+    for (int32_t i = 0; i < 4; i++) {
+        wsJsonPool* pool = wsJsonPoolInit(threadCounts[i]);
+
+        double start = now();
+        wsJsonBatch* batch = wsJsonParseLines(pool, data, length, WS_JSON_PARSE_VIEWS);
+        double batchSeconds = now() - start;
+        size_t records = batch ? batch->recordCount - batch->errorCount : 0;
+        wsJsonBatchFree(batch);
+
+        // Padded so the workers don't share a cache line
+        int64_t sums[8 * 8] = { 0 };
+        start = now();
+        wsJsonEachLine(pool, data, length, WS_JSON_PARSE_VIEWS, countStatus, sums);
+        double eachSeconds = now() - start;
+        int64_t check = 0;
+        for (int32_t w = 0; w < 8; w++) check += sums[w * 8];
+
+        printf("%d threads  batch %8.0f krecords/s %7.1f MB/s  callback %8.0f krecords/s %7.1f MB/s  (%zu records, check %lld)\n",
+               threadCounts[i], lines / batchSeconds / 1e3, toMegabytes(length) / batchSeconds,
+               lines / eachSeconds / 1e3, toMegabytes(length) / eachSeconds, records, (long long)check);
+        wsJsonPoolFree(pool);
+    }
+    free(data);
+    return 0;
+}
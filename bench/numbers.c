@@ -0,0 +1,143 @@
+/*
+ *  Number benchmark
+ *  Conversion speed of the number parser against strtod and of the 
+ *  formatter against snprintf, followed by parse and write throughput 
+ *  of number heavy documents.
+ */
+#define WS_JSON_IMPLEMENTATION
+#include "../src/wsJson.h"
+#include "bench.h"
+
+#define COUNT 200000
+#define ROUNDS 20
+
+static uint64_t randomState = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t nextRandom(void) {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 7;
+    randomState ^= randomState << 17;
+    return randomState;
+}
+
+typedef enum { INTEGERS, DECIMALS, DOUBLES } Kind;
+static const char* kindNames[] = { "integers", "decimals", "doubles" };
+
+static double randomValue(Kind kind) {
+    switch (kind) {
+        case INTEGERS: return (double)(1700000000000LL + (int64_t)(nextRandom() % 100000000));
+        case DECIMALS: return (double)(nextRandom() % 10000000) / 1000.0;
+        default: return (double)nextRandom() / (double)UINT64_MAX * 1e6 - 5e5;
+    }
+}
+
+// NUL separated number tokens
+static char* buildTokens(Kind kind, size_t* length) {
+    char* tokens = malloc(COUNT * 32);
+    size_t used = 0;
+    for (int32_t i = 0; i < COUNT; i++) {
+        double value = randomValue(kind);
+        if (kind == INTEGERS) used += sprintf(tokens + used, "%lld", (long long)value) + 1;
+        else if (kind == DECIMALS) used += sprintf(tokens + used, "%.3f", value) + 1;
+        else used += sprintf(tokens + used, "%.17g", value) + 1;
+    }
+    *length = used;
+    return tokens;
+}
+
+static void benchParse(Kind kind) {
+    size_t length;
+    char* tokens = buildTokens(kind, &length);
+    double sum = 0.0;
+
+    double start = now();
+    for (int32_t r = 0; r < ROUNDS; r++) {
+        for (const char* cursor = tokens; cursor < tokens + length; cursor += strlen(cursor) + 1) {
+            sum += strtod(cursor, NULL);
+        }
+    }
+    double strtodSeconds = now() - start;
+
+    start = now();
+    for (int32_t r = 0; r < ROUNDS; r++) {
+        for (const char* cursor = tokens; cursor < tokens + length;) {
+            double value;
+            int64_t integer;
+            bool isInteger;
+            cursor = _wsJsonParseNumber(cursor, tokens + length, &value, &integer, &isInteger) + 1;
+            sum -= value;
+        }
+    }
+    double wsSeconds = now() - start;
+
+    printf("parse  %-9s strtod %7.1f  wsJson %7.1f Mnumbers/s (check %g)\n", kindNames[kind],
+           COUNT * (double)ROUNDS / strtodSeconds / 1e6, COUNT * (double)ROUNDS / wsSeconds / 1e6, sum);
+    free(tokens);
+}
+
+static void benchFormat(Kind kind) {
+    double* values = malloc(COUNT * sizeof(double));
+    for (int32_t i = 0; i < COUNT; i++) values[i] = randomValue(kind);
+    char buffer[64];
+    size_t total = 0;
+
+    double start = now();
+    for (int32_t r = 0; r < ROUNDS; r++) {
+        for (int32_t i = 0; i < COUNT; i++) total += snprintf(buffer, sizeof(buffer), "%.17g", values[i]);
+    }
+    double snprintfSeconds = now() - start;
+
+    start = now();
+    for (int32_t r = 0; r < ROUNDS; r++) {
+        for (int32_t i = 0; i < COUNT; i++) total += _wsJsonFormatDouble(values[i], buffer);
+    }
+    double wsSeconds = now() - start;
+
+    printf("format %-9s %%.17g  %7.1f  wsJson %7.1f Mnumbers/s (bytes %zu)\n", kindNames[kind],
+           COUNT * (double)ROUNDS / snprintfSeconds / 1e6, COUNT * (double)ROUNDS / wsSeconds / 1e6, total);
+    free(values);
+}
+
+static void benchDocument(Kind kind) {
+    wsJson* root = wsJsonInitObject(NULL);
+    wsJson* values = wsJsonInitArray("values");
+    for (int32_t i = 0; i < COUNT; i++) {
+        if (kind == INTEGERS) wsJsonAddElement(values, wsJsonInitInteger(NULL, (int64_t)randomValue(kind)));
+        else wsJsonAddElement(values, wsJsonInitNumber(NULL, randomValue(kind)));
+    }
+    wsJsonAddField(root, values);
+
+    wsJsonWriter writer;
+    wsJsonWriterInitGrowable(&writer, 0);
+    double start = now();
+    for (int32_t r = 0; r < ROUNDS; r++) {
+        writer.used = 0;
+        writer.length = 0;
+        wsJsonWrite(&writer, root);
+    }
+    double writeSeconds = now() - start;
+    wsJsonFree(root);
+
+    wsJsonArena* arena = wsJsonArenaInit(0);
+    wsJsonSetArena(arena);
+    start = now();
+    for (int32_t r = 0; r < ROUNDS; r++) {
+        const char* cursor = writer.buffer;
+        wsStringToJson(&cursor);
+        wsJsonArenaReset(arena);
+    }
+    double parseSeconds = now() - start;
+    wsJsonSetArena(NULL);
+    wsJsonArenaFree(arena);
+
+    double megabytes = toMegabytes((double)writer.used * ROUNDS);
+    printf("document %-9s parse %7.1f MB/s  write %7.1f MB/s\n", kindNames[kind], megabytes / parseSeconds, megabytes / writeSeconds);
+    wsJsonWriterFree(&writer);
+}
+
+int main(void) {
+    for (Kind kind = INTEGERS; kind <= DOUBLES; kind++) benchParse(kind);
+    for (Kind kind = INTEGERS; kind <= DOUBLES; kind++) benchFormat(kind);
+    for (Kind kind = INTEGERS; kind <= DOUBLES; kind++) benchDocument(kind);
+    return 0;
+}
@@ -0,0 +1,78 @@
+/*
+ *  Parallel serialization benchmark
+ *  Writes a snapshot with an array of one million objects into a growable
+ *  buffer and through wsJsonWriteVec (no stitching copy), single threaded
+ *  and with 1, 2, 4 and 8 pool threads. Outputs are checked to be equal.
+ */
+#define WS_JSON_IMPLEMENTATION
+#include "../src/wsJson.h"
+#include "bench.h"
+
+#include <stdio.h>
+
+#define ITEMS 1000000
+
+static wsJson* buildSnapshot(void) {
+    wsJson* root = wsJsonInitObject(NULL);
+    wsJsonAddInteger(root, "version", 3);
+    wsJson* entities = wsJsonInitArray("entities");
+    for (int32_t i = 0; i < ITEMS; i++) {
+        wsJson* entity = wsJsonInitObject(NULL);
+        wsJsonAddInteger(entity, "id", i);
+        wsJsonAddString(entity, "name", "entity");
+        wsJsonAddNumber(entity, "x", i * 0.25);
+        wsJsonAddNumber(entity, "y", i / 3.0);
+        wsJsonAddBool(entity, "active", i % 3 == 0);
+        wsJsonAddElement(entities, entity);
+    }
+    wsJsonAddField(root, entities);
+    return root;
+}
+
+static int32_t countSlices(void* user, const wsJsonSlice* slices, size_t count) {
+    size_t* total = user;
+    for (size_t i = 0; i < count; i++) *total += slices[i].size;
+    return WS_OK;
+}
+
+int main(void) {
+    wsJson* root = buildSnapshot();
+
+    for (int32_t pretty = 0; pretty < 2; pretty++) {
+        wsJsonWriter reference;
+        wsJsonWriterInitGrowable(&reference, 0);
+        double start = now();
+        if (pretty) wsJsonWritePretty(&reference, root);
+        else wsJsonWrite(&reference, root);
+        double singleSeconds = now() - start;
+        printf("%s %.1f MB  wsJsonWrite%s %7.1f MB/s\n", pretty ? "pretty " : "compact", toMegabytes(reference.used),
+               pretty ? "Pretty" : "      ", toMegabytes(reference.used) / singleSeconds);
+
+        int32_t threadCounts[] = { 1, 2, 4, 8 };
+        for (int32_t i = 0; i < 4; i++) {
+            wsJsonPool* pool = wsJsonPoolInit(threadCounts[i]);
+
+            wsJsonWriter writer;
+            wsJsonWriterInitGrowable(&writer, 0);
+            start = now();
+            if (pretty) wsJsonWritePrettyParallel(pool, &writer, root);
+            else wsJsonWriteParallel(pool, &writer, root);
+            double bufferSeconds = now() - start;
+            bool same = writer.used == reference.used && memcmp(writer.buffer, reference.buffer, reference.used) == 0;
+            wsJsonWriterFree(&writer);
+
+            size_t total = 0;
+            start = now();
+            wsJsonWriteVec(pool, root, pretty, countSlices, &total);
+            double vecSeconds = now() - start;
+
+            printf("  %d threads  buffer %7.1f MB/s  vec %7.1f MB/s  %s\n", threadCounts[i],
+                   toMegabytes(reference.used) / bufferSeconds, toMegabytes(reference.used) / vecSeconds,
+                   same && total == reference.used ? "identical" : "DIFFERENT");
+            wsJsonPoolFree(pool);
+        }
+        wsJsonWriterFree(&reference);
+    }
+    wsJsonFree(root);
+    return 0;
+}
@@ -0,0 +1,91 @@
+/*
+ *  SIMD scanning benchmark
+ *  Parse throughput for every simd level supported by this cpu on a 
+ *  whitespace heavy (pretty printed) and a string heavy document.
+ */
+#define WS_JSON_IMPLEMENTATION
+#include "../src/wsJson.h"
+#include "bench.h"
+
+#define TARGET_BYTES (64 * 1024 * 1024)
+
+static char* buildPretty(void) {
+    wsJson* root = wsJsonInitObject(NULL);
+    wsJson* items = wsJsonInitArray("items");
+    for (int32_t i = 0; i < 2000; i++) {
+        wsJson* item = wsJsonInitObject(NULL);
+        wsJsonAddNumber(item, "id", i);
+        wsJsonAddString(item, "name", "item");
+        wsJson* nested = wsJsonInitObject("nested");
+        wsJson* deeper = wsJsonInitObject("deeper");
+        wsJsonAddBool(deeper, "enabled", i % 2);
+        wsJsonAddNull(deeper, "parent");
+        wsJsonAddField(nested, deeper);
+        wsJsonAddField(item, nested);
+        wsJsonAddElement(items, item);
+    }
+    wsJsonAddField(root, items);
+
+    wsJsonWriter writer;
+    wsJsonWriterInitGrowable(&writer, 0);
+    wsJsonWritePretty(&writer, root);
+    wsJsonFree(root);
+    return writer.buffer;
+}
+
+static char* buildStrings(void) {
+    wsJson* root = wsJsonInitObject(NULL);
+    char value[512];
+    for (int32_t i = 0; i < 2000; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "message_%d", i);
+        int32_t length = 64 + (i * 37) % 400;
+        for (int32_t c = 0; c < length; c++) value[c] = 'a' + (c * 7 + i) % 26;
+        value[length] = '\0';
+        if (i % 5 == 0) memcpy(value + length / 2, "\\\"", 2); // some escapes
+        wsJsonAddString(root, key, value);
+    }
+
+    wsJsonWriter writer;
+    wsJsonWriterInitGrowable(&writer, 0);
+    wsJsonWrite(&writer, root);
+    wsJsonFree(root);
+    return writer.buffer;
+}
+
+static void run(const char* name, const char* doc) {
+    size_t length = strlen(doc);
+    int32_t rounds = (int32_t)(TARGET_BYTES / length) + 1;
+    wsJsonArena* arena = wsJsonArenaInit(0);
+
+    for (int32_t level = WS_JSON_SIMD_SCALAR; level <= WS_JSON_SIMD_NEON; level++) {
+        if (!_wsJsonSimdSupported(level)) continue;
+        wsJsonSetSimdLevel(level);
+
+        wsJsonSetArena(arena);
+        double start = now();
+        for (int32_t r = 0; r < rounds; r++) {
+            const char* cursor = doc;
+            wsStringToJsonEx(&cursor, WS_JSON_PARSE_VIEWS);
+            wsJsonArenaReset(arena);
+        }
+        double seconds = now() - start;
+        wsJsonSetArena(NULL);
+
+        printf("%-12s %-8s %8.1f MB/s\n", name, wsJsonSimdLevelToString(level), 
+               toMegabytes((double)length * rounds) / seconds);
+    }
+    wsJsonArenaFree(arena);
+}
+
+int main(void) {
+    char* pretty = buildPretty();
+    char* strings = buildStrings();
+
+    run("whitespace", pretty);
+    run("strings", strings);
+
+    free(pretty);
+    free(strings);
+    return 0;
+}
@@ -0,0 +1,546 @@
+/*
+ *  Benchmark suite
+ *  Generates a deterministic corpus (twitter like statuses, number heavy
+ *  coordinates, string heavy documents, deep nesting, a wide object and
+ *  NDJSON records) and measures for every document: build and free time
+ *  through the API, parse MB/s (heap and arena with views), serialize MB/s,
+ *  wsJsonGet ns/op, the peak memory of a parsed document and how many
+ *  allocator calls a parse takes with and without the block pools.
+ *  The table goes to stdout followed by a one line json summary, pass a
+ *  path to also write the summary there (make bench writes bench/bin/summary.json).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+// Counting allocator, every block carries its size in a 16 byte header
+static size_t benchCurrent;
+static size_t benchPeak;
+static size_t benchCalls;
+
+static void* benchMalloc(size_t size) {
+    benchCalls++;
+    size_t* block = malloc(size + 16);
+    if (!block) return NULL;
+    *block = size;
+    benchCurrent += size;
+    if (benchCurrent > benchPeak) benchPeak = benchCurrent;
+    return (char*)block + 16;
+}
+
+static void benchFree(void* ptr) {
+    if (!ptr) return;
+    size_t* block = (size_t*)((char*)ptr - 16);
+    benchCurrent -= *block;
+    free(block);
+}
+
+static void* benchRealloc(void* ptr, size_t size) {
+    if (!ptr) return benchMalloc(size);
+    benchCalls++;
+    size_t* block = (size_t*)((char*)ptr - 16);
+    size_t old = *block;
+    block = realloc(block, size + 16);
+    if (!block) return NULL;
+    *block = size;
+    benchCurrent += size - old;
+    if (benchCurrent > benchPeak) benchPeak = benchCurrent;
+    return (char*)block + 16;
+}
+
+#define WS_JSON_MALLOC(size) benchMalloc(size)
+#define WS_JSON_REALLOC(ptr, size) benchRealloc(ptr, size)
+#define WS_JSON_FREE(ptr) benchFree(ptr)
+
+#define WS_JSON_IMPLEMENTATION
+#include "../src/wsJson.h"
+#include "bench.h"
+
+#define MIN_SECONDS 0.25
+#define MAX_ROUNDS 50
+#define LOOKUPS 200000
+#define LOOKUP_KEYS 1024
+
+static const char* words[] = { "json", "parser", "fast", "tree", "value", "cache", "stream", "batch", "index", "token",
+                               "river", "mountain", "coffee", "city", "night", "music" };
+
+static void sentence(char* out, int32_t count) {
+    out[0] = '\0';
+    for (int32_t i = 0; i < count; i++) {
+        strcat(out, words[next() % 16]);
+        strcat(out, i + 1 < count ? " " : "");
+    }
+}
+
+/* Corpus */
+static wsJson* buildTwitter(void) {
+    wsJson* root = wsJsonInitObject(NULL);
+    wsJson* statuses = wsJsonInitArray("statuses");
+    char text[256], buffer[64];
+    for (int32_t i = 0; i < 4000; i++) {
+        wsJson* status = wsJsonInitObject(NULL);
+        wsJsonAddString(status, "created_at", "Sun Aug 31 00:29:15 +0000 2014");
+        wsJsonAddInteger(status, "id", 505874924095815681 + i);
+        snprintf(buffer, sizeof(buffer), "%lld", 505874924095815681LL + i);
+        wsJsonAddString(status, "id_str", buffer);
+        sentence(text, 12);
+        strcat(text, " \\u3042\\n@user \\\"quoted\\\"");
+        wsJsonAddString(status, "text", text);
+        wsJsonAddString(status, "source", "<a href=\\\"https://mobile.example.com\\\" rel=\\\"nofollow\\\">Mobile Web</a>");
+        wsJsonAddBool(status, "truncated", false);
+        wsJsonAddNull(status, "in_reply_to_status_id");
+
+        wsJson* user = wsJsonInitObject("user");
+        wsJsonAddInteger(user, "id", next());
+        snprintf(buffer, sizeof(buffer), "user_%u", next() % 100000);
+        wsJsonAddString(user, "screen_name", buffer);
+        wsJsonAddString(user, "name", "Some Name");
+        wsJsonAddString(user, "location", "Tokyo");
+        sentence(text, 8);
+        wsJsonAddString(user, "description", text);
+        wsJsonAddInteger(user, "followers_count", next() % 50000);
+        wsJsonAddInteger(user, "friends_count", next() % 2000);
+        wsJsonAddBool(user, "verified", next() % 10 == 0);
+        wsJsonAddString(user, "profile_background_color", "C0DEED");
+        wsJsonAddString(user, "profile_image_url_https", "https://pbs.example.com/profile_images/1234/avatar_normal.jpeg");
+        wsJsonAddField(status, user);
+
+        wsJson* entities = wsJsonInitObject("entities");
+        wsJson* hashtags = wsJsonInitArray("hashtags");
+        for (int32_t h = 0; h < (int32_t)(next() % 3); h++) {
+            wsJson* tag = wsJsonInitObject(NULL);
+            wsJsonAddString(tag, "text", words[next() % 16]);
+            wsJson* indices = wsJsonInitArray("indices");
+            wsJsonAddElement(indices, wsJsonInitInteger(NULL, h * 10));
+            wsJsonAddElement(indices, wsJsonInitInteger(NULL, h * 10 + 6));
+            wsJsonAddField(tag, indices);
+            wsJsonAddElement(hashtags, tag);
+        }
+        wsJsonAddField(entities, hashtags);
+        wsJsonAddField(entities, wsJsonInitArray("urls"));
+        wsJsonAddField(entities, wsJsonInitArray("user_mentions"));
+        wsJsonAddField(status, entities);
+
+        wsJsonAddInteger(status, "retweet_count", next() % 100);
+        wsJsonAddInteger(status, "favorite_count", next() % 300);
+        wsJsonAddBool(status, "favorited", false);
+        wsJsonAddString(status, "lang", "ja");
+        wsJsonAddNull(status, "geo");
+        wsJsonAddElement(statuses, status);
+    }
+    wsJsonAddField(root, statuses);
+    wsJson* metadata = wsJsonInitObject("search_metadata");
+    wsJsonAddNumber(metadata, "completed_in", 0.087);
+    wsJsonAddInteger(metadata, "count", 4000);
+    wsJsonAddField(root, metadata);
+    return root;
+}
+
+static void keyTwitter(int32_t i, char* out, size_t size) {
+    static const char* keys[] = { "user.screen_name", "entities.hashtags", "retweet_count", "user.followers_count", "lang" };
+    snprintf(out, size, "%s", keys[i % 5]);
+}
+
+static wsJson* buildNumbers(void) {
+    wsJson* root = wsJsonInitObject(NULL);
+    wsJsonAddString(root, "type", "FeatureCollection");
+    wsJson* features = wsJsonInitArray("features");
+    char key[16];
+    for (int32_t f = 0; f < 40; f++) {
+        wsJson* feature = wsJsonInitObject(NULL);
+        wsJsonAddString(feature, "type", "Polygon");
+        wsJson* properties = wsJsonInitObject("properties");
+        for (int32_t p = 0; p < 8; p++) {
+            snprintf(key, sizeof(key), "p%d", p);
+            wsJsonAddInteger(properties, key, next());
+        }
+        wsJsonAddField(feature, properties);
+        wsJson* rings = wsJsonInitArray("coordinates");
+        wsJson* ring = wsJsonInitArray(NULL);
+        for (int32_t i = 0; i < 5000; i++) {
+            wsJson* point = wsJsonInitArray(NULL);
+            wsJsonAddElement(point, wsJsonInitNumber(NULL, -65.613616999999977 + next() / 1e6));
+            wsJsonAddElement(point, wsJsonInitNumber(NULL, 43.420273000000009 + next() / 1e7));
+            wsJsonAddElement(ring, point);
+        }
+        wsJsonAddElement(rings, ring);
+        wsJsonAddField(feature, rings);
+        wsJsonAddElement(features, feature);
+    }
+    wsJsonAddField(root, features);
+    return root;
+}
+
+static void keyNumbers(int32_t i, char* out, size_t size) {
+    snprintf(out, size, "properties.p%d", i % 8);
+}
+
+static wsJson* buildStrings(void) {
+    wsJson* root = wsJsonInitObject(NULL);
+    wsJson* documents = wsJsonInitArray("documents");
+    char text[2048], title[128];
+    for (int32_t i = 0; i < 6000; i++) {
+        wsJson* document = wsJsonInitObject(NULL);
+        sentence(title, 6);
+        wsJsonAddString(document, "title", title);
+        sentence(text, 150);
+        strcat(text, "\\n\\t\\\"end\\\" \\u00e9");
+        wsJsonAddString(document, "body", text);
+        wsJsonAddString(document, "author", "A. Writer");
+        wsJson* tags = wsJsonInitArray("tags");
+        for (int32_t t = 0; t < 4; t++) wsJsonAddElement(tags, wsJsonInitString(NULL, words[next() % 16]));
+        wsJsonAddField(document, tags);
+        wsJsonAddElement(documents, document);
+    }
+    wsJsonAddField(root, documents);
+    wsJsonAddString(root, "collection", "articles");
+    return root;
+}
+
+static void keyStrings(int32_t i, char* out, size_t size) {
+    static const char* keys[] = { "title", "body", "author", "tags" };
+    snprintf(out, size, "%s", keys[i % 4]);
+}
+
+// Chains of objects nested close to WS_JSON_MAX_DEPTH under the keys c0, c1, ...
+#define DEEP_LEVELS (WS_JSON_MAX_DEPTH - 2)
+
+static wsJson* buildDeep(void) {
+    wsJson* root = wsJsonInitObject(NULL);
+    char key[16];
+    for (int32_t c = 0; c < 400; c++) {
+        snprintf(key, sizeof(key), "c%d", c);
+        wsJson* chain = wsJsonInitObject(key);
+        wsJsonAddField(root, chain);
+        for (int32_t level = 0; level < DEEP_LEVELS; level++) {
+            wsJsonAddInteger(chain, "n", level);
+            wsJsonAddString(chain, "tag", "node");
+            if (level + 1 == DEEP_LEVELS) break;
+            wsJson* child = wsJsonInitObject("next");
+            wsJsonAddField(chain, child);
+            chain = child;
+        }
+    }
+    return root;
+}
+
+static void keyDeep(int32_t i, char* out, size_t size) {
+    int32_t levels = 50 + i % 200;
+    int32_t used = snprintf(out, size, "c%d", i % 400);
+    for (int32_t level = 0; level < levels && used + 6 < (int32_t)size; level++) used += snprintf(out + used, size - used, ".next");
+    snprintf(out + used, size - used, ".n");
+}
+
+static wsJson* buildWide(void) {
+    wsJson* root = wsJsonInitObject(NULL);
+    char key[16];
+    for (int32_t i = 0; i < 200000; i++) {
+        snprintf(key, sizeof(key), "k%06d", i);
+        wsJson* entry = wsJsonInitObject(key);
+        wsJsonAddInteger(entry, "v", i);
+        wsJsonAddString(entry, "s", "x");
+        wsJsonAddField(root, entry);
+    }
+    return root;
+}
+
+static void keyWide(int32_t i, char* out, size_t size) {
+    snprintf(out, size, "k%06u.v", (uint32_t)(i * 7919) % 200000);
+}
+
+// Records of one NDJSON file, the corpus writes one element per line
+static wsJson* buildLines(void) {
+    static const char* levels[] = { "debug", "info", "warning", "error" };
+    static const char* paths[] = { "/api/v1/users", "/api/v1/orders/search", "/health", "/static/app.js" };
+    wsJson* records = wsJsonInitArray(NULL);
+    for (int32_t i = 0; i < 60000; i++) {
+        wsJson* record = wsJsonInitObject(NULL);
+        wsJsonAddInteger(record, "ts", 1700000000000 + i);
+        wsJsonAddString(record, "level", levels[next() % 4]);
+        wsJson* request = wsJsonInitObject("request");
+        wsJsonAddString(request, "method", "GET");
+        wsJsonAddString(request, "path", paths[next() % 4]);
+        wsJsonAddInteger(request, "status", 200 + next() % 300);
+        wsJsonAddNumber(request, "ms", (next() % 100000) / 1000.0);
+        wsJsonAddField(record, request);
+        wsJsonAddString(record, "message", "request finished in the usual amount of time");
+        wsJsonAddElement(records, record);
+    }
+    return records;
+}
+
+static void keyLines(int32_t i, char* out, size_t size) {
+    snprintf(out, size, "%s", i % 2 ? "request.status" : "level");
+}
+
+typedef struct Corpus {
+    const char* name;
+    wsJson* (*build)(void);
+    void (*lookupKey)(int32_t i, char* out, size_t size);
+    const char* items; // lookups go to the elements of this array instead of the root
+    bool lines;
+} Corpus;
+
+static const Corpus corpora[] = {
+    { "twitter", buildTwitter, keyTwitter, "statuses", false },
+    { "numbers", buildNumbers, keyNumbers, "features", false },
+    { "strings", buildStrings, keyStrings, "documents", false },
+    { "deep", buildDeep, keyDeep, NULL, false },
+    { "wide", buildWide, keyWide, NULL, false },
+    { "ndjson", buildLines, keyLines, NULL, true },
+};
+
+/* Measurements */
+typedef struct Result {
+    size_t bytes;
+    double buildMs;
+    double freeMs;
+    double parseMBps;
+    double parseArenaMBps;
+    double serializeMBps;
+    double lookupNs;
+    size_t peakBytes;
+    double parsePooledMBps;
+    size_t allocCalls; // WS_JSON_MALLOC and WS_JSON_REALLOC calls of one parse
+    size_t pooledCalls; // the same with warm block pools
+} Result;
+
+// Corpus text, NDJSON records are written one per line
+typedef struct Text {
+    char* data;
+    size_t length;
+    size_t capacity;
+} Text;
+
+static int32_t appendText(void* user, const char* data, size_t size) {
+    Text* text = user;
+    if (text->length + size + 1 > text->capacity) {
+        text->capacity = (text->length + size + 1) * 2;
+        text->data = realloc(text->data, text->capacity);
+    }
+    memcpy(text->data + text->length, data, size);
+    text->length += size;
+    return WS_OK;
+}
+
+static Text writeCorpus(const Corpus* corpus, wsJson* tree) {
+    Text text = { NULL, 0, 0 };
+    wsJsonWriter writer;
+    wsJsonWriterInitSink(&writer, appendText, &text);
+    if (!corpus->lines) {
+        wsJsonWrite(&writer, tree);
+        return text;
+    }
+    for (int32_t i = 0; i < tree->array.elementCount; i++) {
+        wsJsonWrite(&writer, tree->array.elements[i]);
+        appendText(&text, "\n", 1);
+    }
+    return text;
+}
+
+// Parsed document, for NDJSON the records of a batch
+typedef struct Parsed {
+    wsJson* root;
+    wsJsonBatch* batch;
+} Parsed;
+
+static Parsed parse(const Corpus* corpus, const Text* text, uint32_t flags) {
+    Parsed parsed = { NULL, NULL };
+    if (corpus->lines) parsed.batch = wsJsonParseLines(NULL, text->data, text->length, flags);
+    else parsed.root = wsJsonParse(text->data, text->length, flags);
+    return parsed;
+}
+
+static void release(Parsed* parsed) {
+    if (parsed->batch) wsJsonBatchFree(parsed->batch);
+    if (parsed->root) wsJsonFree(parsed->root);
+}
+
+static wsJson* lookupRoot(const Corpus* corpus, const Parsed* parsed, int32_t i) {
+    if (parsed->batch) return parsed->batch->records[(size_t)i % parsed->batch->recordCount];
+    if (!corpus->items) return parsed->root;
+    int32_t count = wsJsonGetArrayLen(parsed->root, corpus->items);
+    return wsJsonGetArrayAt(parsed->root, corpus->items, (i * 7919) % count);
+}
+
+static bool measure(const Corpus* corpus, Result* result) {
+    seed = 1;
+    double start = now();
+    wsJson* tree = corpus->build();
+    result->buildMs = (now() - start) * 1e3;
+
+    Text text = writeCorpus(corpus, tree);
+    result->bytes = text.length;
+    double megabytes = toMegabytes(text.length);
+
+    // Serialize into a growable buffer that already has its final size
+    wsJsonWriter writer;
+    wsJsonWriterInitGrowable(&writer, text.length);
+    int32_t rounds = 0;
+    start = now();
+    do {
+        writer.used = 0;
+        if (corpus->lines) {
+            for (int32_t i = 0; i < tree->array.elementCount; i++) wsJsonWrite(&writer, tree->array.elements[i]);
+        }
+        else {
+            wsJsonWrite(&writer, tree);
+        }
+        rounds++;
+    } while (rounds < MAX_ROUNDS && now() - start < MIN_SECONDS);
+    result->serializeMBps = megabytes * rounds / (now() - start);
+    wsJsonWriterFree(&writer);
+    wsJsonFree(tree);
+
+    // Parse on the heap, free gets timed separately
+    double parseSeconds = 0, freeSeconds = 0;
+    rounds = 0;
+    do {
+        size_t base = benchCurrent;
+        benchPeak = benchCurrent;
+        size_t calls = benchCalls;
+        double parseStart = now();
+        Parsed parsed = parse(corpus, &text, 0);
+        double parseEnd = now();
+        result->allocCalls = benchCalls - calls;
+        if (!parsed.root && !parsed.batch) {
+            printf("%s: parse failed\n", corpus->name);
+            free(text.data);
+            return false;
+        }
+        result->peakBytes = benchPeak - base;
+        release(&parsed);
+        parseSeconds += parseEnd - parseStart;
+        freeSeconds += now() - parseEnd;
+        rounds++;
+    } while (rounds < MAX_ROUNDS && parseSeconds + freeSeconds < MIN_SECONDS);
+    result->parseMBps = megabytes * rounds / parseSeconds;
+    result->freeMs = freeSeconds / rounds * 1e3;
+
+    // Parse with the block pools, the first round fills them
+    wsJsonSetBlockPools(true);
+    Parsed warm = parse(corpus, &text, 0);
+    release(&warm);
+    parseSeconds = 0;
+    rounds = 0;
+    do {
+        size_t calls = benchCalls;
+        double parseStart = now();
+        Parsed parsed = parse(corpus, &text, 0);
+        parseSeconds += now() - parseStart;
+        result->pooledCalls = benchCalls - calls;
+        release(&parsed);
+        rounds++;
+    } while (rounds < MAX_ROUNDS && parseSeconds < MIN_SECONDS);
+    result->parsePooledMBps = megabytes * rounds / parseSeconds;
+    wsJsonSetBlockPools(false);
+
+    // Parse into an arena with views
+    wsJsonArena* arena = wsJsonArenaInit(0);
+    wsJsonSetArena(arena);
+    rounds = 0;
+    start = now();
+    do {
+        Parsed parsed = parse(corpus, &text, WS_JSON_PARSE_VIEWS);
+        if (parsed.batch) wsJsonBatchFree(parsed.batch);
+        wsJsonArenaReset(arena);
+        rounds++;
+    } while (rounds < MAX_ROUNDS && now() - start < MIN_SECONDS);
+    result->parseArenaMBps = megabytes * rounds / (now() - start);
+    wsJsonSetArena(NULL);
+    wsJsonArenaFree(arena);
+
+    // Lookups cycle through a set of keys that all exist
+    static char keys[LOOKUP_KEYS][1536];
+    for (int32_t i = 0; i < LOOKUP_KEYS; i++) corpus->lookupKey(i, keys[i], sizeof(keys[i]));
+    static wsJson* roots[LOOKUP_KEYS];
+    Parsed parsed = parse(corpus, &text, 0);
+    for (int32_t i = 0; i < LOOKUP_KEYS; i++) roots[i] = lookupRoot(corpus, &parsed, i);
+    int32_t found = 0;
+    start = now();
+    for (int32_t i = 0; i < LOOKUPS; i++) found += wsJsonGet(roots[i % LOOKUP_KEYS], keys[i % LOOKUP_KEYS]) != NULL;
+    result->lookupNs = (now() - start) / LOOKUPS * 1e9;
+    release(&parsed);
+    free(text.data);
+    if (found != LOOKUPS) {
+        printf("%s: %d of %d lookups failed\n", corpus->name, LOOKUPS - found, LOOKUPS);
+        return false;
+    }
+    return true;
+}
+
+static void addResult(wsJson* list, const char* name, const Result* result) {
+    wsJson* entry = wsJsonInitObject(NULL);
+    wsJsonAddString(entry, "name", name);
+    wsJsonAddInteger(entry, "bytes", (int64_t)result->bytes);
+    wsJsonAddNumber(entry, "buildMs", result->buildMs);
+    wsJsonAddNumber(entry, "parseMBps", result->parseMBps);
+    wsJsonAddNumber(entry, "parseArenaViewsMBps", result->parseArenaMBps);
+    wsJsonAddNumber(entry, "serializeMBps", result->serializeMBps);
+    wsJsonAddNumber(entry, "lookupNs", result->lookupNs);
+    wsJsonAddNumber(entry, "freeMs", result->freeMs);
+    wsJsonAddInteger(entry, "peakBytes", (int64_t)result->peakBytes);
+    wsJsonAddNumber(entry, "parsePooledMBps", result->parsePooledMBps);
+    wsJsonAddInteger(entry, "allocCalls", (int64_t)result->allocCalls);
+    wsJsonAddInteger(entry, "pooledAllocCalls", (int64_t)result->pooledCalls);
+    wsJsonAddElement(list, entry);
+}
+
+int main(int argc, char** argv) {
+    const int32_t count = (int32_t)(sizeof(corpora) / sizeof(corpora[0]));
+    wsJson* summary = wsJsonInitObject(NULL);
+    wsJsonAddInteger(summary, "version", 1);
+    wsJsonAddString(summary, "compiler", __VERSION__);
+    wsJsonAddString(summary, "simd", wsJsonSimdLevelToString(wsJsonGetSimdLevel()));
+    wsJson* results = wsJsonInitArray("corpora");
+
+    printf("%-8s %8s %9s %11s %11s %11s %10s %9s %9s %10s %9s %9s\n", "corpus", "MB", "build ms", "parse MB/s", "arena MB/s",
+           "write MB/s", "lookup ns", "free ms", "peak MB", "pool MB/s", "allocs", "pooled");
+    int32_t failed = 0;
+    for (int32_t i = 0; i < count; i++) {
+        Result result = { 0 };
+        if (!measure(&corpora[i], &result)) {
+            failed++;
+            continue;
+        }
+        printf("%-8s %8.2f %9.1f %11.1f %11.1f %11.1f %10.1f %9.2f %9.2f %10.1f %9zu %9zu\n", corpora[i].name,
+               toMegabytes(result.bytes), result.buildMs, result.parseMBps, result.parseArenaMBps, result.serializeMBps,
+               result.lookupNs, result.freeMs, toMegabytes(result.peakBytes), result.parsePooledMBps, result.allocCalls,
+               result.pooledCalls);
+        addResult(results, corpora[i].name, &result);
+    }
+    wsJsonAddField(summary, results);
+
+#if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    wsJsonAddInteger(summary, "maxRssKb", usage.ru_maxrss);
+#endif
+
+    wsJsonWriter writer;
+    wsJsonWriterInitGrowable(&writer, 0);
+    wsJsonWrite(&writer, summary);
+    printf("%s\n", writer.buffer);
+    if (argc > 1) {
+        FILE* file = fopen(argv[1], "w");
+        if (file) {
+            wsJsonWriter pretty;
+            wsJsonWriterInitGrowable(&pretty, 0);
+            wsJsonWritePretty(&pretty, summary);
+            fprintf(file, "%s\n", pretty.buffer);
+            wsJsonWriterFree(&pretty);
+            fclose(file);
+        }
+        else {
+            printf("Failed to write %s\n", argv[1]);
+            failed++;
+        }
+    }
+    wsJsonWriterFree(&writer);
+    wsJsonFree(summary);
+    return failed ? 1 : 0;
+}
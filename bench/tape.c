@@ -0,0 +1,95 @@
+/*
+ *  Tape benchmark
+ *  Parse throughput of the tape engine against the tree parser (with 
+ *  views and an arena, its fastest setup) on a record heavy document, 
+ *  plus the cost of turning the tape into a tree afterwards.
+ */
+#define WS_JSON_IMPLEMENTATION
+#include "../src/wsJson.h"
+#include "bench.h"
+
+#define TARGET_BYTES (256 * 1024 * 1024)
+
+static char* buildRecords(size_t* length) {
+    wsJson* root = wsJsonInitArray(NULL);
+    for (int32_t i = 0; i < 20000; i++) {
+        wsJson* record = wsJsonInitObject(NULL);
+        wsJsonAddInteger(record, "id", 1700000000000LL + i);
+        wsJsonAddString(record, "user", "someone_with_a_longer_name");
+        wsJsonAddString(record, "text", "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor \\\"incididunt\\\"");
+        wsJsonAddNumber(record, "score", i * 0.25);
+        wsJsonAddBool(record, "verified", i % 3 == 0);
+        wsJsonAddNull(record, "reply");
+        wsJson* tags = wsJsonInitArray("tags");
+        wsJsonAddElement(tags, wsJsonInitString(NULL, "json"));
+        wsJsonAddElement(tags, wsJsonInitString(NULL, "parser"));
+        wsJsonAddField(record, tags);
+        wsJsonAddElement(root, record);
+    }
+
+    wsJsonWriter writer;
+    wsJsonWriterInitGrowable(&writer, 0);
+    wsJsonWrite(&writer, root);
+    wsJsonFree(root);
+    *length = writer.used;
+    return writer.buffer;
+}
+
+static void report(const char* name, size_t bytes, double seconds) {
+    printf("%-22s %8.1f MB/s\n", name, toMegabytes(bytes) / seconds);
+}
+
+int main(void) {
+    size_t length;
+    char* doc = buildRecords(&length);
+    int32_t rounds = (int32_t)(TARGET_BYTES / length) + 1;
+    printf("document %zu bytes, simd %s\n", length, wsJsonSimdLevelToString(wsJsonGetSimdLevel()));
+
+    wsJsonArena* arena = wsJsonArenaInit(0);
+    wsJsonSetArena(arena);
+    double start = now();
+    for (int32_t r = 0; r < rounds; r++) {
+        wsJsonParse(doc, length, WS_JSON_PARSE_VIEWS);
+        wsJsonArenaReset(arena);
+    }
+    report("tree (views, arena)", length * rounds, now() - start);
+    wsJsonSetArena(NULL);
+
+    wsJsonTape* tape = wsJsonTapeInit();
+    start = now();
+    for (int32_t r = 0; r < rounds; r++) {
+        wsJsonTapeParse(tape, doc, length);
+    }
+    report("tape", length * rounds, now() - start);
+
+    start = now();
+    for (int32_t r = 0; r < rounds; r++) {
+        _wsJsonTapeIndex(tape);
+    }
+    report("tape stage 1", length * rounds, now() - start);
+
+    // Reading every record straight from the tape
+    double sum = 0.0;
+    start = now();
+    for (int32_t r = 0; r < rounds; r++) {
+        for (size_t record = wsJsonTapeFirst(tape, 0); record != WS_JSON_TAPE_END; record = wsJsonTapeNext(tape, record)) {
+            sum += wsJsonTapeNumber(tape, wsJsonTapeGet(tape, record, "score"));
+        }
+    }
+    report("tape field scan", length * rounds, now() - start);
+
+    wsJsonSetArena(arena);
+    start = now();
+    for (int32_t r = 0; r < rounds; r++) {
+        wsJsonTapeToJson(tape, 0, WS_JSON_PARSE_VIEWS);
+        wsJsonArenaReset(arena);
+    }
+    report("tape to tree", length * rounds, now() - start);
+    wsJsonSetArena(NULL);
+    printf("(check %g)\n", sum);
+
+    wsJsonTapeFree(tape);
+    wsJsonArenaFree(arena);
+    free(doc);
+    return 0;
+}
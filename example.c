@@ -46,9 +46,11 @@ int main() {
     printf("Array Length: %d\n", wsJsonGetArrayLen(root, "array"));
 
     // Print Json
-    char string[20000];
-    wsJsonToStringPretty(root, string, 20000);
-    printf("%s\n", string);
+    wsJsonWriter writer;
+    wsJsonWriterInitGrowable(&writer, 0);
+    wsJsonWritePretty(&writer, root);
+    printf("%s\n", writer.buffer);
+    wsJsonWriterFree(&writer);
 
     wsJsonFree(root);
 
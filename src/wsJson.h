@@ -4,14 +4,46 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdbool.h>
+#include <threads.h>
 
+// Keys are not limited anymore, kept for code that sizes own buffers with it
 #define WS_JSON_MAX_KEY_SIZE 64 
 #define WS_JSON_MAX_VALUE_SIZE 256
 
 #define WS_ERROR -1
 #define WS_OK 0
 
+// Default size of a single arena chunk (allocations bigger than that get their own chunk)
+#ifndef WS_JSON_ARENA_CHUNK_SIZE
+    #define WS_JSON_ARENA_CHUNK_SIZE (64 * 1024)
+#endif
+
+#define WS_JSON_ARENA_ALIGN 16
+
+// Objects get a hash index when they reach this many children (0 disables it), lookups only read it
+#ifndef WS_JSON_INDEX_THRESHOLD
+    #define WS_JSON_INDEX_THRESHOLD 16
+#endif
+
+// Arrays and objects with at least this many children get split up by the parallel serializer
+#ifndef WS_JSON_PARALLEL_THRESHOLD
+    #define WS_JSON_PARALLEL_THRESHOLD 1024
+#endif
+
+// Deepest nesting of arrays and objects the parsers and the serializer accept
+#ifndef WS_JSON_MAX_DEPTH
+    #define WS_JSON_MAX_DEPTH 1024
+#endif
+
+// Size of the buffer a sink writer batches output in before calling the sink
+#ifndef WS_JSON_WRITER_BUFFER_SIZE
+    #define WS_JSON_WRITER_BUFFER_SIZE 4096
+#endif
+
+// Define WS_JSON_STATS to count allocations, nodes and parse/serialize time per thread (see wsJsonGetStats)
+
 /* 
  *  Allocators  
  *  Redefine with own ones to use custom allocator
@@ -41,12 +73,37 @@ typedef enum wsJsonType {
     WS_JSON_NULL
 } wsJsonType;
 
+// Node flags
+#define WS_JSON_FLAG_ARENA 0x01 // node and its buffers live in a wsJsonArena
+#define WS_JSON_FLAG_STRING_VIEW 0x02 // stringValue points into the parsed input and is not owned
+#define WS_JSON_FLAG_NO_TERMINATOR 0x04 // key and string views are not NUL terminated, use the lengths
+#define WS_JSON_FLAG_INDEXED 0x08 // object has a key hash index behind its children array
+#define WS_JSON_FLAG_INTEGER 0x10 // number is an exact int64 in integerValue, numberValue holds the closest double
+#define WS_JSON_FLAG_SHARED 0x20 // node belongs to a wsJsonShared document and is read only
+#define WS_JSON_FLAG_TRACKED 0x40 // container has a record in a wsJsonCache
+#define WS_JSON_FLAG_POOLED 0x80 // node and its buffers come from the block pools
+
+// Parse flags
+#define WS_JSON_PARSE_VIEWS 0x01 // keys and strings point into the input, which has to outlive the document
+
+// 32 bytes: key view, type tag, flags and a 16 byte payload.
+// Keys of nodes without a name point to an empty string and are never NULL.
 typedef struct wsJson {
-    char key[WS_JSON_MAX_KEY_SIZE];
-    wsJsonType type;
+    const char* key;
+    uint32_t keyLength;
+    uint8_t type; // wsJsonType
+    uint8_t flags;
+    uint16_t arena; // id of the wsJsonArena of WS_JSON_FLAG_ARENA nodes
     union {
-        char* stringValue;
-        double numberValue;
+        struct {
+            char* stringValue;
+            uint32_t stringLength;
+            uint32_t stringCapacity; // buffer size once a setter changed the string, 0 means stringLength + 1
+        };
+        struct {
+            double numberValue;
+            int64_t integerValue;
+        };
         bool boolValue;
         struct {
             struct wsJson** children;
@@ -61,10 +118,93 @@ typedef struct wsJson {
     };
 } wsJson;
 
+/* 
+ *  Arena
+ *  While an arena is set for the current thread every node, string and 
+ *  child array created by the parser, wsJsonInit* and wsJsonAdd* is bump 
+ *  allocated from it. Reset or free the arena to release the whole document 
+ *  at once instead of calling wsJsonFree. Arena nodes keep the id of their 
+ *  arena and always grow from it, whichever arena is set when they get 
+ *  changed, so the arena has to outlive every change to the document.
+ */
+typedef struct wsJsonArenaChunk {
+    struct wsJsonArenaChunk* next;
+    size_t size;
+    size_t used;
+} wsJsonArenaChunk;
+
+typedef struct wsJsonArena {
+    wsJsonArenaChunk* first;
+    wsJsonArenaChunk* current;
+    size_t chunkSize;
+    uint16_t id; // stored in its nodes, unique among the live arenas
+} wsJsonArena;
+
+// Pass 0 to use WS_JSON_ARENA_CHUNK_SIZE
+wsJsonArena* wsJsonArenaInit(size_t chunkSize);
+void* wsJsonArenaAlloc(wsJsonArena* arena, size_t size);
+
+// Recycles all chunks without returning them to the system
+void wsJsonArenaReset(wsJsonArena* arena);
+void wsJsonArenaFree(wsJsonArena* arena);
+
+// Sets the arena used by the current thread (NULL to go back to the heap), returns the previous one
+wsJsonArena* wsJsonSetArena(wsJsonArena* arena);
+wsJsonArena* wsJsonGetArena(void);
+
+/* 
+ *  Block pools
+ *  Nodes created outside an arena while pools are on for the thread come 
+ *  from size classes (16 to 1024 bytes) carved out of 64 KB chunks, and so 
+ *  do their keys, strings and children arrays. Freed blocks go back on 
+ *  the free list of the thread that allocated them (other threads hand 
+ *  them over without a lock), so the next document reuses them instead of 
+ *  calling WS_JSON_MALLOC. Chunks are kept for the life of the process, a 
+ *  pool of a finished thread is taken over by the next new one.
+ */
+// Turns the pools on or off for nodes the current thread creates, returns the previous setting
+bool wsJsonSetBlockPools(bool enabled);
+bool wsJsonGetBlockPools(void);
+
+/* 
+ *  Stats
+ *  Counters of the current thread, only collected when WS_JSON_STATS is 
+ *  defined before the implementation (otherwise every hook compiles away). 
+ *  Heap allocations carry a small size header then, so memory from the 
+ *  library has to be released through it. Arena and block pool chunks 
+ *  count as heap allocations, nodes count no matter where they live. 
+ *  Memory freed on another thread than the one that allocated it is 
+ *  counted on the freeing thread, so only the sum over all threads is exact.
+ */
+typedef struct wsJsonStatsTimer {
+    uint64_t count;
+    uint64_t bytes; // input parsed or output written
+    uint64_t nanoseconds;
+} wsJsonStatsTimer;
+
+typedef struct wsJsonStats {
+    uint64_t allocations;
+    uint64_t reallocations;
+    uint64_t frees;
+    int64_t bytesInUse;
+    int64_t peakBytes;
+    uint64_t nodes[WS_JSON_NULL + 1]; // created nodes by wsJsonType
+    uint64_t childGrowths; // children arrays grown by wsJsonAddField/wsJsonAddElement
+    wsJsonStatsTimer parse;
+    wsJsonStatsTimer serialize;
+} wsJsonStats;
+
+// Copies the counters of the current thread, WS_ERROR (and zeroed stats) without WS_JSON_STATS
+int32_t wsJsonGetStats(wsJsonStats* stats);
+
+// Zeroes the counters of the current thread, peakBytes restarts from bytesInUse
+void wsJsonResetStats(void);
+
 // Create functions
 wsJson* wsJsonInitObject(const char* key);
 wsJson* wsJsonInitString(const char* key, const char* val);
 wsJson* wsJsonInitNumber(const char* key, double val);
+wsJson* wsJsonInitInteger(const char* key, int64_t val);
 wsJson* wsJsonInitBool(const char* key, bool val);
 wsJson* wsJsonInitArray(const char* key);
 wsJson* wsJsonInitNull(const char* key);
@@ -72,19 +212,231 @@ wsJson* wsJsonInitNull(const char* key);
 // Adds a new child to the json object
 void wsJsonAddField(wsJson* parent, wsJson* child);
 
+// Builds the key hash index of an object now instead of waiting for WS_JSON_INDEX_THRESHOLD children
+int32_t wsJsonIndexObject(wsJson* obj);
+
 // Adds an element to a json array
 void wsJsonAddElement(wsJson* array, wsJson* element);
 
+/* 
+ *  Writer
+ *  Output target shared by the compact and the pretty serializer:
+ *  - fixed buffer: never overflows, length reports the exact size needed
+ *  - growable buffer: heap buffer that doubles, release with wsJsonWriterFree
+ *  - sink: batches output and hands it to a callback (e.g. a socket send buffer)
+ */
+typedef int32_t (*wsJsonWriteFn)(void* user, const char* data, size_t size); // return WS_OK or WS_ERROR
+
+typedef enum wsJsonWriterType {
+    WS_JSON_WRITER_FIXED,
+    WS_JSON_WRITER_GROWABLE,
+    WS_JSON_WRITER_SINK
+} wsJsonWriterType;
+
+typedef struct wsJsonWriter {
+    char* buffer;
+    size_t used;     // bytes currently in buffer
+    size_t capacity; 
+    size_t length;   // total bytes produced (including the ones that did not fit a fixed buffer)
+    wsJsonWriterType type;
+    int32_t error;
+    wsJsonWriteFn sink;
+    void* user;
+    char sinkBuffer[WS_JSON_WRITER_BUFFER_SIZE];
+} wsJsonWriter;
+
+void wsJsonWriterInitFixed(wsJsonWriter* writer, char* out, size_t size);
+int32_t wsJsonWriterInitGrowable(wsJsonWriter* writer, size_t initialCapacity);
+void wsJsonWriterInitSink(wsJsonWriter* writer, wsJsonWriteFn sink, void* user);
+void wsJsonWriterFree(wsJsonWriter* writer);
+
+// Appends the json to the writer, buffers stay NUL terminated and sinks get flushed
+int32_t wsJsonWrite(wsJsonWriter* writer, wsJson* obj);
+int32_t wsJsonWritePretty(wsJsonWriter* writer, wsJson* obj);
+
 // String conversions
+// Return the length of the full output like snprintf, the output got truncated if it is >= size
 int32_t wsJsonToString(wsJson* obj, char* out, size_t size);
 int32_t wsJsonToStringPretty(wsJson* obj, char* out, size_t size);
 wsJson* wsStringToJson(const char** string);
+wsJson* wsStringToJsonEx(const char** string, uint32_t parseFlags);
+
+// Zero copy parse that writes NUL terminators into string, so views are regular C strings
+wsJson* wsStringToJsonInSitu(char* string);
+
+// Parses exactly length bytes, data doesn't need a NUL terminator and nothing behind it is read.
+// The root has to be an object or an array and only whitespace may follow it.
+wsJson* wsJsonParse(const char* data, size_t length, uint32_t parseFlags);
+
+// Memory maps the file and parses it (POSIX only), with WS_JSON_PARSE_VIEWS keys and strings 
+// point into the mapping, which stays alive until wsJsonFileFree
+typedef struct wsJsonFile {
+    wsJson* root;
+    const char* data;
+    size_t length;
+} wsJsonFile;
+
+#if defined(__unix__) || defined(__APPLE__)
+wsJsonFile* wsJsonParseFile(const char* path, uint32_t parseFlags);
+void wsJsonFileFree(wsJsonFile* file);
+#endif
+
+/*
+ *  Binary formats
+ *  MessagePack and CBOR for the same trees. Strings are stored as plain
+ *  UTF-8 on the wire, escape sequences get decoded when writing and added
+ *  again when reading. Integers keep their int64 value, doubles are written
+ *  as float32 when that is exact. The decoders take the same parse flags
+ *  as wsJsonParse and allocate from the current arena, with
+ *  WS_JSON_PARSE_VIEWS keys and strings point into the input unless they
+ *  need escaping. Binary data, extension types and non string map keys
+ *  are rejected, CBOR tags are skipped.
+ */
+int32_t wsJsonWriteMsgPack(wsJsonWriter* writer, wsJson* obj);
+int32_t wsJsonWriteCbor(wsJsonWriter* writer, wsJson* obj);
+
+// Any value can be the root, nothing may follow it
+wsJson* wsJsonParseMsgPack(const void* data, size_t length, uint32_t parseFlags);
+wsJson* wsJsonParseCbor(const void* data, size_t length, uint32_t parseFlags);
+
+/*
+ *  Tape
+ *  Second parse engine for bulk reads. Stage 1 marks the structural 
+ *  characters and string boundaries of 64 byte blocks with SIMD, stage 2 
+ *  walks that index and writes a flat array of 64 bit words. Values are 
+ *  addressed by their word index (the root is 0) and read straight from 
+ *  the tape, strings and keys point into the input which has to outlive 
+ *  the tape. Only strict json whitespace is accepted.
+ */
+#define WS_JSON_TAPE_END ((size_t)-1)
+
+typedef struct wsJsonTape {
+    uint64_t* words;
+    size_t wordCount;
+    size_t wordCapacity;
+
+    // stage 1 output, offsets of the structural characters
+    uint32_t* structurals;
+    size_t structuralCount;
+    size_t structuralCapacity;
+
+    uint64_t* stack;
+    size_t stackCapacity;
+
+    const char* data;
+    size_t length;
+} wsJsonTape;
+
+wsJsonTape* wsJsonTapeInit(void);
+
+// Parses length bytes of data (less than 4 GiB) into the tape, buffers are reused between calls.
+// The root has to be an object or an array.
+int32_t wsJsonTapeParse(wsJsonTape* tape, const char* data, size_t length);
+void wsJsonTapeFree(wsJsonTape* tape);
+
+wsJsonType wsJsonTapeType(const wsJsonTape* tape, size_t index);
+
+// Iteration over the elements of an array or the values of an object, WS_JSON_TAPE_END when done
+size_t wsJsonTapeFirst(const wsJsonTape* tape, size_t container);
+size_t wsJsonTapeNext(const wsJsonTape* tape, size_t index);
+int32_t wsJsonTapeCount(const wsJsonTape* tape, size_t container);
+
+// Key of a value inside an object (not NUL terminated)
+const char* wsJsonTapeKey(const wsJsonTape* tape, size_t index, size_t* length);
+size_t wsJsonTapeGet(const wsJsonTape* tape, size_t object, const char* key);
+size_t wsJsonTapeAt(const wsJsonTape* tape, size_t array, int32_t position);
+
+const char* wsJsonTapeString(const wsJsonTape* tape, size_t index, size_t* length);
+double wsJsonTapeNumber(const wsJsonTape* tape, size_t index);
+int64_t wsJsonTapeInteger(const wsJsonTape* tape, size_t index);
+bool wsJsonTapeBool(const wsJsonTape* tape, size_t index);
+
+// Builds a tree of the value, with WS_JSON_PARSE_VIEWS strings point into the input
+wsJson* wsJsonTapeToJson(const wsJsonTape* tape, size_t index, uint32_t parseFlags);
+
+/* 
+ *  Push parser
+ *  Resumable parser for documents that arrive in chunks (e.g. fragmented 
+ *  websocket frames). State survives chunk boundaries anywhere, including 
+ *  inside strings and numbers. The root has to be an object or an array. 
+ *  In event mode no tree is built and every value is handed to a callback.
+ */
+#define WS_JSON_NEED_MORE 1
+
+typedef enum wsJsonEventType {
+    WS_JSON_EVENT_OBJECT_START,
+    WS_JSON_EVENT_OBJECT_END,
+    WS_JSON_EVENT_ARRAY_START,
+    WS_JSON_EVENT_ARRAY_END,
+    WS_JSON_EVENT_STRING,
+    WS_JSON_EVENT_NUMBER,
+    WS_JSON_EVENT_BOOL,
+    WS_JSON_EVENT_NULL
+} wsJsonEventType;
+
+// Strings and keys are only valid during the callback
+typedef struct wsJsonEvent {
+    wsJsonEventType type;
+    const char* key; // key of the value inside an object, NULL in arrays
+    size_t keyLength;
+    const char* stringValue;
+    size_t stringLength;
+    double numberValue;
+    int64_t integerValue;
+    bool isInteger; // integerValue holds the exact value
+    bool boolValue;
+} wsJsonEvent;
+
+typedef int32_t (*wsJsonEventFn)(void* user, const wsJsonEvent* event); // return WS_ERROR to stop
+
+typedef struct wsJsonParser {
+    int32_t state;
+    bool stringIsKey;
+    bool escape;
+    const char* literal;
+    uint8_t literalLength;
+    uint8_t literalMatched;
+
+    // open containers
+    uint8_t* types;
+    wsJson** nodes;
+    int32_t depth;
+    int32_t stackCapacity;
+
+    // bytes of the current token and the pending key, both can span chunks
+    char* scratch;
+    size_t scratchLength;
+    size_t scratchCapacity;
+    char* key;
+    size_t keyLength;
+    size_t keyCapacity;
+
+    wsJson* root;
+    wsJsonEventFn callback;
+    void* user;
+} wsJsonParser;
+
+wsJsonParser* wsJsonParserInit(void);
+wsJsonParser* wsJsonParserInitEvents(wsJsonEventFn callback, void* user);
+
+// Returns WS_JSON_NEED_MORE, WS_OK once the document is complete or WS_ERROR
+int32_t wsJsonParserFeed(wsJsonParser* parser, const char* chunk, size_t length);
+
+// Hands the finished document over to the caller
+wsJson* wsJsonParserGetRoot(wsJsonParser* parser);
+
+// Prepares the parser for the next document, keeping its buffers
+void wsJsonParserReset(wsJsonParser* parser);
+void wsJsonParserFree(wsJsonParser* parser);
 
 // Get Values 
 wsJson* wsJsonGet(wsJson* obj, const char* key);
+wsJson* wsJsonGetNonPath(wsJson* obj, const char* key); // key is not split at '.' 
 char* wsJsonGetString(wsJson* obj, const char* key);
+const char* wsJsonGetStringView(wsJson* obj, const char* key, size_t* length);
 int32_t wsJsonGetStringEx(wsJson* obj, const char* key, char* out, size_t size);
 double wsJsonGetNumber(wsJson* obj, const char* key);
+int64_t wsJsonGetInteger(wsJson* obj, const char* key); // non integer numbers are truncated
 bool wsJsonGetBool(wsJson* obj, const char* key);
 
 // Array Getters
@@ -99,8 +451,9 @@ int32_t wsJsonSetBoolExplicit(wsJson* obj, const char* key, bool val);
 // Setter functions (if object is null it will change it to the specified type)
 int32_t wsJsonSetString(wsJson* obj, const char* key, const char* val);
 int32_t wsJsonSetNumber(wsJson* obj, const char* key, double val);
+int32_t wsJsonSetInteger(wsJson* obj, const char* key, int64_t val);
 int32_t wsJsonSetBool(wsJson* obj, const char* key, bool val);
-int32_t wsJsonSetElement(wsJson* obj, const char* key, int32_t index, wsJson* element);
+int32_t wsJsonSetElement(wsJson* obj, const char* key, int32_t index, wsJson* element); // frees the old element
 
 // Null conversions
 int32_t wsJsonSetNullToObject(wsJson* obj, const char* key, wsJson* objects);
@@ -109,12 +462,455 @@ int32_t wsJsonSetNullToNumber(wsJson* obj, const char* key, double val);
 int32_t wsJsonSetNullToBool(wsJson* obj, const char* key, bool val);
 int32_t wsJsonSetNullToArray(wsJson* obj, const char* key, wsJson* array);
 
-// Goes recursive trough the json tree and frees everything
+/* 
+ *  Clone and patch
+ *  Patches are applied to the tree in place, members are found through the 
+ *  key index of large objects. Values taken from a patch are cloned, the 
+ *  patch itself stays untouched. Strings and keys are compared as stored.
+ */
+// Deep copy into the current arena (or the heap), keys and string views become owned copies
+wsJson* wsJsonClone(const wsJson* obj);
+
+// Same type and value, object members in any order, numbers by their value
+bool wsJsonEqual(wsJson* a, wsJson* b);
+
+// Removes the member at the dotted key and frees it
+int32_t wsJsonRemove(wsJson* obj, const char* key);
+
+// RFC 7386 JSON Merge Patch, a patch that isn't an object replaces the value of target
+int32_t wsJsonMergePatch(wsJson* target, wsJson* patch);
+
+// RFC 6902 JSON Patch, operations is an array of operation objects (add, remove, replace, 
+// move, copy, test). Stops at the first failing operation, the ones before stay applied
+// (patch a wsJsonClone to get all or nothing).
+int32_t wsJsonApplyPatch(wsJson* target, wsJson* operations);
+
+// JSON Patch that turns a into b (add, remove and replace operations). Subtrees with the 
+// same structural hash are skipped, array elements are matched through a short lookahead.
+wsJson* wsJsonDiff(wsJson* a, wsJson* b);
+
+// Same as a merge patch, members that became null can't be told apart from removed ones there
+wsJson* wsJsonDiffMerge(wsJson* a, wsJson* b);
+
+/* 
+ *  SIMD
+ *  Whitespace skipping and string scanning in the parser use the best 
+ *  instruction set of the cpu (picked at runtime), define WS_JSON_NO_SIMD 
+ *  to always use the scalar reference path.
+ */
+typedef enum wsJsonSimdLevel {
+    WS_JSON_SIMD_AUTO,
+    WS_JSON_SIMD_SCALAR,
+    WS_JSON_SIMD_SSE2,
+    WS_JSON_SIMD_AVX2,
+    WS_JSON_SIMD_NEON
+} wsJsonSimdLevel;
+
+// Returns WS_ERROR if the level is not supported by this cpu/build
+int32_t wsJsonSetSimdLevel(wsJsonSimdLevel level);
+wsJsonSimdLevel wsJsonGetSimdLevel(void);
+const char* wsJsonSimdLevelToString(wsJsonSimdLevel level);
+
+/* 
+ *  Compiled paths
+ *  Dotted path split once into segments with precomputed key hashes, 
+ *  array indices are written like "items[3].id". Use them for paths that 
+ *  are looked up over and over again.
+ */
+typedef struct wsJsonPathSegment {
+    const char* key;
+    uint32_t keyLength;
+    uint32_t hash;
+    int32_t index; // array index, -1 for object keys
+} wsJsonPathSegment;
+
+typedef struct wsJsonPath {
+    wsJsonPathSegment* segments;
+    int32_t segmentCount;
+} wsJsonPath;
+
+wsJsonPath* wsJsonPathInit(const char* path);
+void wsJsonPathFree(wsJsonPath* path);
+
+wsJson* wsJsonGetPath(wsJson* obj, const wsJsonPath* path);
+char* wsJsonGetStringPath(wsJson* obj, const wsJsonPath* path);
+const char* wsJsonGetStringViewPath(wsJson* obj, const wsJsonPath* path, size_t* length);
+int32_t wsJsonGetStringExPath(wsJson* obj, const wsJsonPath* path, char* out, size_t size);
+double wsJsonGetNumberPath(wsJson* obj, const wsJsonPath* path);
+int64_t wsJsonGetIntegerPath(wsJson* obj, const wsJsonPath* path);
+bool wsJsonGetBoolPath(wsJson* obj, const wsJsonPath* path);
+int32_t wsJsonGetArrayLenPath(wsJson* obj, const wsJsonPath* path);
+wsJson* wsJsonGetArrayAtPath(wsJson* obj, const wsJsonPath* path, int32_t index);
+
+int32_t wsJsonSetStringExplicitPath(wsJson* obj, const wsJsonPath* path, const char* val);
+int32_t wsJsonSetNumberExplicitPath(wsJson* obj, const wsJsonPath* path, double val);
+int32_t wsJsonSetBoolExplicitPath(wsJson* obj, const wsJsonPath* path, bool val);
+int32_t wsJsonSetStringPath(wsJson* obj, const wsJsonPath* path, const char* val);
+int32_t wsJsonSetNumberPath(wsJson* obj, const wsJsonPath* path, double val);
+int32_t wsJsonSetIntegerPath(wsJson* obj, const wsJsonPath* path, int64_t val);
+int32_t wsJsonSetBoolPath(wsJson* obj, const wsJsonPath* path, bool val);
+int32_t wsJsonSetElementPath(wsJson* obj, const wsJsonPath* path, int32_t index, wsJson* element);
+int32_t wsJsonSetNullToObjectPath(wsJson* obj, const wsJsonPath* path, wsJson* fields);
+int32_t wsJsonSetNullToStringPath(wsJson* obj, const wsJsonPath* path, const char* val);
+int32_t wsJsonSetNullToNumberPath(wsJson* obj, const wsJsonPath* path, double val);
+int32_t wsJsonSetNullToBoolPath(wsJson* obj, const wsJsonPath* path, bool val);
+int32_t wsJsonSetNullToArrayPath(wsJson* obj, const wsJsonPath* path, wsJson* array);
+
+/* 
+ *  Lazy documents
+ *  Init only locates the root, every lookup scans forward from there and 
+ *  skips unrelated objects and arrays by bracket matching. Only the value 
+ *  that was asked for gets parsed (and only its part of the input gets 
+ *  validated). Keys are dotted like in wsJsonGet, compiled paths can also 
+ *  index arrays. The input has to outlive the lazy document.
+ */
+typedef struct wsJsonLazy {
+    const char* data; // root value
+    const char* end;
+    uint32_t parseFlags; // used for materialized values
+} wsJsonLazy;
+
+int32_t wsJsonLazyInit(wsJsonLazy* doc, const char* data, size_t length, uint32_t parseFlags);
+
+// Parses the value at key into a new tree
+wsJson* wsJsonLazyGet(const wsJsonLazy* doc, const char* key);
+wsJson* wsJsonLazyGetPath(const wsJsonLazy* doc, const wsJsonPath* path);
+
+// Scalars are read without building nodes
+const char* wsJsonLazyGetStringView(const wsJsonLazy* doc, const char* key, size_t* length);
+double wsJsonLazyGetNumber(const wsJsonLazy* doc, const char* key);
+int64_t wsJsonLazyGetInteger(const wsJsonLazy* doc, const char* key);
+bool wsJsonLazyGetBool(const wsJsonLazy* doc, const char* key);
+
+/*
+ *  Struct bindings
+ *  Hot message types can be decoded straight into a C struct and written 
+ *  back out without building a tree. The fields are listed once as an 
+ *  X-macro, WS_JSON_STRUCT declares the struct from the list and 
+ *  WS_JSON_BINDING the descriptor the parser and the writer use (it also 
+ *  works with a struct written by hand, INTEGER and NUMBER follow the 
+ *  member size then):
+ *
+ *      #define ORDER_FIELDS(X) \
+ *          X(INTEGER, id, "id") \
+ *          X(STRING(16), state, "state") \
+ *          X(NUMBER, total, "total") \
+ *          X(BOOL, gift, "gift") \
+ *          X(OBJECT(Address, addressBinding), address, "address")
+ *
+ *      WS_JSON_STRUCT(Order, ORDER_FIELDS);
+ *      WS_JSON_BINDING(orderBinding, Order, ORDER_FIELDS);
+ *
+ *  Field names are found through a perfect hash that gets built on the 
+ *  first use of the binding. Strings are decoded into their char array 
+ *  and escaped again when written, members the input doesn't have keep 
+ *  their value, null zeroes them and unknown keys are skipped without 
+ *  validating them.
+ */
+typedef enum wsJsonBindType {
+    WS_JSON_BIND_INTEGER, // int8_t to int64_t
+    WS_JSON_BIND_NUMBER, // float or double
+    WS_JSON_BIND_BOOL,
+    WS_JSON_BIND_STRING, // NUL terminated char array
+    WS_JSON_BIND_OBJECT, // struct with its own binding
+} wsJsonBindType;
+
+struct wsJsonBinding;
+
+typedef struct wsJsonBindField {
+    const char* name;
+    uint32_t nameLength;
+    wsJsonBindType type;
+    struct wsJsonBinding* binding; // WS_JSON_BIND_OBJECT
+    size_t offset;
+    size_t size;
+} wsJsonBindField;
+
+#define WS_JSON_BIND_MAX_FIELDS 192
+
+typedef struct wsJsonBinding {
+    const wsJsonBindField* (*describe)(int32_t* count);
+    size_t size;
+
+    // Filled on first use
+    _Atomic int32_t state;
+    const wsJsonBindField* fields;
+    int32_t fieldCount;
+    uint32_t multiplier;
+    uint32_t shift;
+    uint32_t mask;
+    bool fullHash; // hashes whole names instead of their length, first, middle and last byte
+    bool perfect; // every name has its own slot, otherwise slots are probed
+    uint8_t slots[256]; // field index + 1, 0 is empty
+} wsJsonBinding;
+
+#define _WS_JSON_BIND_C_INTEGER int64_t,
+#define _WS_JSON_BIND_C_NUMBER double,
+#define _WS_JSON_BIND_C_BOOL bool,
+#define _WS_JSON_BIND_C_STRING(size) char, [size]
+#define _WS_JSON_BIND_C_OBJECT(type, binding) type,
+#define _WS_JSON_BIND_DECLARE_(type, suffix, member) type member suffix;
+#define _WS_JSON_BIND_DECLARE(...) _WS_JSON_BIND_DECLARE_(__VA_ARGS__)
+#define _WS_JSON_BIND_MEMBER(kind, member, json) _WS_JSON_BIND_DECLARE(_WS_JSON_BIND_C_##kind, member)
+
+#define _WS_JSON_BIND_TYPE_INTEGER WS_JSON_BIND_INTEGER, NULL
+#define _WS_JSON_BIND_TYPE_NUMBER WS_JSON_BIND_NUMBER, NULL
+#define _WS_JSON_BIND_TYPE_BOOL WS_JSON_BIND_BOOL, NULL
+#define _WS_JSON_BIND_TYPE_STRING(size) WS_JSON_BIND_STRING, NULL
+#define _WS_JSON_BIND_TYPE_OBJECT(type, binding) WS_JSON_BIND_OBJECT, &(binding)
+#define _WS_JSON_BIND_FIELD(kind, member, json) \
+    { json, sizeof(json) - 1, _WS_JSON_BIND_TYPE_##kind, \
+      offsetof(_wsJsonBindStruct, member), sizeof(((_wsJsonBindStruct*)0)->member) },
+
+// Declares typedef struct name { ... } name from the field list
+#define WS_JSON_STRUCT(name, FIELDS) typedef struct name { FIELDS(_WS_JSON_BIND_MEMBER) } name
+
+// Defines the binding name for structType, nested bindings have to be defined before
+#define WS_JSON_BINDING(name, structType, FIELDS) \
+    static const wsJsonBindField* name##Describe(int32_t* count) { \
+        typedef structType _wsJsonBindStruct; \
+        static const wsJsonBindField fields[] = { FIELDS(_WS_JSON_BIND_FIELD) }; \
+        *count = (int32_t)(sizeof(fields) / sizeof(fields[0])); \
+        return fields; \
+    } \
+    static wsJsonBinding name = { .describe = name##Describe, .size = sizeof(structType) }
+
+// Decodes the object in data into out, input without a member for a field leaves it as it is
+int32_t wsJsonBindParse(wsJsonBinding* binding, const char* data, size_t length, void* out);
+
+// Writes in as compact json, same format as wsJsonWrite
+int32_t wsJsonBindWrite(wsJsonWriter* writer, wsJsonBinding* binding, const void* in);
+
+/*
+ *  Frozen snapshots
+ *  Position independent binary image of a tree that is queried in place,
+ *  so opening one is a mmap without parsing or allocating. A snapshot is
+ *  a 32 byte header and the nodes, children of a node are contiguous and
+ *  objects with WS_JSON_INDEX_THRESHOLD or more fields carry their key
+ *  hash index behind them. Offsets are relative to the node holding them,
+ *  keys and strings are NUL terminated and json escaped like in trees.
+ *  Snapshots are trusted (only the header is checked), written in host
+ *  byte order and limited to 4 GB.
+ */
+typedef struct wsJsonFrozen {
+    uint32_t keyOffset;
+    uint32_t keyLength;
+    uint8_t type; // wsJsonType
+    uint8_t flags; // WS_JSON_FLAG_INTEGER, WS_JSON_FLAG_INDEXED
+    uint16_t reserved;
+    uint32_t count; // string length, field or element count
+    uint64_t value; // double or int64 bits, bool, offset of the string or the children
+} wsJsonFrozen;
+
+int32_t wsJsonFreeze(wsJsonWriter* writer, wsJson* obj);
+
+// data has to be 8 byte aligned (mappings and heap buffers are)
+const wsJsonFrozen* wsJsonFrozenRoot(const void* data, size_t length);
+
+// Maps the snapshot read only (POSIX only), root stays valid until wsJsonFrozenClose
+typedef struct wsJsonFrozenFile {
+    const wsJsonFrozen* root;
+    const void* data;
+    size_t length;
+} wsJsonFrozenFile;
+
+#if defined(__unix__) || defined(__APPLE__)
+wsJsonFrozenFile* wsJsonFrozenOpen(const char* path);
+void wsJsonFrozenClose(wsJsonFrozenFile* file);
+#endif
+
+// Dotted keys like wsJsonGet, an empty key is the node itself
+const wsJsonFrozen* wsJsonFrozenGet(const wsJsonFrozen* obj, const char* key);
+const wsJsonFrozen* wsJsonFrozenGetPath(const wsJsonFrozen* obj, const wsJsonPath* path);
+const char* wsJsonFrozenGetString(const wsJsonFrozen* obj, const char* key, size_t* length);
+double wsJsonFrozenGetNumber(const wsJsonFrozen* obj, const char* key);
+int64_t wsJsonFrozenGetInteger(const wsJsonFrozen* obj, const char* key);
+bool wsJsonFrozenGetBool(const wsJsonFrozen* obj, const char* key);
+int32_t wsJsonFrozenGetArrayLen(const wsJsonFrozen* obj, const char* key);
+const wsJsonFrozen* wsJsonFrozenGetArrayAt(const wsJsonFrozen* obj, const char* key, int32_t index);
+
+// Iteration over fields and elements
+const wsJsonFrozen* wsJsonFrozenChildAt(const wsJsonFrozen* obj, int32_t index);
+const char* wsJsonFrozenKey(const wsJsonFrozen* node);
+
+// Copies the value into a mutable tree (current arena), with WS_JSON_PARSE_VIEWS
+// keys and strings point into the snapshot
+wsJson* wsJsonThaw(const wsJsonFrozen* node, uint32_t parseFlags);
+
+/*
+ *  Worker pool
+ *  Fixed set of threads for the batch functions, create it once and pass
+ *  it to every call. The calling thread works as worker 0, so a pool of
+ *  one thread (or a NULL pool) runs everything on the caller. A pool runs
+ *  one batch at a time.
+ */
+typedef struct wsJsonPool {
+    thrd_t* threads; // threadCount - 1 workers, the caller is worker 0
+    int32_t threadCount;
+    int32_t started;
+    mtx_t lock;
+    cnd_t wake;
+    cnd_t done;
+    uint64_t generation;
+    int32_t pending;
+    bool shutdown;
+    void (*task)(void* context, int32_t worker);
+    void* context;
+} wsJsonPool;
+
+// Pass 0 to use one thread per online cpu
+wsJsonPool* wsJsonPoolInit(int32_t threadCount);
+void wsJsonPoolFree(wsJsonPool* pool);
+
+/*
+ *  NDJSON batches
+ *  Parses newline delimited json (JSON Lines) in parallel. The input is cut
+ *  into chunks at newlines which the workers take in turns, every worker
+ *  parses into its own arena so they never share an allocator. Lines that
+ *  contain only whitespace are skipped, every other line has to be an
+ *  object or an array.
+ */
+typedef struct wsJsonBatch {
+    wsJson** records;     // in input order, NULL for lines that failed to parse
+    size_t* offsets;      // byte offset of the line of every record
+    size_t recordCount;
+    size_t errorCount;
+    wsJsonArena** arenas; // one per worker, the records live in them
+    int32_t arenaCount;
+    const char* data;     // mapping of wsJsonParseLinesFile with WS_JSON_PARSE_VIEWS
+    size_t length;
+} wsJsonBatch;
+
+wsJsonBatch* wsJsonParseLines(wsJsonPool* pool, const char* data, size_t length, uint32_t parseFlags);
+
+// Frees the records together with their arenas
+void wsJsonBatchFree(wsJsonBatch* batch);
+
+// Called from the workers at the same time, record is NULL if the line failed to parse and only
+// lives until the callback returns. offset is the byte offset of the line, return WS_ERROR to stop.
+typedef int32_t (*wsJsonLineFn)(void* user, wsJson* record, size_t offset, int32_t worker);
+
+// Streams the records to callback instead of keeping them, returns WS_ERROR if the callback stopped it
+int32_t wsJsonEachLine(wsJsonPool* pool, const char* data, size_t length, uint32_t parseFlags, wsJsonLineFn callback, void* user);
+
+#if defined(__unix__) || defined(__APPLE__)
+wsJsonBatch* wsJsonParseLinesFile(wsJsonPool* pool, const char* path, uint32_t parseFlags);
+int32_t wsJsonEachLineFile(wsJsonPool* pool, const char* path, uint32_t parseFlags, wsJsonLineFn callback, void* user);
+#endif
+
+/*
+ *  Parallel serialization
+ *  Arrays and objects with WS_JSON_PARALLEL_THRESHOLD or more children are
+ *  cut into ranges of children which the pool workers serialize into their
+ *  own buffers. The output is byte identical to wsJsonWrite/wsJsonWritePretty,
+ *  smaller documents are just written on the calling thread. Sink writers
+ *  get the worker buffers passed through without copying them again.
+ */
+typedef struct wsJsonSlice {
+    const char* data;
+    size_t size;
+} wsJsonSlice;
+
+// Gets every piece of the output in order at once (e.g. to pass them on to writev)
+typedef int32_t (*wsJsonWriteVecFn)(void* user, const wsJsonSlice* slices, size_t count);
+
+int32_t wsJsonWriteParallel(wsJsonPool* pool, wsJsonWriter* writer, wsJson* obj);
+int32_t wsJsonWritePrettyParallel(wsJsonPool* pool, wsJsonWriter* writer, wsJson* obj);
+
+// The slices are only valid until fn returns
+int32_t wsJsonWriteVec(wsJsonPool* pool, wsJson* obj, bool pretty, wsJsonWriteVecFn fn, void* user);
+
+/*
+ *  Shared documents
+ *  A tree that is loaded once and read from many threads. Sharing builds 
+ *  every object index up front and marks all nodes read only, so lookups 
+ *  and serialization never write to the tree and need no locks. The 
+ *  document is reference counted and freed by its last release.
+ *  A slot holds the current version for hot reloads: readers acquire it 
+ *  without locking or waiting, a publish swaps in the new version and 
+ *  drops the old one, which lives on until its last reader releases it.
+ */
+typedef struct wsJsonShared {
+    wsJson* root; // read only, wsJsonAdd*, wsJsonSet* and wsJsonFree refuse it
+    wsJsonArena* arena; // the tree lives in it if not NULL
+    _Atomic int32_t refs;
+} wsJsonShared;
+
+typedef struct wsJsonSharedSlot {
+    _Atomic(wsJsonShared*) current;
+    _Atomic uint32_t epoch;
+    _Atomic int32_t readers[2]; // acquires in progress per epoch
+    mtx_t lock; // serializes publishers
+} wsJsonSharedSlot;
+
+// Takes over the tree (and the arena it lives in, or NULL for heap trees) with one reference,
+// on failure NULL is returned and the tree stays with the caller
+wsJsonShared* wsJsonShare(wsJson* root, wsJsonArena* arena);
+wsJsonShared* wsJsonSharedRetain(wsJsonShared* doc);
+void wsJsonSharedRelease(wsJsonShared* doc);
+
+// The slot takes over the reference of doc (may be NULL)
+int32_t wsJsonSharedSlotInit(wsJsonSharedSlot* slot, wsJsonShared* doc);
+void wsJsonSharedSlotFree(wsJsonSharedSlot* slot);
+
+// Returns a new reference to the current version (or NULL), release it when done
+wsJsonShared* wsJsonSharedSlotAcquire(wsJsonSharedSlot* slot);
+
+// Takes over the reference of doc and releases the previous version once no acquire 
+// can pick it up anymore, readers that still hold it keep it alive
+int32_t wsJsonSharedSlotPublish(wsJsonSharedSlot* slot, wsJsonShared* doc);
+
+/*
+ *  Cached serialization
+ *  Opt-in dirty tracking for documents that get written again and again 
+ *  with small changes in between. A cache keeps the last compact output 
+ *  and where every array and object of the document sits in it. Setters, 
+ *  wsJsonAddField/wsJsonAddElement, wsJsonRemove and the patch functions 
+ *  mark the container they change and its parents, the next write only 
+ *  regenerates those and copies everything else out of the last output. 
+ *  Changes made to nodes by hand are not seen. A document can have one 
+ *  cache, mutate and write it from one thread at a time.
+ */
+typedef struct wsJsonCacheRecord {
+    const wsJson* node; // NULL for free slots
+    const wsJson* parent;
+    size_t offset; // from the start of the parent in the last output
+    size_t length;
+    uint32_t containers; // arrays and objects in the subtree, itself included
+    bool dirty;
+} wsJsonCacheRecord;
+
+typedef struct wsJsonCache {
+    wsJson* root;
+    wsJsonWriter outputs[2]; // the last output and the one the next update writes
+    int32_t current;
+    bool valid;
+    wsJsonCacheRecord* records; // open addressing by node address
+    size_t recordCount;
+    size_t recordMask;
+    mtx_t lock;
+    struct wsJsonCache* next; // caches that can be marked
+} wsJsonCache;
+
+wsJsonCache* wsJsonCacheInit(wsJson* root);
+
+// Free it before the document, it walks the tree to take its marks off the nodes
+void wsJsonCacheFree(wsJsonCache* cache);
+
+// Brings the output up to date, it is then in cache->outputs[cache->current]
+int32_t wsJsonCacheUpdate(wsJsonCache* cache);
+
+// Byte for byte the output of wsJsonWrite / wsJsonToString
+int32_t wsJsonCacheWrite(wsJsonCache* cache, wsJsonWriter* writer);
+int32_t wsJsonCacheToString(wsJsonCache* cache, char* out, size_t size);
+
+// Frees the node and everything below it, walks the tree in place so deep trees can't overflow the stack
 void wsJsonFree(wsJson* obj);
 
 #ifndef WS_JSON_NO_MACROS
     #define wsJsonAddString(parent, key, val) (wsJsonAddField(parent, wsJsonInitString(key, val)))
     #define wsJsonAddNumber(parent, key, val) (wsJsonAddField(parent, wsJsonInitNumber(key, val)))
+    #define wsJsonAddInteger(parent, key, val) (wsJsonAddField(parent, wsJsonInitInteger(key, val)))
     #define wsJsonAddBool(parent, key, val) (wsJsonAddField(parent, wsJsonInitBool(key, val)))
     #define wsJsonAddNull(parent, key) (wsJsonAddField(parent, wsJsonInitNull(key)))
 #endif // WS_JSON_MACROS
@@ -142,6 +938,17 @@ void wsJsonSetLogLevel(int32_t level);
 #include <ctype.h>
 #include <string.h>
 #include <stdio.h>
+#include <math.h>
+#include <locale.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
 
 /* Log */ 
 void _wsJsonLogImpl(int32_t level, const char* file, const char* func, int32_t line, const char* msg, ...) {
@@ -190,741 +997,8442 @@ void wsJsonSetLogLevel(int32_t level) {
     _wsJsonLogLevel = level;
 }
 
-wsJson* wsJsonInitObject(const char* key) {
-    if (!key) {
-        WS_JSON_LOG_API_DUMP("Object key is null");
+/* 
+ *  Stats
+ *  Every allocation of the implementation goes through _wsJsonMalloc,
+ *  _wsJsonRealloc and _wsJsonFree. With WS_JSON_STATS they put the size in 
+ *  a header in front of the block, without it they are the plain macros.
+ */
+#ifdef WS_JSON_STATS
+
+_Thread_local wsJsonStats _wsJsonStats;
+
+// Keeps the block behind it aligned like malloc does
+#define _WS_JSON_STATS_HEADER 16
+
+static inline void _wsJsonStatsAdd(int64_t size) {
+    _wsJsonStats.bytesInUse += size;
+    if (_wsJsonStats.bytesInUse > _wsJsonStats.peakBytes) _wsJsonStats.peakBytes = _wsJsonStats.bytesInUse;
+}
+
+static void* _wsJsonMalloc(size_t size) {
+    unsigned char* block = WS_JSON_MALLOC(_WS_JSON_STATS_HEADER + size);
+    if (!block) return NULL;
+    *(size_t*)block = size;
+    _wsJsonStats.allocations++;
+    _wsJsonStatsAdd((int64_t)size);
+    return block + _WS_JSON_STATS_HEADER;
+}
+
+static void* _wsJsonRealloc(void* ptr, size_t size) {
+    if (!ptr) return _wsJsonMalloc(size);
+    unsigned char* block = (unsigned char*)ptr - _WS_JSON_STATS_HEADER;
+    size_t oldSize = *(size_t*)block;
+    block = WS_JSON_REALLOC(block, _WS_JSON_STATS_HEADER + size);
+    if (!block) return NULL;
+    *(size_t*)block = size;
+    _wsJsonStats.reallocations++;
+    _wsJsonStatsAdd((int64_t)size - (int64_t)oldSize);
+    return block + _WS_JSON_STATS_HEADER;
+}
+
+static void _wsJsonFree(void* ptr) {
+    if (!ptr) return;
+    unsigned char* block = (unsigned char*)ptr - _WS_JSON_STATS_HEADER;
+    _wsJsonStats.frees++;
+    _wsJsonStats.bytesInUse -= (int64_t)*(size_t*)block;
+    WS_JSON_FREE(block);
+}
+
+static inline uint64_t _wsJsonStatsNow(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static inline void _wsJsonStatsTime(wsJsonStatsTimer* timer, uint64_t start, size_t bytes) {
+    timer->count++;
+    timer->bytes += bytes;
+    timer->nanoseconds += _wsJsonStatsNow() - start;
+}
+
+#define _WS_JSON_STAT(counter) (_wsJsonStats.counter++)
+#define _WS_JSON_STATS_START(name) uint64_t name = _wsJsonStatsNow()
+#define _WS_JSON_STATS_TIME(timer, name, bytes) _wsJsonStatsTime(&_wsJsonStats.timer, name, bytes)
+
+int32_t wsJsonGetStats(wsJsonStats* stats) {
+    if (!stats) {
+        WS_JSON_LOG_ERROR("Invalid input paramerter is NULL\n");
+        return WS_ERROR;
     }
+    *stats = _wsJsonStats;
+    return WS_OK;
+}
 
-    wsJson* obj = WS_JSON_MALLOC(sizeof(wsJson));
-    if (!obj) {
-        WS_JSON_LOG_ERROR("Failed to allocate object: %s", key);
-        return NULL;
+void wsJsonResetStats(void) {
+    int64_t bytesInUse = _wsJsonStats.bytesInUse;
+    memset(&_wsJsonStats, 0, sizeof(_wsJsonStats));
+    _wsJsonStats.bytesInUse = bytesInUse;
+    _wsJsonStats.peakBytes = bytesInUse;
+}
+
+#else
+
+static inline void* _wsJsonMalloc(size_t size) { return WS_JSON_MALLOC(size); }
+static inline void* _wsJsonRealloc(void* ptr, size_t size) { return WS_JSON_REALLOC(ptr, size); }
+static inline void _wsJsonFree(void* ptr) { WS_JSON_FREE(ptr); }
+
+#define _WS_JSON_STAT(counter) ((void)0)
+#define _WS_JSON_STATS_START(name) ((void)0)
+#define _WS_JSON_STATS_TIME(timer, name, bytes) ((void)(bytes))
+
+int32_t wsJsonGetStats(wsJsonStats* stats) {
+    if (stats) memset(stats, 0, sizeof(*stats));
+    return WS_ERROR;
+}
+
+void wsJsonResetStats(void) {
+}
+
+#endif // WS_JSON_STATS
+
+/* Arena */
+_Thread_local wsJsonArena* _wsJsonArena = NULL;
+
+#define WS_JSON_ALIGN_UP(size, align) (((size) + (align) - 1) & ~((size_t)(align) - 1))
+#define WS_JSON_ARENA_CHUNK_HEADER WS_JSON_ALIGN_UP(sizeof(wsJsonArenaChunk), WS_JSON_ARENA_ALIGN)
+#define WS_JSON_ARENA_CHUNK_DATA(chunk) ((unsigned char*)(chunk) + WS_JSON_ARENA_CHUNK_HEADER)
+
+// Live arenas by id in pages of 256, so arena nodes find theirs without it being set.
+// Pages are never freed and slots are only written under the lock, a node can 
+// only be reached once the arena that made it is registered.
+static wsJsonArena** _wsJsonArenaPages[256];
+static uint32_t _wsJsonArenaNextId = 1;
+static mtx_t _wsJsonArenasLock;
+static once_flag _wsJsonArenasOnce = ONCE_FLAG_INIT;
+
+static void _wsJsonArenasInit(void) {
+    mtx_init(&_wsJsonArenasLock, mtx_plain);
+}
+
+// Takes the next free id, 0 when all 65535 are in use
+static uint16_t _wsJsonArenaRegister(wsJsonArena* arena) {
+    call_once(&_wsJsonArenasOnce, _wsJsonArenasInit);
+    mtx_lock(&_wsJsonArenasLock);
+    uint16_t id = 0;
+    for (uint32_t tries = 0; tries < 65535 && !id; tries++) {
+        uint32_t candidate = _wsJsonArenaNextId;
+        _wsJsonArenaNextId = candidate == 65535 ? 1 : candidate + 1;
+        wsJsonArena** page = _wsJsonArenaPages[candidate >> 8];
+        if (!page) {
+            // Straight from the allocator, pages stay for the life of the process and aren't counted in the stats
+            page = WS_JSON_CALLOC(256, sizeof(wsJsonArena*));
+            if (!page) break;
+            _wsJsonArenaPages[candidate >> 8] = page;
+        }
+        if (!page[candidate & 255]) {
+            page[candidate & 255] = arena;
+            id = (uint16_t)candidate;
+        }
     }
-    memset(obj, 0, sizeof(wsJson));
-    obj->object.children = NULL;
-    obj->object.childCount = 0;
-    obj->object.childCapacity = 0;
-    obj->type = WS_JSON_OBJECT;
-    if (key) strncpy(obj->key, key, sizeof(obj->key) - 1);
-    return obj;
+    mtx_unlock(&_wsJsonArenasLock);
+    return id;
 }
 
-wsJson* wsJsonInitString(const char* key, const char* val) {
-    wsJson* obj = WS_JSON_MALLOC(sizeof(wsJson));
-    if (!obj) {
-        WS_JSON_LOG_ERROR("Failed to allocate memory for json object: %s\n", key);
+static void _wsJsonArenaUnregister(const wsJsonArena* arena) {
+    mtx_lock(&_wsJsonArenasLock);
+    _wsJsonArenaPages[arena->id >> 8][arena->id & 255] = NULL;
+    mtx_unlock(&_wsJsonArenasLock);
+}
+
+static inline wsJsonArena* _wsJsonArenaOf(const wsJson* node) {
+    wsJsonArena** page = _wsJsonArenaPages[node->arena >> 8];
+    return page ? page[node->arena & 255] : NULL;
+}
+
+wsJsonArena* wsJsonArenaInit(size_t chunkSize) {
+    wsJsonArena* arena = _wsJsonMalloc(sizeof(wsJsonArena));
+    if (!arena) {
+        WS_JSON_LOG_ERROR("Failed to allocate json arena\n");
         return NULL;
     }
-    memset(obj, 0, sizeof(wsJson));
-    obj->type = WS_JSON_STRING;
-    if (key) strncpy(obj->key, key, sizeof(obj->key) - 1);
-    if (val) { 
-        size_t length = strlen(val);
-        obj->stringValue = WS_JSON_MALLOC(length + 1);
-        strncpy(obj->stringValue, val, length);
-        obj->stringValue[length] = '\0';
+    arena->first = NULL;
+    arena->current = NULL;
+    arena->chunkSize = chunkSize ? chunkSize : WS_JSON_ARENA_CHUNK_SIZE;
+    arena->id = _wsJsonArenaRegister(arena);
+    if (!arena->id) {
+        WS_JSON_LOG_ERROR("Failed to register json arena, too many arenas are alive\n");
+        _wsJsonFree(arena);
+        return NULL;
     }
-    return obj;
+    return arena;
 }
 
-wsJson* wsJsonInitNumber(const char* key, double val) {
-    wsJson* obj = WS_JSON_MALLOC(sizeof(wsJson));
-    if (!obj) {
-        WS_JSON_LOG_ERROR("Failed to allocate memory for json object: %s\n", key);
+void* wsJsonArenaAlloc(wsJsonArena* arena, size_t size) {
+    if (!arena) {
+        WS_JSON_LOG_ERROR("Arena is NULL\n");
         return NULL;
     }
-    memset(obj, 0, sizeof(wsJson));
-    obj->type = WS_JSON_NUMBER;
-    if (key) strncpy(obj->key, key, sizeof(obj->key) - 1);
-    obj->numberValue = val;
-    return obj;
-}
+    size = WS_JSON_ALIGN_UP(size ? size : 1, WS_JSON_ARENA_ALIGN);
 
-wsJson* wsJsonInitBool(const char* key, bool val) {
-    wsJson* obj = WS_JSON_MALLOC(sizeof(wsJson));
-    if (!obj) {
-        WS_JSON_LOG_ERROR("Failed to allocate memory for json object: %s\n", key);
-        return NULL;
+    wsJsonArenaChunk* chunk = arena->current;
+    if (chunk && chunk->size - chunk->used >= size) {
+        void* ptr = WS_JSON_ARENA_CHUNK_DATA(chunk) + chunk->used;
+        chunk->used += size;
+        return ptr;
     }
-    memset(obj, 0, sizeof(wsJson));
-    obj->type = WS_JSON_BOOL;
-    if (key) strncpy(obj->key, key, sizeof(obj->key) - 1);
-    obj->boolValue = val;
-    return obj;
-}
 
-wsJson* wsJsonInitArray(const char* key) {
-    wsJson* obj = WS_JSON_MALLOC(sizeof(wsJson));
-    if (!obj) {
-        WS_JSON_LOG_ERROR("Failed to allocate memory for json array: %s\n", key);
-        return NULL;
+    // Move on to chunks kept alive by a previous reset
+    while (chunk && chunk->next) {
+        chunk = chunk->next;
+        chunk->used = 0;
+        if (chunk->size >= size) {
+            arena->current = chunk;
+            chunk->used = size;
+            return WS_JSON_ARENA_CHUNK_DATA(chunk);
+        }
     }
-    memset(obj, 0, sizeof(wsJson));
-    obj->array.elements = NULL;
-    obj->array.elementCount = 0;
-    obj->array.elementCapacity = 0;
-    obj->type = WS_JSON_ARRAY;
-    if (key) strncpy(obj->key, key, sizeof(obj->key) - 1);
-    return obj;
-}
 
-wsJson* wsJsonInitNull(const char* key) {
-    wsJson* obj = WS_JSON_MALLOC(sizeof(wsJson));
-    if (!obj) {
-        WS_JSON_LOG_ERROR("Failed to allocate memory for json null: %s\n", key);
+    size_t chunkSize = size > arena->chunkSize ? size : arena->chunkSize;
+    wsJsonArenaChunk* newChunk = _wsJsonMalloc(WS_JSON_ARENA_CHUNK_HEADER + chunkSize);
+    if (!newChunk) {
+        WS_JSON_LOG_ERROR("Failed to allocate json arena chunk of size: %zu\n", chunkSize);
         return NULL;
     }
-    memset(obj, 0, sizeof(wsJson));
-    obj->type = WS_JSON_NULL;
-    if (key) strncpy(obj->key, key, sizeof(obj->key) - 1);
-    return obj;
+    newChunk->next = NULL;
+    newChunk->size = chunkSize;
+    newChunk->used = size;
+
+    if (chunk) chunk->next = newChunk;
+    else arena->first = newChunk;
+    arena->current = newChunk;
+    return WS_JSON_ARENA_CHUNK_DATA(newChunk);
 }
 
-void wsJsonAddField(wsJson *parent, wsJson *child) {
-    if (!parent || parent->type != WS_JSON_OBJECT || !child) return;
+// Grows in place when ptr is the last allocation of the current chunk
+static void* _wsJsonArenaRealloc(wsJsonArena* arena, void* ptr, size_t oldSize, size_t newSize) {
+    if (!ptr) return wsJsonArenaAlloc(arena, newSize);
 
-    if (parent->object.childCount >= parent->object.childCapacity) {
-        int32_t newCap = parent->object.childCapacity == 0 ? 4 : parent->object.childCapacity * 2;
-        parent->object.children = WS_JSON_REALLOC(parent->object.children, sizeof(wsJson) * newCap);
-        parent->object.childCapacity = newCap;
+    wsJsonArenaChunk* chunk = arena->current;
+    size_t alignedOld = WS_JSON_ALIGN_UP(oldSize, WS_JSON_ARENA_ALIGN);
+    size_t alignedNew = WS_JSON_ALIGN_UP(newSize, WS_JSON_ARENA_ALIGN);
+    if (chunk && chunk->used >= alignedOld &&
+        WS_JSON_ARENA_CHUNK_DATA(chunk) + chunk->used - alignedOld == (unsigned char*)ptr &&
+        chunk->used - alignedOld + alignedNew <= chunk->size) {
+        chunk->used = chunk->used - alignedOld + alignedNew;
+        return ptr;
     }
-    parent->object.children[parent->object.childCount++] = child;
+
+    void* out = wsJsonArenaAlloc(arena, newSize);
+    if (out) memcpy(out, ptr, oldSize < newSize ? oldSize : newSize);
+    return out;
 }
 
-void wsJsonAddElement(wsJson *array, wsJson *element) {
-    if (!array || array->type != WS_JSON_ARRAY || !element) return;
-    
+void wsJsonArenaReset(wsJsonArena* arena) {
+    if (!arena) return;
+    // The following chunks get cleared once the allocator reaches them again
+    if (arena->first) arena->first->used = 0;
+    arena->current = arena->first;
+}
+
+void wsJsonArenaFree(wsJsonArena* arena) {
+    if (!arena) return;
+    if (_wsJsonArena == arena) _wsJsonArena = NULL;
+    _wsJsonArenaUnregister(arena);
+
+    wsJsonArenaChunk* chunk = arena->first;
+    while (chunk) {
+        wsJsonArenaChunk* next = chunk->next;
+        _wsJsonFree(chunk);
+        chunk = next;
+    }
+    _wsJsonFree(arena);
+}
+
+wsJsonArena* wsJsonSetArena(wsJsonArena* arena) {
+    wsJsonArena* previous = _wsJsonArena;
+    _wsJsonArena = arena;
+    return previous;
+}
+
+wsJsonArena* wsJsonGetArena(void) {
+    return _wsJsonArena;
+}
+
+/* Block pools */
+#define _WS_JSON_BLOCK_CLASSES 12
+#define _WS_JSON_BLOCK_LARGE 15 // class of blocks that come straight from _wsJsonMalloc
+#define _WS_JSON_BLOCK_HEADER 8
+#define _WS_JSON_BLOCK_CHUNK (64 * 1024)
+
+static const uint32_t _wsJsonBlockSizes[_WS_JSON_BLOCK_CLASSES] = { 16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024 };
+
+typedef struct _wsJsonFreeBlock {
+    struct _wsJsonFreeBlock* next;
+} _wsJsonFreeBlock;
+
+// Every block starts with a header holding its pool (16 byte aligned) and its class in the low 4 bits,
+// large blocks hold their size there instead
+typedef struct _wsJsonBlockPool {
+    _wsJsonFreeBlock* freeLists[_WS_JSON_BLOCK_CLASSES];
+    _Atomic(_wsJsonFreeBlock*) remote; // blocks freed by other threads
+    unsigned char* bump;
+    unsigned char* bumpEnd;
+    void* chunks;
+    void* allocation; // unaligned start of the pool
+    struct _wsJsonBlockPool* next; // on the list of pools without a thread
+} _wsJsonBlockPool;
+
+static _Thread_local bool _wsJsonBlockPoolsOn = false;
+static _Thread_local _wsJsonBlockPool* _wsJsonBlocks = NULL; // pool of the current thread
+static mtx_t _wsJsonBlockPoolsLock;
+static once_flag _wsJsonBlockPoolsOnce = ONCE_FLAG_INIT;
+static tss_t _wsJsonBlockPoolsExit;
+static _wsJsonBlockPool* _wsJsonAbandonedPools = NULL;
+
+// Runs when a thread that used its pool exits, blocks still in use stay valid
+static void _wsJsonBlockPoolAbandon(void* data) {
+    _wsJsonBlockPool* pool = data;
+    _wsJsonBlocks = NULL;
+    mtx_lock(&_wsJsonBlockPoolsLock);
+    pool->next = _wsJsonAbandonedPools;
+    _wsJsonAbandonedPools = pool;
+    mtx_unlock(&_wsJsonBlockPoolsLock);
+}
+
+static void _wsJsonBlockPoolsInit(void) {
+    mtx_init(&_wsJsonBlockPoolsLock, mtx_plain);
+    tss_create(&_wsJsonBlockPoolsExit, _wsJsonBlockPoolAbandon);
+}
+
+static _wsJsonBlockPool* _wsJsonBlockPoolGet(void) {
+    if (_wsJsonBlocks) return _wsJsonBlocks;
+
+    call_once(&_wsJsonBlockPoolsOnce, _wsJsonBlockPoolsInit);
+    mtx_lock(&_wsJsonBlockPoolsLock);
+    _wsJsonBlockPool* pool = _wsJsonAbandonedPools;
+    if (pool) _wsJsonAbandonedPools = pool->next;
+    mtx_unlock(&_wsJsonBlockPoolsLock);
+
+    if (!pool) {
+        void* allocation = _wsJsonMalloc(sizeof(_wsJsonBlockPool) + 15);
+        if (!allocation) {
+            WS_JSON_LOG_ERROR("Failed to allocate json block pool\n");
+            return NULL;
+        }
+        pool = (_wsJsonBlockPool*)WS_JSON_ALIGN_UP((uintptr_t)allocation, 16);
+        memset(pool, 0, sizeof(*pool));
+        atomic_init(&pool->remote, NULL);
+        pool->allocation = allocation;
+    }
+    pool->next = NULL;
+    tss_set(_wsJsonBlockPoolsExit, pool);
+    _wsJsonBlocks = pool;
+    return pool;
+}
+
+static inline int32_t _wsJsonBlockClass(size_t size) {
+    if (size <= 64) return size ? (int32_t)((size - 1) >> 4) : 0;
+    int32_t sizeClass = 4;
+    while (sizeClass < _WS_JSON_BLOCK_CLASSES && _wsJsonBlockSizes[sizeClass] < size) sizeClass++;
+    return sizeClass;
+}
+
+// Moves the blocks other threads gave back onto the free lists
+static void _wsJsonBlockPoolDrain(_wsJsonBlockPool* pool) {
+    _wsJsonFreeBlock* block = atomic_exchange_explicit(&pool->remote, NULL, memory_order_acquire);
+    while (block) {
+        _wsJsonFreeBlock* next = block->next;
+        uint32_t sizeClass = ((uint64_t*)block)[-1] & 15;
+        block->next = pool->freeLists[sizeClass];
+        pool->freeLists[sizeClass] = block;
+        block = next;
+    }
+}
+
+static void* _wsJsonBlockAlloc(size_t size) {
+    int32_t sizeClass = _wsJsonBlockClass(size);
+    if (sizeClass == _WS_JSON_BLOCK_CLASSES) {
+        uint64_t* header = _wsJsonMalloc(_WS_JSON_BLOCK_HEADER + size);
+        if (!header) return NULL;
+        *header = (uint64_t)size << 4 | _WS_JSON_BLOCK_LARGE;
+        return header + 1;
+    }
+
+    _wsJsonBlockPool* pool = _wsJsonBlockPoolGet();
+    if (!pool) return NULL;
+    if (!pool->freeLists[sizeClass] && atomic_load_explicit(&pool->remote, memory_order_relaxed)) {
+        _wsJsonBlockPoolDrain(pool);
+    }
+    _wsJsonFreeBlock* block = pool->freeLists[sizeClass];
+    if (block) {
+        pool->freeLists[sizeClass] = block->next;
+        return block;
+    }
+
+    size_t stride = _WS_JSON_BLOCK_HEADER + _wsJsonBlockSizes[sizeClass];
+    if ((size_t)(pool->bumpEnd - pool->bump) < stride) {
+        unsigned char* chunk = _wsJsonMalloc(_WS_JSON_BLOCK_CHUNK);
+        if (!chunk) {
+            WS_JSON_LOG_ERROR("Failed to allocate json block chunk\n");
+            return NULL;
+        }
+        *(void**)chunk = pool->chunks;
+        pool->chunks = chunk;
+        pool->bump = chunk + 8;
+        pool->bumpEnd = chunk + _WS_JSON_BLOCK_CHUNK;
+    }
+    uint64_t* header = (uint64_t*)pool->bump;
+    pool->bump += stride;
+    *header = (uint64_t)(uintptr_t)pool | (uint64_t)sizeClass;
+    return header + 1;
+}
+
+static void _wsJsonBlockFree(void* ptr) {
+    if (!ptr) return;
+    uint64_t* header = (uint64_t*)ptr - 1;
+    uint32_t sizeClass = *header & 15;
+    if (sizeClass == _WS_JSON_BLOCK_LARGE) {
+        _wsJsonFree(header);
+        return;
+    }
+
+    _wsJsonBlockPool* owner = (_wsJsonBlockPool*)(uintptr_t)(*header & ~(uint64_t)15);
+    _wsJsonFreeBlock* block = ptr;
+    if (owner == _wsJsonBlocks) {
+        block->next = owner->freeLists[sizeClass];
+        owner->freeLists[sizeClass] = block;
+        return;
+    }
+    block->next = atomic_load_explicit(&owner->remote, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&owner->remote, &block->next, block, 
+                                                  memory_order_release, memory_order_relaxed));
+}
+
+static inline size_t _wsJsonBlockCapacity(const void* ptr) {
+    uint64_t header = ((const uint64_t*)ptr)[-1];
+    uint32_t sizeClass = header & 15;
+    return sizeClass == _WS_JSON_BLOCK_LARGE ? (size_t)(header >> 4) : _wsJsonBlockSizes[sizeClass];
+}
+
+// Stays in place while the block has room
+static void* _wsJsonBlockRealloc(void* ptr, size_t size) {
+    if (!ptr) return _wsJsonBlockAlloc(size);
+    size_t capacity = _wsJsonBlockCapacity(ptr);
+    if (size <= capacity) return ptr;
+
+    uint64_t* header = (uint64_t*)ptr - 1;
+    if ((*header & 15) == _WS_JSON_BLOCK_LARGE) {
+        header = _wsJsonRealloc(header, _WS_JSON_BLOCK_HEADER + size);
+        if (!header) return NULL;
+        *header = (uint64_t)size << 4 | _WS_JSON_BLOCK_LARGE;
+        return header + 1;
+    }
+    void* out = _wsJsonBlockAlloc(size);
+    if (!out) return NULL;
+    memcpy(out, ptr, capacity);
+    _wsJsonBlockFree(ptr);
+    return out;
+}
+
+bool wsJsonSetBlockPools(bool enabled) {
+    bool previous = _wsJsonBlockPoolsOn;
+    _wsJsonBlockPoolsOn = enabled;
+    return previous;
+}
+
+bool wsJsonGetBlockPools(void) {
+    return _wsJsonBlockPoolsOn;
+}
+
+// Allocates a buffer owned by the same allocator as node
+static void* _wsJsonNodeAlloc(wsJson* node, size_t size) {
+    if (node->flags & WS_JSON_FLAG_ARENA) {
+        wsJsonArena* arena = _wsJsonArenaOf(node);
+        if (!arena) {
+            WS_JSON_LOG_ERROR("Arena of json node was freed\n");
+            return NULL;
+        }
+        return wsJsonArenaAlloc(arena, size);
+    }
+    if (node->flags & WS_JSON_FLAG_POOLED) return _wsJsonBlockAlloc(size);
+    return _wsJsonMalloc(size);
+}
+
+static void* _wsJsonNodeRealloc(wsJson* node, void* ptr, size_t oldSize, size_t newSize) {
+    if (node->flags & WS_JSON_FLAG_ARENA) {
+        wsJsonArena* arena = _wsJsonArenaOf(node);
+        if (!arena) {
+            WS_JSON_LOG_ERROR("Arena of json node was freed\n");
+            return NULL;
+        }
+        return _wsJsonArenaRealloc(arena, ptr, oldSize, newSize);
+    }
+    if (node->flags & WS_JSON_FLAG_POOLED) return _wsJsonBlockRealloc(ptr, newSize);
+    return _wsJsonRealloc(ptr, newSize);
+}
+
+static void _wsJsonNodeFree(wsJson* node, void* ptr) {
+    if (node->flags & WS_JSON_FLAG_ARENA) return;
+    if (node->flags & WS_JSON_FLAG_POOLED) _wsJsonBlockFree(ptr);
+    else _wsJsonFree(ptr);
+}
+
+// Allocators a node can belong to, buffers can only move between nodes with the same ones
+#define _WS_JSON_FLAG_ALLOCATOR (WS_JSON_FLAG_ARENA | WS_JSON_FLAG_POOLED)
+
+static inline bool _wsJsonSameAllocator(const wsJson* a, const wsJson* b) {
+    if ((a->flags & _WS_JSON_FLAG_ALLOCATOR) != (b->flags & _WS_JSON_FLAG_ALLOCATOR)) return false;
+    return !(a->flags & WS_JSON_FLAG_ARENA) || a->arena == b->arena;
+}
+
+static char* _wsJsonNodeStrndup(wsJson* node, const char* val, size_t length) {
+    char* out = _wsJsonNodeAlloc(node, length + 1);
+    if (!out) return NULL;
+    memcpy(out, val, length);
+    out[length] = '\0';
+    return out;
+}
+
+// Allocates a zeroed node from the current arena, the block pools or the heap, 
+// the key is stored right behind the node in the same allocation
+static wsJson* _wsJsonAllocNode(wsJsonType type, const char* key, size_t keyLength) {
+    size_t size = sizeof(wsJson) + (key ? keyLength + 1 : 0);
+    wsJson* obj;
+    if (_wsJsonArena) {
+        obj = wsJsonArenaAlloc(_wsJsonArena, size);
+    }
+    else if (_wsJsonBlockPoolsOn) {
+        obj = _wsJsonBlockAlloc(size);
+    }
+    else {
+        obj = _wsJsonMalloc(size);
+    }
+    if (!obj) return NULL;
+    _WS_JSON_STAT(nodes[type]);
+
+    memset(obj, 0, sizeof(wsJson));
+    obj->type = type;
+    if (_wsJsonArena) {
+        obj->flags |= WS_JSON_FLAG_ARENA;
+        obj->arena = _wsJsonArena->id;
+    }
+    else if (_wsJsonBlockPoolsOn) {
+        obj->flags |= WS_JSON_FLAG_POOLED;
+    }
+    if (key) {
+        char* inlineKey = (char*)(obj + 1);
+        memcpy(inlineKey, key, keyLength);
+        inlineKey[keyLength] = '\0';
+        obj->key = inlineKey;
+        obj->keyLength = (uint32_t)keyLength;
+    }
+    else {
+        obj->key = "";
+    }
+    return obj;
+}
+
+wsJson* wsJsonInitObject(const char* key) {
+    if (!key) {
+        WS_JSON_LOG_API_DUMP("Object key is null");
+    }
+
+    wsJson* obj = _wsJsonAllocNode(WS_JSON_OBJECT, key, key ? strlen(key) : 0);
+    if (!obj) {
+        WS_JSON_LOG_ERROR("Failed to allocate object: %s", key);
+        return NULL;
+    }
+    return obj;
+}
+
+wsJson* wsJsonInitString(const char* key, const char* val) {
+    wsJson* obj = _wsJsonAllocNode(WS_JSON_STRING, key, key ? strlen(key) : 0);
+    if (!obj) {
+        WS_JSON_LOG_ERROR("Failed to allocate memory for json object: %s\n", key);
+        return NULL;
+    }
+    if (val) { 
+        size_t length = strlen(val);
+        obj->stringValue = _wsJsonNodeStrndup(obj, val, length);
+        obj->stringLength = (uint32_t)length;
+    }
+    return obj;
+}
+
+wsJson* wsJsonInitNumber(const char* key, double val) {
+    wsJson* obj = _wsJsonAllocNode(WS_JSON_NUMBER, key, key ? strlen(key) : 0);
+    if (!obj) {
+        WS_JSON_LOG_ERROR("Failed to allocate memory for json object: %s\n", key);
+        return NULL;
+    }
+    obj->numberValue = val;
+    return obj;
+}
+
+wsJson* wsJsonInitInteger(const char* key, int64_t val) {
+    wsJson* obj = _wsJsonAllocNode(WS_JSON_NUMBER, key, key ? strlen(key) : 0);
+    if (!obj) {
+        WS_JSON_LOG_ERROR("Failed to allocate memory for json object: %s\n", key);
+        return NULL;
+    }
+    obj->flags |= WS_JSON_FLAG_INTEGER;
+    obj->integerValue = val;
+    obj->numberValue = (double)val;
+    return obj;
+}
+
+wsJson* wsJsonInitBool(const char* key, bool val) {
+    wsJson* obj = _wsJsonAllocNode(WS_JSON_BOOL, key, key ? strlen(key) : 0);
+    if (!obj) {
+        WS_JSON_LOG_ERROR("Failed to allocate memory for json object: %s\n", key);
+        return NULL;
+    }
+    obj->boolValue = val;
+    return obj;
+}
+
+wsJson* wsJsonInitArray(const char* key) {
+    wsJson* obj = _wsJsonAllocNode(WS_JSON_ARRAY, key, key ? strlen(key) : 0);
+    if (!obj) {
+        WS_JSON_LOG_ERROR("Failed to allocate memory for json array: %s\n", key);
+        return NULL;
+    }
+    return obj;
+}
+
+wsJson* wsJsonInitNull(const char* key) {
+    wsJson* obj = _wsJsonAllocNode(WS_JSON_NULL, key, key ? strlen(key) : 0);
+    if (!obj) {
+        WS_JSON_LOG_ERROR("Failed to allocate memory for json null: %s\n", key);
+        return NULL;
+    }
+    return obj;
+}
+
+// NULL (with an error) for nodes of a shared document, which are read only
+static wsJson* _wsJsonMutable(wsJson* node) {
+    if (node && (node->flags & WS_JSON_FLAG_SHARED)) {
+        WS_JSON_LOG_ERROR("Json node belongs to a shared document and is read only\n");
+        return NULL;
+    }
+    return node;
+}
+
+static void _wsJsonCacheTouch(const wsJson* node);
+
+// Marks a changed container (and its parents) for the cache that tracks it
+static inline void _wsJsonTouch(const wsJson* node) {
+    if (node && (node->flags & WS_JSON_FLAG_TRACKED)) _wsJsonCacheTouch(node);
+}
+
+/* 
+ *  Object index
+ *  Open addressing table stored in the same allocation right behind the 
+ *  children pointers, so it grows and gets freed together with them. The 
+ *  children array keeps the insertion order for serialization.
+ */
+typedef struct _wsJsonIndexSlot {
+    uint32_t hash;
+    uint32_t index; // child index + 1, 0 is an empty slot
+} _wsJsonIndexSlot;
+
+// FNV-1a
+static inline uint32_t _wsJsonHashKey(const char* key, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)key[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static size_t _wsJsonIndexSlotCount(int32_t capacity) {
+    size_t count = 8;
+    while (count < (size_t)capacity * 2) count <<= 1;
+    return count;
+}
+
+static size_t _wsJsonChildrenSize(int32_t capacity, bool indexed) {
+    size_t size = sizeof(wsJson*) * capacity;
+    if (indexed) size += sizeof(_wsJsonIndexSlot) * _wsJsonIndexSlotCount(capacity);
+    return size;
+}
+
+static inline _wsJsonIndexSlot* _wsJsonIndexSlots(wsJson* obj) {
+    return (_wsJsonIndexSlot*)(obj->object.children + obj->object.childCapacity);
+}
+
+static void _wsJsonIndexInsert(wsJson* obj, int32_t index) {
+    wsJson* child = obj->object.children[index];
+    _wsJsonIndexSlot* slots = _wsJsonIndexSlots(obj);
+    size_t mask = _wsJsonIndexSlotCount(obj->object.childCapacity) - 1;
+    uint32_t hash = _wsJsonHashKey(child->key, child->keyLength);
+
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        if (slots[i].index == 0) {
+            slots[i].hash = hash;
+            slots[i].index = (uint32_t)index + 1;
+            return;
+        }
+        // Lookups return the first child with a key, like the linear scan
+        wsJson* other = obj->object.children[slots[i].index - 1];
+        if (slots[i].hash == hash && other->keyLength == child->keyLength &&
+            memcmp(other->key, child->key, child->keyLength) == 0) {
+            return;
+        }
+    }
+}
+
+static void _wsJsonIndexRebuild(wsJson* obj) {
+    memset(_wsJsonIndexSlots(obj), 0, sizeof(_wsJsonIndexSlot) * _wsJsonIndexSlotCount(obj->object.childCapacity));
+    for (int32_t i = 0; i < obj->object.childCount; i++) {
+        _wsJsonIndexInsert(obj, i);
+    }
+}
+
+static wsJson* _wsJsonIndexFind(wsJson* obj, const char* key, size_t keyLen, uint32_t hash) {
+    _wsJsonIndexSlot* slots = _wsJsonIndexSlots(obj);
+    size_t mask = _wsJsonIndexSlotCount(obj->object.childCapacity) - 1;
+
+    for (size_t i = hash & mask; slots[i].index; i = (i + 1) & mask) {
+        if (slots[i].hash != hash) continue;
+        wsJson* child = obj->object.children[slots[i].index - 1];
+        if (child->keyLength == keyLen && memcmp(child->key, key, keyLen) == 0) return child;
+    }
+    return NULL;
+}
+
+int32_t wsJsonIndexObject(wsJson* obj) {
+    if (!obj || obj->type != WS_JSON_OBJECT) {
+        WS_JSON_LOG_ERROR("Obj is not from type WS_JSON_OBJECT\n");
+        return WS_ERROR;
+    }
+    if (obj->flags & WS_JSON_FLAG_INDEXED) return WS_OK;
+    if (!_wsJsonMutable(obj)) return WS_ERROR;
+
+    int32_t capacity = obj->object.childCapacity ? obj->object.childCapacity : 4;
+    wsJson** children = _wsJsonNodeRealloc(obj, obj->object.children, 
+                                           _wsJsonChildrenSize(obj->object.childCapacity, false), 
+                                           _wsJsonChildrenSize(capacity, true));
+    if (!children) {
+        WS_JSON_LOG_ERROR("Failed to allocate json object index\n");
+        return WS_ERROR;
+    }
+    obj->object.children = children;
+    obj->object.childCapacity = capacity;
+    obj->flags |= WS_JSON_FLAG_INDEXED;
+    _wsJsonIndexRebuild(obj);
+    return WS_OK;
+}
+
+void wsJsonAddField(wsJson *parent, wsJson *child) {
+    if (!parent || parent->type != WS_JSON_OBJECT || !child) return;
+    if (!_wsJsonMutable(parent) || !_wsJsonMutable(child)) return;
+    _wsJsonTouch(parent);
+
+    bool indexed = parent->flags & WS_JSON_FLAG_INDEXED;
+    bool rebuild = false;
+    if (parent->object.childCount >= parent->object.childCapacity) {
+        int32_t newCap = parent->object.childCapacity == 0 ? 4 : parent->object.childCapacity * 2;
+        wsJson** children = _wsJsonNodeRealloc(parent, parent->object.children, 
+                                               _wsJsonChildrenSize(parent->object.childCapacity, indexed), 
+                                               _wsJsonChildrenSize(newCap, indexed));
+        if (!children) {
+            WS_JSON_LOG_ERROR("Failed to grow json object children\n");
+            return;
+        }
+        parent->object.children = children;
+        parent->object.childCapacity = newCap;
+        _WS_JSON_STAT(childGrowths);
+        rebuild = indexed;
+    }
+    parent->object.children[parent->object.childCount++] = child;
+    if (rebuild) _wsJsonIndexRebuild(parent);
+    else if (indexed) _wsJsonIndexInsert(parent, parent->object.childCount - 1);
+    // Large objects switch to the hash index here, so lookups never write and 
+    // can run on one tree from several threads. On failure they keep scanning.
+    else if (WS_JSON_INDEX_THRESHOLD > 0 && parent->object.childCount >= WS_JSON_INDEX_THRESHOLD) wsJsonIndexObject(parent);
+}
+
+void wsJsonAddElement(wsJson *array, wsJson *element) {
+    if (!array || array->type != WS_JSON_ARRAY || !element) return;
+    if (!_wsJsonMutable(array) || !_wsJsonMutable(element)) return;
+    _wsJsonTouch(array);
+
     if (array->array.elementCount >= array->array.elementCapacity) {
         int32_t newCap = array->array.elementCapacity == 0 ? 4 : array->array.elementCapacity * 2;
-        array->array.elements = WS_JSON_REALLOC(array->array.elements, sizeof(wsJson) * newCap);
+        wsJson** elements = _wsJsonNodeRealloc(array, array->array.elements, 
+                                               sizeof(wsJson*) * array->array.elementCapacity, sizeof(wsJson*) * newCap);
+        if (!elements) {
+            WS_JSON_LOG_ERROR("Failed to grow json array elements\n");
+            return;
+        }
+        array->array.elements = elements;
         array->array.elementCapacity = newCap;
+        _WS_JSON_STAT(childGrowths);
+    }
+    array->array.elements[array->array.elementCount++] = element;
+}
+
+/* 
+ *  Numbers
+ *  Parsing tries an exact int64 first, then the Clinger fast path (both 
+ *  operands are exact doubles) and then Eisel-Lemire with 128 bit powers 
+ *  of five. The few inputs none of them can decide go to strtod. Formatting 
+ *  uses Grisu2, which finds the shortest (or close to) digits that read 
+ *  back to the same double.
+ */
+
+static const double _wsJsonExactPowersOfTen[23] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// 5^q normalized to 128 bits (rounded up for q < 0) for q in -342..308
+static const uint64_t _wsJsonPowersOfFive[651][2] = {
+    {0xeef453d6923bd65aULL, 0x113faa2906a13b3fULL}, {0x9558b4661b6565f8ULL, 0x4ac7ca59a424c507ULL},
+    {0xbaaee17fa23ebf76ULL, 0x5d79bcf00d2df649ULL}, {0xe95a99df8ace6f53ULL, 0xf4d82c2c107973dcULL},
+    {0x91d8a02bb6c10594ULL, 0x79071b9b8a4be869ULL}, {0xb64ec836a47146f9ULL, 0x9748e2826cdee284ULL},
+    {0xe3e27a444d8d98b7ULL, 0xfd1b1b2308169b25ULL}, {0x8e6d8c6ab0787f72ULL, 0xfe30f0f5e50e20f7ULL},
+    {0xb208ef855c969f4fULL, 0xbdbd2d335e51a935ULL}, {0xde8b2b66b3bc4723ULL, 0xad2c788035e61382ULL},
+    {0x8b16fb203055ac76ULL, 0x4c3bcb5021afcc31ULL}, {0xaddcb9e83c6b1793ULL, 0xdf4abe242a1bbf3dULL},
+    {0xd953e8624b85dd78ULL, 0xd71d6dad34a2af0dULL}, {0x87d4713d6f33aa6bULL, 0x8672648c40e5ad68ULL},
+    {0xa9c98d8ccb009506ULL, 0x680efdaf511f18c2ULL}, {0xd43bf0effdc0ba48ULL, 0x0212bd1b2566def2ULL},
+    {0x84a57695fe98746dULL, 0x014bb630f7604b57ULL}, {0xa5ced43b7e3e9188ULL, 0x419ea3bd35385e2dULL},
+    {0xcf42894a5dce35eaULL, 0x52064cac828675b9ULL}, {0x818995ce7aa0e1b2ULL, 0x7343efebd1940993ULL},
+    {0xa1ebfb4219491a1fULL, 0x1014ebe6c5f90bf8ULL}, {0xca66fa129f9b60a6ULL, 0xd41a26e077774ef6ULL},
+    {0xfd00b897478238d0ULL, 0x8920b098955522b4ULL}, {0x9e20735e8cb16382ULL, 0x55b46e5f5d5535b0ULL},
+    {0xc5a890362fddbc62ULL, 0xeb2189f734aa831dULL}, {0xf712b443bbd52b7bULL, 0xa5e9ec7501d523e4ULL},
+    {0x9a6bb0aa55653b2dULL, 0x47b233c92125366eULL}, {0xc1069cd4eabe89f8ULL, 0x999ec0bb696e840aULL},
+    {0xf148440a256e2c76ULL, 0xc00670ea43ca250dULL}, {0x96cd2a865764dbcaULL, 0x380406926a5e5728ULL},
+    {0xbc807527ed3e12bcULL, 0xc605083704f5ecf2ULL}, {0xeba09271e88d976bULL, 0xf7864a44c633682eULL},
+    {0x93445b8731587ea3ULL, 0x7ab3ee6afbe0211dULL}, {0xb8157268fdae9e4cULL, 0x5960ea05bad82964ULL},
+    {0xe61acf033d1a45dfULL, 0x6fb92487298e33bdULL}, {0x8fd0c16206306babULL, 0xa5d3b6d479f8e056ULL},
+    {0xb3c4f1ba87bc8696ULL, 0x8f48a4899877186cULL}, {0xe0b62e2929aba83cULL, 0x331acdabfe94de87ULL},
+    {0x8c71dcd9ba0b4925ULL, 0x9ff0c08b7f1d0b14ULL}, {0xaf8e5410288e1b6fULL, 0x07ecf0ae5ee44dd9ULL},
+    {0xdb71e91432b1a24aULL, 0xc9e82cd9f69d6150ULL}, {0x892731ac9faf056eULL, 0xbe311c083a225cd2ULL},
+    {0xab70fe17c79ac6caULL, 0x6dbd630a48aaf406ULL}, {0xd64d3d9db981787dULL, 0x092cbbccdad5b108ULL},
+    {0x85f0468293f0eb4eULL, 0x25bbf56008c58ea5ULL}, {0xa76c582338ed2621ULL, 0xaf2af2b80af6f24eULL},
+    {0xd1476e2c07286faaULL, 0x1af5af660db4aee1ULL}, {0x82cca4db847945caULL, 0x50d98d9fc890ed4dULL},
+    {0xa37fce126597973cULL, 0xe50ff107bab528a0ULL}, {0xcc5fc196fefd7d0cULL, 0x1e53ed49a96272c8ULL},
+    {0xff77b1fcbebcdc4fULL, 0x25e8e89c13bb0f7aULL}, {0x9faacf3df73609b1ULL, 0x77b191618c54e9acULL},
+    {0xc795830d75038c1dULL, 0xd59df5b9ef6a2417ULL}, {0xf97ae3d0d2446f25ULL, 0x4b0573286b44ad1dULL},
+    {0x9becce62836ac577ULL, 0x4ee367f9430aec32ULL}, {0xc2e801fb244576d5ULL, 0x229c41f793cda73fULL},
+    {0xf3a20279ed56d48aULL, 0x6b43527578c1110fULL}, {0x9845418c345644d6ULL, 0x830a13896b78aaa9ULL},
+    {0xbe5691ef416bd60cULL, 0x23cc986bc656d553ULL}, {0xedec366b11c6cb8fULL, 0x2cbfbe86b7ec8aa8ULL},
+    {0x94b3a202eb1c3f39ULL, 0x7bf7d71432f3d6a9ULL}, {0xb9e08a83a5e34f07ULL, 0xdaf5ccd93fb0cc53ULL},
+    {0xe858ad248f5c22c9ULL, 0xd1b3400f8f9cff68ULL}, {0x91376c36d99995beULL, 0x23100809b9c21fa1ULL},
+    {0xb58547448ffffb2dULL, 0xabd40a0c2832a78aULL}, {0xe2e69915b3fff9f9ULL, 0x16c90c8f323f516cULL},
+    {0x8dd01fad907ffc3bULL, 0xae3da7d97f6792e3ULL}, {0xb1442798f49ffb4aULL, 0x99cd11cfdf41779cULL},
+    {0xdd95317f31c7fa1dULL, 0x40405643d711d583ULL}, {0x8a7d3eef7f1cfc52ULL, 0x482835ea666b2572ULL},
+    {0xad1c8eab5ee43b66ULL, 0xda3243650005eecfULL}, {0xd863b256369d4a40ULL, 0x90bed43e40076a82ULL},
+    {0x873e4f75e2224e68ULL, 0x5a7744a6e804a291ULL}, {0xa90de3535aaae202ULL, 0x711515d0a205cb36ULL},
+    {0xd3515c2831559a83ULL, 0x0d5a5b44ca873e03ULL}, {0x8412d9991ed58091ULL, 0xe858790afe9486c2ULL},
+    {0xa5178fff668ae0b6ULL, 0x626e974dbe39a872ULL}, {0xce5d73ff402d98e3ULL, 0xfb0a3d212dc8128fULL},
+    {0x80fa687f881c7f8eULL, 0x7ce66634bc9d0b99ULL}, {0xa139029f6a239f72ULL, 0x1c1fffc1ebc44e80ULL},
+    {0xc987434744ac874eULL, 0xa327ffb266b56220ULL}, {0xfbe9141915d7a922ULL, 0x4bf1ff9f0062baa8ULL},
+    {0x9d71ac8fada6c9b5ULL, 0x6f773fc3603db4a9ULL}, {0xc4ce17b399107c22ULL, 0xcb550fb4384d21d3ULL},
+    {0xf6019da07f549b2bULL, 0x7e2a53a146606a48ULL}, {0x99c102844f94e0fbULL, 0x2eda7444cbfc426dULL},
+    {0xc0314325637a1939ULL, 0xfa911155fefb5308ULL}, {0xf03d93eebc589f88ULL, 0x793555ab7eba27caULL},
+    {0x96267c7535b763b5ULL, 0x4bc1558b2f3458deULL}, {0xbbb01b9283253ca2ULL, 0x9eb1aaedfb016f16ULL},
+    {0xea9c227723ee8bcbULL, 0x465e15a979c1cadcULL}, {0x92a1958a7675175fULL, 0x0bfacd89ec191ec9ULL},
+    {0xb749faed14125d36ULL, 0xcef980ec671f667bULL}, {0xe51c79a85916f484ULL, 0x82b7e12780e7401aULL},
+    {0x8f31cc0937ae58d2ULL, 0xd1b2ecb8b0908810ULL}, {0xb2fe3f0b8599ef07ULL, 0x861fa7e6dcb4aa15ULL},
+    {0xdfbdcece67006ac9ULL, 0x67a791e093e1d49aULL}, {0x8bd6a141006042bdULL, 0xe0c8bb2c5c6d24e0ULL},
+    {0xaecc49914078536dULL, 0x58fae9f773886e18ULL}, {0xda7f5bf590966848ULL, 0xaf39a475506a899eULL},
+    {0x888f99797a5e012dULL, 0x6d8406c952429603ULL}, {0xaab37fd7d8f58178ULL, 0xc8e5087ba6d33b83ULL},
+    {0xd5605fcdcf32e1d6ULL, 0xfb1e4a9a90880a64ULL}, {0x855c3be0a17fcd26ULL, 0x5cf2eea09a55067fULL},
+    {0xa6b34ad8c9dfc06fULL, 0xf42faa48c0ea481eULL}, {0xd0601d8efc57b08bULL, 0xf13b94daf124da26ULL},
+    {0x823c12795db6ce57ULL, 0x76c53d08d6b70858ULL}, {0xa2cb1717b52481edULL, 0x54768c4b0c64ca6eULL},
+    {0xcb7ddcdda26da268ULL, 0xa9942f5dcf7dfd09ULL}, {0xfe5d54150b090b02ULL, 0xd3f93b35435d7c4cULL},
+    {0x9efa548d26e5a6e1ULL, 0xc47bc5014a1a6dafULL}, {0xc6b8e9b0709f109aULL, 0x359ab6419ca1091bULL},
+    {0xf867241c8cc6d4c0ULL, 0xc30163d203c94b62ULL}, {0x9b407691d7fc44f8ULL, 0x79e0de63425dcf1dULL},
+    {0xc21094364dfb5636ULL, 0x985915fc12f542e4ULL}, {0xf294b943e17a2bc4ULL, 0x3e6f5b7b17b2939dULL},
+    {0x979cf3ca6cec5b5aULL, 0xa705992ceecf9c42ULL}, {0xbd8430bd08277231ULL, 0x50c6ff782a838353ULL},
+    {0xece53cec4a314ebdULL, 0xa4f8bf5635246428ULL}, {0x940f4613ae5ed136ULL, 0x871b7795e136be99ULL},
+    {0xb913179899f68584ULL, 0x28e2557b59846e3fULL}, {0xe757dd7ec07426e5ULL, 0x331aeada2fe589cfULL},
+    {0x9096ea6f3848984fULL, 0x3ff0d2c85def7621ULL}, {0xb4bca50b065abe63ULL, 0x0fed077a756b53a9ULL},
+    {0xe1ebce4dc7f16dfbULL, 0xd3e8495912c62894ULL}, {0x8d3360f09cf6e4bdULL, 0x64712dd7abbbd95cULL},
+    {0xb080392cc4349decULL, 0xbd8d794d96aacfb3ULL}, {0xdca04777f541c567ULL, 0xecf0d7a0fc5583a0ULL},
+    {0x89e42caaf9491b60ULL, 0xf41686c49db57244ULL}, {0xac5d37d5b79b6239ULL, 0x311c2875c522ced5ULL},
+    {0xd77485cb25823ac7ULL, 0x7d633293366b828bULL}, {0x86a8d39ef77164bcULL, 0xae5dff9c02033197ULL},
+    {0xa8530886b54dbdebULL, 0xd9f57f830283fdfcULL}, {0xd267caa862a12d66ULL, 0xd072df63c324fd7bULL},
+    {0x8380dea93da4bc60ULL, 0x4247cb9e59f71e6dULL}, {0xa46116538d0deb78ULL, 0x52d9be85f074e608ULL},
+    {0xcd795be870516656ULL, 0x67902e276c921f8bULL}, {0x806bd9714632dff6ULL, 0x00ba1cd8a3db53b6ULL},
+    {0xa086cfcd97bf97f3ULL, 0x80e8a40eccd228a4ULL}, {0xc8a883c0fdaf7df0ULL, 0x6122cd128006b2cdULL},
+    {0xfad2a4b13d1b5d6cULL, 0x796b805720085f81ULL}, {0x9cc3a6eec6311a63ULL, 0xcbe3303674053bb0ULL},
+    {0xc3f490aa77bd60fcULL, 0xbedbfc4411068a9cULL}, {0xf4f1b4d515acb93bULL, 0xee92fb5515482d44ULL},
+    {0x991711052d8bf3c5ULL, 0x751bdd152d4d1c4aULL}, {0xbf5cd54678eef0b6ULL, 0xd262d45a78a0635dULL},
+    {0xef340a98172aace4ULL, 0x86fb897116c87c34ULL}, {0x9580869f0e7aac0eULL, 0xd45d35e6ae3d4da0ULL},
+    {0xbae0a846d2195712ULL, 0x8974836059cca109ULL}, {0xe998d258869facd7ULL, 0x2bd1a438703fc94bULL},
+    {0x91ff83775423cc06ULL, 0x7b6306a34627ddcfULL}, {0xb67f6455292cbf08ULL, 0x1a3bc84c17b1d542ULL},
+    {0xe41f3d6a7377eecaULL, 0x20caba5f1d9e4a93ULL}, {0x8e938662882af53eULL, 0x547eb47b7282ee9cULL},
+    {0xb23867fb2a35b28dULL, 0xe99e619a4f23aa43ULL}, {0xdec681f9f4c31f31ULL, 0x6405fa00e2ec94d4ULL},
+    {0x8b3c113c38f9f37eULL, 0xde83bc408dd3dd04ULL}, {0xae0b158b4738705eULL, 0x9624ab50b148d445ULL},
+    {0xd98ddaee19068c76ULL, 0x3badd624dd9b0957ULL}, {0x87f8a8d4cfa417c9ULL, 0xe54ca5d70a80e5d6ULL},
+    {0xa9f6d30a038d1dbcULL, 0x5e9fcf4ccd211f4cULL}, {0xd47487cc8470652bULL, 0x7647c3200069671fULL},
+    {0x84c8d4dfd2c63f3bULL, 0x29ecd9f40041e073ULL}, {0xa5fb0a17c777cf09ULL, 0xf468107100525890ULL},
+    {0xcf79cc9db955c2ccULL, 0x7182148d4066eeb4ULL}, {0x81ac1fe293d599bfULL, 0xc6f14cd848405530ULL},
+    {0xa21727db38cb002fULL, 0xb8ada00e5a506a7cULL}, {0xca9cf1d206fdc03bULL, 0xa6d90811f0e4851cULL},
+    {0xfd442e4688bd304aULL, 0x908f4a166d1da663ULL}, {0x9e4a9cec15763e2eULL, 0x9a598e4e043287feULL},
+    {0xc5dd44271ad3cdbaULL, 0x40eff1e1853f29fdULL}, {0xf7549530e188c128ULL, 0xd12bee59e68ef47cULL},
+    {0x9a94dd3e8cf578b9ULL, 0x82bb74f8301958ceULL}, {0xc13a148e3032d6e7ULL, 0xe36a52363c1faf01ULL},
+    {0xf18899b1bc3f8ca1ULL, 0xdc44e6c3cb279ac1ULL}, {0x96f5600f15a7b7e5ULL, 0x29ab103a5ef8c0b9ULL},
+    {0xbcb2b812db11a5deULL, 0x7415d448f6b6f0e7ULL}, {0xebdf661791d60f56ULL, 0x111b495b3464ad21ULL},
+    {0x936b9fcebb25c995ULL, 0xcab10dd900beec34ULL}, {0xb84687c269ef3bfbULL, 0x3d5d514f40eea742ULL},
+    {0xe65829b3046b0afaULL, 0x0cb4a5a3112a5112ULL}, {0x8ff71a0fe2c2e6dcULL, 0x47f0e785eaba72abULL},
+    {0xb3f4e093db73a093ULL, 0x59ed216765690f56ULL}, {0xe0f218b8d25088b8ULL, 0x306869c13ec3532cULL},
+    {0x8c974f7383725573ULL, 0x1e414218c73a13fbULL}, {0xafbd2350644eeacfULL, 0xe5d1929ef90898faULL},
+    {0xdbac6c247d62a583ULL, 0xdf45f746b74abf39ULL}, {0x894bc396ce5da772ULL, 0x6b8bba8c328eb783ULL},
+    {0xab9eb47c81f5114fULL, 0x066ea92f3f326564ULL}, {0xd686619ba27255a2ULL, 0xc80a537b0efefebdULL},
+    {0x8613fd0145877585ULL, 0xbd06742ce95f5f36ULL}, {0xa798fc4196e952e7ULL, 0x2c48113823b73704ULL},
+    {0xd17f3b51fca3a7a0ULL, 0xf75a15862ca504c5ULL}, {0x82ef85133de648c4ULL, 0x9a984d73dbe722fbULL},
+    {0xa3ab66580d5fdaf5ULL, 0xc13e60d0d2e0ebbaULL}, {0xcc963fee10b7d1b3ULL, 0x318df905079926a8ULL},
+    {0xffbbcfe994e5c61fULL, 0xfdf17746497f7052ULL}, {0x9fd561f1fd0f9bd3ULL, 0xfeb6ea8bedefa633ULL},
+    {0xc7caba6e7c5382c8ULL, 0xfe64a52ee96b8fc0ULL}, {0xf9bd690a1b68637bULL, 0x3dfdce7aa3c673b0ULL},
+    {0x9c1661a651213e2dULL, 0x06bea10ca65c084eULL}, {0xc31bfa0fe5698db8ULL, 0x486e494fcff30a62ULL},
+    {0xf3e2f893dec3f126ULL, 0x5a89dba3c3efccfaULL}, {0x986ddb5c6b3a76b7ULL, 0xf89629465a75e01cULL},
+    {0xbe89523386091465ULL, 0xf6bbb397f1135823ULL}, {0xee2ba6c0678b597fULL, 0x746aa07ded582e2cULL},
+    {0x94db483840b717efULL, 0xa8c2a44eb4571cdcULL}, {0xba121a4650e4ddebULL, 0x92f34d62616ce413ULL},
+    {0xe896a0d7e51e1566ULL, 0x77b020baf9c81d17ULL}, {0x915e2486ef32cd60ULL, 0x0ace1474dc1d122eULL},
+    {0xb5b5ada8aaff80b8ULL, 0x0d819992132456baULL}, {0xe3231912d5bf60e6ULL, 0x10e1fff697ed6c69ULL},
+    {0x8df5efabc5979c8fULL, 0xca8d3ffa1ef463c1ULL}, {0xb1736b96b6fd83b3ULL, 0xbd308ff8a6b17cb2ULL},
+    {0xddd0467c64bce4a0ULL, 0xac7cb3f6d05ddbdeULL}, {0x8aa22c0dbef60ee4ULL, 0x6bcdf07a423aa96bULL},
+    {0xad4ab7112eb3929dULL, 0x86c16c98d2c953c6ULL}, {0xd89d64d57a607744ULL, 0xe871c7bf077ba8b7ULL},
+    {0x87625f056c7c4a8bULL, 0x11471cd764ad4972ULL}, {0xa93af6c6c79b5d2dULL, 0xd598e40d3dd89bcfULL},
+    {0xd389b47879823479ULL, 0x4aff1d108d4ec2c3ULL}, {0x843610cb4bf160cbULL, 0xcedf722a585139baULL},
+    {0xa54394fe1eedb8feULL, 0xc2974eb4ee658828ULL}, {0xce947a3da6a9273eULL, 0x733d226229feea32ULL},
+    {0x811ccc668829b887ULL, 0x0806357d5a3f525fULL}, {0xa163ff802a3426a8ULL, 0xca07c2dcb0cf26f7ULL},
+    {0xc9bcff6034c13052ULL, 0xfc89b393dd02f0b5ULL}, {0xfc2c3f3841f17c67ULL, 0xbbac2078d443ace2ULL},
+    {0x9d9ba7832936edc0ULL, 0xd54b944b84aa4c0dULL}, {0xc5029163f384a931ULL, 0x0a9e795e65d4df11ULL},
+    {0xf64335bcf065d37dULL, 0x4d4617b5ff4a16d5ULL}, {0x99ea0196163fa42eULL, 0x504bced1bf8e4e45ULL},
+    {0xc06481fb9bcf8d39ULL, 0xe45ec2862f71e1d6ULL}, {0xf07da27a82c37088ULL, 0x5d767327bb4e5a4cULL},
+    {0x964e858c91ba2655ULL, 0x3a6a07f8d510f86fULL}, {0xbbe226efb628afeaULL, 0x890489f70a55368bULL},
+    {0xeadab0aba3b2dbe5ULL, 0x2b45ac74ccea842eULL}, {0x92c8ae6b464fc96fULL, 0x3b0b8bc90012929dULL},
+    {0xb77ada0617e3bbcbULL, 0x09ce6ebb40173744ULL}, {0xe55990879ddcaabdULL, 0xcc420a6a101d0515ULL},
+    {0x8f57fa54c2a9eab6ULL, 0x9fa946824a12232dULL}, {0xb32df8e9f3546564ULL, 0x47939822dc96abf9ULL},
+    {0xdff9772470297ebdULL, 0x59787e2b93bc56f7ULL}, {0x8bfbea76c619ef36ULL, 0x57eb4edb3c55b65aULL},
+    {0xaefae51477a06b03ULL, 0xede622920b6b23f1ULL}, {0xdab99e59958885c4ULL, 0xe95fab368e45ecedULL},
+    {0x88b402f7fd75539bULL, 0x11dbcb0218ebb414ULL}, {0xaae103b5fcd2a881ULL, 0xd652bdc29f26a119ULL},
+    {0xd59944a37c0752a2ULL, 0x4be76d3346f0495fULL}, {0x857fcae62d8493a5ULL, 0x6f70a4400c562ddbULL},
+    {0xa6dfbd9fb8e5b88eULL, 0xcb4ccd500f6bb952ULL}, {0xd097ad07a71f26b2ULL, 0x7e2000a41346a7a7ULL},
+    {0x825ecc24c873782fULL, 0x8ed400668c0c28c8ULL}, {0xa2f67f2dfa90563bULL, 0x728900802f0f32faULL},
+    {0xcbb41ef979346bcaULL, 0x4f2b40a03ad2ffb9ULL}, {0xfea126b7d78186bcULL, 0xe2f610c84987bfa8ULL},
+    {0x9f24b832e6b0f436ULL, 0x0dd9ca7d2df4d7c9ULL}, {0xc6ede63fa05d3143ULL, 0x91503d1c79720dbbULL},
+    {0xf8a95fcf88747d94ULL, 0x75a44c6397ce912aULL}, {0x9b69dbe1b548ce7cULL, 0xc986afbe3ee11abaULL},
+    {0xc24452da229b021bULL, 0xfbe85badce996168ULL}, {0xf2d56790ab41c2a2ULL, 0xfae27299423fb9c3ULL},
+    {0x97c560ba6b0919a5ULL, 0xdccd879fc967d41aULL}, {0xbdb6b8e905cb600fULL, 0x5400e987bbc1c920ULL},
+    {0xed246723473e3813ULL, 0x290123e9aab23b68ULL}, {0x9436c0760c86e30bULL, 0xf9a0b6720aaf6521ULL},
+    {0xb94470938fa89bceULL, 0xf808e40e8d5b3e69ULL}, {0xe7958cb87392c2c2ULL, 0xb60b1d1230b20e04ULL},
+    {0x90bd77f3483bb9b9ULL, 0xb1c6f22b5e6f48c2ULL}, {0xb4ecd5f01a4aa828ULL, 0x1e38aeb6360b1af3ULL},
+    {0xe2280b6c20dd5232ULL, 0x25c6da63c38de1b0ULL}, {0x8d590723948a535fULL, 0x579c487e5a38ad0eULL},
+    {0xb0af48ec79ace837ULL, 0x2d835a9df0c6d851ULL}, {0xdcdb1b2798182244ULL, 0xf8e431456cf88e65ULL},
+    {0x8a08f0f8bf0f156bULL, 0x1b8e9ecb641b58ffULL}, {0xac8b2d36eed2dac5ULL, 0xe272467e3d222f3fULL},
+    {0xd7adf884aa879177ULL, 0x5b0ed81dcc6abb0fULL}, {0x86ccbb52ea94baeaULL, 0x98e947129fc2b4e9ULL},
+    {0xa87fea27a539e9a5ULL, 0x3f2398d747b36224ULL}, {0xd29fe4b18e88640eULL, 0x8eec7f0d19a03aadULL},
+    {0x83a3eeeef9153e89ULL, 0x1953cf68300424acULL}, {0xa48ceaaab75a8e2bULL, 0x5fa8c3423c052dd7ULL},
+    {0xcdb02555653131b6ULL, 0x3792f412cb06794dULL}, {0x808e17555f3ebf11ULL, 0xe2bbd88bbee40bd0ULL},
+    {0xa0b19d2ab70e6ed6ULL, 0x5b6aceaeae9d0ec4ULL}, {0xc8de047564d20a8bULL, 0xf245825a5a445275ULL},
+    {0xfb158592be068d2eULL, 0xeed6e2f0f0d56712ULL}, {0x9ced737bb6c4183dULL, 0x55464dd69685606bULL},
+    {0xc428d05aa4751e4cULL, 0xaa97e14c3c26b886ULL}, {0xf53304714d9265dfULL, 0xd53dd99f4b3066a8ULL},
+    {0x993fe2c6d07b7fabULL, 0xe546a8038efe4029ULL}, {0xbf8fdb78849a5f96ULL, 0xde98520472bdd033ULL},
+    {0xef73d256a5c0f77cULL, 0x963e66858f6d4440ULL}, {0x95a8637627989aadULL, 0xdde7001379a44aa8ULL},
+    {0xbb127c53b17ec159ULL, 0x5560c018580d5d52ULL}, {0xe9d71b689dde71afULL, 0xaab8f01e6e10b4a6ULL},
+    {0x9226712162ab070dULL, 0xcab3961304ca70e8ULL}, {0xb6b00d69bb55c8d1ULL, 0x3d607b97c5fd0d22ULL},
+    {0xe45c10c42a2b3b05ULL, 0x8cb89a7db77c506aULL}, {0x8eb98a7a9a5b04e3ULL, 0x77f3608e92adb242ULL},
+    {0xb267ed1940f1c61cULL, 0x55f038b237591ed3ULL}, {0xdf01e85f912e37a3ULL, 0x6b6c46dec52f6688ULL},
+    {0x8b61313bbabce2c6ULL, 0x2323ac4b3b3da015ULL}, {0xae397d8aa96c1b77ULL, 0xabec975e0a0d081aULL},
+    {0xd9c7dced53c72255ULL, 0x96e7bd358c904a21ULL}, {0x881cea14545c7575ULL, 0x7e50d64177da2e54ULL},
+    {0xaa242499697392d2ULL, 0xdde50bd1d5d0b9e9ULL}, {0xd4ad2dbfc3d07787ULL, 0x955e4ec64b44e864ULL},
+    {0x84ec3c97da624ab4ULL, 0xbd5af13bef0b113eULL}, {0xa6274bbdd0fadd61ULL, 0xecb1ad8aeacdd58eULL},
+    {0xcfb11ead453994baULL, 0x67de18eda5814af2ULL}, {0x81ceb32c4b43fcf4ULL, 0x80eacf948770ced7ULL},
+    {0xa2425ff75e14fc31ULL, 0xa1258379a94d028dULL}, {0xcad2f7f5359a3b3eULL, 0x096ee45813a04330ULL},
+    {0xfd87b5f28300ca0dULL, 0x8bca9d6e188853fcULL}, {0x9e74d1b791e07e48ULL, 0x775ea264cf55347eULL},
+    {0xc612062576589ddaULL, 0x95364afe032a819eULL}, {0xf79687aed3eec551ULL, 0x3a83ddbd83f52205ULL},
+    {0x9abe14cd44753b52ULL, 0xc4926a9672793543ULL}, {0xc16d9a0095928a27ULL, 0x75b7053c0f178294ULL},
+    {0xf1c90080baf72cb1ULL, 0x5324c68b12dd6339ULL}, {0x971da05074da7beeULL, 0xd3f6fc16ebca5e04ULL},
+    {0xbce5086492111aeaULL, 0x88f4bb1ca6bcf585ULL}, {0xec1e4a7db69561a5ULL, 0x2b31e9e3d06c32e6ULL},
+    {0x9392ee8e921d5d07ULL, 0x3aff322e62439fd0ULL}, {0xb877aa3236a4b449ULL, 0x09befeb9fad487c3ULL},
+    {0xe69594bec44de15bULL, 0x4c2ebe687989a9b4ULL}, {0x901d7cf73ab0acd9ULL, 0x0f9d37014bf60a11ULL},
+    {0xb424dc35095cd80fULL, 0x538484c19ef38c95ULL}, {0xe12e13424bb40e13ULL, 0x2865a5f206b06fbaULL},
+    {0x8cbccc096f5088cbULL, 0xf93f87b7442e45d4ULL}, {0xafebff0bcb24aafeULL, 0xf78f69a51539d749ULL},
+    {0xdbe6fecebdedd5beULL, 0xb573440e5a884d1cULL}, {0x89705f4136b4a597ULL, 0x31680a88f8953031ULL},
+    {0xabcc77118461cefcULL, 0xfdc20d2b36ba7c3eULL}, {0xd6bf94d5e57a42bcULL, 0x3d32907604691b4dULL},
+    {0x8637bd05af6c69b5ULL, 0xa63f9a49c2c1b110ULL}, {0xa7c5ac471b478423ULL, 0x0fcf80dc33721d54ULL},
+    {0xd1b71758e219652bULL, 0xd3c36113404ea4a9ULL}, {0x83126e978d4fdf3bULL, 0x645a1cac083126eaULL},
+    {0xa3d70a3d70a3d70aULL, 0x3d70a3d70a3d70a4ULL}, {0xccccccccccccccccULL, 0xcccccccccccccccdULL},
+    {0x8000000000000000ULL, 0x0000000000000000ULL}, {0xa000000000000000ULL, 0x0000000000000000ULL},
+    {0xc800000000000000ULL, 0x0000000000000000ULL}, {0xfa00000000000000ULL, 0x0000000000000000ULL},
+    {0x9c40000000000000ULL, 0x0000000000000000ULL}, {0xc350000000000000ULL, 0x0000000000000000ULL},
+    {0xf424000000000000ULL, 0x0000000000000000ULL}, {0x9896800000000000ULL, 0x0000000000000000ULL},
+    {0xbebc200000000000ULL, 0x0000000000000000ULL}, {0xee6b280000000000ULL, 0x0000000000000000ULL},
+    {0x9502f90000000000ULL, 0x0000000000000000ULL}, {0xba43b74000000000ULL, 0x0000000000000000ULL},
+    {0xe8d4a51000000000ULL, 0x0000000000000000ULL}, {0x9184e72a00000000ULL, 0x0000000000000000ULL},
+    {0xb5e620f480000000ULL, 0x0000000000000000ULL}, {0xe35fa931a0000000ULL, 0x0000000000000000ULL},
+    {0x8e1bc9bf04000000ULL, 0x0000000000000000ULL}, {0xb1a2bc2ec5000000ULL, 0x0000000000000000ULL},
+    {0xde0b6b3a76400000ULL, 0x0000000000000000ULL}, {0x8ac7230489e80000ULL, 0x0000000000000000ULL},
+    {0xad78ebc5ac620000ULL, 0x0000000000000000ULL}, {0xd8d726b7177a8000ULL, 0x0000000000000000ULL},
+    {0x878678326eac9000ULL, 0x0000000000000000ULL}, {0xa968163f0a57b400ULL, 0x0000000000000000ULL},
+    {0xd3c21bcecceda100ULL, 0x0000000000000000ULL}, {0x84595161401484a0ULL, 0x0000000000000000ULL},
+    {0xa56fa5b99019a5c8ULL, 0x0000000000000000ULL}, {0xcecb8f27f4200f3aULL, 0x0000000000000000ULL},
+    {0x813f3978f8940984ULL, 0x4000000000000000ULL}, {0xa18f07d736b90be5ULL, 0x5000000000000000ULL},
+    {0xc9f2c9cd04674edeULL, 0xa400000000000000ULL}, {0xfc6f7c4045812296ULL, 0x4d00000000000000ULL},
+    {0x9dc5ada82b70b59dULL, 0xf020000000000000ULL}, {0xc5371912364ce305ULL, 0x6c28000000000000ULL},
+    {0xf684df56c3e01bc6ULL, 0xc732000000000000ULL}, {0x9a130b963a6c115cULL, 0x3c7f400000000000ULL},
+    {0xc097ce7bc90715b3ULL, 0x4b9f100000000000ULL}, {0xf0bdc21abb48db20ULL, 0x1e86d40000000000ULL},
+    {0x96769950b50d88f4ULL, 0x1314448000000000ULL}, {0xbc143fa4e250eb31ULL, 0x17d955a000000000ULL},
+    {0xeb194f8e1ae525fdULL, 0x5dcfab0800000000ULL}, {0x92efd1b8d0cf37beULL, 0x5aa1cae500000000ULL},
+    {0xb7abc627050305adULL, 0xf14a3d9e40000000ULL}, {0xe596b7b0c643c719ULL, 0x6d9ccd05d0000000ULL},
+    {0x8f7e32ce7bea5c6fULL, 0xe4820023a2000000ULL}, {0xb35dbf821ae4f38bULL, 0xdda2802c8a800000ULL},
+    {0xe0352f62a19e306eULL, 0xd50b2037ad200000ULL}, {0x8c213d9da502de45ULL, 0x4526f422cc340000ULL},
+    {0xaf298d050e4395d6ULL, 0x9670b12b7f410000ULL}, {0xdaf3f04651d47b4cULL, 0x3c0cdd765f114000ULL},
+    {0x88d8762bf324cd0fULL, 0xa5880a69fb6ac800ULL}, {0xab0e93b6efee0053ULL, 0x8eea0d047a457a00ULL},
+    {0xd5d238a4abe98068ULL, 0x72a4904598d6d880ULL}, {0x85a36366eb71f041ULL, 0x47a6da2b7f864750ULL},
+    {0xa70c3c40a64e6c51ULL, 0x999090b65f67d924ULL}, {0xd0cf4b50cfe20765ULL, 0xfff4b4e3f741cf6dULL},
+    {0x82818f1281ed449fULL, 0xbff8f10e7a8921a4ULL}, {0xa321f2d7226895c7ULL, 0xaff72d52192b6a0dULL},
+    {0xcbea6f8ceb02bb39ULL, 0x9bf4f8a69f764490ULL}, {0xfee50b7025c36a08ULL, 0x02f236d04753d5b4ULL},
+    {0x9f4f2726179a2245ULL, 0x01d762422c946590ULL}, {0xc722f0ef9d80aad6ULL, 0x424d3ad2b7b97ef5ULL},
+    {0xf8ebad2b84e0d58bULL, 0xd2e0898765a7deb2ULL}, {0x9b934c3b330c8577ULL, 0x63cc55f49f88eb2fULL},
+    {0xc2781f49ffcfa6d5ULL, 0x3cbf6b71c76b25fbULL}, {0xf316271c7fc3908aULL, 0x8bef464e3945ef7aULL},
+    {0x97edd871cfda3a56ULL, 0x97758bf0e3cbb5acULL}, {0xbde94e8e43d0c8ecULL, 0x3d52eeed1cbea317ULL},
+    {0xed63a231d4c4fb27ULL, 0x4ca7aaa863ee4bddULL}, {0x945e455f24fb1cf8ULL, 0x8fe8caa93e74ef6aULL},
+    {0xb975d6b6ee39e436ULL, 0xb3e2fd538e122b44ULL}, {0xe7d34c64a9c85d44ULL, 0x60dbbca87196b616ULL},
+    {0x90e40fbeea1d3a4aULL, 0xbc8955e946fe31cdULL}, {0xb51d13aea4a488ddULL, 0x6babab6398bdbe41ULL},
+    {0xe264589a4dcdab14ULL, 0xc696963c7eed2dd1ULL}, {0x8d7eb76070a08aecULL, 0xfc1e1de5cf543ca2ULL},
+    {0xb0de65388cc8ada8ULL, 0x3b25a55f43294bcbULL}, {0xdd15fe86affad912ULL, 0x49ef0eb713f39ebeULL},
+    {0x8a2dbf142dfcc7abULL, 0x6e3569326c784337ULL}, {0xacb92ed9397bf996ULL, 0x49c2c37f07965404ULL},
+    {0xd7e77a8f87daf7fbULL, 0xdc33745ec97be906ULL}, {0x86f0ac99b4e8dafdULL, 0x69a028bb3ded71a3ULL},
+    {0xa8acd7c0222311bcULL, 0xc40832ea0d68ce0cULL}, {0xd2d80db02aabd62bULL, 0xf50a3fa490c30190ULL},
+    {0x83c7088e1aab65dbULL, 0x792667c6da79e0faULL}, {0xa4b8cab1a1563f52ULL, 0x577001b891185938ULL},
+    {0xcde6fd5e09abcf26ULL, 0xed4c0226b55e6f86ULL}, {0x80b05e5ac60b6178ULL, 0x544f8158315b05b4ULL},
+    {0xa0dc75f1778e39d6ULL, 0x696361ae3db1c721ULL}, {0xc913936dd571c84cULL, 0x03bc3a19cd1e38e9ULL},
+    {0xfb5878494ace3a5fULL, 0x04ab48a04065c723ULL}, {0x9d174b2dcec0e47bULL, 0x62eb0d64283f9c76ULL},
+    {0xc45d1df942711d9aULL, 0x3ba5d0bd324f8394ULL}, {0xf5746577930d6500ULL, 0xca8f44ec7ee36479ULL},
+    {0x9968bf6abbe85f20ULL, 0x7e998b13cf4e1ecbULL}, {0xbfc2ef456ae276e8ULL, 0x9e3fedd8c321a67eULL},
+    {0xefb3ab16c59b14a2ULL, 0xc5cfe94ef3ea101eULL}, {0x95d04aee3b80ece5ULL, 0xbba1f1d158724a12ULL},
+    {0xbb445da9ca61281fULL, 0x2a8a6e45ae8edc97ULL}, {0xea1575143cf97226ULL, 0xf52d09d71a3293bdULL},
+    {0x924d692ca61be758ULL, 0x593c2626705f9c56ULL}, {0xb6e0c377cfa2e12eULL, 0x6f8b2fb00c77836cULL},
+    {0xe498f455c38b997aULL, 0x0b6dfb9c0f956447ULL}, {0x8edf98b59a373fecULL, 0x4724bd4189bd5eacULL},
+    {0xb2977ee300c50fe7ULL, 0x58edec91ec2cb657ULL}, {0xdf3d5e9bc0f653e1ULL, 0x2f2967b66737e3edULL},
+    {0x8b865b215899f46cULL, 0xbd79e0d20082ee74ULL}, {0xae67f1e9aec07187ULL, 0xecd8590680a3aa11ULL},
+    {0xda01ee641a708de9ULL, 0xe80e6f4820cc9495ULL}, {0x884134fe908658b2ULL, 0x3109058d147fdcddULL},
+    {0xaa51823e34a7eedeULL, 0xbd4b46f0599fd415ULL}, {0xd4e5e2cdc1d1ea96ULL, 0x6c9e18ac7007c91aULL},
+    {0x850fadc09923329eULL, 0x03e2cf6bc604ddb0ULL}, {0xa6539930bf6bff45ULL, 0x84db8346b786151cULL},
+    {0xcfe87f7cef46ff16ULL, 0xe612641865679a63ULL}, {0x81f14fae158c5f6eULL, 0x4fcb7e8f3f60c07eULL},
+    {0xa26da3999aef7749ULL, 0xe3be5e330f38f09dULL}, {0xcb090c8001ab551cULL, 0x5cadf5bfd3072cc5ULL},
+    {0xfdcb4fa002162a63ULL, 0x73d9732fc7c8f7f6ULL}, {0x9e9f11c4014dda7eULL, 0x2867e7fddcdd9afaULL},
+    {0xc646d63501a1511dULL, 0xb281e1fd541501b8ULL}, {0xf7d88bc24209a565ULL, 0x1f225a7ca91a4226ULL},
+    {0x9ae757596946075fULL, 0x3375788de9b06958ULL}, {0xc1a12d2fc3978937ULL, 0x0052d6b1641c83aeULL},
+    {0xf209787bb47d6b84ULL, 0xc0678c5dbd23a49aULL}, {0x9745eb4d50ce6332ULL, 0xf840b7ba963646e0ULL},
+    {0xbd176620a501fbffULL, 0xb650e5a93bc3d898ULL}, {0xec5d3fa8ce427affULL, 0xa3e51f138ab4cebeULL},
+    {0x93ba47c980e98cdfULL, 0xc66f336c36b10137ULL}, {0xb8a8d9bbe123f017ULL, 0xb80b0047445d4184ULL},
+    {0xe6d3102ad96cec1dULL, 0xa60dc059157491e5ULL}, {0x9043ea1ac7e41392ULL, 0x87c89837ad68db2fULL},
+    {0xb454e4a179dd1877ULL, 0x29babe4598c311fbULL}, {0xe16a1dc9d8545e94ULL, 0xf4296dd6fef3d67aULL},
+    {0x8ce2529e2734bb1dULL, 0x1899e4a65f58660cULL}, {0xb01ae745b101e9e4ULL, 0x5ec05dcff72e7f8fULL},
+    {0xdc21a1171d42645dULL, 0x76707543f4fa1f73ULL}, {0x899504ae72497ebaULL, 0x6a06494a791c53a8ULL},
+    {0xabfa45da0edbde69ULL, 0x0487db9d17636892ULL}, {0xd6f8d7509292d603ULL, 0x45a9d2845d3c42b6ULL},
+    {0x865b86925b9bc5c2ULL, 0x0b8a2392ba45a9b2ULL}, {0xa7f26836f282b732ULL, 0x8e6cac7768d7141eULL},
+    {0xd1ef0244af2364ffULL, 0x3207d795430cd926ULL}, {0x8335616aed761f1fULL, 0x7f44e6bd49e807b8ULL},
+    {0xa402b9c5a8d3a6e7ULL, 0x5f16206c9c6209a6ULL}, {0xcd036837130890a1ULL, 0x36dba887c37a8c0fULL},
+    {0x802221226be55a64ULL, 0xc2494954da2c9789ULL}, {0xa02aa96b06deb0fdULL, 0xf2db9baa10b7bd6cULL},
+    {0xc83553c5c8965d3dULL, 0x6f92829494e5acc7ULL}, {0xfa42a8b73abbf48cULL, 0xcb772339ba1f17f9ULL},
+    {0x9c69a97284b578d7ULL, 0xff2a760414536efbULL}, {0xc38413cf25e2d70dULL, 0xfef5138519684abaULL},
+    {0xf46518c2ef5b8cd1ULL, 0x7eb258665fc25d69ULL}, {0x98bf2f79d5993802ULL, 0xef2f773ffbd97a61ULL},
+    {0xbeeefb584aff8603ULL, 0xaafb550ffacfd8faULL}, {0xeeaaba2e5dbf6784ULL, 0x95ba2a53f983cf38ULL},
+    {0x952ab45cfa97a0b2ULL, 0xdd945a747bf26183ULL}, {0xba756174393d88dfULL, 0x94f971119aeef9e4ULL},
+    {0xe912b9d1478ceb17ULL, 0x7a37cd5601aab85dULL}, {0x91abb422ccb812eeULL, 0xac62e055c10ab33aULL},
+    {0xb616a12b7fe617aaULL, 0x577b986b314d6009ULL}, {0xe39c49765fdf9d94ULL, 0xed5a7e85fda0b80bULL},
+    {0x8e41ade9fbebc27dULL, 0x14588f13be847307ULL}, {0xb1d219647ae6b31cULL, 0x596eb2d8ae258fc8ULL},
+    {0xde469fbd99a05fe3ULL, 0x6fca5f8ed9aef3bbULL}, {0x8aec23d680043beeULL, 0x25de7bb9480d5854ULL},
+    {0xada72ccc20054ae9ULL, 0xaf561aa79a10ae6aULL}, {0xd910f7ff28069da4ULL, 0x1b2ba1518094da04ULL},
+    {0x87aa9aff79042286ULL, 0x90fb44d2f05d0842ULL}, {0xa99541bf57452b28ULL, 0x353a1607ac744a53ULL},
+    {0xd3fa922f2d1675f2ULL, 0x42889b8997915ce8ULL}, {0x847c9b5d7c2e09b7ULL, 0x69956135febada11ULL},
+    {0xa59bc234db398c25ULL, 0x43fab9837e699095ULL}, {0xcf02b2c21207ef2eULL, 0x94f967e45e03f4bbULL},
+    {0x8161afb94b44f57dULL, 0x1d1be0eebac278f5ULL}, {0xa1ba1ba79e1632dcULL, 0x6462d92a69731732ULL},
+    {0xca28a291859bbf93ULL, 0x7d7b8f7503cfdcfeULL}, {0xfcb2cb35e702af78ULL, 0x5cda735244c3d43eULL},
+    {0x9defbf01b061adabULL, 0x3a0888136afa64a7ULL}, {0xc56baec21c7a1916ULL, 0x088aaa1845b8fdd0ULL},
+    {0xf6c69a72a3989f5bULL, 0x8aad549e57273d45ULL}, {0x9a3c2087a63f6399ULL, 0x36ac54e2f678864bULL},
+    {0xc0cb28a98fcf3c7fULL, 0x84576a1bb416a7ddULL}, {0xf0fdf2d3f3c30b9fULL, 0x656d44a2a11c51d5ULL},
+    {0x969eb7c47859e743ULL, 0x9f644ae5a4b1b325ULL}, {0xbc4665b596706114ULL, 0x873d5d9f0dde1feeULL},
+    {0xeb57ff22fc0c7959ULL, 0xa90cb506d155a7eaULL}, {0x9316ff75dd87cbd8ULL, 0x09a7f12442d588f2ULL},
+    {0xb7dcbf5354e9beceULL, 0x0c11ed6d538aeb2fULL}, {0xe5d3ef282a242e81ULL, 0x8f1668c8a86da5faULL},
+    {0x8fa475791a569d10ULL, 0xf96e017d694487bcULL}, {0xb38d92d760ec4455ULL, 0x37c981dcc395a9acULL},
+    {0xe070f78d3927556aULL, 0x85bbe253f47b1417ULL}, {0x8c469ab843b89562ULL, 0x93956d7478ccec8eULL},
+    {0xaf58416654a6babbULL, 0x387ac8d1970027b2ULL}, {0xdb2e51bfe9d0696aULL, 0x06997b05fcc0319eULL},
+    {0x88fcf317f22241e2ULL, 0x441fece3bdf81f03ULL}, {0xab3c2fddeeaad25aULL, 0xd527e81cad7626c3ULL},
+    {0xd60b3bd56a5586f1ULL, 0x8a71e223d8d3b074ULL}, {0x85c7056562757456ULL, 0xf6872d5667844e49ULL},
+    {0xa738c6bebb12d16cULL, 0xb428f8ac016561dbULL}, {0xd106f86e69d785c7ULL, 0xe13336d701beba52ULL},
+    {0x82a45b450226b39cULL, 0xecc0024661173473ULL}, {0xa34d721642b06084ULL, 0x27f002d7f95d0190ULL},
+    {0xcc20ce9bd35c78a5ULL, 0x31ec038df7b441f4ULL}, {0xff290242c83396ceULL, 0x7e67047175a15271ULL},
+    {0x9f79a169bd203e41ULL, 0x0f0062c6e984d386ULL}, {0xc75809c42c684dd1ULL, 0x52c07b78a3e60868ULL},
+    {0xf92e0c3537826145ULL, 0xa7709a56ccdf8a82ULL}, {0x9bbcc7a142b17ccbULL, 0x88a66076400bb691ULL},
+    {0xc2abf989935ddbfeULL, 0x6acff893d00ea435ULL}, {0xf356f7ebf83552feULL, 0x0583f6b8c4124d43ULL},
+    {0x98165af37b2153deULL, 0xc3727a337a8b704aULL}, {0xbe1bf1b059e9a8d6ULL, 0x744f18c0592e4c5cULL},
+    {0xeda2ee1c7064130cULL, 0x1162def06f79df73ULL}, {0x9485d4d1c63e8be7ULL, 0x8addcb5645ac2ba8ULL},
+    {0xb9a74a0637ce2ee1ULL, 0x6d953e2bd7173692ULL}, {0xe8111c87c5c1ba99ULL, 0xc8fa8db6ccdd0437ULL},
+    {0x910ab1d4db9914a0ULL, 0x1d9c9892400a22a2ULL}, {0xb54d5e4a127f59c8ULL, 0x2503beb6d00cab4bULL},
+    {0xe2a0b5dc971f303aULL, 0x2e44ae64840fd61dULL}, {0x8da471a9de737e24ULL, 0x5ceaecfed289e5d2ULL},
+    {0xb10d8e1456105dadULL, 0x7425a83e872c5f47ULL}, {0xdd50f1996b947518ULL, 0xd12f124e28f77719ULL},
+    {0x8a5296ffe33cc92fULL, 0x82bd6b70d99aaa6fULL}, {0xace73cbfdc0bfb7bULL, 0x636cc64d1001550bULL},
+    {0xd8210befd30efa5aULL, 0x3c47f7e05401aa4eULL}, {0x8714a775e3e95c78ULL, 0x65acfaec34810a71ULL},
+    {0xa8d9d1535ce3b396ULL, 0x7f1839a741a14d0dULL}, {0xd31045a8341ca07cULL, 0x1ede48111209a050ULL},
+    {0x83ea2b892091e44dULL, 0x934aed0aab460432ULL}, {0xa4e4b66b68b65d60ULL, 0xf81da84d5617853fULL},
+    {0xce1de40642e3f4b9ULL, 0x36251260ab9d668eULL}, {0x80d2ae83e9ce78f3ULL, 0xc1d72b7c6b426019ULL},
+    {0xa1075a24e4421730ULL, 0xb24cf65b8612f81fULL}, {0xc94930ae1d529cfcULL, 0xdee033f26797b627ULL},
+    {0xfb9b7cd9a4a7443cULL, 0x169840ef017da3b1ULL}, {0x9d412e0806e88aa5ULL, 0x8e1f289560ee864eULL},
+    {0xc491798a08a2ad4eULL, 0xf1a6f2bab92a27e2ULL}, {0xf5b5d7ec8acb58a2ULL, 0xae10af696774b1dbULL},
+    {0x9991a6f3d6bf1765ULL, 0xacca6da1e0a8ef29ULL}, {0xbff610b0cc6edd3fULL, 0x17fd090a58d32af3ULL},
+    {0xeff394dcff8a948eULL, 0xddfc4b4cef07f5b0ULL}, {0x95f83d0a1fb69cd9ULL, 0x4abdaf101564f98eULL},
+    {0xbb764c4ca7a4440fULL, 0x9d6d1ad41abe37f1ULL}, {0xea53df5fd18d5513ULL, 0x84c86189216dc5edULL},
+    {0x92746b9be2f8552cULL, 0x32fd3cf5b4e49bb4ULL}, {0xb7118682dbb66a77ULL, 0x3fbc8c33221dc2a1ULL},
+    {0xe4d5e82392a40515ULL, 0x0fabaf3feaa5334aULL}, {0x8f05b1163ba6832dULL, 0x29cb4d87f2a7400eULL},
+    {0xb2c71d5bca9023f8ULL, 0x743e20e9ef511012ULL}, {0xdf78e4b2bd342cf6ULL, 0x914da9246b255416ULL},
+    {0x8bab8eefb6409c1aULL, 0x1ad089b6c2f7548eULL}, {0xae9672aba3d0c320ULL, 0xa184ac2473b529b1ULL},
+    {0xda3c0f568cc4f3e8ULL, 0xc9e5d72d90a2741eULL}, {0x8865899617fb1871ULL, 0x7e2fa67c7a658892ULL},
+    {0xaa7eebfb9df9de8dULL, 0xddbb901b98feeab7ULL}, {0xd51ea6fa85785631ULL, 0x552a74227f3ea565ULL},
+    {0x8533285c936b35deULL, 0xd53a88958f87275fULL}, {0xa67ff273b8460356ULL, 0x8a892abaf368f137ULL},
+    {0xd01fef10a657842cULL, 0x2d2b7569b0432d85ULL}, {0x8213f56a67f6b29bULL, 0x9c3b29620e29fc73ULL},
+    {0xa298f2c501f45f42ULL, 0x8349f3ba91b47b8fULL}, {0xcb3f2f7642717713ULL, 0x241c70a936219a73ULL},
+    {0xfe0efb53d30dd4d7ULL, 0xed238cd383aa0110ULL}, {0x9ec95d1463e8a506ULL, 0xf4363804324a40aaULL},
+    {0xc67bb4597ce2ce48ULL, 0xb143c6053edcd0d5ULL}, {0xf81aa16fdc1b81daULL, 0xdd94b7868e94050aULL},
+    {0x9b10a4e5e9913128ULL, 0xca7cf2b4191c8326ULL}, {0xc1d4ce1f63f57d72ULL, 0xfd1c2f611f63a3f0ULL},
+    {0xf24a01a73cf2dccfULL, 0xbc633b39673c8cecULL}, {0x976e41088617ca01ULL, 0xd5be0503e085d813ULL},
+    {0xbd49d14aa79dbc82ULL, 0x4b2d8644d8a74e18ULL}, {0xec9c459d51852ba2ULL, 0xddf8e7d60ed1219eULL},
+    {0x93e1ab8252f33b45ULL, 0xcabb90e5c942b503ULL}, {0xb8da1662e7b00a17ULL, 0x3d6a751f3b936243ULL},
+    {0xe7109bfba19c0c9dULL, 0x0cc512670a783ad4ULL}, {0x906a617d450187e2ULL, 0x27fb2b80668b24c5ULL},
+    {0xb484f9dc9641e9daULL, 0xb1f9f660802dedf6ULL}, {0xe1a63853bbd26451ULL, 0x5e7873f8a0396973ULL},
+    {0x8d07e33455637eb2ULL, 0xdb0b487b6423e1e8ULL}, {0xb049dc016abc5e5fULL, 0x91ce1a9a3d2cda62ULL},
+    {0xdc5c5301c56b75f7ULL, 0x7641a140cc7810fbULL}, {0x89b9b3e11b6329baULL, 0xa9e904c87fcb0a9dULL},
+    {0xac2820d9623bf429ULL, 0x546345fa9fbdcd44ULL}, {0xd732290fbacaf133ULL, 0xa97c177947ad4095ULL},
+    {0x867f59a9d4bed6c0ULL, 0x49ed8eabcccc485dULL}, {0xa81f301449ee8c70ULL, 0x5c68f256bfff5a74ULL},
+    {0xd226fc195c6a2f8cULL, 0x73832eec6fff3111ULL}, {0x83585d8fd9c25db7ULL, 0xc831fd53c5ff7eabULL},
+    {0xa42e74f3d032f525ULL, 0xba3e7ca8b77f5e55ULL}, {0xcd3a1230c43fb26fULL, 0x28ce1bd2e55f35ebULL},
+    {0x80444b5e7aa7cf85ULL, 0x7980d163cf5b81b3ULL}, {0xa0555e361951c366ULL, 0xd7e105bcc332621fULL},
+    {0xc86ab5c39fa63440ULL, 0x8dd9472bf3fefaa7ULL}, {0xfa856334878fc150ULL, 0xb14f98f6f0feb951ULL},
+    {0x9c935e00d4b9d8d2ULL, 0x6ed1bf9a569f33d3ULL}, {0xc3b8358109e84f07ULL, 0x0a862f80ec4700c8ULL},
+    {0xf4a642e14c6262c8ULL, 0xcd27bb612758c0faULL}, {0x98e7e9cccfbd7dbdULL, 0x8038d51cb897789cULL},
+    {0xbf21e44003acdd2cULL, 0xe0470a63e6bd56c3ULL}, {0xeeea5d5004981478ULL, 0x1858ccfce06cac74ULL},
+    {0x95527a5202df0ccbULL, 0x0f37801e0c43ebc8ULL}, {0xbaa718e68396cffdULL, 0xd30560258f54e6baULL},
+    {0xe950df20247c83fdULL, 0x47c6b82ef32a2069ULL}, {0x91d28b7416cdd27eULL, 0x4cdc331d57fa5441ULL},
+    {0xb6472e511c81471dULL, 0xe0133fe4adf8e952ULL}, {0xe3d8f9e563a198e5ULL, 0x58180fddd97723a6ULL},
+    {0x8e679c2f5e44ff8fULL, 0x570f09eaa7ea7648ULL},
+};
+
+// Cached 10^k as normalized 64 bit significand and binary exponent for k = -348, -340, ..., 340
+static const uint64_t _wsJsonCachedPowersF[87] = {
+    0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL,
+    0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+    0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL,
+    0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+    0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+    0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+    0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL, 0xb23867fb2a35b28eULL,
+    0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+    0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL,
+    0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+    0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL,
+    0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+    0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL,
+    0xaa242499697392d3ULL, 0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+    0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+    0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+    0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL,
+    0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+    0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL, 0x924d692ca61be758ULL,
+    0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+    0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL,
+    0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+    0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL,
+    0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+    0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+    0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+    0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL, 0x80444b5e7aa7cf85ULL,
+    0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+    0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL,
+};
+
+static const int16_t _wsJsonCachedPowersE[87] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+    -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+    -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+    -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+    -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+    109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+    641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+    907, 933, 960, 986, 1013, 1039, 1066,
+};
+
+static inline uint64_t _wsJsonMul128(uint64_t a, uint64_t b, uint64_t* high) {
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 product = (unsigned __int128)a * b;
+    *high = (uint64_t)(product >> 64);
+    return (uint64_t)product;
+#else
+    uint64_t aLow = a & 0xFFFFFFFF, aHigh = a >> 32;
+    uint64_t bLow = b & 0xFFFFFFFF, bHigh = b >> 32;
+    uint64_t low = aLow * bLow;
+    uint64_t middle1 = aHigh * bLow + (low >> 32);
+    uint64_t middle2 = aLow * bHigh + (middle1 & 0xFFFFFFFF);
+    *high = aHigh * bHigh + (middle1 >> 32) + (middle2 >> 32);
+    return (middle2 << 32) | (low & 0xFFFFFFFF);
+#endif
+}
+
+// x must not be 0
+static inline int32_t _wsJsonClz64(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_clzll(x);
+#else
+    int32_t count = 0;
+    while (!(x & (1ULL << 63))) {
+        x <<= 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+// w * 10^q for a non zero w, returns false when the result can't be decided (or is subnormal)
+static bool _wsJsonEiselLemire(uint64_t w, int64_t q, bool negative, double* out) {
+    if (q < -342) {
+        *out = negative ? -0.0 : 0.0;
+        return true;
+    }
+    if (q > 308) {
+        *out = negative ? -HUGE_VAL : HUGE_VAL;
+        return true;
+    }
+
+    int32_t lz = _wsJsonClz64(w);
+    w <<= lz;
+    const uint64_t* power = _wsJsonPowersOfFive[q + 342];
+    uint64_t high;
+    uint64_t low = _wsJsonMul128(w, power[0], &high);
+    if ((high & 0x1FF) == 0x1FF) {
+        // Not enough bits to round, bring in the lower half of the power
+        uint64_t high2;
+        _wsJsonMul128(w, power[1], &high2);
+        low += high2;
+        if (high2 > low) high++;
+        if (low == UINT64_MAX) return false;
+    }
+
+    uint64_t upperBit = high >> 63;
+    int32_t shift = (int32_t)upperBit + 64 - 52 - 3;
+    uint64_t mantissa = high >> shift;
+    lz += (int32_t)(1 ^ upperBit);
+
+    // Exactly between two doubles, only possible while 5^q fits 64 bits
+    if (low <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1 && (mantissa << shift) == high) {
+        mantissa &= ~1ULL;
+    }
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if (mantissa >= (1ULL << 53)) {
+        mantissa = 1ULL << 52;
+        lz--;
+    }
+    mantissa &= ~(1ULL << 52);
+
+    // 1024 + 63 + q + floor(log2(5^q))
+    int64_t exponent = (((152170 + 65536) * q) >> 16) + 1024 + 63 - lz;
+    if (exponent < 1 || exponent > 2046) return false;
+
+    uint64_t bits = mantissa | ((uint64_t)exponent << 52) | ((uint64_t)negative << 63);
+    memcpy(out, &bits, sizeof(bits));
+    return true;
+}
+
+// strtod with '.' swapped for the decimal point of the current locale
+static double _wsJsonStrtod(const char* start, size_t length) {
+    char stackBuffer[64];
+    char* buffer = length < sizeof(stackBuffer) ? stackBuffer : _wsJsonMalloc(length + 1);
+    if (!buffer) return 0.0;
+    memcpy(buffer, start, length);
+    buffer[length] = '\0';
+
+    char point = localeconv()->decimal_point[0];
+    if (point != '.') {
+        char* dot = memchr(buffer, '.', length);
+        if (dot) *dot = point;
+    }
+
+    double value = strtod(buffer, NULL);
+    if (buffer != stackBuffer) _wsJsonFree(buffer);
+    return value;
+}
+
+#define _WS_JSON_IS_DIGIT(c) ((unsigned char)((c) - '0') < 10)
+
+// Scans a json number between string and end and returns its end, NULL if there are no digits 
+// or it is too big for a double (json has no infinity, written back it would become null).
+// isInteger is set when the number has no fraction or exponent and fits an int64.
+static const char* _wsJsonParseNumber(const char* string, const char* end, double* value, int64_t* integer, bool* isInteger) {
+    const char* cursor = string;
+    bool negative = cursor < end && *cursor == '-';
+    if (negative) cursor++;
+    if (cursor == end || !_WS_JSON_IS_DIGIT(*cursor)) return NULL;
+
+    // Up to 19 significant digits fit the significand, the rest only moves the exponent
+    uint64_t significand = 0;
+    int32_t digits = 0;
+    int64_t exponent = 0;
+    bool truncated = false;
+    bool integral = true;
+
+    while (cursor < end && _WS_JSON_IS_DIGIT(*cursor)) {
+        if (digits < 19) {
+            significand = significand * 10 + (uint64_t)(*cursor - '0');
+            if (significand) digits++;
+        }
+        else {
+            exponent++;
+            truncated |= *cursor != '0';
+        }
+        cursor++;
+    }
+
+    if (cursor < end && *cursor == '.') {
+        integral = false;
+        cursor++;
+        while (cursor < end && _WS_JSON_IS_DIGIT(*cursor)) {
+            if (digits < 19) {
+                significand = significand * 10 + (uint64_t)(*cursor - '0');
+                if (significand) digits++;
+                exponent--;
+            }
+            else truncated |= *cursor != '0';
+            cursor++;
+        }
+    }
+
+    if (cursor < end && (*cursor == 'e' || *cursor == 'E')) {
+        const char* exponentStart = cursor + 1;
+        bool exponentNegative = exponentStart < end && *exponentStart == '-';
+        if (exponentStart < end && (*exponentStart == '-' || *exponentStart == '+')) exponentStart++;
+        // Without digits the 'e' is not part of the number
+        if (exponentStart < end && _WS_JSON_IS_DIGIT(*exponentStart)) {
+            int64_t explicitExponent = 0;
+            cursor = exponentStart;
+            while (cursor < end && _WS_JSON_IS_DIGIT(*cursor)) {
+                if (explicitExponent < 100000) explicitExponent = explicitExponent * 10 + (*cursor - '0');
+                cursor++;
+            }
+            exponent += exponentNegative ? -explicitExponent : explicitExponent;
+            integral = false;
+        }
+    }
+
+    *isInteger = false;
+    if (integral && exponent == 0 && !(negative && significand == 0)) {
+        if (!negative && significand <= (uint64_t)INT64_MAX) {
+            *integer = (int64_t)significand;
+            *isInteger = true;
+        }
+        else if (negative && significand <= (uint64_t)INT64_MAX + 1) {
+            *integer = significand == (uint64_t)INT64_MAX + 1 ? INT64_MIN : -(int64_t)significand;
+            *isInteger = true;
+        }
+    }
+
+    if (significand == 0) {
+        *value = negative ? -0.0 : 0.0;
+    }
+    else if (!truncated && exponent >= -22 && exponent <= 22 && significand <= (1ULL << 53)) {
+        double result = (double)significand;
+        if (exponent < 0) result /= _wsJsonExactPowersOfTen[-exponent];
+        else result *= _wsJsonExactPowersOfTen[exponent];
+        *value = negative ? -result : result;
+    }
+    else if (truncated || !_wsJsonEiselLemire(significand, exponent, negative, value)) {
+        *value = _wsJsonStrtod(string, cursor - string);
+    }
+    return isinf(*value) ? NULL : cursor;
+}
+
+typedef struct _wsJsonDiyFp {
+    uint64_t f;
+    int32_t e;
+} _wsJsonDiyFp;
+
+static inline _wsJsonDiyFp _wsJsonDiyFpMul(_wsJsonDiyFp a, _wsJsonDiyFp b) {
+    uint64_t high;
+    uint64_t low = _wsJsonMul128(a.f, b.f, &high);
+    high += low >> 63; // round
+    return (_wsJsonDiyFp){ high, a.e + b.e + 64 };
+}
+
+static inline _wsJsonDiyFp _wsJsonDiyFpNormalize(_wsJsonDiyFp v) {
+    int32_t shift = _wsJsonClz64(v.f);
+    return (_wsJsonDiyFp){ v.f << shift, v.e - shift };
+}
+
+static void _wsJsonGrisuRound(char* buffer, int32_t length, uint64_t delta, uint64_t rest, uint64_t tenKappa, uint64_t distance) {
+    while (rest < distance && delta - rest >= tenKappa &&
+           (rest + tenKappa < distance || distance - rest > rest + tenKappa - distance)) {
+        buffer[length - 1]--;
+        rest += tenKappa;
+    }
+}
+
+static const uint64_t _wsJsonPowersOfTen64[20] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+    100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+    10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+// Writes the digits of a positive finite double, the value is digits * 10^K
+static int32_t _wsJsonGrisu2(double value, char* buffer, int32_t* K) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    int32_t biasedExponent = (int32_t)((bits >> 52) & 0x7FF);
+    uint64_t significand = bits & ((1ULL << 52) - 1);
+    _wsJsonDiyFp v;
+    if (biasedExponent) v = (_wsJsonDiyFp){ significand | (1ULL << 52), biasedExponent - 1075 };
+    else v = (_wsJsonDiyFp){ significand, -1074 };
+
+    // Boundaries halfway to the neighbouring doubles, both with the exponent of the upper one
+    _wsJsonDiyFp plus = _wsJsonDiyFpNormalize((_wsJsonDiyFp){ (v.f << 1) + 1, v.e - 1 });
+    _wsJsonDiyFp minus = v.f == (1ULL << 52) ? (_wsJsonDiyFp){ (v.f << 2) - 1, v.e - 2 } : (_wsJsonDiyFp){ (v.f << 1) - 1, v.e - 1 };
+    minus.f <<= minus.e - plus.e;
+    minus.e = plus.e;
+
+    // Cached power that brings the upper boundary's exponent into -60..-32
+    double dk = (-61 - plus.e) * 0.30102999566398114 + 347;
+    int32_t k = (int32_t)dk;
+    if (dk - k > 0.0) k++;
+    uint32_t index = (uint32_t)((k >> 3) + 1);
+    *K = -(-348 + (int32_t)(index << 3));
+    _wsJsonDiyFp cached = { _wsJsonCachedPowersF[index], _wsJsonCachedPowersE[index] };
+
+    _wsJsonDiyFp w = _wsJsonDiyFpMul(_wsJsonDiyFpNormalize(v), cached);
+    _wsJsonDiyFp upper = _wsJsonDiyFpMul(plus, cached);
+    _wsJsonDiyFp lower = _wsJsonDiyFpMul(minus, cached);
+    lower.f++;
+    upper.f--;
+
+    // Digit generation
+    uint64_t delta = upper.f - lower.f;
+    int32_t oneShift = -upper.e;
+    uint64_t oneMask = (1ULL << oneShift) - 1;
+    uint64_t distance = upper.f - w.f;
+    uint32_t p1 = (uint32_t)(upper.f >> oneShift);
+    uint64_t p2 = upper.f & oneMask;
+    int32_t kappa = 1;
+    while (kappa < 10 && p1 >= _wsJsonPowersOfTen64[kappa]) kappa++;
+    int32_t length = 0;
+
+    while (kappa > 0) {
+        uint32_t divisor = (uint32_t)_wsJsonPowersOfTen64[kappa - 1];
+        uint32_t digit = p1 / divisor;
+        p1 %= divisor;
+        if (digit || length) buffer[length++] = (char)('0' + digit);
+        kappa--;
+        uint64_t rest = ((uint64_t)p1 << oneShift) + p2;
+        if (rest <= delta) {
+            *K += kappa;
+            _wsJsonGrisuRound(buffer, length, delta, rest, _wsJsonPowersOfTen64[kappa] << oneShift, distance);
+            return length;
+        }
+    }
+
+    for (;;) {
+        p2 *= 10;
+        delta *= 10;
+        char digit = (char)(p2 >> oneShift);
+        if (digit || length) buffer[length++] = (char)('0' + digit);
+        p2 &= oneMask;
+        kappa--;
+        if (p2 < delta) {
+            *K += kappa;
+            int32_t scale = -kappa;
+            _wsJsonGrisuRound(buffer, length, delta, p2, 1ULL << oneShift, distance * (scale < 20 ? _wsJsonPowersOfTen64[scale] : 0));
+            return length;
+        }
+    }
+}
+
+// out needs 21 bytes
+static int32_t _wsJsonFormatInteger(int64_t value, char* out) {
+    char digits[20];
+    uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+    int32_t count = 0;
+    do {
+        digits[count++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+
+    int32_t length = 0;
+    if (value < 0) out[length++] = '-';
+    while (count) out[length++] = digits[--count];
+    return length;
+}
+
+// Shortest representation that reads back to the same double, out needs 32 bytes.
+// Json has no NaN or infinity so they are written as null.
+static int32_t _wsJsonFormatDouble(double value, char* out) {
+    if (value != value || value - value != 0.0) {
+        memcpy(out, "null", 4);
+        return 4;
+    }
+    if (value > -9007199254740992.0 && value < 9007199254740992.0 && (double)(int64_t)value == value) {
+        if (value == 0.0 && signbit(value)) {
+            memcpy(out, "-0", 2);
+            return 2;
+        }
+        return _wsJsonFormatInteger((int64_t)value, out);
+    }
+
+    char* buffer = out;
+    if (value < 0) {
+        *buffer++ = '-';
+        value = -value;
+    }
+
+    int32_t k;
+    int32_t length = _wsJsonGrisu2(value, buffer, &k);
+    int32_t kk = length + k; // 10^(kk - 1) <= value < 10^kk
+
+    if (k >= 0 && kk <= 21) {
+        // 1234e7 -> 12340000000
+        for (int32_t i = length; i < kk; i++) buffer[i] = '0';
+        length = kk;
+    }
+    else if (kk > 0 && kk <= 21) {
+        // 1234e-2 -> 12.34
+        memmove(&buffer[kk + 1], &buffer[kk], length - kk);
+        buffer[kk] = '.';
+        length++;
+    }
+    else if (kk > -6 && kk <= 0) {
+        // 1234e-6 -> 0.001234
+        int32_t offset = 2 - kk;
+        memmove(&buffer[offset], &buffer[0], length);
+        buffer[0] = '0';
+        buffer[1] = '.';
+        for (int32_t i = 2; i < offset; i++) buffer[i] = '0';
+        length += offset;
+    }
+    else {
+        // 1e30, 1234e30 -> 1.234e33
+        if (length > 1) {
+            memmove(&buffer[2], &buffer[1], length - 1);
+            buffer[1] = '.';
+            length++;
+        }
+        buffer[length++] = 'e';
+        length += _wsJsonFormatInteger(kk - 1, &buffer[length]);
+    }
+    return (int32_t)(buffer - out) + length;
+}
+
+/* Writer */
+void wsJsonWriterInitFixed(wsJsonWriter* writer, char* out, size_t size) {
+    memset(writer, 0, offsetof(wsJsonWriter, sinkBuffer));
+    writer->type = WS_JSON_WRITER_FIXED;
+    writer->buffer = size ? out : NULL;
+    writer->capacity = out && size ? size - 1 : 0; // keep space for the terminator
+    if (writer->buffer && size) writer->buffer[0] = '\0';
+}
+
+int32_t wsJsonWriterInitGrowable(wsJsonWriter* writer, size_t initialCapacity) {
+    memset(writer, 0, offsetof(wsJsonWriter, sinkBuffer));
+    writer->type = WS_JSON_WRITER_GROWABLE;
+    writer->capacity = initialCapacity ? initialCapacity : 256;
+    writer->buffer = _wsJsonMalloc(writer->capacity + 1);
+    if (!writer->buffer) {
+        WS_JSON_LOG_ERROR("Failed to allocate json writer buffer\n");
+        writer->error = WS_ERROR;
+        return WS_ERROR;
+    }
+    writer->buffer[0] = '\0';
+    return WS_OK;
+}
+
+void wsJsonWriterInitSink(wsJsonWriter* writer, wsJsonWriteFn sink, void* user) {
+    memset(writer, 0, offsetof(wsJsonWriter, sinkBuffer));
+    writer->type = WS_JSON_WRITER_SINK;
+    writer->buffer = writer->sinkBuffer;
+    writer->capacity = sizeof(writer->sinkBuffer);
+    writer->sink = sink;
+    writer->user = user;
+}
+
+void wsJsonWriterFree(wsJsonWriter* writer) {
+    if (!writer) return;
+    if (writer->type == WS_JSON_WRITER_GROWABLE) _wsJsonFree(writer->buffer);
+    writer->buffer = NULL;
+    writer->used = 0;
+    writer->capacity = 0;
+}
+
+static void _wsJsonWriterFlush(wsJsonWriter* writer) {
+    if (writer->type != WS_JSON_WRITER_SINK || writer->used == 0) return;
+    if (!writer->error && writer->sink(writer->user, writer->buffer, writer->used) != WS_OK) {
+        WS_JSON_LOG_ERROR("Json writer sink failed\n");
+        writer->error = WS_ERROR;
+    }
+    writer->used = 0;
+}
+
+static void _wsJsonWriterPutSlow(wsJsonWriter* writer, const char* data, size_t size) {
+    switch (writer->type) {
+        case WS_JSON_WRITER_FIXED: {
+            size_t fits = writer->capacity - writer->used;
+            if (fits > size) fits = size;
+            if (fits) memcpy(writer->buffer + writer->used, data, fits);
+            writer->used += fits;
+            break;
+        }
+        case WS_JSON_WRITER_GROWABLE: {
+            size_t newCap = writer->capacity * 2;
+            while (newCap < writer->used + size) newCap *= 2;
+            char* buffer = _wsJsonRealloc(writer->buffer, newCap + 1);
+            if (!buffer) {
+                WS_JSON_LOG_ERROR("Failed to grow json writer buffer\n");
+                writer->error = WS_ERROR;
+                return;
+            }
+            writer->buffer = buffer;
+            writer->capacity = newCap;
+            memcpy(writer->buffer + writer->used, data, size);
+            writer->used += size;
+            break;
+        }
+        case WS_JSON_WRITER_SINK:
+            while (size > 0 && !writer->error) {
+                size_t fits = writer->capacity - writer->used;
+                if (fits > size) fits = size;
+                memcpy(writer->buffer + writer->used, data, fits);
+                writer->used += fits;
+                data += fits;
+                size -= fits;
+                if (writer->used == writer->capacity) _wsJsonWriterFlush(writer);
+            }
+            break;
+    }
+}
+
+static inline void _wsJsonWriterPut(wsJsonWriter* writer, const char* data, size_t size) {
+    writer->length += size;
+    if (writer->capacity - writer->used >= size) {
+        memcpy(writer->buffer + writer->used, data, size);
+        writer->used += size;
+        return;
+    }
+    _wsJsonWriterPutSlow(writer, data, size);
+}
+
+static inline void _wsJsonWriterPutChar(wsJsonWriter* writer, char c) {
+    if (writer->used < writer->capacity) {
+        writer->buffer[writer->used++] = c;
+        writer->length++;
+        return;
+    }
+    _wsJsonWriterPut(writer, &c, 1);
+}
+
+static void _wsJsonWriterIndent(wsJsonWriter* writer, int32_t indent) {
+    static const char spaces[] = "                                ";
+    while (indent > 0) {
+        int32_t count = indent < (int32_t)sizeof(spaces) - 1 ? indent : (int32_t)sizeof(spaces) - 1;
+        _wsJsonWriterPut(writer, spaces, count);
+        indent -= count;
+    }
+}
+
+static void _wsJsonWriteNumber(wsJsonWriter* writer, wsJson* obj) {
+    char digits[32];
+    int32_t length;
+    if (obj->flags & WS_JSON_FLAG_INTEGER) length = _wsJsonFormatInteger(obj->integerValue, digits);
+    else length = _wsJsonFormatDouble(obj->numberValue, digits);
+    _wsJsonWriterPut(writer, digits, length);
+}
+
+static void _wsJsonWriteKey(wsJsonWriter* writer, wsJson* child) {
+    _wsJsonWriterPutChar(writer, '"');
+    _wsJsonWriterPut(writer, child->key, child->keyLength);
+    _wsJsonWriterPut(writer, "\": ", 3);
+}
+
+// Writes the scalar types, returns false for objects and arrays
+static bool _wsJsonWriteScalar(wsJsonWriter* writer, wsJson* obj) {
+    switch (obj->type) {
+        case WS_JSON_STRING:
+            _wsJsonWriterPutChar(writer, '"');
+            _wsJsonWriterPut(writer, obj->stringValue, obj->stringLength);
+            _wsJsonWriterPutChar(writer, '"');
+            return true;
+        case WS_JSON_NUMBER:
+            _wsJsonWriteNumber(writer, obj);
+            return true;
+        case WS_JSON_BOOL:
+            if (obj->boolValue) _wsJsonWriterPut(writer, "true", 4);
+            else _wsJsonWriterPut(writer, "false", 5);
+            return true;
+        case WS_JSON_NULL:
+            _wsJsonWriterPut(writer, "null", 4);
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* 
+ *  Nesting stacks
+ *  The parser and the serializer keep their path through the document in an 
+ *  explicit stack instead of recursing, so deep documents can't overflow 
+ *  small thread stacks. The first levels live in an inline buffer of the 
+ *  caller, deeper ones move to the heap.
+ */
+#define _WS_JSON_INLINE_DEPTH (WS_JSON_MAX_DEPTH < 32 ? WS_JSON_MAX_DEPTH : 32)
+
+static int32_t _wsJsonStackGrow(void** stack, void* inlineStack, int32_t* capacity, size_t itemSize) {
+    if (*capacity >= WS_JSON_MAX_DEPTH) {
+        WS_JSON_LOG_ERROR("Json nesting is deeper than WS_JSON_MAX_DEPTH (%d)\n", WS_JSON_MAX_DEPTH);
+        return WS_ERROR;
+    }
+    int32_t newCap = *capacity * 2 < WS_JSON_MAX_DEPTH ? *capacity * 2 : WS_JSON_MAX_DEPTH;
+    void* grown;
+    if (*stack == inlineStack) {
+        grown = _wsJsonMalloc(itemSize * newCap);
+        if (grown) memcpy(grown, inlineStack, itemSize * *capacity);
+    }
+    else {
+        grown = _wsJsonRealloc(*stack, itemSize * newCap);
+    }
+    if (!grown) {
+        WS_JSON_LOG_ERROR("Failed to grow json nesting stack\n");
+        return WS_ERROR;
+    }
+    *stack = grown;
+    *capacity = newCap;
+    return WS_OK;
+}
+
+typedef struct _wsJsonWriteFrame {
+    wsJson* node;
+    int32_t index; // next child to write
+} _wsJsonWriteFrame;
+
+static inline void _wsJsonWriteOpen(wsJsonWriter* writer, wsJson* obj, bool pretty) {
+    char open = obj->type == WS_JSON_OBJECT ? '{' : '[';
+    _wsJsonWriterPutChar(writer, open);
+    if (pretty) _wsJsonWriterPutChar(writer, '\n');
+}
+
+// Compact and pretty serializer, indent is the level the value starts at
+static int32_t _wsJsonWriteTree(wsJsonWriter* writer, wsJson* obj, bool pretty, int32_t indent) {
+    if (_wsJsonWriteScalar(writer, obj)) return WS_OK;
+    if (obj->type != WS_JSON_OBJECT && obj->type != WS_JSON_ARRAY) {
+        WS_JSON_LOG_ERROR("Failed to parse json into string\n");
+        return WS_ERROR;
+    }
+
+    _wsJsonWriteFrame inlineStack[_WS_JSON_INLINE_DEPTH];
+    _wsJsonWriteFrame* stack = inlineStack;
+    int32_t capacity = _WS_JSON_INLINE_DEPTH;
+    int32_t depth = 1;
+    int32_t result = WS_OK;
+    stack[0].node = obj;
+    stack[0].index = 0;
+    _wsJsonWriteOpen(writer, obj, pretty);
+
+    while (depth > 0) {
+        _wsJsonWriteFrame* frame = &stack[depth - 1];
+        wsJson* node = frame->node;
+        bool object = node->type == WS_JSON_OBJECT;
+        int32_t count = object ? node->object.childCount : node->array.elementCount;
+
+        if (frame->index == count) {
+            if (pretty) {
+                _wsJsonWriterPutChar(writer, '\n');
+                _wsJsonWriterIndent(writer, indent + (depth - 1) * 4);
+            }
+            _wsJsonWriterPutChar(writer, object ? '}' : ']');
+            depth--;
+            continue;
+        }
+
+        wsJson* child = object ? node->object.children[frame->index] : node->array.elements[frame->index];
+        if (frame->index++ > 0) {
+            if (pretty) _wsJsonWriterPut(writer, ",\n", 2);
+            else _wsJsonWriterPutChar(writer, ',');
+        }
+        if (pretty) _wsJsonWriterIndent(writer, indent + depth * 4);
+        if (object) _wsJsonWriteKey(writer, child);
+        if (_wsJsonWriteScalar(writer, child)) continue;
+
+        if (child->type != WS_JSON_OBJECT && child->type != WS_JSON_ARRAY) {
+            WS_JSON_LOG_ERROR("Failed to parse json into string\n");
+            result = WS_ERROR;
+            break;
+        }
+        if (depth == capacity && _wsJsonStackGrow((void**)&stack, inlineStack, &capacity, sizeof(_wsJsonWriteFrame)) != WS_OK) {
+            result = WS_ERROR;
+            break;
+        }
+        stack[depth].node = child;
+        stack[depth].index = 0;
+        depth++;
+        _wsJsonWriteOpen(writer, child, pretty);
+    }
+
+    if (stack != inlineStack) _wsJsonFree(stack);
+    return result;
+}
+
+static int32_t _wsJsonWriteValue(wsJsonWriter* writer, wsJson* obj) {
+    return _wsJsonWriteTree(writer, obj, false, 0);
+}
+
+static int32_t _wsJsonWritePrettyValue(wsJsonWriter* writer, wsJson* obj, int32_t indent) {
+    return _wsJsonWriteTree(writer, obj, true, indent);
+}
+
+static int32_t _wsJsonWriterFinish(wsJsonWriter* writer, int32_t result) {
+    if (writer->type == WS_JSON_WRITER_SINK) _wsJsonWriterFlush(writer);
+    else if (writer->buffer) writer->buffer[writer->used] = '\0';
+    if (writer->error) return WS_ERROR;
+    return result;
+}
+
+int32_t wsJsonWrite(wsJsonWriter* writer, wsJson* obj) {
+    if (!writer || !obj) {
+        WS_JSON_LOG_ERROR("Invalid JSON or writer\n");
+        return WS_ERROR;
+    }
+    _WS_JSON_STATS_START(start);
+    size_t length = writer->length;
+    int32_t result = _wsJsonWriterFinish(writer, _wsJsonWriteValue(writer, obj));
+    _WS_JSON_STATS_TIME(serialize, start, writer->length - length);
+    return result;
+}
+
+int32_t wsJsonWritePretty(wsJsonWriter* writer, wsJson* obj) {
+    if (!writer || !obj) {
+        WS_JSON_LOG_ERROR("Invalid JSON or writer\n");
+        return WS_ERROR;
+    }
+    _WS_JSON_STATS_START(start);
+    size_t length = writer->length;
+    int32_t result = _wsJsonWriterFinish(writer, _wsJsonWritePrettyValue(writer, obj, 0));
+    _WS_JSON_STATS_TIME(serialize, start, writer->length - length);
+    return result;
+}
+
+int32_t wsJsonToString(wsJson *obj, char *out, size_t size) {
+    if (!obj) {
+        WS_JSON_LOG_ERROR("Input json obj is NULL\n");
+        return WS_ERROR;
+    }
+    
+    wsJsonWriter writer;
+    wsJsonWriterInitFixed(&writer, out, size);
+    if (wsJsonWrite(&writer, obj) != WS_OK) return WS_ERROR;
+    return (int32_t)writer.length;
+}
+
+int32_t wsJsonToStringPretty(wsJson *obj, char *out, size_t size) {
+    if (!obj) {
+        WS_JSON_LOG_ERROR("Input json obj is NULL\n");
+        return WS_ERROR;
+    }
+
+    wsJsonWriter writer;
+    wsJsonWriterInitFixed(&writer, out, size);
+    if (wsJsonWritePretty(&writer, obj) != WS_OK) return WS_ERROR;
+    return (int32_t)writer.length;
+}
+
+/* SIMD */
+#if !defined(WS_JSON_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64)) && (defined(__GNUC__) || defined(__clang__))
+    #define WS_JSON_SIMD_X86
+    #include <immintrin.h>
+#elif !defined(WS_JSON_NO_SIMD) && defined(__ARM_NEON)
+    #define WS_JSON_SIMD_NEON_IMPL
+    #include <arm_neon.h>
+#endif
+
+// The vector paths use unaligned loads (loadu / vld1q), the input can start at any address. 
+// They only load whole blocks in front of end and the tail goes byte by byte (the tape copies 
+// it into a padded block), so no load reaches past end into a page that may not be mapped.
+#if defined(__GNUC__) || defined(__clang__)
+    #define WS_JSON_CTZ(mask) __builtin_ctz(mask)
+    #define WS_JSON_CTZ64(mask) __builtin_ctzll(mask)
+#else
+    static inline int32_t _wsJsonCtz64(uint64_t mask) {
+        int32_t count = 0;
+        while (!(mask & 1)) {
+            mask >>= 1;
+            count++;
+        }
+        return count;
+    }
+    #define WS_JSON_CTZ(mask) _wsJsonCtz64(mask)
+    #define WS_JSON_CTZ64(mask) _wsJsonCtz64(mask)
+#endif
+
+typedef const char* (*_wsJsonScanFn)(const char* string, const char* end);
+
+// Scalar reference path
+static const char* _wsJsonSkipWhitespaceScalar(const char* string, const char* end) {
+    while (string < end && isspace((unsigned char)*string)) string++;
+    return string;
+}
+
+// Stops at the next '"', '\\' or end
+static const char* _wsJsonScanStringScalar(const char* string, const char* end) {
+    while (string < end && *string != '"' && *string != '\\') string++;
+    return string;
+}
+
+#ifdef WS_JSON_SIMD_X86
+// Whitespace is ' ' and '\t'..'\r' like isspace in the C locale
+static const char* _wsJsonSkipWhitespaceSse2(const char* string, const char* end) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i range = _mm_set1_epi8(4);
+
+    while (end - string >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)string);
+        __m128i isSpace = _mm_cmpeq_epi8(chunk, space);
+        __m128i isControl = _mm_cmpeq_epi8(_mm_subs_epu8(_mm_sub_epi8(chunk, tab), range), _mm_setzero_si128());
+        uint32_t mask = ~(uint32_t)_mm_movemask_epi8(_mm_or_si128(isSpace, isControl)) & 0xFFFF;
+        if (mask) return string + WS_JSON_CTZ(mask);
+        string += 16;
+    }
+    return _wsJsonSkipWhitespaceScalar(string, end);
+}
+
+static const char* _wsJsonScanStringSse2(const char* string, const char* end) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+
+    while (end - string >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)string);
+        __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(hits);
+        if (mask) return string + WS_JSON_CTZ(mask);
+        string += 16;
+    }
+    return _wsJsonScanStringScalar(string, end);
+}
+
+__attribute__((target("avx2"))) static const char* _wsJsonSkipWhitespaceAvx2(const char* string, const char* end) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i range = _mm256_set1_epi8(4);
+
+    while (end - string >= 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)string);
+        __m256i isSpace = _mm256_cmpeq_epi8(chunk, space);
+        __m256i isControl = _mm256_cmpeq_epi8(_mm256_subs_epu8(_mm256_sub_epi8(chunk, tab), range), _mm256_setzero_si256());
+        uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(_mm256_or_si256(isSpace, isControl));
+        if (mask) return string + WS_JSON_CTZ(mask);
+        string += 32;
+    }
+    return _wsJsonSkipWhitespaceSse2(string, end);
+}
+
+__attribute__((target("avx2"))) static const char* _wsJsonScanStringAvx2(const char* string, const char* end) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+
+    while (end - string >= 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)string);
+        __m256i hits = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote), _mm256_cmpeq_epi8(chunk, backslash));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(hits);
+        if (mask) return string + WS_JSON_CTZ(mask);
+        string += 32;
+    }
+    return _wsJsonScanStringSse2(string, end);
+}
+#endif // WS_JSON_SIMD_X86
+
+#ifdef WS_JSON_SIMD_NEON_IMPL
+// NEON has no movemask, narrowing the compare result gives 4 bits per byte instead
+static inline uint64_t _wsJsonNeonMask(uint8x16_t hits) {
+    return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hits), 4)), 0);
+}
+
+static const char* _wsJsonSkipWhitespaceNeon(const char* string, const char* end) {
+    const uint8x16_t space = vdupq_n_u8(' ');
+    const uint8x16_t tab = vdupq_n_u8('\t');
+    const uint8x16_t range = vdupq_n_u8(4);
+
+    while (end - string >= 16) {
+        uint8x16_t chunk = vld1q_u8((const uint8_t*)string);
+        uint8x16_t isSpace = vorrq_u8(vceqq_u8(chunk, space), vcleq_u8(vsubq_u8(chunk, tab), range));
+        uint64_t mask = ~_wsJsonNeonMask(isSpace);
+        if (mask) return string + (WS_JSON_CTZ64(mask) >> 2);
+        string += 16;
+    }
+    return _wsJsonSkipWhitespaceScalar(string, end);
+}
+
+static const char* _wsJsonScanStringNeon(const char* string, const char* end) {
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t backslash = vdupq_n_u8('\\');
+
+    while (end - string >= 16) {
+        uint8x16_t chunk = vld1q_u8((const uint8_t*)string);
+        uint8x16_t hits = vorrq_u8(vceqq_u8(chunk, quote), vceqq_u8(chunk, backslash));
+        uint64_t mask = _wsJsonNeonMask(hits);
+        if (mask) return string + (WS_JSON_CTZ64(mask) >> 2);
+        string += 16;
+    }
+    return _wsJsonScanStringScalar(string, end);
+}
+#endif // WS_JSON_SIMD_NEON_IMPL
+
+static const char* _wsJsonSkipWhitespaceDispatch(const char* string, const char* end);
+static const char* _wsJsonScanStringDispatch(const char* string, const char* end);
+
+// Tape stage 1, one bit per byte of a 64 byte block for each character class
+typedef struct _wsJsonBlockMasks {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t op;    // { } [ ] : ,
+    uint64_t space; // json whitespace
+} _wsJsonBlockMasks;
+
+typedef void (*_wsJsonClassifyFn)(const char* block, _wsJsonBlockMasks* masks);
+
+static void _wsJsonClassifyScalar(const char* block, _wsJsonBlockMasks* masks) {
+    memset(masks, 0, sizeof(_wsJsonBlockMasks));
+    for (int32_t i = 0; i < 64; i++) {
+        uint64_t bit = 1ULL << i;
+        switch (block[i]) {
+            case '"': masks->quote |= bit; break;
+            case '\\': masks->backslash |= bit; break;
+            case '{': case '}': case '[': case ']': case ':': case ',': masks->op |= bit; break;
+            case ' ': case '\t': case '\n': case '\r': masks->space |= bit; break;
+            default: break;
+        }
+    }
+}
+
+#ifdef WS_JSON_SIMD_X86
+static void _wsJsonClassifySse2(const char* block, _wsJsonBlockMasks* masks) {
+    memset(masks, 0, sizeof(_wsJsonBlockMasks));
+    for (int32_t i = 0; i < 4; i++) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(block + i * 16));
+        // '[' and ']' only differ from '{' and '}' in bit 5
+        __m128i folded = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+        __m128i op = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')), _mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))),
+                                  _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(':')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8(','))));
+        __m128i space = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'))),
+                                     _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r'))));
+        int32_t shift = i * 16;
+        masks->quote |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('"'))) << shift;
+        masks->backslash |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\'))) << shift;
+        masks->op |= (uint64_t)(uint32_t)_mm_movemask_epi8(op) << shift;
+        masks->space |= (uint64_t)(uint32_t)_mm_movemask_epi8(space) << shift;
+    }
+}
+
+__attribute__((target("avx2"))) static void _wsJsonClassifyAvx2(const char* block, _wsJsonBlockMasks* masks) {
+    memset(masks, 0, sizeof(_wsJsonBlockMasks));
+    for (int32_t i = 0; i < 2; i++) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)(block + i * 32));
+        __m256i folded = _mm256_or_si256(chunk, _mm256_set1_epi8(0x20));
+        __m256i op = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(folded, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('}'))),
+                                     _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(':')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(','))));
+        __m256i space = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\t'))),
+                                        _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\r'))));
+        int32_t shift = i * 32;
+        masks->quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('"'))) << shift;
+        masks->backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\\'))) << shift;
+        masks->op |= (uint64_t)(uint32_t)_mm256_movemask_epi8(op) << shift;
+        masks->space |= (uint64_t)(uint32_t)_mm256_movemask_epi8(space) << shift;
+    }
+}
+#endif // WS_JSON_SIMD_X86
+
+#if defined(WS_JSON_SIMD_NEON_IMPL) && defined(__aarch64__)
+// 64 compare results to one bit each, weighting the bytes and adding neighbours up
+static inline uint64_t _wsJsonNeonMask64(uint8x16_t a, uint8x16_t b, uint8x16_t c, uint8x16_t d) {
+    static const uint8_t weights[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    const uint8x16_t bits = vld1q_u8(weights);
+    uint8x16_t sum0 = vpaddq_u8(vandq_u8(a, bits), vandq_u8(b, bits));
+    uint8x16_t sum1 = vpaddq_u8(vandq_u8(c, bits), vandq_u8(d, bits));
+    sum0 = vpaddq_u8(sum0, sum1);
+    sum0 = vpaddq_u8(sum0, sum0);
+    return vgetq_lane_u64(vreinterpretq_u64_u8(sum0), 0);
+}
+
+static void _wsJsonClassifyNeon(const char* block, _wsJsonBlockMasks* masks) {
+    uint8x16_t quote[4], backslash[4], op[4], space[4];
+    for (int32_t i = 0; i < 4; i++) {
+        uint8x16_t chunk = vld1q_u8((const uint8_t*)block + i * 16);
+        uint8x16_t folded = vorrq_u8(chunk, vdupq_n_u8(0x20));
+        quote[i] = vceqq_u8(chunk, vdupq_n_u8('"'));
+        backslash[i] = vceqq_u8(chunk, vdupq_n_u8('\\'));
+        op[i] = vorrq_u8(vorrq_u8(vceqq_u8(folded, vdupq_n_u8('{')), vceqq_u8(folded, vdupq_n_u8('}'))),
+                         vorrq_u8(vceqq_u8(chunk, vdupq_n_u8(':')), vceqq_u8(chunk, vdupq_n_u8(','))));
+        space[i] = vorrq_u8(vorrq_u8(vceqq_u8(chunk, vdupq_n_u8(' ')), vceqq_u8(chunk, vdupq_n_u8('\t'))),
+                            vorrq_u8(vceqq_u8(chunk, vdupq_n_u8('\n')), vceqq_u8(chunk, vdupq_n_u8('\r'))));
+    }
+    masks->quote = _wsJsonNeonMask64(quote[0], quote[1], quote[2], quote[3]);
+    masks->backslash = _wsJsonNeonMask64(backslash[0], backslash[1], backslash[2], backslash[3]);
+    masks->op = _wsJsonNeonMask64(op[0], op[1], op[2], op[3]);
+    masks->space = _wsJsonNeonMask64(space[0], space[1], space[2], space[3]);
+}
+#endif
+
+static void _wsJsonClassifyDispatch(const char* block, _wsJsonBlockMasks* masks);
+
+/* 
+ *  Dispatch
+ *  The parsers load the functions relaxed, every implementation gives the 
+ *  same results so a thread that still sees an older one is fine. The level 
+ *  is stored with release after the functions, a thread that acquires it 
+ *  sees them. The automatic level is picked once through call_once.
+ */
+static _Atomic(_wsJsonClassifyFn) _wsJsonClassifyImpl = _wsJsonClassifyDispatch;
+static _Atomic(_wsJsonScanFn) _wsJsonSkipWhitespaceImpl = _wsJsonSkipWhitespaceDispatch;
+static _Atomic(_wsJsonScanFn) _wsJsonScanStringImpl = _wsJsonScanStringDispatch;
+static _Atomic(wsJsonSimdLevel) _wsJsonSimdLevel = WS_JSON_SIMD_AUTO;
+static once_flag _wsJsonSimdOnce = ONCE_FLAG_INIT;
+
+static bool _wsJsonSimdSupported(wsJsonSimdLevel level) {
+    switch (level) {
+        case WS_JSON_SIMD_AUTO:
+        case WS_JSON_SIMD_SCALAR:
+            return true;
+#ifdef WS_JSON_SIMD_X86
+        case WS_JSON_SIMD_SSE2:
+            return true;
+        case WS_JSON_SIMD_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+#ifdef WS_JSON_SIMD_NEON_IMPL
+        case WS_JSON_SIMD_NEON:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+static void _wsJsonSimdUse(wsJsonSimdLevel level) {
+    _wsJsonScanFn skipWhitespace, scanString;
+    _wsJsonClassifyFn classify;
+    switch (level) {
+#ifdef WS_JSON_SIMD_X86
+        case WS_JSON_SIMD_SSE2:
+            skipWhitespace = _wsJsonSkipWhitespaceSse2;
+            scanString = _wsJsonScanStringSse2;
+            classify = _wsJsonClassifySse2;
+            break;
+        case WS_JSON_SIMD_AVX2:
+            skipWhitespace = _wsJsonSkipWhitespaceAvx2;
+            scanString = _wsJsonScanStringAvx2;
+            classify = _wsJsonClassifyAvx2;
+            break;
+#endif
+#ifdef WS_JSON_SIMD_NEON_IMPL
+        case WS_JSON_SIMD_NEON:
+            skipWhitespace = _wsJsonSkipWhitespaceNeon;
+            scanString = _wsJsonScanStringNeon;
+#ifdef __aarch64__
+            classify = _wsJsonClassifyNeon;
+#else
+            classify = _wsJsonClassifyScalar;
+#endif
+            break;
+#endif
+        default:
+            skipWhitespace = _wsJsonSkipWhitespaceScalar;
+            scanString = _wsJsonScanStringScalar;
+            classify = _wsJsonClassifyScalar;
+            break;
+    }
+    atomic_store_explicit(&_wsJsonSkipWhitespaceImpl, skipWhitespace, memory_order_relaxed);
+    atomic_store_explicit(&_wsJsonScanStringImpl, scanString, memory_order_relaxed);
+    atomic_store_explicit(&_wsJsonClassifyImpl, classify, memory_order_relaxed);
+    atomic_store_explicit(&_wsJsonSimdLevel, level, memory_order_release);
+}
+
+static wsJsonSimdLevel _wsJsonSimdBest(void) {
+    wsJsonSimdLevel level = WS_JSON_SIMD_SCALAR;
+    if (_wsJsonSimdSupported(WS_JSON_SIMD_NEON)) level = WS_JSON_SIMD_NEON;
+    if (_wsJsonSimdSupported(WS_JSON_SIMD_SSE2)) level = WS_JSON_SIMD_SSE2;
+    if (_wsJsonSimdSupported(WS_JSON_SIMD_AVX2)) level = WS_JSON_SIMD_AVX2;
+    return level;
+}
+
+// Leaves a level that got set before the first parse alone
+static void _wsJsonSimdInit(void) {
+    if (atomic_load_explicit(&_wsJsonSimdLevel, memory_order_acquire) == WS_JSON_SIMD_AUTO) {
+        _wsJsonSimdUse(_wsJsonSimdBest());
+    }
+}
+
+int32_t wsJsonSetSimdLevel(wsJsonSimdLevel level) {
+    if (!_wsJsonSimdSupported(level)) {
+        WS_JSON_LOG_WARNING("Simd level %s is not supported\n", wsJsonSimdLevelToString(level));
+        return WS_ERROR;
+    }
+    _wsJsonSimdUse(level == WS_JSON_SIMD_AUTO ? _wsJsonSimdBest() : level);
+    return WS_OK;
+}
+
+wsJsonSimdLevel wsJsonGetSimdLevel(void) {
+    wsJsonSimdLevel level = atomic_load_explicit(&_wsJsonSimdLevel, memory_order_acquire);
+    if (level != WS_JSON_SIMD_AUTO) return level;
+    call_once(&_wsJsonSimdOnce, _wsJsonSimdInit);
+    return atomic_load_explicit(&_wsJsonSimdLevel, memory_order_acquire);
+}
+
+const char* wsJsonSimdLevelToString(wsJsonSimdLevel level) {
+    switch (level) {
+        case WS_JSON_SIMD_AUTO:     return "auto";
+        case WS_JSON_SIMD_SCALAR:   return "scalar";
+        case WS_JSON_SIMD_SSE2:     return "sse2";
+        case WS_JSON_SIMD_AVX2:     return "avx2";
+        case WS_JSON_SIMD_NEON:     return "neon";
+        default:                    return "unknown";
+    }
+}
+
+// First call picks the implementation
+static const char* _wsJsonSkipWhitespaceDispatch(const char* string, const char* end) {
+    wsJsonGetSimdLevel();
+    return atomic_load_explicit(&_wsJsonSkipWhitespaceImpl, memory_order_relaxed)(string, end);
+}
+
+static const char* _wsJsonScanStringDispatch(const char* string, const char* end) {
+    wsJsonGetSimdLevel();
+    return atomic_load_explicit(&_wsJsonScanStringImpl, memory_order_relaxed)(string, end);
+}
+
+static void _wsJsonClassifyDispatch(const char* block, _wsJsonBlockMasks* masks) {
+    wsJsonGetSimdLevel();
+    atomic_load_explicit(&_wsJsonClassifyImpl, memory_order_relaxed)(block, masks);
+}
+
+static inline bool _wsJsonIsSpace(char c) {
+    return c == ' ' || (unsigned char)(c - '\t') <= 4;
+}
+
+static const char* skipWhitespaces(const char* string, const char* end) {
+    // Most calls sit on a structural character or a single space already
+    if (string == end || !_wsJsonIsSpace(*string)) return string;
+    if (string + 1 == end || !_wsJsonIsSpace(string[1])) return string + 1;
+    return atomic_load_explicit(&_wsJsonSkipWhitespaceImpl, memory_order_relaxed)(string + 2, end);
+}
+
+// Current character or NUL at the end of the input
+static inline char parsePeek(const char* string, const char* end) {
+    return string < end ? *string : '\0';
+}
+
+static inline bool parseLiteral(const char* string, const char* end, const char* literal, size_t length) {
+    return (size_t)(end - string) >= length && memcmp(string, literal, length) == 0;
+}
+
+// Returns the start of the string content and its length without copying
+static const char* parseString(const char** string, const char* end, size_t* length) {
+    (*string)++; // skip "
+    const char* start = *string;
+
+    // Find end (also handle escape sequences)
+    for (;;) {
+        *string = atomic_load_explicit(&_wsJsonScanStringImpl, memory_order_relaxed)(*string, end);
+        if (parsePeek(*string, end) != '\\') break;
+        (*string)++;
+        if (*string < end) (*string)++;
+    }
+    *length = *string - start;
+
+    if (parsePeek(*string, end) == '"') (*string)++; // skip closing " 
+    return start;
+}
+
+// Internal parse flag, views get NUL terminated by overwriting the closing quote
+#define _WS_JSON_PARSE_IN_SITU 0x80
+
+// Turns a parsed string into a view (or a copy when not parsing with views)
+static char* parseView(wsJson* node, const char* string, size_t length, uint32_t flags) {
+    if (!(flags & WS_JSON_PARSE_VIEWS)) return _wsJsonNodeStrndup(node, string, length);
+
+    if (flags & _WS_JSON_PARSE_IN_SITU) ((char*)string)[length] = '\0';
+    else node->flags |= WS_JSON_FLAG_NO_TERMINATOR;
+    return (char*)string;
+}
+
+static wsJson* parseAllocNode(wsJsonType type, const char* key, size_t keyLen, uint32_t flags) {
+    if (!key || !(flags & WS_JSON_PARSE_VIEWS)) return _wsJsonAllocNode(type, key, keyLen);
+
+    wsJson* node = _wsJsonAllocNode(type, NULL, 0);
+    if (!node) return NULL;
+    node->key = parseView(node, key, keyLen, flags);
+    node->keyLength = (uint32_t)keyLen;
+    return node;
+}
+
+// Strings, numbers, bools and null, the key is allocated together with the node
+static wsJson* parseScalar(const char** string, const char* end, const char* key, size_t keyLen, uint32_t flags) {
+    char c = parsePeek(*string, end);
+
+    // Is String 
+    if (c == '"') {
+        size_t valLen;
+        const char* val = parseString(string, end, &valLen);
+        wsJson* node = parseAllocNode(WS_JSON_STRING, key, keyLen, flags);
+        if (!node) {
+            WS_JSON_LOG_ERROR("Failed to allocate json node when parsing string\n");
+            return NULL;
+        }
+        if (flags & WS_JSON_PARSE_VIEWS) node->flags |= WS_JSON_FLAG_STRING_VIEW;
+        node->stringValue = parseView(node, val, valLen, flags);
+        node->stringLength = (uint32_t)valLen;
+        if (!node->stringValue) {
+            WS_JSON_LOG_ERROR("Failed to parse json value when parsing string\n");
+            wsJsonFree(node);
+            return NULL;
+        }
+        return node;
+    }
+
+    // Is Digit 
+    else if (isdigit((unsigned char)c) || c == '-') {
+        double num;
+        int64_t integer;
+        bool isInteger;
+        const char* endPtr = _wsJsonParseNumber(*string, end, &num, &integer, &isInteger);
+        if (!endPtr) {
+            WS_JSON_LOG_ERROR("Failed to parse json number\n");
+            return NULL;
+        }
+        wsJson* node = parseAllocNode(WS_JSON_NUMBER, key, keyLen, flags);
+        if (!node) {
+            WS_JSON_LOG_ERROR("Failed to allocate json node when parsing string\n");
+            return NULL;
+        }
+        node->numberValue = num;
+        if (isInteger) {
+            node->flags |= WS_JSON_FLAG_INTEGER;
+            node->integerValue = integer;
+        }
+        *string = endPtr;
+        return node;
+    }
+
+    // Is Bool (true)
+    else if (parseLiteral(*string, end, "true", 4)) {
+        wsJson* node = parseAllocNode(WS_JSON_BOOL, key, keyLen, flags);
+        if (!node) {
+            WS_JSON_LOG_ERROR("Failed to allocate json node when parsing string\n");
+            return NULL;
+        }
+        node->boolValue = true;
+        *string += 4;
+        return node;
+    }
+
+    // Is Bool (false)
+    else if (parseLiteral(*string, end, "false", 5)) {
+        wsJson* node = parseAllocNode(WS_JSON_BOOL, key, keyLen, flags);
+        if (!node) {
+            WS_JSON_LOG_ERROR("Failed to allocate json node when parsing string\n");
+            return NULL;
+        }
+        node->boolValue = false;
+        *string += 5;
+        return node;
+    }
+
+    // Is Null
+    else if (parseLiteral(*string, end, "null", 4)) {
+        wsJson* node = parseAllocNode(WS_JSON_NULL, key, keyLen, flags);
+        if (!node) {
+            WS_JSON_LOG_ERROR("Failed to allocate json node when parsing null\n");
+            return NULL;
+        }
+        *string += 4;
+        return node;
+    }
+
+    return NULL;
+}
+
+// Parses the object or array at *string. Open containers are kept on an explicit 
+// stack and get linked into their parent right away, so on errors freeing the 
+// root releases everything.
+static wsJson* parseNested(const char** string, const char* end, const char* key, size_t keyLen, uint32_t flags) {
+    wsJson* inlineStack[_WS_JSON_INLINE_DEPTH];
+    wsJson** stack = inlineStack;
+    int32_t capacity = _WS_JSON_INLINE_DEPTH;
+    int32_t depth = 0;
+    wsJson* root = NULL;
+
+    for (;;) {
+        // Open the container at *string
+        bool object = **string == '{';
+        if (depth == capacity && _wsJsonStackGrow((void**)&stack, inlineStack, &capacity, sizeof(wsJson*)) != WS_OK) goto fail;
+        wsJson* container = parseAllocNode(object ? WS_JSON_OBJECT : WS_JSON_ARRAY, key, keyLen, flags);
+        if (!container) {
+            WS_JSON_LOG_ERROR(object ? "Failed to allocate json object\n" : "Failed to allocate json array\n");
+            goto fail;
+        }
+        if (depth == 0) root = container;
+        else if (stack[depth - 1]->type == WS_JSON_OBJECT) wsJsonAddField(stack[depth - 1], container);
+        else wsJsonAddElement(stack[depth - 1], container);
+        stack[depth++] = container;
+        (*string)++;
+
+        // Read members until a nested container starts
+        for (;;) {
+            wsJson* parent = stack[depth - 1];
+            object = parent->type == WS_JSON_OBJECT;
+            *string = skipWhitespaces(*string, end);
+            if (*string == end) {
+                WS_JSON_LOG_ERROR(object ? "Failed to parse object: missing '}'\n" : "Failed to parse array: missing ']'\n");
+                goto fail;
+            }
+            if (**string == (object ? '}' : ']')) {
+                (*string)++;
+                if (--depth == 0) goto done;
+                *string = skipWhitespaces(*string, end);
+                if (parsePeek(*string, end) == ',') (*string)++;
+                continue;
+            }
+
+            key = NULL;
+            keyLen = 0;
+            if (object) {
+                // read key
+                if (**string != '"') {
+                    WS_JSON_LOG_ERROR("Failed to parse json key\n");
+                    goto fail;
+                }
+                key = parseString(string, end, &keyLen);
+
+                *string = skipWhitespaces(*string, end);
+                if (parsePeek(*string, end) != ':') goto fail;
+                (*string)++;
+            }
+
+            // Read value
+            *string = skipWhitespaces(*string, end);
+            char c = parsePeek(*string, end);
+            if (c == '{' || c == '[') break;
+
+            wsJson* value = parseScalar(string, end, key, keyLen, flags);
+            if (!value) {
+                WS_JSON_LOG_ERROR(object ? "Failed to parse json value\n" : "Failed to parse array element\n");
+                goto fail;
+            }
+            if (object) wsJsonAddField(parent, value);
+            else wsJsonAddElement(parent, value);
+
+            *string = skipWhitespaces(*string, end);
+            if (parsePeek(*string, end) == ',') (*string)++;
+        }
+    }
+
+done:
+    if (stack != inlineStack) _wsJsonFree(stack);
+    return root;
+
+fail:
+    if (root) wsJsonFree(root);
+    if (stack != inlineStack) _wsJsonFree(stack);
+    return NULL;
+}
+
+static wsJson* parseValue(const char** string, const char* end, const char* key, size_t keyLen, uint32_t flags) {
+    (*string) = skipWhitespaces(*string, end);
+    char c = parsePeek(*string, end);
+    if (c == '{' || c == '[') return parseNested(string, end, key, keyLen, flags);
+    return parseScalar(string, end, key, keyLen, flags);
+}
+
+static wsJson* parseObject(const char** string, const char* end, const char* key, size_t keyLen, uint32_t flags) {
+    *string = skipWhitespaces(*string, end);
+    if (parsePeek(*string, end) != '{') {
+        WS_JSON_LOG_ERROR("Failed to convert string to json\n");
+        return NULL;
+    }
+    return parseNested(string, end, key, keyLen, flags);
+}
+
+wsJson* wsStringToJson(const char** string) {
+    if (!string) {
+        WS_JSON_LOG_ERROR("Invalid input paramerter is NULL\n");
+        return NULL;
+    }
+    _WS_JSON_STATS_START(start);
+    size_t length = strlen(*string);
+    wsJson* root = parseObject(string, *string + length, NULL, 0, 0);
+    _WS_JSON_STATS_TIME(parse, start, length);
+    return root;
+}
+
+wsJson* wsStringToJsonEx(const char** string, uint32_t parseFlags) {
+    if (!string) {
+        WS_JSON_LOG_ERROR("Invalid input paramerter is NULL\n");
+        return NULL;
+    }
+    _WS_JSON_STATS_START(start);
+    size_t length = strlen(*string);
+    wsJson* root = parseObject(string, *string + length, NULL, 0, parseFlags & ~_WS_JSON_PARSE_IN_SITU);
+    _WS_JSON_STATS_TIME(parse, start, length);
+    return root;
+}
+
+wsJson* wsStringToJsonInSitu(char* string) {
+    if (!string) {
+        WS_JSON_LOG_ERROR("Invalid input paramerter is NULL\n");
+        return NULL;
+    }
+    _WS_JSON_STATS_START(start);
+    const char* cursor = string;
+    size_t length = strlen(string);
+    wsJson* root = parseObject(&cursor, string + length, NULL, 0, WS_JSON_PARSE_VIEWS | _WS_JSON_PARSE_IN_SITU);
+    _WS_JSON_STATS_TIME(parse, start, length);
+    return root;
+}
+
+static wsJson* parseDocument(const char* data, size_t length, uint32_t parseFlags) {
+    const char* end = data + length;
+    const char* cursor = skipWhitespaces(data, end);
+    char c = parsePeek(cursor, end);
+    if (c != '{' && c != '[') {
+        WS_JSON_LOG_ERROR("Failed to parse json: root has to be an object or an array\n");
+        return NULL;
+    }
+
+    wsJson* root = parseValue(&cursor, end, NULL, 0, parseFlags & ~_WS_JSON_PARSE_IN_SITU);
+    if (!root) return NULL;
+    if (skipWhitespaces(cursor, end) != end) {
+        WS_JSON_LOG_ERROR("Failed to parse json: unexpected data after the root\n");
+        wsJsonFree(root);
+        return NULL;
+    }
+    return root;
+}
+
+wsJson* wsJsonParse(const char* data, size_t length, uint32_t parseFlags) {
+    if (!data) {
+        WS_JSON_LOG_ERROR("Invalid input paramerter is NULL\n");
+        return NULL;
+    }
+    _WS_JSON_STATS_START(start);
+    wsJson* root = parseDocument(data, length, parseFlags);
+    _WS_JSON_STATS_TIME(parse, start, length);
+    return root;
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+// Read only private mapping of the whole file, NULL for empty files
+static void* _wsJsonMapFile(const char* path, size_t* length) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        WS_JSON_LOG_ERROR("Failed to open %s\n", path);
+        return NULL;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        WS_JSON_LOG_ERROR("Failed to read %s or it is empty\n", path);
+        close(fd);
+        return NULL;
+    }
+    *length = (size_t)info.st_size;
+    void* data = mmap(NULL, *length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        WS_JSON_LOG_ERROR("Failed to map %s\n", path);
+        return NULL;
+    }
+#ifdef MADV_SEQUENTIAL
+    madvise(data, *length, MADV_SEQUENTIAL);
+#endif
+    return data;
+}
+
+wsJsonFile* wsJsonParseFile(const char* path, uint32_t parseFlags) {
+    if (!path) {
+        WS_JSON_LOG_ERROR("Invalid input paramerter is NULL\n");
+        return NULL;
+    }
+
+    size_t length;
+    void* data = _wsJsonMapFile(path, &length);
+    if (!data) return NULL;
+
+    wsJsonFile* file = _wsJsonMalloc(sizeof(wsJsonFile));
+    if (!file) {
+        WS_JSON_LOG_ERROR("Failed to allocate json file\n");
+        munmap(data, length);
+        return NULL;
+    }
+    file->root = wsJsonParse(data, length, parseFlags);
+    file->data = data;
+    file->length = length;
+    if (!file->root) {
+        WS_JSON_LOG_ERROR("Failed to parse %s\n", path);
+        wsJsonFileFree(file);
+        return NULL;
+    }
+
+    // Copied documents don't need the mapping anymore
+    if (!(parseFlags & WS_JSON_PARSE_VIEWS)) {
+        munmap(data, length);
+        file->data = NULL;
+        file->length = 0;
+    }
+    return file;
+}
+
+void wsJsonFileFree(wsJsonFile* file) {
+    if (!file) return;
+    if (file->root) wsJsonFree(file->root);
+    if (file->data) munmap((void*)file->data, file->length);
+    _wsJsonFree(file);
+}
+#endif
+
+/* Binary formats */
+
+// Big endian value of size bytes behind a one byte prefix
+static void _wsJsonWriteBigEndian(wsJsonWriter* writer, uint8_t prefix, uint64_t value, int32_t size) {
+    unsigned char bytes[9];
+    bytes[0] = prefix;
+    for (int32_t i = 0; i < size; i++) bytes[size - i] = (unsigned char)(value >> (i * 8));
+    _wsJsonWriterPut(writer, (const char*)bytes, size + 1);
+}
+
+static uint64_t _wsJsonReadBigEndian(const uint8_t* bytes, int32_t size) {
+    uint64_t value = 0;
+    for (int32_t i = 0; i < size; i++) value = (value << 8) | bytes[i];
+    return value;
+}
+
+static uint32_t _wsJsonReadHex4(const char* string) {
+    uint32_t value = 0;
+    for (int32_t i = 0; i < 4; i++) {
+        char c = string[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9') value |= c - '0';
+        else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') value |= (c | 0x20) - 'a' + 10;
+        else return UINT32_MAX;
+    }
+    return value;
+}
+
+// Decodes the escape sequences of a json string into UTF-8, out needs length bytes.
+// Broken escapes are copied unchanged.
+static size_t _wsJsonUnescape(const char* string, size_t length, char* out) {
+    const char* end = string + length;
+    char* cursor = out;
+    while (string < end) {
+        const char* backslash = memchr(string, '\\', end - string);
+        if (!backslash) backslash = end;
+        memcpy(cursor, string, backslash - string);
+        cursor += backslash - string;
+        string = backslash;
+        if (string == end) break;
+        if (end - string < 2) {
+            *cursor++ = *string++;
+            continue;
+        }
+
+        char c = string[1];
+        const char* simple = strchr("\"\\/bfnrt", c);
+        if (simple && c) {
+            static const char decoded[] = "\"\\/\b\f\n\r\t";
+            *cursor++ = decoded[simple - "\"\\/bfnrt"];
+            string += 2;
+            continue;
+        }
+        uint32_t codepoint = c == 'u' && end - string >= 6 ? _wsJsonReadHex4(string + 2) : UINT32_MAX;
+        if (codepoint == UINT32_MAX) {
+            *cursor++ = *string++;
+            continue;
+        }
+        size_t used = 6;
+        if (codepoint >= 0xd800 && codepoint < 0xdc00 && end - string >= 12 && string[6] == '\\' && string[7] == 'u') {
+            uint32_t low = _wsJsonReadHex4(string + 8);
+            if (low >= 0xdc00 && low < 0xe000) {
+                codepoint = 0x10000 + ((codepoint - 0xd800) << 10) + (low - 0xdc00);
+                used = 12;
+            }
+        }
+        // Every encoding is shorter than its escape sequence
+        if (codepoint < 0x80) {
+            *cursor++ = (char)codepoint;
+        } else if (codepoint < 0x800) {
+            *cursor++ = (char)(0xc0 | (codepoint >> 6));
+            *cursor++ = (char)(0x80 | (codepoint & 0x3f));
+        } else if (codepoint < 0x10000) {
+            *cursor++ = (char)(0xe0 | (codepoint >> 12));
+            *cursor++ = (char)(0x80 | ((codepoint >> 6) & 0x3f));
+            *cursor++ = (char)(0x80 | (codepoint & 0x3f));
+        } else {
+            *cursor++ = (char)(0xf0 | (codepoint >> 18));
+            *cursor++ = (char)(0x80 | ((codepoint >> 12) & 0x3f));
+            *cursor++ = (char)(0x80 | ((codepoint >> 6) & 0x3f));
+            *cursor++ = (char)(0x80 | (codepoint & 0x3f));
+        }
+        string += used;
+    }
+    return cursor - out;
+}
+
+// Character behind the backslash for bytes that need escaping ('u' for \u00XX), 0 for the rest
+static const char _wsJsonEscapes[256] = {
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    ['"'] = '"', ['\\'] = '\\'
+};
+
+// Index of the first byte from start on that needs escaping (or length), skips 8 bytes 
+// at a time while they contain no control characters, quotes and backslashes
+static size_t _wsJsonNextEscape(const char* string, size_t start, size_t length) {
+    const uint64_t ones = 0x0101010101010101ull;
+    size_t i = start;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, string + i, 8);
+        uint64_t quote = word ^ (ones * '"');
+        uint64_t backslash = word ^ (ones * '\\');
+        uint64_t hits = ((word - ones * 0x20) & ~word) | ((quote - ones) & ~quote) | ((backslash - ones) & ~backslash);
+        if (hits & (ones * 0x80)) break;
+    }
+    while (i < length && !_wsJsonEscapes[(unsigned char)string[i]]) i++;
+    return i;
+}
+
+static bool _wsJsonNeedsEscape(const char* string, size_t length) {
+    return _wsJsonNextEscape(string, 0, length) < length;
+}
+
+// Length of string with json escapes added
+static size_t _wsJsonEscapedLength(const char* string, size_t length) {
+    size_t escaped = length;
+    for (size_t i = _wsJsonNextEscape(string, 0, length); i < length; i = _wsJsonNextEscape(string, i + 1, length)) {
+        escaped += _wsJsonEscapes[(unsigned char)string[i]] == 'u' ? 5 : 1;
+    }
+    return escaped;
+}
+
+static void _wsJsonEscape(const char* string, size_t length, char* out) {
+    static const char hex[] = "0123456789abcdef";
+    size_t copied = 0;
+    for (size_t i = _wsJsonNextEscape(string, 0, length); i < length; i = _wsJsonNextEscape(string, i + 1, length)) {
+        unsigned char c = (unsigned char)string[i];
+        char escape = _wsJsonEscapes[c];
+        memcpy(out, string + copied, i - copied);
+        out += i - copied;
+        copied = i + 1;
+        *out++ = '\\';
+        *out++ = escape;
+        if (escape == 'u') {
+            memcpy(out, "00", 2);
+            out[2] = hex[c >> 4];
+            out[3] = hex[c & 15];
+            out += 4;
+        }
+    }
+    memcpy(out, string + copied, length - copied);
+}
+
+typedef struct _wsJsonBinaryFormat {
+    void (*writeHead)(wsJsonWriter* writer, wsJsonType type, uint64_t count);
+    void (*writeInteger)(wsJsonWriter* writer, int64_t value);
+    void (*writeDouble)(wsJsonWriter* writer, double value);
+    void (*writeSimple)(wsJsonWriter* writer, wsJsonType type, bool value);
+} _wsJsonBinaryFormat;
+
+// Writes the unescaped string behind its header
+static int32_t _wsJsonWriteBinaryString(wsJsonWriter* writer, const _wsJsonBinaryFormat* format, const char* string, size_t length) {
+    if (!memchr(string, '\\', length)) {
+        format->writeHead(writer, WS_JSON_STRING, length);
+        _wsJsonWriterPut(writer, string, length);
+        return WS_OK;
+    }
+
+    char stackBuffer[256];
+    char* buffer = length <= sizeof(stackBuffer) ? stackBuffer : _wsJsonMalloc(length);
+    if (!buffer) {
+        WS_JSON_LOG_ERROR("Failed to allocate string buffer\n");
+        return WS_ERROR;
+    }
+    size_t decoded = _wsJsonUnescape(string, length, buffer);
+    format->writeHead(writer, WS_JSON_STRING, decoded);
+    _wsJsonWriterPut(writer, buffer, decoded);
+    if (buffer != stackBuffer) _wsJsonFree(buffer);
+    return WS_OK;
+}
+
+// Writes scalars completely and only the header of arrays and objects
+static int32_t _wsJsonWriteBinaryShallow(wsJsonWriter* writer, const _wsJsonBinaryFormat* format, wsJson* obj) {
+    switch (obj->type) {
+        case WS_JSON_STRING:
+            return _wsJsonWriteBinaryString(writer, format, obj->stringValue, obj->stringLength);
+        case WS_JSON_NUMBER:
+            if (obj->flags & WS_JSON_FLAG_INTEGER) format->writeInteger(writer, obj->integerValue);
+            else format->writeDouble(writer, obj->numberValue);
+            return WS_OK;
+        case WS_JSON_BOOL:
+        case WS_JSON_NULL:
+            format->writeSimple(writer, obj->type, obj->type == WS_JSON_BOOL && obj->boolValue);
+            return WS_OK;
+        case WS_JSON_OBJECT:
+            format->writeHead(writer, WS_JSON_OBJECT, obj->object.childCount);
+            return WS_OK;
+        case WS_JSON_ARRAY:
+            format->writeHead(writer, WS_JSON_ARRAY, obj->array.elementCount);
+            return WS_OK;
+        default:
+            WS_JSON_LOG_ERROR("Failed to write json node of unknown type\n");
+            return WS_ERROR;
+    }
+}
+
+static int32_t _wsJsonWriteBinaryValue(wsJsonWriter* writer, const _wsJsonBinaryFormat* format, wsJson* obj) {
+    if (_wsJsonWriteBinaryShallow(writer, format, obj) != WS_OK) return WS_ERROR;
+    if (obj->type != WS_JSON_OBJECT && obj->type != WS_JSON_ARRAY) return WS_OK;
+
+    _wsJsonWriteFrame inlineStack[_WS_JSON_INLINE_DEPTH];
+    _wsJsonWriteFrame* stack = inlineStack;
+    int32_t capacity = _WS_JSON_INLINE_DEPTH;
+    int32_t depth = 1;
+    int32_t result = WS_OK;
+    stack[0].node = obj;
+    stack[0].index = 0;
+
+    while (depth > 0) {
+        _wsJsonWriteFrame* frame = &stack[depth - 1];
+        wsJson* node = frame->node;
+        bool object = node->type == WS_JSON_OBJECT;
+        int32_t count = object ? node->object.childCount : node->array.elementCount;
+        if (frame->index == count) {
+            depth--;
+            continue;
+        }
+
+        wsJson* child = object ? node->object.children[frame->index] : node->array.elements[frame->index];
+        frame->index++;
+        if (object && _wsJsonWriteBinaryString(writer, format, child->key, child->keyLength) != WS_OK) {
+            result = WS_ERROR;
+            break;
+        }
+        if (_wsJsonWriteBinaryShallow(writer, format, child) != WS_OK) {
+            result = WS_ERROR;
+            break;
+        }
+        if (child->type != WS_JSON_OBJECT && child->type != WS_JSON_ARRAY) continue;
+
+        if (depth == capacity && _wsJsonStackGrow((void**)&stack, inlineStack, &capacity, sizeof(_wsJsonWriteFrame)) != WS_OK) {
+            result = WS_ERROR;
+            break;
+        }
+        stack[depth].node = child;
+        stack[depth].index = 0;
+        depth++;
+    }
+
+    if (stack != inlineStack) _wsJsonFree(stack);
+    return result;
+}
+
+static bool _wsJsonFitsFloat(double value) {
+    return (double)(float)value == value || value != value;
+}
+
+/* MessagePack */
+static void _wsJsonMsgPackHead(wsJsonWriter* writer, wsJsonType type, uint64_t count) {
+    if (type == WS_JSON_STRING) {
+        if (count < 32) _wsJsonWriterPutChar(writer, (char)(0xa0 | count));
+        else if (count <= UINT8_MAX) _wsJsonWriteBigEndian(writer, 0xd9, count, 1);
+        else if (count <= UINT16_MAX) _wsJsonWriteBigEndian(writer, 0xda, count, 2);
+        else _wsJsonWriteBigEndian(writer, 0xdb, count, 4);
+        return;
+    }
+    bool object = type == WS_JSON_OBJECT;
+    if (count < 16) _wsJsonWriterPutChar(writer, (char)((object ? 0x80 : 0x90) | count));
+    else if (count <= UINT16_MAX) _wsJsonWriteBigEndian(writer, object ? 0xde : 0xdc, count, 2);
+    else _wsJsonWriteBigEndian(writer, object ? 0xdf : 0xdd, count, 4);
+}
+
+static void _wsJsonMsgPackInteger(wsJsonWriter* writer, int64_t value) {
+    if (value >= 0) {
+        if (value < 128) _wsJsonWriterPutChar(writer, (char)value);
+        else if (value <= UINT8_MAX) _wsJsonWriteBigEndian(writer, 0xcc, value, 1);
+        else if (value <= UINT16_MAX) _wsJsonWriteBigEndian(writer, 0xcd, value, 2);
+        else if (value <= UINT32_MAX) _wsJsonWriteBigEndian(writer, 0xce, value, 4);
+        else _wsJsonWriteBigEndian(writer, 0xcf, value, 8);
+    } else {
+        if (value >= -32) _wsJsonWriterPutChar(writer, (char)(0xe0 | (value & 0x1f)));
+        else if (value >= INT8_MIN) _wsJsonWriteBigEndian(writer, 0xd0, (uint8_t)value, 1);
+        else if (value >= INT16_MIN) _wsJsonWriteBigEndian(writer, 0xd1, (uint16_t)value, 2);
+        else if (value >= INT32_MIN) _wsJsonWriteBigEndian(writer, 0xd2, (uint32_t)value, 4);
+        else _wsJsonWriteBigEndian(writer, 0xd3, (uint64_t)value, 8);
+    }
+}
+
+static void _wsJsonMsgPackDouble(wsJsonWriter* writer, double value) {
+    if (_wsJsonFitsFloat(value)) {
+        float single = (float)value;
+        uint32_t bits;
+        memcpy(&bits, &single, 4);
+        _wsJsonWriteBigEndian(writer, 0xca, bits, 4);
+        return;
+    }
+    uint64_t bits;
+    memcpy(&bits, &value, 8);
+    _wsJsonWriteBigEndian(writer, 0xcb, bits, 8);
+}
+
+static void _wsJsonMsgPackSimple(wsJsonWriter* writer, wsJsonType type, bool value) {
+    _wsJsonWriterPutChar(writer, (char)(type == WS_JSON_NULL ? 0xc0 : value ? 0xc3 : 0xc2));
+}
+
+static const _wsJsonBinaryFormat _wsJsonMsgPackFormat = {
+    _wsJsonMsgPackHead, _wsJsonMsgPackInteger, _wsJsonMsgPackDouble, _wsJsonMsgPackSimple
+};
+
+int32_t wsJsonWriteMsgPack(wsJsonWriter* writer, wsJson* obj) {
+    if (!writer || !obj) {
+        WS_JSON_LOG_ERROR("Invalid JSON or writer\n");
+        return WS_ERROR;
+    }
+    _WS_JSON_STATS_START(start);
+    size_t length = writer->length;
+    int32_t result = _wsJsonWriterFinish(writer, _wsJsonWriteBinaryValue(writer, &_wsJsonMsgPackFormat, obj));
+    _WS_JSON_STATS_TIME(serialize, start, writer->length - length);
+    return result;
+}
+
+/* CBOR */
+static void _wsJsonCborArgument(wsJsonWriter* writer, uint8_t major, uint64_t value) {
+    if (value < 24) _wsJsonWriterPutChar(writer, (char)(major << 5 | value));
+    else if (value <= UINT8_MAX) _wsJsonWriteBigEndian(writer, major << 5 | 24, value, 1);
+    else if (value <= UINT16_MAX) _wsJsonWriteBigEndian(writer, major << 5 | 25, value, 2);
+    else if (value <= UINT32_MAX) _wsJsonWriteBigEndian(writer, major << 5 | 26, value, 4);
+    else _wsJsonWriteBigEndian(writer, major << 5 | 27, value, 8);
+}
+
+static void _wsJsonCborHead(wsJsonWriter* writer, wsJsonType type, uint64_t count) {
+    _wsJsonCborArgument(writer, type == WS_JSON_STRING ? 3 : type == WS_JSON_ARRAY ? 4 : 5, count);
+}
+
+static void _wsJsonCborInteger(wsJsonWriter* writer, int64_t value) {
+    if (value >= 0) _wsJsonCborArgument(writer, 0, (uint64_t)value);
+    else _wsJsonCborArgument(writer, 1, ~(uint64_t)value); // -1 - value
+}
+
+static void _wsJsonCborDouble(wsJsonWriter* writer, double value) {
+    if (_wsJsonFitsFloat(value)) {
+        float single = (float)value;
+        uint32_t bits;
+        memcpy(&bits, &single, 4);
+        _wsJsonWriteBigEndian(writer, 0xfa, bits, 4);
+        return;
+    }
+    uint64_t bits;
+    memcpy(&bits, &value, 8);
+    _wsJsonWriteBigEndian(writer, 0xfb, bits, 8);
+}
+
+static void _wsJsonCborSimple(wsJsonWriter* writer, wsJsonType type, bool value) {
+    _wsJsonWriterPutChar(writer, (char)(type == WS_JSON_NULL ? 0xf6 : value ? 0xf5 : 0xf4));
+}
+
+static const _wsJsonBinaryFormat _wsJsonCborFormat = {
+    _wsJsonCborHead, _wsJsonCborInteger, _wsJsonCborDouble, _wsJsonCborSimple
+};
+
+int32_t wsJsonWriteCbor(wsJsonWriter* writer, wsJson* obj) {
+    if (!writer || !obj) {
+        WS_JSON_LOG_ERROR("Invalid JSON or writer\n");
+        return WS_ERROR;
+    }
+    _WS_JSON_STATS_START(start);
+    size_t length = writer->length;
+    int32_t result = _wsJsonWriterFinish(writer, _wsJsonWriteBinaryValue(writer, &_wsJsonCborFormat, obj));
+    _WS_JSON_STATS_TIME(serialize, start, writer->length - length);
+    return result;
+}
+
+/* Binary decoding */
+typedef struct _wsJsonBinaryItem {
+    wsJsonType type;
+    bool isInteger;
+    bool indefinite; // CBOR array or map that ends with a break
+    int64_t integer;
+    double number;
+    bool boolean;
+    const char* string;
+    uint64_t count;  // string length or number of elements/fields
+} _wsJsonBinaryItem;
+
+// Reads one item header (and scalar payload), returns the cursor behind it or NULL
+typedef const uint8_t* (*_wsJsonBinaryReadFn)(const uint8_t* cursor, const uint8_t* end, _wsJsonBinaryItem* item);
+
+// Node with the key escaped like the text parser would have read it
+static wsJson* _wsJsonBinaryAllocNode(wsJsonType type, const char* key, size_t keyLength, uint32_t flags) {
+    if (!key || !_wsJsonNeedsEscape(key, keyLength)) return parseAllocNode(type, key, keyLength, flags);
+
+    size_t escapedLength = _wsJsonEscapedLength(key, keyLength);
+    char* escaped = _wsJsonMalloc(escapedLength);
+    if (!escaped) return NULL;
+    _wsJsonEscape(key, keyLength, escaped);
+    wsJson* node = _wsJsonAllocNode(type, escaped, escapedLength);
+    _wsJsonFree(escaped);
+    return node;
+}
+
+static wsJson* _wsJsonBinaryString(const char* key, size_t keyLength, const char* string, size_t length, uint32_t flags) {
+    wsJson* node = _wsJsonBinaryAllocNode(WS_JSON_STRING, key, keyLength, flags);
+    if (!node) return NULL;
+    if (!_wsJsonNeedsEscape(string, length)) {
+        if (flags & WS_JSON_PARSE_VIEWS) node->flags |= WS_JSON_FLAG_STRING_VIEW;
+        node->stringValue = parseView(node, string, length, flags);
+        node->stringLength = (uint32_t)length;
+    } else {
+        size_t escapedLength = _wsJsonEscapedLength(string, length);
+        node->stringValue = _wsJsonNodeAlloc(node, escapedLength + 1);
+        if (node->stringValue) {
+            _wsJsonEscape(string, length, node->stringValue);
+            node->stringValue[escapedLength] = '\0';
+        }
+        node->stringLength = (uint32_t)escapedLength;
+    }
+    if (!node->stringValue) {
+        wsJsonFree(node);
+        return NULL;
+    }
+    return node;
+}
+
+typedef struct _wsJsonBinaryFrame {
+    wsJson* node;
+    uint64_t remaining; // children still to read
+    bool indefinite;    // ends with a break instead
+} _wsJsonBinaryFrame;
+
+// Decodes one value with an explicit stack of open containers like parseNested
+static wsJson* _wsJsonBinaryValue(_wsJsonBinaryReadFn read, const uint8_t** cursor, const uint8_t* end, uint32_t flags) {
+    _wsJsonBinaryFrame inlineStack[_WS_JSON_INLINE_DEPTH];
+    _wsJsonBinaryFrame* stack = inlineStack;
+    int32_t capacity = _WS_JSON_INLINE_DEPTH;
+    int32_t depth = 0;
+    wsJson* root = NULL;
+    const char* key = NULL;
+    size_t keyLength = 0;
+
+    for (;;) {
+        _wsJsonBinaryItem item;
+        const uint8_t* next = read(*cursor, end, &item);
+        if (!next) {
+            WS_JSON_LOG_ERROR("Failed to decode binary json value\n");
+            goto fail;
+        }
+        *cursor = next;
+
+        wsJson* node;
+        if (item.type == WS_JSON_STRING) {
+            node = _wsJsonBinaryString(key, keyLength, item.string, item.count, flags);
+        }
+        else {
+            node = _wsJsonBinaryAllocNode(item.type, key, keyLength, flags);
+            if (!node) WS_JSON_LOG_ERROR("Failed to allocate json node\n");
+        }
+        if (!node) goto fail;
+        if (depth == 0) root = node;
+        else if (stack[depth - 1].node->type == WS_JSON_OBJECT) wsJsonAddField(stack[depth - 1].node, node);
+        else wsJsonAddElement(stack[depth - 1].node, node);
+
+        switch (item.type) {
+            case WS_JSON_NUMBER:
+                node->numberValue = item.number;
+                if (item.isInteger) {
+                    node->flags |= WS_JSON_FLAG_INTEGER;
+                    node->integerValue = item.integer;
+                }
+                break;
+            case WS_JSON_BOOL:
+                node->boolValue = item.boolean;
+                break;
+            case WS_JSON_OBJECT:
+            case WS_JSON_ARRAY:
+                // Every element takes at least one byte, so larger counts are broken input
+                if (!item.indefinite && item.count > (uint64_t)(end - *cursor)) {
+                    WS_JSON_LOG_ERROR("Failed to decode binary json: container is larger than the input\n");
+                    goto fail;
+                }
+                if (depth == capacity && _wsJsonStackGrow((void**)&stack, inlineStack, &capacity, sizeof(_wsJsonBinaryFrame)) != WS_OK) goto fail;
+                stack[depth].node = node;
+                stack[depth].remaining = item.count;
+                stack[depth].indefinite = item.indefinite;
+                depth++;
+                break;
+            default:
+                break;
+        }
+
+        // Close finished containers until one has another child
+        for (;;) {
+            if (depth == 0) goto done;
+            _wsJsonBinaryFrame* frame = &stack[depth - 1];
+            if (frame->indefinite) {
+                if (*cursor == end) {
+                    WS_JSON_LOG_ERROR("Failed to decode binary json: missing break\n");
+                    goto fail;
+                }
+                if (**cursor != 0xff) break;
+                (*cursor)++;
+            }
+            else if (frame->remaining > 0) {
+                frame->remaining--;
+                break;
+            }
+            depth--;
+        }
+
+        key = NULL;
+        keyLength = 0;
+        if (stack[depth - 1].node->type == WS_JSON_OBJECT) {
+            _wsJsonBinaryItem field;
+            next = read(*cursor, end, &field);
+            if (!next || field.type != WS_JSON_STRING) {
+                WS_JSON_LOG_ERROR("Failed to decode binary json: map keys have to be strings\n");
+                goto fail;
+            }
+            *cursor = next;
+            key = field.string;
+            keyLength = field.count;
+        }
+    }
+
+done:
+    if (stack != inlineStack) _wsJsonFree(stack);
+    return root;
+
+fail:
+    if (root) wsJsonFree(root);
+    if (stack != inlineStack) _wsJsonFree(stack);
+    return NULL;
+}
+
+static wsJson* _wsJsonParseBinary(_wsJsonBinaryReadFn read, const void* data, size_t length, uint32_t parseFlags) {
+    if (!data) {
+        WS_JSON_LOG_ERROR("Invalid input paramerter is NULL\n");
+        return NULL;
+    }
+    _WS_JSON_STATS_START(start);
+    const uint8_t* cursor = data;
+    const uint8_t* end = cursor + length;
+    wsJson* root = _wsJsonBinaryValue(read, &cursor, end, parseFlags & ~_WS_JSON_PARSE_IN_SITU);
+    if (root && cursor != end) {
+        WS_JSON_LOG_ERROR("Failed to decode binary json: unexpected data after the root\n");
+        wsJsonFree(root);
+        root = NULL;
+    }
+    _WS_JSON_STATS_TIME(parse, start, length);
+    return root;
+}
+
+static const uint8_t* _wsJsonMsgPackRead(const uint8_t* cursor, const uint8_t* end, _wsJsonBinaryItem* item) {
+    if (cursor == end) return NULL;
+    memset(item, 0, sizeof(_wsJsonBinaryItem));
+    uint8_t byte = *cursor++;
+    size_t available = end - cursor;
+
+    int32_t size = 0; // bytes of the length or value behind the type byte
+    if (byte < 0x80 || byte >= 0xe0) {
+        item->type = WS_JSON_NUMBER;
+        item->isInteger = true;
+        item->integer = (int8_t)byte;
+        item->number = (double)item->integer;
+        return cursor;
+    }
+    if (byte < 0xa0) {
+        item->type = byte < 0x90 ? WS_JSON_OBJECT : WS_JSON_ARRAY;
+        item->count = byte & 0x0f;
+        return cursor;
+    }
+    if (byte < 0xc0) {
+        item->count = byte & 0x1f;
+        if (item->count > available) return NULL;
+        item->type = WS_JSON_STRING;
+        item->string = (const char*)cursor;
+        return cursor + item->count;
+    }
+
+    switch (byte) {
+        case 0xc0: item->type = WS_JSON_NULL; return cursor;
+        case 0xc2: item->type = WS_JSON_BOOL; item->boolean = false; return cursor;
+        case 0xc3: item->type = WS_JSON_BOOL; item->boolean = true; return cursor;
+        case 0xca: case 0xcb: {
+            size = byte == 0xca ? 4 : 8;
+            if ((size_t)size > available) return NULL;
+            uint64_t bits = _wsJsonReadBigEndian(cursor, size);
+            item->type = WS_JSON_NUMBER;
+            if (size == 4) {
+                uint32_t single = (uint32_t)bits;
+                float value;
+                memcpy(&value, &single, 4);
+                item->number = value;
+            } else {
+                memcpy(&item->number, &bits, 8);
+            }
+            return cursor + size;
+        }
+        case 0xcc: case 0xcd: case 0xce: case 0xcf:
+        case 0xd0: case 0xd1: case 0xd2: case 0xd3: {
+            size = 1 << (byte & 3);
+            if ((size_t)size > available) return NULL;
+            uint64_t bits = _wsJsonReadBigEndian(cursor, size);
+            item->type = WS_JSON_NUMBER;
+            item->isInteger = true;
+            if (byte >= 0xd0) {
+                // Sign extend
+                int32_t shift = 64 - size * 8;
+                item->integer = (int64_t)(bits << shift) >> shift;
+            } else if (bits > INT64_MAX) {
+                item->isInteger = false;
+                item->number = (double)bits;
+                return cursor + size;
+            } else {
+                item->integer = (int64_t)bits;
+            }
+            item->number = (double)item->integer;
+            return cursor + size;
+        }
+        case 0xd9: case 0xda: case 0xdb:
+            item->type = WS_JSON_STRING;
+            size = 1 << (byte - 0xd9);
+            break;
+        case 0xdc: case 0xdd:
+            item->type = WS_JSON_ARRAY;
+            size = byte == 0xdc ? 2 : 4;
+            break;
+        case 0xde: case 0xdf:
+            item->type = WS_JSON_OBJECT;
+            size = byte == 0xde ? 2 : 4;
+            break;
+        default:
+            WS_JSON_LOG_ERROR("Unsupported MessagePack type 0x%02x\n", byte);
+            return NULL;
+    }
+
+    if ((size_t)size > available) return NULL;
+    item->count = _wsJsonReadBigEndian(cursor, size);
+    cursor += size;
+    if (item->type == WS_JSON_STRING) {
+        if (item->count > (size_t)(end - cursor)) return NULL;
+        item->string = (const char*)cursor;
+        cursor += item->count;
+    }
+    return cursor;
+}
+
+static double _wsJsonHalfToDouble(uint16_t half) {
+    int32_t exponent = (half >> 10) & 0x1f;
+    int32_t mantissa = half & 0x3ff;
+    double value;
+    if (exponent == 0) value = ldexp(mantissa, -24);
+    else if (exponent != 31) value = ldexp(mantissa + 1024, exponent - 25);
+    else value = mantissa == 0 ? INFINITY : NAN;
+    return half & 0x8000 ? -value : value;
+}
+
+static const uint8_t* _wsJsonCborRead(const uint8_t* cursor, const uint8_t* end, _wsJsonBinaryItem* item) {
+    for (;;) {
+        if (cursor == end) return NULL;
+        memset(item, 0, sizeof(_wsJsonBinaryItem));
+        uint8_t byte = *cursor++;
+        uint8_t major = byte >> 5;
+        uint8_t info = byte & 0x1f;
+
+        uint64_t argument = info;
+        if (info >= 24 && info <= 27) {
+            int32_t size = 1 << (info - 24);
+            if ((size_t)size > (size_t)(end - cursor)) return NULL;
+            argument = _wsJsonReadBigEndian(cursor, size);
+            cursor += size;
+        } else if (info > 27 && !(info == 31 && (major == 4 || major == 5))) {
+            WS_JSON_LOG_ERROR("Unsupported CBOR item 0x%02x\n", byte);
+            return NULL;
+        }
+
+        switch (major) {
+            case 0:
+            case 1:
+                item->type = WS_JSON_NUMBER;
+                if (argument > INT64_MAX) {
+                    item->number = major == 0 ? (double)argument : -1.0 - (double)argument;
+                    return cursor;
+                }
+                item->isInteger = true;
+                item->integer = major == 0 ? (int64_t)argument : -1 - (int64_t)argument;
+                item->number = (double)item->integer;
+                return cursor;
+            case 3:
+                if (argument > (uint64_t)(end - cursor)) return NULL;
+                item->type = WS_JSON_STRING;
+                item->string = (const char*)cursor;
+                item->count = argument;
+                return cursor + argument;
+            case 4:
+            case 5:
+                item->type = major == 4 ? WS_JSON_ARRAY : WS_JSON_OBJECT;
+                item->indefinite = info == 31;
+                item->count = argument;
+                return cursor;
+            case 6:
+                continue; // tags only annotate the next item
+            case 7:
+                switch (info) {
+                    case 20: item->type = WS_JSON_BOOL; item->boolean = false; return cursor;
+                    case 21: item->type = WS_JSON_BOOL; item->boolean = true; return cursor;
+                    case 22: case 23: item->type = WS_JSON_NULL; return cursor; // null, undefined
+                    case 25: item->type = WS_JSON_NUMBER; item->number = _wsJsonHalfToDouble((uint16_t)argument); return cursor;
+                    case 26: {
+                        uint32_t bits = (uint32_t)argument;
+                        float value;
+                        memcpy(&value, &bits, 4);
+                        item->type = WS_JSON_NUMBER;
+                        item->number = value;
+                        return cursor;
+                    }
+                    case 27:
+                        item->type = WS_JSON_NUMBER;
+                        memcpy(&item->number, &argument, 8);
+                        return cursor;
+                    default:
+                        break;
+                }
+                // fallthrough
+            default:
+                WS_JSON_LOG_ERROR("Unsupported CBOR item 0x%02x\n", byte);
+                return NULL;
+        }
+    }
+}
+
+wsJson* wsJsonParseMsgPack(const void* data, size_t length, uint32_t parseFlags) {
+    return _wsJsonParseBinary(_wsJsonMsgPackRead, data, length, parseFlags);
+}
+
+wsJson* wsJsonParseCbor(const void* data, size_t length, uint32_t parseFlags) {
+    return _wsJsonParseBinary(_wsJsonCborRead, data, length, parseFlags);
+}
+
+/* Frozen snapshots */
+#define _WS_JSON_FROZEN_VERSION 1
+#define _WS_JSON_FROZEN_BYTE_ORDER 0x01020304u
+
+typedef struct _wsJsonFrozenHeader {
+    char magic[4]; // "wsJF"
+    uint32_t version;
+    uint32_t byteOrder; // tells apart snapshots written on a host with the other byte order
+    uint32_t reserved;
+    uint64_t length;
+    uint64_t stringOffset; // start of the key and string region
+} _wsJsonFrozenHeader;
+
+// Interned key, offset into the string region + 1 (0 is an empty slot)
+typedef struct _wsJsonFrozenKeySlot {
+    uint32_t hash;
+    uint32_t offset;
+} _wsJsonFrozenKeySlot;
+
+typedef struct _wsJsonFreezer {
+    wsJsonFrozen* nodes;
+    size_t nodeCount; // allocated so far
+    size_t stringOffset; // where the string region starts in the snapshot
+    char* strings;
+    size_t stringUsed;
+    size_t stringCapacity;
+    _wsJsonFrozenKeySlot* keys;
+    size_t keyCount;
+    size_t keyCapacity;
+    int32_t error;
+} _wsJsonFreezer;
+
+typedef struct _wsJsonFreezeFrame {
+    wsJson* node;
+    size_t first; // position of the first child
+    int32_t index; // next child to freeze
+} _wsJsonFreezeFrame;
+
+// Nodes needed below obj, index slots count as one node per three slots
+static size_t _wsJsonFreezeNodeSlots(wsJson* obj) {
+    if (obj->type != WS_JSON_OBJECT && obj->type != WS_JSON_ARRAY) return 0;
+    int32_t count = obj->type == WS_JSON_OBJECT ? obj->object.childCount : obj->array.elementCount;
+    size_t nodes = (size_t)count;
+    if (obj->type == WS_JSON_OBJECT && WS_JSON_INDEX_THRESHOLD > 0 && count >= WS_JSON_INDEX_THRESHOLD) {
+        nodes += (sizeof(_wsJsonIndexSlot) * _wsJsonIndexSlotCount(count) + sizeof(wsJsonFrozen) - 1) / sizeof(wsJsonFrozen);
+    }
+    return nodes;
+}
+
+static int32_t _wsJsonFreezeNodeCount(wsJson* obj, size_t* nodes) {
+    *nodes = _wsJsonFreezeNodeSlots(obj);
+    if (obj->type != WS_JSON_OBJECT && obj->type != WS_JSON_ARRAY) return WS_OK;
+
+    _wsJsonFreezeFrame inlineStack[_WS_JSON_INLINE_DEPTH];
+    _wsJsonFreezeFrame* stack = inlineStack;
+    int32_t capacity = _WS_JSON_INLINE_DEPTH;
+    int32_t depth = 1;
+    int32_t result = WS_OK;
+    stack[0].node = obj;
+    stack[0].index = 0;
+
+    while (depth > 0) {
+        _wsJsonFreezeFrame* frame = &stack[depth - 1];
+        wsJson* node = frame->node;
+        bool object = node->type == WS_JSON_OBJECT;
+        int32_t count = object ? node->object.childCount : node->array.elementCount;
+        if (frame->index == count) {
+            depth--;
+            continue;
+        }
+
+        wsJson* child = object ? node->object.children[frame->index] : node->array.elements[frame->index];
+        frame->index++;
+        if (child->type != WS_JSON_OBJECT && child->type != WS_JSON_ARRAY) continue;
+        *nodes += _wsJsonFreezeNodeSlots(child);
+
+        if (depth == capacity && _wsJsonStackGrow((void**)&stack, inlineStack, &capacity, sizeof(_wsJsonFreezeFrame)) != WS_OK) {
+            result = WS_ERROR;
+            break;
+        }
+        stack[depth].node = child;
+        stack[depth].index = 0;
+        depth++;
+    }
+
+    if (stack != inlineStack) _wsJsonFree(stack);
+    return result;
+}
+
+// Appends a NUL terminated string, returns its offset in the string region
+static size_t _wsJsonFreezeString(_wsJsonFreezer* freezer, const char* string, size_t length) {
+    if (freezer->stringUsed + length + 1 > freezer->stringCapacity) {
+        size_t newCap = freezer->stringCapacity ? freezer->stringCapacity * 2 : 4096;
+        while (newCap < freezer->stringUsed + length + 1) newCap *= 2;
+        char* strings = _wsJsonRealloc(freezer->strings, newCap);
+        if (!strings) {
+            WS_JSON_LOG_ERROR("Failed to grow frozen string region\n");
+            freezer->error = WS_ERROR;
+            return 0;
+        }
+        freezer->strings = strings;
+        freezer->stringCapacity = newCap;
+    }
+    size_t offset = freezer->stringUsed;
+    memcpy(freezer->strings + offset, string, length);
+    freezer->strings[offset + length] = '\0';
+    freezer->stringUsed += length + 1;
+    return offset;
+}
+
+// Keys and short strings like enum values repeat a lot, each one is stored once
+static size_t _wsJsonFreezeShared(_wsJsonFreezer* freezer, const char* key, size_t length) {
+    if (freezer->keyCount * 2 >= freezer->keyCapacity) {
+        size_t newCap = freezer->keyCapacity ? freezer->keyCapacity * 2 : 256;
+        _wsJsonFrozenKeySlot* keys = _wsJsonMalloc(sizeof(_wsJsonFrozenKeySlot) * newCap);
+        if (!keys) {
+            WS_JSON_LOG_ERROR("Failed to grow frozen key table\n");
+            freezer->error = WS_ERROR;
+            return 0;
+        }
+        memset(keys, 0, sizeof(_wsJsonFrozenKeySlot) * newCap);
+        for (size_t i = 0; i < freezer->keyCapacity; i++) {
+            if (!freezer->keys[i].offset) continue;
+            size_t slot = freezer->keys[i].hash & (newCap - 1);
+            while (keys[slot].offset) slot = (slot + 1) & (newCap - 1);
+            keys[slot] = freezer->keys[i];
+        }
+        _wsJsonFree(freezer->keys);
+        freezer->keys = keys;
+        freezer->keyCapacity = newCap;
+    }
+
+    uint32_t hash = _wsJsonHashKey(key, length);
+    size_t mask = freezer->keyCapacity - 1;
+    size_t slot = hash & mask;
+    for (; freezer->keys[slot].offset; slot = (slot + 1) & mask) {
+        if (freezer->keys[slot].hash != hash) continue;
+        const char* other = freezer->strings + freezer->keys[slot].offset - 1;
+        if (memcmp(other, key, length) == 0 && other[length] == '\0') return freezer->keys[slot].offset - 1;
+    }
+
+    size_t offset = _wsJsonFreezeString(freezer, key, length);
+    if (freezer->error || offset >= UINT32_MAX) return 0;
+    freezer->keys[slot].hash = hash;
+    freezer->keys[slot].offset = (uint32_t)offset + 1;
+    freezer->keyCount++;
+    return offset;
+}
+
+static inline size_t _wsJsonFrozenPosition(size_t node) {
+    return sizeof(_wsJsonFrozenHeader) + sizeof(wsJsonFrozen) * node;
+}
+
+// Freezes obj without its children, returns the position of the first child
+static size_t _wsJsonFreezeShallow(_wsJsonFreezer* freezer, wsJson* obj, size_t position) {
+    wsJsonFrozen* node = &freezer->nodes[position];
+    size_t base = freezer->stringOffset - _wsJsonFrozenPosition(position);
+    node->keyOffset = (uint32_t)(base + _wsJsonFreezeShared(freezer, obj->key, obj->keyLength));
+    node->keyLength = obj->keyLength;
+    node->type = obj->type;
+
+    switch (obj->type) {
+        case WS_JSON_STRING: {
+            const char* string = obj->stringValue ? obj->stringValue : "";
+            node->count = obj->stringLength;
+            if (obj->stringLength <= 64) node->value = base + _wsJsonFreezeShared(freezer, string, obj->stringLength);
+            else node->value = base + _wsJsonFreezeString(freezer, string, obj->stringLength);
+            break;
+        }
+        case WS_JSON_NUMBER:
+            if (obj->flags & WS_JSON_FLAG_INTEGER) {
+                node->flags |= WS_JSON_FLAG_INTEGER;
+                node->value = (uint64_t)obj->integerValue;
+            }
+            else {
+                memcpy(&node->value, &obj->numberValue, sizeof(double));
+            }
+            break;
+        case WS_JSON_BOOL:
+            node->value = obj->boolValue;
+            break;
+        case WS_JSON_OBJECT:
+        case WS_JSON_ARRAY: {
+            int32_t count = obj->type == WS_JSON_OBJECT ? obj->object.childCount : obj->array.elementCount;
+            wsJson** children = obj->type == WS_JSON_OBJECT ? obj->object.children : obj->array.elements;
+            size_t first = freezer->nodeCount;
+            freezer->nodeCount += count;
+            node->count = (uint32_t)count;
+            node->value = _wsJsonFrozenPosition(first) - _wsJsonFrozenPosition(position);
+
+            _wsJsonIndexSlot* slots = NULL;
+            size_t mask = 0;
+            if (obj->type == WS_JSON_OBJECT && WS_JSON_INDEX_THRESHOLD > 0 && count >= WS_JSON_INDEX_THRESHOLD) {
+                size_t slotCount = _wsJsonIndexSlotCount(count);
+                slots = (_wsJsonIndexSlot*)&freezer->nodes[freezer->nodeCount];
+                mask = slotCount - 1;
+                freezer->nodeCount += (sizeof(_wsJsonIndexSlot) * slotCount + sizeof(wsJsonFrozen) - 1) / sizeof(wsJsonFrozen);
+                node->flags |= WS_JSON_FLAG_INDEXED;
+            }
+
+            // First child with a key wins, like in the tree index
+            for (int32_t i = 0; slots && i < count; i++) {
+                wsJson* child = children[i];
+                uint32_t hash = _wsJsonHashKey(child->key, child->keyLength);
+                size_t slot = hash & mask;
+                while (slots[slot].index) {
+                    wsJson* other = children[slots[slot].index - 1];
+                    if (slots[slot].hash == hash && other->keyLength == child->keyLength &&
+                        memcmp(other->key, child->key, child->keyLength) == 0) break;
+                    slot = (slot + 1) & mask;
+                }
+                if (!slots[slot].index) {
+                    slots[slot].hash = hash;
+                    slots[slot].index = (uint32_t)i + 1;
+                }
+            }
+            return first;
+        }
+        default:
+            break;
+    }
+    return 0;
+}
+
+// Children get the next free nodes in the order of a depth first walk, so
+// every children array lies behind its parent
+static void _wsJsonFreezeNode(_wsJsonFreezer* freezer, wsJson* obj) {
+    size_t first = _wsJsonFreezeShallow(freezer, obj, 0);
+    if (obj->type != WS_JSON_OBJECT && obj->type != WS_JSON_ARRAY) return;
+
+    _wsJsonFreezeFrame inlineStack[_WS_JSON_INLINE_DEPTH];
+    _wsJsonFreezeFrame* stack = inlineStack;
+    int32_t capacity = _WS_JSON_INLINE_DEPTH;
+    int32_t depth = 1;
+    stack[0].node = obj;
+    stack[0].first = first;
+    stack[0].index = 0;
+
+    while (depth > 0 && !freezer->error) {
+        _wsJsonFreezeFrame* frame = &stack[depth - 1];
+        wsJson* node = frame->node;
+        bool object = node->type == WS_JSON_OBJECT;
+        int32_t count = object ? node->object.childCount : node->array.elementCount;
+        if (frame->index == count) {
+            depth--;
+            continue;
+        }
+
+        wsJson* child = object ? node->object.children[frame->index] : node->array.elements[frame->index];
+        size_t childFirst = _wsJsonFreezeShallow(freezer, child, frame->first + frame->index);
+        frame->index++;
+        if (child->type != WS_JSON_OBJECT && child->type != WS_JSON_ARRAY) continue;
+
+        if (depth == capacity && _wsJsonStackGrow((void**)&stack, inlineStack, &capacity, sizeof(_wsJsonFreezeFrame)) != WS_OK) {
+            freezer->error = WS_ERROR;
+            break;
+        }
+        stack[depth].node = child;
+        stack[depth].first = childFirst;
+        stack[depth].index = 0;
+        depth++;
+    }
+
+    if (stack != inlineStack) _wsJsonFree(stack);
+}
+
+int32_t wsJsonFreeze(wsJsonWriter* writer, wsJson* obj) {
+    if (!writer || !obj) {
+        WS_JSON_LOG_ERROR("Invalid JSON or writer\n");
+        return WS_ERROR;
+    }
+
+    _wsJsonFreezer freezer = { 0 };
+    size_t nodeTotal;
+    if (_wsJsonFreezeNodeCount(obj, &nodeTotal) != WS_OK) return _wsJsonWriterFinish(writer, WS_ERROR);
+    nodeTotal++;
+    freezer.nodes = _wsJsonMalloc(sizeof(wsJsonFrozen) * nodeTotal);
+    if (!freezer.nodes) {
+        WS_JSON_LOG_ERROR("Failed to allocate frozen nodes\n");
+        return WS_ERROR;
+    }
+    memset(freezer.nodes, 0, sizeof(wsJsonFrozen) * nodeTotal);
+    freezer.nodeCount = 1;
+    freezer.stringOffset = _wsJsonFrozenPosition(nodeTotal);
+    _wsJsonFreezeNode(&freezer, obj);
+
+    size_t stringOffset = freezer.stringOffset;
+    size_t length = stringOffset + ((freezer.stringUsed + 7) & ~(size_t)7);
+    if (!freezer.error && length > UINT32_MAX) {
+        WS_JSON_LOG_ERROR("Frozen snapshot is larger than 4 GB\n");
+        freezer.error = WS_ERROR;
+    }
+
+    int32_t result = freezer.error;
+    if (!result) {
+        _wsJsonFrozenHeader header = { { 'w', 's', 'J', 'F' }, _WS_JSON_FROZEN_VERSION, _WS_JSON_FROZEN_BYTE_ORDER, 0, length, stringOffset };
+        static const char padding[8] = { 0 };
+        _wsJsonWriterPut(writer, (const char*)&header, sizeof(header));
+        _wsJsonWriterPut(writer, (const char*)freezer.nodes, sizeof(wsJsonFrozen) * nodeTotal);
+        _wsJsonWriterPut(writer, freezer.strings, freezer.stringUsed);
+        _wsJsonWriterPut(writer, padding, length - stringOffset - freezer.stringUsed);
+    }
+
+    _wsJsonFree(freezer.nodes);
+    _wsJsonFree(freezer.strings);
+    _wsJsonFree(freezer.keys);
+    return _wsJsonWriterFinish(writer, result);
+}
+
+const wsJsonFrozen* wsJsonFrozenRoot(const void* data, size_t length) {
+    if (!data) {
+        WS_JSON_LOG_ERROR("Invalid input paramerter is NULL\n");
+        return NULL;
+    }
+    const _wsJsonFrozenHeader* header = data;
+    if (((uintptr_t)data & 7) || length < sizeof(_wsJsonFrozenHeader) + sizeof(wsJsonFrozen) ||
+        memcmp(header->magic, "wsJF", 4) != 0) {
+        WS_JSON_LOG_ERROR("Data is not an aligned frozen snapshot\n");
+        return NULL;
+    }
+    if (header->version != _WS_JSON_FROZEN_VERSION || header->byteOrder != _WS_JSON_FROZEN_BYTE_ORDER) {
+        WS_JSON_LOG_ERROR("Frozen snapshot has an unsupported version or byte order\n");
+        return NULL;
+    }
+    if (header->length > length) {
+        WS_JSON_LOG_ERROR("Frozen snapshot is truncated\n");
+        return NULL;
+    }
+    return (const wsJsonFrozen*)(header + 1);
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+wsJsonFrozenFile* wsJsonFrozenOpen(const char* path) {
+    if (!path) {
+        WS_JSON_LOG_ERROR("Invalid input paramerter is NULL\n");
+        return NULL;
+    }
+
+    size_t length;
+    void* data = _wsJsonMapFile(path, &length);
+    if (!data) return NULL;
+#ifdef MADV_NORMAL
+    madvise(data, length, MADV_NORMAL); // lookups jump around
+#endif
+
+    const wsJsonFrozen* root = wsJsonFrozenRoot(data, length);
+    wsJsonFrozenFile* file = root ? _wsJsonMalloc(sizeof(wsJsonFrozenFile)) : NULL;
+    if (!file) {
+        WS_JSON_LOG_ERROR("Failed to open frozen snapshot %s\n", path);
+        munmap(data, length);
+        return NULL;
+    }
+    file->root = root;
+    file->data = data;
+    file->length = length;
+    return file;
+}
+
+void wsJsonFrozenClose(wsJsonFrozenFile* file) {
+    if (!file) return;
+    munmap((void*)file->data, file->length);
+    _wsJsonFree(file);
+}
+#endif
+
+static inline const wsJsonFrozen* _wsJsonFrozenChildren(const wsJsonFrozen* node) {
+    return (const wsJsonFrozen*)((const char*)node + node->value);
+}
+
+static const wsJsonFrozen* _wsJsonFrozenField(const wsJsonFrozen* obj, const char* key, size_t keyLen, const uint32_t* hash) {
+    if (obj->type != WS_JSON_OBJECT) {
+        WS_JSON_LOG_ERROR("Obj is not from type WS_JSON_OBJECT\n");
+        return NULL;
+    }
+
+    const wsJsonFrozen* children = _wsJsonFrozenChildren(obj);
+    if (obj->flags & WS_JSON_FLAG_INDEXED) {
+        const _wsJsonIndexSlot* slots = (const _wsJsonIndexSlot*)(children + obj->count);
+        size_t mask = _wsJsonIndexSlotCount((int32_t)obj->count) - 1;
+        uint32_t keyHash = hash ? *hash : _wsJsonHashKey(key, keyLen);
+        for (size_t i = keyHash & mask; slots[i].index; i = (i + 1) & mask) {
+            if (slots[i].hash != keyHash) continue;
+            const wsJsonFrozen* child = &children[slots[i].index - 1];
+            if (child->keyLength == keyLen && memcmp((const char*)child + child->keyOffset, key, keyLen) == 0) return child;
+        }
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < obj->count; i++) {
+        const wsJsonFrozen* child = &children[i];
+        if (child->keyLength == keyLen && memcmp((const char*)child + child->keyOffset, key, keyLen) == 0) {
+            return child;
+        }
+    }
+    return NULL;
+}
+
+const wsJsonFrozen* wsJsonFrozenGet(const wsJsonFrozen* obj, const char* key) {
+    if (!obj) {
+        WS_JSON_LOG_ERROR("Invalid input is NULL\n");
+        return NULL;
+    }
+    if (!key || !*key) return obj;
+
+    const char* start = key;
+    const char* dot;
+    const wsJsonFrozen* current = obj;
+
+    while (current && (dot = strchr(start, '.'))) {
+        current = _wsJsonFrozenField(current, start, (size_t)(dot - start), NULL);
+        start = dot + 1;
+    }
+
+    if (current && *start) {
+        current = _wsJsonFrozenField(current, start, strlen(start), NULL);
+    }
+    return current;
+}
+
+const wsJsonFrozen* wsJsonFrozenGetPath(const wsJsonFrozen* obj, const wsJsonPath* path) {
+    if (!obj || !path) {
+        WS_JSON_LOG_ERROR("Invalid input is NULL\n");
+        return NULL;
+    }
+
+    const wsJsonFrozen* current = obj;
+    for (int32_t i = 0; i < path->segmentCount && current; i++) {
+        const wsJsonPathSegment* segment = &path->segments[i];
+        if (segment->index >= 0) {
+            if (current->type != WS_JSON_ARRAY) {
+                WS_JSON_LOG_ERROR("Obj is not from type WS_JSON_ARRAY\n");
+                return NULL;
+            }
+            if ((uint32_t)segment->index >= current->count) return NULL;
+            current = &_wsJsonFrozenChildren(current)[segment->index];
+        }
+        else {
+            current = _wsJsonFrozenField(current, segment->key, segment->keyLength, &segment->hash);
+        }
+    }
+    return current;
+}
+
+const char* wsJsonFrozenGetString(const wsJsonFrozen* obj, const char* key, size_t* length) {
+    const wsJsonFrozen* node = wsJsonFrozenGet(obj, key);
+    if (node && node->type == WS_JSON_STRING) {
+        if (length) *length = node->count;
+        return (const char*)node + node->value;
+    }
+    if (length) *length = 0;
+    return NULL;
+}
+
+double wsJsonFrozenGetNumber(const wsJsonFrozen* obj, const char* key) {
+    const wsJsonFrozen* node = wsJsonFrozenGet(obj, key);
+    if (node && node->type == WS_JSON_NUMBER) {
+        if (node->flags & WS_JSON_FLAG_INTEGER) return (double)(int64_t)node->value;
+        double value;
+        memcpy(&value, &node->value, sizeof(double));
+        return value;
+    }
+    return WS_ERROR;
+}
+
+int64_t wsJsonFrozenGetInteger(const wsJsonFrozen* obj, const char* key) {
+    const wsJsonFrozen* node = wsJsonFrozenGet(obj, key);
+    if (node && node->type == WS_JSON_NUMBER) {
+        if (node->flags & WS_JSON_FLAG_INTEGER) return (int64_t)node->value;
+        double value;
+        memcpy(&value, &node->value, sizeof(double));
+        if (value != value) return 0;
+        if (value <= -9223372036854775808.0) return INT64_MIN;
+        if (value >= 9223372036854775808.0) return INT64_MAX;
+        return (int64_t)value;
+    }
+    return WS_ERROR;
+}
+
+bool wsJsonFrozenGetBool(const wsJsonFrozen* obj, const char* key) {
+    const wsJsonFrozen* node = wsJsonFrozenGet(obj, key);
+    if (node && node->type == WS_JSON_BOOL) {
+        return node->value != 0;
+    }
+    return WS_ERROR;
+}
+
+int32_t wsJsonFrozenGetArrayLen(const wsJsonFrozen* obj, const char* key) {
+    const wsJsonFrozen* node = wsJsonFrozenGet(obj, key);
+    if (node && node->type == WS_JSON_ARRAY) {
+        return (int32_t)node->count;
+    }
+    return WS_ERROR;
+}
+
+const wsJsonFrozen* wsJsonFrozenGetArrayAt(const wsJsonFrozen* obj, const char* key, int32_t index) {
+    const wsJsonFrozen* node = wsJsonFrozenGet(obj, key);
+    if (node && node->type == WS_JSON_ARRAY) {
+        return wsJsonFrozenChildAt(node, index);
+    }
+    return NULL;
+}
+
+const wsJsonFrozen* wsJsonFrozenChildAt(const wsJsonFrozen* obj, int32_t index) {
+    if (!obj || (obj->type != WS_JSON_OBJECT && obj->type != WS_JSON_ARRAY)) return NULL;
+    if (index < 0 || (uint32_t)index >= obj->count) return NULL;
+    return &_wsJsonFrozenChildren(obj)[index];
+}
+
+const char* wsJsonFrozenKey(const wsJsonFrozen* node) {
+    if (!node) return NULL;
+    return (const char*)node + node->keyOffset;
+}
+
+// Snapshot strings are NUL terminated, so views don't need WS_JSON_FLAG_NO_TERMINATOR
+// Thaws frozen without its children, arrays and objects get their final capacity
+static wsJson* _wsJsonThawShallow(const wsJsonFrozen* frozen, bool key, uint32_t flags) {
+    const char* keyString = key ? wsJsonFrozenKey(frozen) : NULL;
+    wsJson* node;
+    if (keyString && (flags & WS_JSON_PARSE_VIEWS)) {
+        node = _wsJsonAllocNode(frozen->type, NULL, 0);
+        if (node) {
+            node->key = keyString;
+            node->keyLength = frozen->keyLength;
+        }
+    }
+    else {
+        node = _wsJsonAllocNode(frozen->type, keyString, frozen->keyLength);
+    }
+    if (!node) {
+        WS_JSON_LOG_ERROR("Failed to allocate json node when thawing snapshot\n");
+        return NULL;
+    }
+
+    switch (frozen->type) {
+        case WS_JSON_OBJECT:
+        case WS_JSON_ARRAY: {
+            bool object = frozen->type == WS_JSON_OBJECT;
+            if (frozen->count) {
+                wsJson** children = _wsJsonNodeAlloc(node, sizeof(wsJson*) * frozen->count);
+                if (!children) {
+                    wsJsonFree(node);
+                    return NULL;
+                }
+                if (object) {
+                    node->object.children = children;
+                    node->object.childCapacity = (int32_t)frozen->count;
+                }
+                else {
+                    node->array.elements = children;
+                    node->array.elementCapacity = (int32_t)frozen->count;
+                }
+            }
+            break;
+        }
+        case WS_JSON_STRING: {
+            const char* string = (const char*)frozen + frozen->value;
+            if (flags & WS_JSON_PARSE_VIEWS) {
+                node->flags |= WS_JSON_FLAG_STRING_VIEW;
+                node->stringValue = (char*)string;
+            }
+            else {
+                node->stringValue = _wsJsonNodeStrndup(node, string, frozen->count);
+            }
+            node->stringLength = frozen->count;
+            if (!node->stringValue) {
+                wsJsonFree(node);
+                return NULL;
+            }
+            break;
+        }
+        case WS_JSON_NUMBER:
+            if (frozen->flags & WS_JSON_FLAG_INTEGER) {
+                node->flags |= WS_JSON_FLAG_INTEGER;
+                node->integerValue = (int64_t)frozen->value;
+                node->numberValue = (double)node->integerValue;
+            }
+            else {
+                memcpy(&node->numberValue, &frozen->value, sizeof(double));
+            }
+            break;
+        case WS_JSON_BOOL:
+            node->boolValue = frozen->value != 0;
+            break;
+        default:
+            break;
+    }
+    return node;
+}
+
+typedef struct _wsJsonThawFrame {
+    const wsJsonFrozen* frozen;
+    wsJson* node;
+    uint32_t index; // next child to thaw
+} _wsJsonThawFrame;
+
+static wsJson* _wsJsonThawNode(const wsJsonFrozen* frozen, uint32_t flags) {
+    wsJson* root = _wsJsonThawShallow(frozen, false, flags);
+    if (!root || !frozen->count || (root->type != WS_JSON_OBJECT && root->type != WS_JSON_ARRAY)) return root;
+
+    _wsJsonThawFrame inlineStack[_WS_JSON_INLINE_DEPTH];
+    _wsJsonThawFrame* stack = inlineStack;
+    int32_t capacity = _WS_JSON_INLINE_DEPTH;
+    int32_t depth = 1;
+    int32_t result = WS_OK;
+    stack[0].frozen = frozen;
+    stack[0].node = root;
+    stack[0].index = 0;
+
+    while (depth > 0) {
+        _wsJsonThawFrame* frame = &stack[depth - 1];
+        if (frame->index == frame->frozen->count) {
+            depth--;
+            continue;
+        }
+
+        bool object = frame->frozen->type == WS_JSON_OBJECT;
+        const wsJsonFrozen* child = &_wsJsonFrozenChildren(frame->frozen)[frame->index++];
+        wsJson* value = _wsJsonThawShallow(child, object, flags);
+        if (!value) {
+            result = WS_ERROR;
+            break;
+        }
+        if (object) wsJsonAddField(frame->node, value);
+        else wsJsonAddElement(frame->node, value);
+        if (!child->count || (child->type != WS_JSON_OBJECT && child->type != WS_JSON_ARRAY)) continue;
+
+        if (depth == capacity && _wsJsonStackGrow((void**)&stack, inlineStack, &capacity, sizeof(_wsJsonThawFrame)) != WS_OK) {
+            result = WS_ERROR;
+            break;
+        }
+        stack[depth].frozen = child;
+        stack[depth].node = value;
+        stack[depth].index = 0;
+        depth++;
+    }
+
+    if (stack != inlineStack) _wsJsonFree(stack);
+    if (result != WS_OK) {
+        wsJsonFree(root);
+        return NULL;
+    }
+    return root;
+}
+
+wsJson* wsJsonThaw(const wsJsonFrozen* node, uint32_t parseFlags) {
+    if (!node) {
+        WS_JSON_LOG_ERROR("Invalid input paramerter is NULL\n");
+        return NULL;
+    }
+    return _wsJsonThawNode(node, parseFlags);
+}
+
+/* 
+ *  Tape
+ *  Word layout: type character in the top byte, payload below it.
+ *  '{' '['          index behind the matching close word (low 32 bits) and child count (bits 32..55)
+ *  '}' ']'          index of the open word
+ *  '"' 'k'          offset of the string (or key) in the input, the next word holds the length
+ *  'l' 'd'          the next word holds the int64 or the double bits
+ *  't' 'f' 'n'      no payload
+ */
+#define _WS_JSON_TAPE_WORD(type, payload) (((uint64_t)(uint8_t)(type) << 56) | (uint64_t)(payload))
+#define _WS_JSON_TAPE_TYPE(word) ((char)((word) >> 56))
+#define _WS_JSON_TAPE_PAYLOAD(word) ((word) & 0x00FFFFFFFFFFFFFFULL)
+#define _WS_JSON_TAPE_MAX_COUNT 0xFFFFFF
+
+wsJsonTape* wsJsonTapeInit(void) {
+    wsJsonTape* tape = _wsJsonMalloc(sizeof(wsJsonTape));
+    if (!tape) {
+        WS_JSON_LOG_ERROR("Failed to allocate json tape\n");
+        return NULL;
+    }
+    memset(tape, 0, sizeof(wsJsonTape));
+    return tape;
+}
+
+void wsJsonTapeFree(wsJsonTape* tape) {
+    if (!tape) return;
+    _wsJsonFree(tape->words);
+    _wsJsonFree(tape->structurals);
+    _wsJsonFree(tape->stack);
+    _wsJsonFree(tape);
+}
+
+static int32_t _wsJsonTapeReserve(void** buffer, size_t* capacity, size_t needed, size_t elementSize) {
+    if (needed <= *capacity) return WS_OK;
+    size_t newCapacity = *capacity ? *capacity * 2 : 1024;
+    while (newCapacity < needed) newCapacity *= 2;
+    void* grown = _wsJsonRealloc(*buffer, newCapacity * elementSize);
+    if (!grown) {
+        WS_JSON_LOG_ERROR("Failed to grow json tape\n");
+        return WS_ERROR;
+    }
+    *buffer = grown;
+    *capacity = newCapacity;
+    return WS_OK;
+}
+
+// Bit i is the xor of bits 0..i, turns quote bits into "inside a string" bits
+static inline uint64_t _wsJsonPrefixXor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+// Classifies the 64 bytes at block, copying a shorter tail into a space padded buffer first
+static inline void _wsJsonClassifyBlock(const char* block, size_t available, _wsJsonBlockMasks* masks) {
+    _wsJsonClassifyFn classify = atomic_load_explicit(&_wsJsonClassifyImpl, memory_order_relaxed);
+    if (available >= 64) {
+        classify(block, masks);
+        return;
+    }
+    char tail[64];
+    memset(tail, ' ', sizeof(tail));
+    memcpy(tail, block, available);
+    classify(tail, masks);
+}
+
+// Removes escaped quotes from masks->quote and returns the bits inside strings (opening quote 
+// included), the carries continue runs of backslashes and strings across blocks
+static inline uint64_t _wsJsonBlockStrings(_wsJsonBlockMasks* masks, uint64_t* escapedCarry, uint64_t* inStringCarry) {
+    // Backslashes are rare, resolving runs of them one by one is cheap enough
+    uint64_t escaped = *escapedCarry;
+    uint64_t escapes = masks->backslash & ~escaped;
+    *escapedCarry = 0;
+    while (escapes) {
+        uint64_t bit = escapes & (0 - escapes);
+        uint64_t next = bit << 1;
+        if (next) escaped |= next;
+        else *escapedCarry = 1;
+        escapes &= ~(bit | next);
+    }
+
+    masks->quote &= ~escaped;
+    uint64_t inString = _wsJsonPrefixXor(masks->quote) ^ *inStringCarry;
+    *inStringCarry = (uint64_t)((int64_t)inString >> 63);
+    return inString;
+}
+
+// Stage 1: offsets of every unescaped quote, operator outside of strings and first byte of a scalar
+static int32_t _wsJsonTapeIndex(wsJsonTape* tape) {
+    const char* data = tape->data;
+    size_t length = tape->length;
+    uint64_t escapedCarry = 0;  // bit 0 when the previous block ended on an escaping backslash
+    uint64_t inStringCarry = 0; // all ones when the previous block ended inside a string
+    uint64_t scalarCarry = 0;   // bit 0 when the previous block ended inside a scalar
+    tape->structuralCount = 0;
+
+    for (size_t base = 0; base < length; base += 64) {
+        _wsJsonBlockMasks masks;
+        _wsJsonClassifyBlock(data + base, length - base, &masks);
+        uint64_t inString = _wsJsonBlockStrings(&masks, &escapedCarry, &inStringCarry);
+        uint64_t quote = masks.quote;
+
+        uint64_t scalar = ~(masks.op | masks.space | quote | inString);
+        uint64_t scalarStart = scalar & ~((scalar << 1) | scalarCarry);
+        scalarCarry = scalar >> 63;
+
+        uint64_t structurals = (masks.op & ~inString) | quote | scalarStart;
+        if (_wsJsonTapeReserve((void**)&tape->structurals, &tape->structuralCapacity, tape->structuralCount + 64, sizeof(uint32_t)) != WS_OK) {
+            return WS_ERROR;
+        }
+        uint32_t* out = tape->structurals + tape->structuralCount;
+        while (structurals) {
+            *out++ = (uint32_t)(base + WS_JSON_CTZ64(structurals));
+            structurals &= structurals - 1;
+        }
+        tape->structuralCount = out - tape->structurals;
+    }
+
+    if (inStringCarry) {
+        WS_JSON_LOG_ERROR("Failed to parse json: unterminated string\n");
+        return WS_ERROR;
+    }
+    return WS_OK;
+}
+
+// Number or literal between start and the next structural character
+static int32_t _wsJsonTapeScalar(wsJsonTape* tape, const char* start, const char* limit) {
+    uint64_t* words = tape->words + tape->wordCount;
+    const char* end;
+    switch (*start) {
+        case 't':
+            if (!parseLiteral(start, limit, "true", 4)) return WS_ERROR;
+            words[0] = _WS_JSON_TAPE_WORD('t', 0);
+            end = start + 4;
+            tape->wordCount += 1;
+            break;
+        case 'f':
+            if (!parseLiteral(start, limit, "false", 5)) return WS_ERROR;
+            words[0] = _WS_JSON_TAPE_WORD('f', 0);
+            end = start + 5;
+            tape->wordCount += 1;
+            break;
+        case 'n':
+            if (!parseLiteral(start, limit, "null", 4)) return WS_ERROR;
+            words[0] = _WS_JSON_TAPE_WORD('n', 0);
+            end = start + 4;
+            tape->wordCount += 1;
+            break;
+        default: {
+            double value;
+            int64_t integer;
+            bool isInteger;
+            end = _wsJsonParseNumber(start, limit, &value, &integer, &isInteger);
+            if (!end) return WS_ERROR;
+            if (isInteger) {
+                words[0] = _WS_JSON_TAPE_WORD('l', 0);
+                words[1] = (uint64_t)integer;
+            }
+            else {
+                words[0] = _WS_JSON_TAPE_WORD('d', 0);
+                memcpy(&words[1], &value, sizeof(double));
+            }
+            tape->wordCount += 2;
+            break;
+        }
+    }
+    return skipWhitespaces(end, limit) == limit ? WS_OK : WS_ERROR;
+}
+
+enum {
+    _WS_JSON_TAPE_VALUE,
+    _WS_JSON_TAPE_FIRST_VALUE, // after '[', value or ']'
+    _WS_JSON_TAPE_FIRST_KEY,   // after '{', key or '}'
+    _WS_JSON_TAPE_KEY,
+    _WS_JSON_TAPE_AFTER_VALUE
+};
+
+// Stage 2: walks the structurals with an explicit stack and writes the words
+static int32_t _wsJsonTapeBuild(wsJsonTape* tape) {
+    const char* data = tape->data;
+    const uint32_t* structurals = tape->structurals;
+    size_t count = tape->structuralCount;
+
+    // Every structural produces at most two words
+    tape->wordCount = 0;
+    if (_wsJsonTapeReserve((void**)&tape->words, &tape->wordCapacity, count * 2 + 2, sizeof(uint64_t)) != WS_OK) return WS_ERROR;
+    if (count == 0 || (data[structurals[0]] != '{' && data[structurals[0]] != '[')) {
+        WS_JSON_LOG_ERROR("Failed to parse json: root has to be an object or an array\n");
+        return WS_ERROR;
+    }
+
+    uint64_t* words = tape->words;
+    size_t depth = 0;
+    int32_t state = _WS_JSON_TAPE_VALUE;
+    size_t i = 0;
+
+    while (i < count) {
+        uint32_t position = structurals[i];
+        char c = data[position];
+
+        switch (state) {
+            case _WS_JSON_TAPE_FIRST_KEY:
+                if (c == '}') goto close;
+                // fallthrough
+            case _WS_JSON_TAPE_KEY: {
+                if (c != '"' || i + 2 >= count || data[structurals[i + 1]] != '"' || data[structurals[i + 2]] != ':') goto fail;
+                words[tape->wordCount++] = _WS_JSON_TAPE_WORD('k', position + 1);
+                words[tape->wordCount++] = structurals[i + 1] - position - 1;
+                i += 3;
+                state = _WS_JSON_TAPE_VALUE;
+                continue;
+            }
+            case _WS_JSON_TAPE_AFTER_VALUE: {
+                char open = _WS_JSON_TAPE_TYPE(words[tape->stack[depth - 1] & 0xFFFFFFFF]);
+                if (c == ',') {
+                    state = open == '{' ? _WS_JSON_TAPE_KEY : _WS_JSON_TAPE_VALUE;
+                    i++;
+                    continue;
+                }
+                if ((open == '{' && c == '}') || (open == '[' && c == ']')) goto close;
+                goto fail;
+            }
+            case _WS_JSON_TAPE_FIRST_VALUE:
+                if (c == ']') goto close;
+                // fallthrough
+            default:
+                break;
+        }
+
+        // A value starts here
+        if (depth) tape->stack[depth - 1] += 1ULL << 32;
+        if (c == '{' || c == '[') {
+            if (depth >= WS_JSON_MAX_DEPTH) {
+                WS_JSON_LOG_ERROR("Json nesting is deeper than WS_JSON_MAX_DEPTH (%d)\n", WS_JSON_MAX_DEPTH);
+                return WS_ERROR;
+            }
+            if (_wsJsonTapeReserve((void**)&tape->stack, &tape->stackCapacity, depth + 1, sizeof(uint64_t)) != WS_OK) return WS_ERROR;
+            tape->stack[depth++] = tape->wordCount;
+            words[tape->wordCount++] = _WS_JSON_TAPE_WORD(c, 0);
+            state = c == '{' ? _WS_JSON_TAPE_FIRST_KEY : _WS_JSON_TAPE_FIRST_VALUE;
+            i++;
+            continue;
+        }
+        if (c == '"') {
+            if (i + 1 >= count || data[structurals[i + 1]] != '"') goto fail;
+            words[tape->wordCount++] = _WS_JSON_TAPE_WORD('"', position + 1);
+            words[tape->wordCount++] = structurals[i + 1] - position - 1;
+            i += 2;
+        }
+        else {
+            const char* limit = i + 1 < count ? data + structurals[i + 1] : data + tape->length;
+            if (c == '}' || c == ']' || c == ',' || c == ':' || _wsJsonTapeScalar(tape, data + position, limit) != WS_OK) goto fail;
+            i++;
+        }
+        state = _WS_JSON_TAPE_AFTER_VALUE;
+        continue;
+
+    close: {
+            uint64_t entry = tape->stack[--depth];
+            size_t openIndex = (size_t)(entry & 0xFFFFFFFF);
+            uint64_t children = entry >> 32;
+            if (children > _WS_JSON_TAPE_MAX_COUNT) children = _WS_JSON_TAPE_MAX_COUNT;
+            words[tape->wordCount] = _WS_JSON_TAPE_WORD(c, openIndex);
+            tape->wordCount++;
+            words[openIndex] = _WS_JSON_TAPE_WORD(_WS_JSON_TAPE_TYPE(words[openIndex]), (children << 32) | tape->wordCount);
+            i++;
+            if (!depth) {
+                if (i != count) {
+                    WS_JSON_LOG_ERROR("Failed to parse json: unexpected data after the root\n");
+                    return WS_ERROR;
+                }
+                return WS_OK;
+            }
+            state = _WS_JSON_TAPE_AFTER_VALUE;
+            continue;
+        }
+    }
+
+    WS_JSON_LOG_ERROR("Failed to parse json: unexpected end of input\n");
+    return WS_ERROR;
+
+fail:
+    WS_JSON_LOG_ERROR("Failed to parse json: unexpected '%c' at offset %u\n", data[structurals[i]], structurals[i]);
+    return WS_ERROR;
+}
+
+int32_t wsJsonTapeParse(wsJsonTape* tape, const char* data, size_t length) {
+    if (!tape || !data) {
+        WS_JSON_LOG_ERROR("Invalid input paramerter is NULL\n");
+        return WS_ERROR;
+    }
+    if (length >= UINT32_MAX) {
+        WS_JSON_LOG_ERROR("Json input is too large for the tape\n");
+        return WS_ERROR;
+    }
+    _WS_JSON_STATS_START(start);
+    tape->data = data;
+    tape->length = length;
+    tape->wordCount = 0;
+    int32_t result = WS_OK;
+    if (_wsJsonTapeIndex(tape) != WS_OK || _wsJsonTapeBuild(tape) != WS_OK) {
+        tape->wordCount = 0;
+        result = WS_ERROR;
+    }
+    _WS_JSON_STATS_TIME(parse, start, length);
+    return result;
+}
+
+static inline bool _wsJsonTapeValid(const wsJsonTape* tape, size_t index) {
+    return tape && index < tape->wordCount;
+}
+
+wsJsonType wsJsonTapeType(const wsJsonTape* tape, size_t index) {
+    if (!_wsJsonTapeValid(tape, index)) return WS_JSON_NULL;
+    switch (_WS_JSON_TAPE_TYPE(tape->words[index])) {
+        case '"': return WS_JSON_STRING;
+        case 'l': case 'd': return WS_JSON_NUMBER;
+        case '{': return WS_JSON_OBJECT;
+        case '[': return WS_JSON_ARRAY;
+        case 't': case 'f': return WS_JSON_BOOL;
+        default: return WS_JSON_NULL;
+    }
+}
+
+// Index of the word behind the value
+static size_t _wsJsonTapeSkip(const wsJsonTape* tape, size_t index) {
+    uint64_t word = tape->words[index];
+    switch (_WS_JSON_TAPE_TYPE(word)) {
+        case '{': case '[': return (size_t)(word & 0xFFFFFFFF);
+        case '"': case 'k': case 'l': case 'd': return index + 2;
+        default: return index + 1;
+    }
+}
+
+// Steps over the key in objects, WS_JSON_TAPE_END at the close word
+static size_t _wsJsonTapeValueAt(const wsJsonTape* tape, size_t index) {
+    if (index >= tape->wordCount) return WS_JSON_TAPE_END;
+    switch (_WS_JSON_TAPE_TYPE(tape->words[index])) {
+        case 'k': return index + 2;
+        case '}': case ']': return WS_JSON_TAPE_END;
+        default: return index;
+    }
+}
+
+size_t wsJsonTapeFirst(const wsJsonTape* tape, size_t container) {
+    if (!_wsJsonTapeValid(tape, container)) return WS_JSON_TAPE_END;
+    char type = _WS_JSON_TAPE_TYPE(tape->words[container]);
+    if (type != '{' && type != '[') return WS_JSON_TAPE_END;
+    return _wsJsonTapeValueAt(tape, container + 1);
+}
+
+size_t wsJsonTapeNext(const wsJsonTape* tape, size_t index) {
+    if (!_wsJsonTapeValid(tape, index) || index == 0) return WS_JSON_TAPE_END;
+    return _wsJsonTapeValueAt(tape, _wsJsonTapeSkip(tape, index));
+}
+
+int32_t wsJsonTapeCount(const wsJsonTape* tape, size_t container) {
+    if (!_wsJsonTapeValid(tape, container)) return WS_ERROR;
+    uint64_t word = tape->words[container];
+    char type = _WS_JSON_TAPE_TYPE(word);
+    if (type != '{' && type != '[') return WS_ERROR;
+
+    int32_t count = (int32_t)((word >> 32) & _WS_JSON_TAPE_MAX_COUNT);
+    if (count < _WS_JSON_TAPE_MAX_COUNT) return count;
+    // Saturated, count by walking
+    count = 0;
+    for (size_t child = wsJsonTapeFirst(tape, container); child != WS_JSON_TAPE_END; child = wsJsonTapeNext(tape, child)) count++;
+    return count;
+}
+
+const char* wsJsonTapeKey(const wsJsonTape* tape, size_t index, size_t* length) {
+    if (!_wsJsonTapeValid(tape, index) || index < 2 || _WS_JSON_TAPE_TYPE(tape->words[index - 2]) != 'k') return NULL;
+    if (length) *length = (size_t)tape->words[index - 1];
+    return tape->data + _WS_JSON_TAPE_PAYLOAD(tape->words[index - 2]);
+}
+
+size_t wsJsonTapeGet(const wsJsonTape* tape, size_t object, const char* key) {
+    if (!_wsJsonTapeValid(tape, object) || !key || _WS_JSON_TAPE_TYPE(tape->words[object]) != '{') return WS_JSON_TAPE_END;
+    size_t keyLength = strlen(key);
+    for (size_t child = wsJsonTapeFirst(tape, object); child != WS_JSON_TAPE_END; child = wsJsonTapeNext(tape, child)) {
+        size_t childKeyLength = 0;
+        const char* childKey = wsJsonTapeKey(tape, child, &childKeyLength);
+        if (childKey && childKeyLength == keyLength && memcmp(childKey, key, keyLength) == 0) return child;
+    }
+    return WS_JSON_TAPE_END;
+}
+
+size_t wsJsonTapeAt(const wsJsonTape* tape, size_t array, int32_t position) {
+    if (!_wsJsonTapeValid(tape, array) || position < 0 || _WS_JSON_TAPE_TYPE(tape->words[array]) != '[') return WS_JSON_TAPE_END;
+    size_t child = wsJsonTapeFirst(tape, array);
+    while (position-- > 0 && child != WS_JSON_TAPE_END) child = wsJsonTapeNext(tape, child);
+    return child;
+}
+
+const char* wsJsonTapeString(const wsJsonTape* tape, size_t index, size_t* length) {
+    if (!_wsJsonTapeValid(tape, index) || _WS_JSON_TAPE_TYPE(tape->words[index]) != '"') return NULL;
+    if (length) *length = (size_t)tape->words[index + 1];
+    return tape->data + _WS_JSON_TAPE_PAYLOAD(tape->words[index]);
+}
+
+double wsJsonTapeNumber(const wsJsonTape* tape, size_t index) {
+    if (!_wsJsonTapeValid(tape, index)) return WS_ERROR;
+    char type = _WS_JSON_TAPE_TYPE(tape->words[index]);
+    if (type == 'l') return (double)(int64_t)tape->words[index + 1];
+    if (type == 'd') {
+        double value;
+        memcpy(&value, &tape->words[index + 1], sizeof(double));
+        return value;
+    }
+    return WS_ERROR;
+}
+
+int64_t wsJsonTapeInteger(const wsJsonTape* tape, size_t index) {
+    if (!_wsJsonTapeValid(tape, index)) return WS_ERROR;
+    char type = _WS_JSON_TAPE_TYPE(tape->words[index]);
+    if (type == 'l') return (int64_t)tape->words[index + 1];
+    if (type == 'd') {
+        double value;
+        memcpy(&value, &tape->words[index + 1], sizeof(double));
+        if (value != value) return 0;
+        if (value <= -9223372036854775808.0) return INT64_MIN;
+        if (value >= 9223372036854775808.0) return INT64_MAX;
+        return (int64_t)value;
+    }
+    return WS_ERROR;
+}
+
+bool wsJsonTapeBool(const wsJsonTape* tape, size_t index) {
+    if (!_wsJsonTapeValid(tape, index)) return WS_ERROR;
+    char type = _WS_JSON_TAPE_TYPE(tape->words[index]);
+    if (type == 't') return true;
+    if (type == 'f') return false;
+    return WS_ERROR;
+}
+
+// Converts the value at index without its children
+static wsJson* _wsJsonTapeShallow(const wsJsonTape* tape, size_t index, const char* key, size_t keyLen, uint32_t flags) {
+    uint64_t word = tape->words[index];
+    char type = _WS_JSON_TAPE_TYPE(word);
+    wsJson* node = parseAllocNode(wsJsonTapeType(tape, index), key, keyLen, flags);
+    if (!node) {
+        WS_JSON_LOG_ERROR("Failed to allocate json node when converting tape\n");
+        return NULL;
+    }
+
+    switch (type) {
+        case '"': {
+            if (flags & WS_JSON_PARSE_VIEWS) node->flags |= WS_JSON_FLAG_STRING_VIEW;
+            size_t length;
+            const char* string = wsJsonTapeString(tape, index, &length);
+            node->stringValue = parseView(node, string, length, flags);
+            node->stringLength = (uint32_t)length;
+            if (!node->stringValue) {
+                wsJsonFree(node);
+                return NULL;
+            }
+            break;
+        }
+        case 'l':
+            node->flags |= WS_JSON_FLAG_INTEGER;
+            node->integerValue = (int64_t)tape->words[index + 1];
+            node->numberValue = (double)node->integerValue;
+            break;
+        case 'd':
+            memcpy(&node->numberValue, &tape->words[index + 1], sizeof(double));
+            break;
+        case 't':
+        case 'f':
+            node->boolValue = type == 't';
+            break;
+        default:
+            break;
+    }
+    return node;
+}
+
+typedef struct _wsJsonTapeFrame {
+    wsJson* node;
+    size_t child; // tape index of the next child to convert
+} _wsJsonTapeFrame;
+
+static wsJson* _wsJsonTapeNode(const wsJsonTape* tape, size_t index, uint32_t flags) {
+    wsJson* root = _wsJsonTapeShallow(tape, index, NULL, 0, flags);
+    if (!root || (root->type != WS_JSON_OBJECT && root->type != WS_JSON_ARRAY)) return root;
+
+    _wsJsonTapeFrame inlineStack[_WS_JSON_INLINE_DEPTH];
+    _wsJsonTapeFrame* stack = inlineStack;
+    int32_t capacity = _WS_JSON_INLINE_DEPTH;
+    int32_t depth = 1;
+    int32_t result = WS_OK;
+    stack[0].node = root;
+    stack[0].child = wsJsonTapeFirst(tape, index);
+
+    while (depth > 0) {
+        _wsJsonTapeFrame* frame = &stack[depth - 1];
+        if (frame->child == WS_JSON_TAPE_END) {
+            depth--;
+            continue;
+        }
+
+        size_t child = frame->child;
+        frame->child = wsJsonTapeNext(tape, child);
+        bool object = frame->node->type == WS_JSON_OBJECT;
+        size_t childKeyLength = 0;
+        const char* childKey = object ? wsJsonTapeKey(tape, child, &childKeyLength) : NULL;
+        wsJson* value = _wsJsonTapeShallow(tape, child, childKey, childKeyLength, flags);
+        if (!value) {
+            result = WS_ERROR;
+            break;
+        }
+        if (object) wsJsonAddField(frame->node, value);
+        else wsJsonAddElement(frame->node, value);
+        if (value->type != WS_JSON_OBJECT && value->type != WS_JSON_ARRAY) continue;
+
+        if (depth == capacity && _wsJsonStackGrow((void**)&stack, inlineStack, &capacity, sizeof(_wsJsonTapeFrame)) != WS_OK) {
+            result = WS_ERROR;
+            break;
+        }
+        stack[depth].node = value;
+        stack[depth].child = wsJsonTapeFirst(tape, child);
+        depth++;
+    }
+
+    if (stack != inlineStack) _wsJsonFree(stack);
+    if (result != WS_OK) {
+        wsJsonFree(root);
+        return NULL;
+    }
+    return root;
+}
+
+wsJson* wsJsonTapeToJson(const wsJsonTape* tape, size_t index, uint32_t parseFlags) {
+    if (!_wsJsonTapeValid(tape, index)) {
+        WS_JSON_LOG_ERROR("Invalid tape index\n");
+        return NULL;
+    }
+    return _wsJsonTapeNode(tape, index, parseFlags & ~_WS_JSON_PARSE_IN_SITU);
+}
+
+/* Lazy documents */
+int32_t wsJsonLazyInit(wsJsonLazy* doc, const char* data, size_t length, uint32_t parseFlags) {
+    if (!doc || !data) {
+        WS_JSON_LOG_ERROR("Invalid input paramerter is NULL\n");
+        return WS_ERROR;
+    }
+    const char* end = data + length;
+    const char* root = skipWhitespaces(data, end);
+    char c = parsePeek(root, end);
+    if (c != '{' && c != '[') {
+        WS_JSON_LOG_ERROR("Failed to parse json: root has to be an object or an array\n");
+        return WS_ERROR;
+    }
+    doc->data = root;
+    doc->end = end;
+    doc->parseFlags = parseFlags & ~_WS_JSON_PARSE_IN_SITU;
+    return WS_OK;
+}
+
+// Returns the end of the object or array at string, strings are masked out 64 bytes at a time 
+// and only the brackets outside of them are looked at
+static const char* _wsJsonLazySkipContainer(const char* string, const char* end) {
+    uint64_t escapedCarry = 0;
+    uint64_t inStringCarry = 0;
+    int64_t depth = 0;
+
+    for (const char* block = string; block < end; block += 64) {
+        size_t available = (size_t)(end - block);
+        _wsJsonBlockMasks masks;
+        _wsJsonClassifyBlock(block, available, &masks);
+        uint64_t inString = _wsJsonBlockStrings(&masks, &escapedCarry, &inStringCarry);
+        uint64_t operators = masks.op & ~inString;
+        if (available < 64) operators &= (1ULL << available) - 1;
+
+        while (operators) {
+            const char* position = block + WS_JSON_CTZ64(operators);
+            operators &= operators - 1;
+            char c = *position;
+            if (c == '{' || c == '[') depth++;
+            else if (c == '}' || c == ']') {
+                if (--depth == 0) return position + 1;
+            }
+        }
+    }
+    return NULL;
+}
+
+// Returns the end of the value at string, NULL if it is cut off
+static const char* _wsJsonLazySkip(const char* string, const char* end) {
+    char c = parsePeek(string, end);
+    if (c == '{' || c == '[') return _wsJsonLazySkipContainer(string, end);
+    if (c == '"') {
+        size_t length;
+        const char* start = parseString(&string, end, &length);
+        return start + length < end && start[length] == '"' ? string : NULL;
+    }
+
+    const char* start = string;
+    while (string < end) {
+        c = *string;
+        if (c == ',' || c == '}' || c == ']' || _wsJsonIsSpace(c)) break;
+        string++;
+    }
+    return string != start ? string : NULL;
+}
+
+// Start of the value of key in the object at string, inputKey is set to the key inside the input
+static const char* _wsJsonLazyField(const char* string, const char* end, const char* key, size_t keyLength, const char** inputKey) {
+    if (parsePeek(string, end) != '{') return NULL;
+    string++;
+
+    for (;;) {
+        string = skipWhitespaces(string, end);
+        if (parsePeek(string, end) != '"') return NULL;
+        size_t fieldKeyLength;
+        const char* fieldKey = parseString(&string, end, &fieldKeyLength);
+        string = skipWhitespaces(string, end);
+        if (parsePeek(string, end) != ':') return NULL;
+        string = skipWhitespaces(string + 1, end);
+        if (fieldKeyLength == keyLength && memcmp(fieldKey, key, keyLength) == 0) {
+            *inputKey = fieldKey;
+            return string;
+        }
+
+        string = _wsJsonLazySkip(string, end);
+        if (!string) return NULL;
+        string = skipWhitespaces(string, end);
+        if (parsePeek(string, end) != ',') return NULL;
+        string++;
+    }
+}
+
+// Start of the element at index in the array at string
+static const char* _wsJsonLazyElement(const char* string, const char* end, int32_t index) {
+    if (parsePeek(string, end) != '[') return NULL;
+    string = skipWhitespaces(string + 1, end);
+    if (parsePeek(string, end) == ']') return NULL;
+
+    for (int32_t i = 0; i < index; i++) {
+        string = _wsJsonLazySkip(string, end);
+        if (!string) return NULL;
+        string = skipWhitespaces(string, end);
+        if (parsePeek(string, end) != ',') return NULL;
+        string = skipWhitespaces(string + 1, end);
+    }
+    return string;
+}
+
+// Start of the value at the dotted key, lastKey is set to its key inside the input
+static const char* _wsJsonLazyFind(const wsJsonLazy* doc, const char* key, const char** lastKey, size_t* lastKeyLength) {
+    if (!doc || !key) {
+        WS_JSON_LOG_ERROR("Invalid input is NULL\n");
+        return NULL;
+    }
+    const char* current = doc->data;
+    const char* start = key;
+    const char* dot;
+
+    *lastKey = NULL;
+    *lastKeyLength = 0;
+    while (current && (dot = strchr(start, '.'))) {
+        current = _wsJsonLazyField(current, doc->end, start, (size_t)(dot - start), lastKey);
+        start = dot + 1;
+    }
+    if (current && *start) {
+        *lastKeyLength = strlen(start);
+        current = _wsJsonLazyField(current, doc->end, start, *lastKeyLength, lastKey);
+    }
+    return current;
+}
+
+static wsJson* _wsJsonLazyMaterialize(const wsJsonLazy* doc, const char* value, const char* key, size_t keyLength) {
+    if (!value) return NULL;
+    return parseValue(&value, doc->end, key, keyLength, doc->parseFlags);
+}
+
+wsJson* wsJsonLazyGet(const wsJsonLazy* doc, const char* key) {
+    const char* lastKey;
+    size_t lastKeyLength;
+    const char* value = _wsJsonLazyFind(doc, key, &lastKey, &lastKeyLength);
+    return _wsJsonLazyMaterialize(doc, value, lastKey, lastKeyLength);
+}
+
+wsJson* wsJsonLazyGetPath(const wsJsonLazy* doc, const wsJsonPath* path) {
+    if (!doc || !path) {
+        WS_JSON_LOG_ERROR("Invalid input is NULL\n");
+        return NULL;
+    }
+
+    const char* current = doc->data;
+    const char* key = NULL;
+    size_t keyLength = 0;
+    for (int32_t i = 0; i < path->segmentCount && current; i++) {
+        const wsJsonPathSegment* segment = &path->segments[i];
+        if (segment->index >= 0) {
+            current = _wsJsonLazyElement(current, doc->end, segment->index);
+            key = NULL;
+            keyLength = 0;
+        }
+        else {
+            current = _wsJsonLazyField(current, doc->end, segment->key, segment->keyLength, &key);
+            keyLength = segment->keyLength;
+        }
+    }
+    return _wsJsonLazyMaterialize(doc, current, key, keyLength);
+}
+
+const char* wsJsonLazyGetStringView(const wsJsonLazy* doc, const char* key, size_t* length) {
+    const char* lastKey;
+    size_t lastKeyLength;
+    const char* value = _wsJsonLazyFind(doc, key, &lastKey, &lastKeyLength);
+    if (!value || parsePeek(value, doc->end) != '"') {
+        if (length) *length = 0;
+        return NULL;
+    }
+    size_t valueLength;
+    const char* string = parseString(&value, doc->end, &valueLength);
+    if (length) *length = valueLength;
+    return string;
+}
+
+double wsJsonLazyGetNumber(const wsJsonLazy* doc, const char* key) {
+    const char* lastKey;
+    size_t lastKeyLength;
+    const char* value = _wsJsonLazyFind(doc, key, &lastKey, &lastKeyLength);
+    double number;
+    int64_t integer;
+    bool isInteger;
+    if (!value || !_wsJsonParseNumber(value, doc->end, &number, &integer, &isInteger)) return WS_ERROR;
+    return number;
+}
+
+int64_t wsJsonLazyGetInteger(const wsJsonLazy* doc, const char* key) {
+    const char* lastKey;
+    size_t lastKeyLength;
+    const char* value = _wsJsonLazyFind(doc, key, &lastKey, &lastKeyLength);
+    double number;
+    int64_t integer;
+    bool isInteger;
+    if (!value || !_wsJsonParseNumber(value, doc->end, &number, &integer, &isInteger)) return WS_ERROR;
+    if (isInteger) return integer;
+    if (number != number) return 0;
+    if (number <= -9223372036854775808.0) return INT64_MIN;
+    if (number >= 9223372036854775808.0) return INT64_MAX;
+    return (int64_t)number;
+}
+
+bool wsJsonLazyGetBool(const wsJsonLazy* doc, const char* key) {
+    const char* lastKey;
+    size_t lastKeyLength;
+    const char* value = _wsJsonLazyFind(doc, key, &lastKey, &lastKeyLength);
+    if (!value) return WS_ERROR;
+    if (parseLiteral(value, doc->end, "true", 4)) return true;
+    if (parseLiteral(value, doc->end, "false", 5)) return false;
+    return WS_ERROR;
+}
+
+/* Struct bindings */
+#define _WS_JSON_BIND_NEW 0
+#define _WS_JSON_BIND_BUILDING 1
+#define _WS_JSON_BIND_READY 2
+#define _WS_JSON_BIND_BROKEN 3
+
+// What the binding hash looks at, length and three bytes are enough to tell most field names apart
+static inline uint32_t _wsJsonBindSample(const char* key, size_t length, bool fullHash) {
+    if (fullHash) return _wsJsonHashKey(key, length);
+    uint32_t sample = (uint32_t)length;
+    if (length) {
+        sample ^= (uint32_t)(unsigned char)key[0] << 8 ^ (uint32_t)(unsigned char)key[length / 2] << 16 ^
+                  (uint32_t)(unsigned char)key[length - 1] << 24;
+    }
+    return sample;
+}
+
+// Tries multipliers for every table size until all names land in their own slot
+static bool _wsJsonBindSearch(wsJsonBinding* binding, bool fullHash) {
+    int32_t minBits = 1;
+    while ((1 << minBits) < binding->fieldCount * 2) minBits++;
+    for (int32_t bits = minBits; bits <= 8; bits++) {
+        for (uint32_t attempt = 1; attempt <= 256; attempt++) {
+            uint32_t multiplier = (uint32_t)(attempt * 0x9E3779B97F4A7C15ull >> 32) | 1;
+            memset(binding->slots, 0, sizeof(binding->slots));
+            int32_t i = 0;
+            for (; i < binding->fieldCount; i++) {
+                const wsJsonBindField* field = &binding->fields[i];
+                uint32_t slot = (_wsJsonBindSample(field->name, field->nameLength, fullHash) * multiplier) >> (32 - bits);
+                if (binding->slots[slot]) break;
+                binding->slots[slot] = (uint8_t)(i + 1);
+            }
+            if (i == binding->fieldCount) {
+                binding->multiplier = multiplier;
+                binding->shift = 32 - bits;
+                binding->mask = (1u << bits) - 1;
+                binding->fullHash = fullHash;
+                binding->perfect = true;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static bool _wsJsonBindPrepare(wsJsonBinding* binding);
+
+static bool _wsJsonBindBuild(wsJsonBinding* binding) {
+    binding->fields = binding->describe(&binding->fieldCount);
+    if (binding->fieldCount > WS_JSON_BIND_MAX_FIELDS) {
+        WS_JSON_LOG_ERROR("Json binding has more than WS_JSON_BIND_MAX_FIELDS (%d) fields\n", WS_JSON_BIND_MAX_FIELDS);
+        return false;
+    }
+    for (int32_t i = 0; i < binding->fieldCount; i++) {
+        const wsJsonBindField* field = &binding->fields[i];
+        bool valid;
+        switch (field->type) {
+            case WS_JSON_BIND_INTEGER:
+                valid = field->size == 1 || field->size == 2 || field->size == 4 || field->size == 8;
+                break;
+            case WS_JSON_BIND_NUMBER:
+                valid = field->size == sizeof(float) || field->size == sizeof(double);
+                break;
+            case WS_JSON_BIND_BOOL:
+                valid = field->size == sizeof(bool);
+                break;
+            case WS_JSON_BIND_STRING:
+                valid = field->size > 0;
+                break;
+            case WS_JSON_BIND_OBJECT:
+                valid = field->binding && field->binding->size == field->size && _wsJsonBindPrepare(field->binding);
+                break;
+            default:
+                valid = false;
+                break;
+        }
+        if (!valid) {
+            WS_JSON_LOG_ERROR("Json binding field %s doesn't match its struct member\n", field->name);
+            return false;
+        }
+    }
+
+    if (_wsJsonBindSearch(binding, false) || _wsJsonBindSearch(binding, true)) return true;
+
+    // Lots of fields, fall back to probing the biggest table
+    memset(binding->slots, 0, sizeof(binding->slots));
+    binding->multiplier = 0x9E3779B1u;
+    binding->shift = 24;
+    binding->mask = 255;
+    binding->fullHash = true;
+    binding->perfect = false;
+    for (int32_t i = 0; i < binding->fieldCount; i++) {
+        const wsJsonBindField* field = &binding->fields[i];
+        uint32_t slot = (_wsJsonHashKey(field->name, field->nameLength) * binding->multiplier) >> binding->shift;
+        while (binding->slots[slot]) slot = (slot + 1) & binding->mask;
+        binding->slots[slot] = (uint8_t)(i + 1);
+    }
+    return true;
+}
+
+// Builds the hash on first use, threads that come in meanwhile wait for it
+static bool _wsJsonBindPrepare(wsJsonBinding* binding) {
+    int32_t state = atomic_load_explicit(&binding->state, memory_order_acquire);
+    if (state == _WS_JSON_BIND_READY) return true;
+    if (state == _WS_JSON_BIND_NEW && atomic_compare_exchange_strong(&binding->state, &state, _WS_JSON_BIND_BUILDING)) {
+        bool built = _wsJsonBindBuild(binding);
+        atomic_store_explicit(&binding->state, built ? _WS_JSON_BIND_READY : _WS_JSON_BIND_BROKEN, memory_order_release);
+        return built;
+    }
+    while ((state = atomic_load_explicit(&binding->state, memory_order_acquire)) == _WS_JSON_BIND_BUILDING) thrd_yield();
+    return state == _WS_JSON_BIND_READY;
+}
+
+static const wsJsonBindField* _wsJsonBindFind(const wsJsonBinding* binding, const char* key, size_t length) {
+    uint32_t slot = (_wsJsonBindSample(key, length, binding->fullHash) * binding->multiplier) >> binding->shift;
+    for (;;) {
+        uint8_t index = binding->slots[slot];
+        if (!index) return NULL;
+        const wsJsonBindField* field = &binding->fields[index - 1];
+        if (field->nameLength == length && memcmp(field->name, key, length) == 0) return field;
+        if (binding->perfect) return NULL;
+        slot = (slot + 1) & binding->mask;
+    }
+}
+
+static bool _wsJsonBindStoreInteger(void* member, size_t size, int64_t value) {
+    switch (size) {
+        case 1:
+            if (value < INT8_MIN || value > INT8_MAX) return false;
+            *(int8_t*)member = (int8_t)value;
+            return true;
+        case 2:
+            if (value < INT16_MIN || value > INT16_MAX) return false;
+            *(int16_t*)member = (int16_t)value;
+            return true;
+        case 4:
+            if (value < INT32_MIN || value > INT32_MAX) return false;
+            *(int32_t*)member = (int32_t)value;
+            return true;
+        default:
+            *(int64_t*)member = value;
+            return true;
+    }
+}
+
+static int64_t _wsJsonBindLoadInteger(const void* member, size_t size) {
+    switch (size) {
+        case 1: return *(const int8_t*)member;
+        case 2: return *(const int16_t*)member;
+        case 4: return *(const int32_t*)member;
+        default: return *(const int64_t*)member;
+    }
+}
+
+static const char* _wsJsonBindParseObject(wsJsonBinding* binding, const char* string, const char* end, unsigned char* out);
+
+// Returns the end of the value, NULL if it doesn't fit the member
+static const char* _wsJsonBindParseValue(const wsJsonBindField* field, const char* string, const char* end, unsigned char* out) {
+    unsigned char* member = out + field->offset;
+    if (parseLiteral(string, end, "null", 4)) {
+        memset(member, 0, field->size);
+        return string + 4;
+    }
+
+    switch (field->type) {
+        case WS_JSON_BIND_INTEGER:
+        case WS_JSON_BIND_NUMBER: {
+            double number;
+            int64_t integer;
+            bool isInteger;
+            const char* next = _wsJsonParseNumber(string, end, &number, &integer, &isInteger);
+            if (!next) return NULL;
+            if (field->type == WS_JSON_BIND_INTEGER) {
+                return isInteger && _wsJsonBindStoreInteger(member, field->size, integer) ? next : NULL;
+            }
+            if (field->size == sizeof(float)) {
+                if (isinf((float)number)) return NULL;
+                *(float*)member = (float)number;
+            }
+            else *(double*)member = number;
+            return next;
+        }
+        case WS_JSON_BIND_BOOL:
+            if (parseLiteral(string, end, "true", 4)) {
+                *(bool*)member = true;
+                return string + 4;
+            }
+            if (parseLiteral(string, end, "false", 5)) {
+                *(bool*)member = false;
+                return string + 5;
+            }
+            return NULL;
+        case WS_JSON_BIND_STRING: {
+            if (parsePeek(string, end) != '"') return NULL;
+            size_t length;
+            const char* start = parseString(&string, end, &length);
+            if (start + length >= end || start[length] != '"') return NULL;
+            if (!memchr(start, '\\', length)) {
+                if (length >= field->size) return NULL;
+                memcpy(member, start, length);
+                member[length] = '\0';
+                return string;
+            }
+
+            // Escapes only get shorter, a string too long for the member can still fit once decoded
+            char stackBuffer[256];
+            char* buffer = length <= sizeof(stackBuffer) ? stackBuffer : _wsJsonMalloc(length);
+            if (!buffer) return NULL;
+            size_t decoded = _wsJsonUnescape(start, length, buffer);
+            if (decoded < field->size) {
+                memcpy(member, buffer, decoded);
+                member[decoded] = '\0';
+            }
+            if (buffer != stackBuffer) _wsJsonFree(buffer);
+            return decoded < field->size ? string : NULL;
+        }
+        case WS_JSON_BIND_OBJECT:
+            return _wsJsonBindParseObject(field->binding, string, end, member);
+        default:
+            return NULL;
+    }
+}
+
+// Nested bindings recurse, their depth is fixed by the struct types and not by the input
+static const char* _wsJsonBindParseObject(wsJsonBinding* binding, const char* string, const char* end, unsigned char* out) {
+    if (parsePeek(string, end) != '{') {
+        WS_JSON_LOG_ERROR("Failed to parse json into struct: expected an object\n");
+        return NULL;
+    }
+    string = skipWhitespaces(string + 1, end);
+    if (parsePeek(string, end) == '}') return string + 1;
+
+    for (;;) {
+        if (parsePeek(string, end) != '"') {
+            WS_JSON_LOG_ERROR("Failed to parse json into struct: expected a key\n");
+            return NULL;
+        }
+        size_t keyLength;
+        const char* key = parseString(&string, end, &keyLength);
+        string = skipWhitespaces(string, end);
+        if (parsePeek(string, end) != ':') {
+            WS_JSON_LOG_ERROR("Failed to parse json into struct: expected ':'\n");
+            return NULL;
+        }
+        string = skipWhitespaces(string + 1, end);
+
+        const wsJsonBindField* field = _wsJsonBindFind(binding, key, keyLength);
+        if (field) {
+            string = _wsJsonBindParseValue(field, string, end, out);
+            if (!string) {
+                WS_JSON_LOG_ERROR("Failed to parse json into struct: value of %s doesn't fit its member\n", field->name);
+                return NULL;
+            }
+        }
+        else {
+            string = _wsJsonLazySkip(string, end);
+            if (!string) {
+                WS_JSON_LOG_ERROR("Failed to parse json into struct: value of unknown key is cut off\n");
+                return NULL;
+            }
+        }
+
+        string = skipWhitespaces(string, end);
+        char c = parsePeek(string, end);
+        if (c == '}') return string + 1;
+        if (c != ',') {
+            WS_JSON_LOG_ERROR("Failed to parse json into struct: expected ',' or '}'\n");
+            return NULL;
+        }
+        string = skipWhitespaces(string + 1, end);
+    }
+}
+
+int32_t wsJsonBindParse(wsJsonBinding* binding, const char* data, size_t length, void* out) {
+    if (!binding || !data || !out) {
+        WS_JSON_LOG_ERROR("Invalid input paramerter is NULL\n");
+        return WS_ERROR;
+    }
+    if (!_wsJsonBindPrepare(binding)) return WS_ERROR;
+
+    _WS_JSON_STATS_START(start);
+    const char* end = data + length;
+    const char* cursor = _wsJsonBindParseObject(binding, skipWhitespaces(data, end), end, out);
+    int32_t result = WS_OK;
+    if (!cursor) {
+        result = WS_ERROR;
+    }
+    else if (skipWhitespaces(cursor, end) != end) {
+        WS_JSON_LOG_ERROR("Failed to parse json: unexpected data after the root\n");
+        result = WS_ERROR;
+    }
+    _WS_JSON_STATS_TIME(parse, start, length);
+    return result;
+}
+
+// Members hold decoded text, escaped the same way nodes built from binary input are
+static void _wsJsonBindWriteString(wsJsonWriter* writer, const char* string, size_t length) {
+    _wsJsonWriterPutChar(writer, '"');
+    if (!_wsJsonNeedsEscape(string, length)) {
+        _wsJsonWriterPut(writer, string, length);
+    }
+    else {
+        char stackBuffer[256];
+        size_t escapedLength = _wsJsonEscapedLength(string, length);
+        char* buffer = escapedLength <= sizeof(stackBuffer) ? stackBuffer : _wsJsonMalloc(escapedLength);
+        if (!buffer) {
+            WS_JSON_LOG_ERROR("Failed to allocate string buffer\n");
+            writer->error = WS_ERROR;
+            return;
+        }
+        _wsJsonEscape(string, length, buffer);
+        _wsJsonWriterPut(writer, buffer, escapedLength);
+        if (buffer != stackBuffer) _wsJsonFree(buffer);
+    }
+    _wsJsonWriterPutChar(writer, '"');
+}
+
+static void _wsJsonBindWriteObject(wsJsonWriter* writer, const wsJsonBinding* binding, const unsigned char* in) {
+    char digits[32];
+    _wsJsonWriterPutChar(writer, '{');
+    for (int32_t i = 0; i < binding->fieldCount; i++) {
+        const wsJsonBindField* field = &binding->fields[i];
+        const unsigned char* member = in + field->offset;
+        if (i) _wsJsonWriterPutChar(writer, ',');
+        _wsJsonWriterPutChar(writer, '"');
+        _wsJsonWriterPut(writer, field->name, field->nameLength);
+        _wsJsonWriterPut(writer, "\": ", 3);
+
+        switch (field->type) {
+            case WS_JSON_BIND_INTEGER:
+                _wsJsonWriterPut(writer, digits, _wsJsonFormatInteger(_wsJsonBindLoadInteger(member, field->size), digits));
+                break;
+            case WS_JSON_BIND_NUMBER: {
+                double number = field->size == sizeof(float) ? *(const float*)member : *(const double*)member;
+                _wsJsonWriterPut(writer, digits, _wsJsonFormatDouble(number, digits));
+                break;
+            }
+            case WS_JSON_BIND_BOOL:
+                if (*(const bool*)member) _wsJsonWriterPut(writer, "true", 4);
+                else _wsJsonWriterPut(writer, "false", 5);
+                break;
+            case WS_JSON_BIND_STRING: {
+                const unsigned char* terminator = memchr(member, '\0', field->size);
+                _wsJsonBindWriteString(writer, (const char*)member, terminator ? (size_t)(terminator - member) : field->size);
+                break;
+            }
+            case WS_JSON_BIND_OBJECT:
+                _wsJsonBindWriteObject(writer, field->binding, member);
+                break;
+        }
+    }
+    _wsJsonWriterPutChar(writer, '}');
+}
+
+int32_t wsJsonBindWrite(wsJsonWriter* writer, wsJsonBinding* binding, const void* in) {
+    if (!writer || !binding || !in) {
+        WS_JSON_LOG_ERROR("Invalid input paramerter is NULL\n");
+        return WS_ERROR;
+    }
+    if (!_wsJsonBindPrepare(binding)) return WS_ERROR;
+
+    _WS_JSON_STATS_START(start);
+    size_t length = writer->length;
+    _wsJsonBindWriteObject(writer, binding, in);
+    int32_t result = _wsJsonWriterFinish(writer, WS_OK);
+    _WS_JSON_STATS_TIME(serialize, start, writer->length - length);
+    return result;
+}
+
+/* Worker pool */
+static int _wsJsonPoolMain(void* arg) {
+    wsJsonPool* pool = arg;
+    mtx_lock(&pool->lock);
+    int32_t worker = ++pool->started;
+    uint64_t seen = 0;
+    for (;;) {
+        while (pool->generation == seen && !pool->shutdown) cnd_wait(&pool->wake, &pool->lock);
+        if (pool->shutdown) break;
+        seen = pool->generation;
+        mtx_unlock(&pool->lock);
+
+        pool->task(pool->context, worker);
+
+        mtx_lock(&pool->lock);
+        if (--pool->pending == 0) cnd_signal(&pool->done);
+    }
+    mtx_unlock(&pool->lock);
+    return 0;
+}
+
+wsJsonPool* wsJsonPoolInit(int32_t threadCount) {
+    if (threadCount <= 0) {
+#if defined(__unix__) || defined(__APPLE__)
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threadCount = cpus > 0 ? (int32_t)cpus : 1;
+#else
+        threadCount = 1;
+#endif
+    }
+
+    wsJsonPool* pool = _wsJsonMalloc(sizeof(wsJsonPool));
+    if (!pool) {
+        WS_JSON_LOG_ERROR("Failed to allocate json pool\n");
+        return NULL;
+    }
+    memset(pool, 0, sizeof(wsJsonPool));
+    pool->threads = _wsJsonMalloc(sizeof(thrd_t) * (threadCount > 1 ? threadCount - 1 : 1));
+    if (!pool->threads || mtx_init(&pool->lock, mtx_plain) != thrd_success) {
+        WS_JSON_LOG_ERROR("Failed to allocate json pool\n");
+        _wsJsonFree(pool->threads);
+        _wsJsonFree(pool);
+        return NULL;
+    }
+    cnd_init(&pool->wake);
+    cnd_init(&pool->done);
+
+    // Workers start on the picked simd functions instead of the dispatch stubs
+    wsJsonGetSimdLevel();
+
+    pool->threadCount = 1;
+    for (int32_t i = 0; i < threadCount - 1; i++) {
+        if (thrd_create(&pool->threads[i], _wsJsonPoolMain, pool) != thrd_success) {
+            WS_JSON_LOG_WARNING("Failed to start pool thread, using %d threads\n", pool->threadCount);
+            break;
+        }
+        pool->threadCount++;
+    }
+    return pool;
+}
+
+void wsJsonPoolFree(wsJsonPool* pool) {
+    if (!pool) return;
+    mtx_lock(&pool->lock);
+    pool->shutdown = true;
+    cnd_broadcast(&pool->wake);
+    mtx_unlock(&pool->lock);
+    for (int32_t i = 0; i < pool->threadCount - 1; i++) thrd_join(pool->threads[i], NULL);
+
+    cnd_destroy(&pool->wake);
+    cnd_destroy(&pool->done);
+    mtx_destroy(&pool->lock);
+    _wsJsonFree(pool->threads);
+    _wsJsonFree(pool);
+}
+
+// Runs task on every worker of the pool and waits for all of them
+static void _wsJsonPoolRun(wsJsonPool* pool, void (*task)(void* context, int32_t worker), void* context) {
+    if (!pool || pool->threadCount <= 1) {
+        task(context, 0);
+        return;
+    }
+
+    mtx_lock(&pool->lock);
+    pool->task = task;
+    pool->context = context;
+    pool->pending = pool->threadCount - 1;
+    pool->generation++;
+    cnd_broadcast(&pool->wake);
+    mtx_unlock(&pool->lock);
+
+    task(context, 0);
+
+    mtx_lock(&pool->lock);
+    while (pool->pending > 0) cnd_wait(&pool->done, &pool->lock);
+    mtx_unlock(&pool->lock);
+}
+
+static int32_t _wsJsonPoolThreadCount(const wsJsonPool* pool) {
+    return pool ? pool->threadCount : 1;
+}
+
+/* NDJSON batches */
+#define WS_JSON_LINE_CHUNK_MIN (64 * 1024)
+#define WS_JSON_LINE_CHUNK_MAX (4 * 1024 * 1024)
+
+typedef struct _wsJsonLineChunk {
+    wsJson** records;
+    size_t* offsets;
+    size_t recordCount;
+    size_t recordCapacity;
+    size_t errorCount;
+} _wsJsonLineChunk;
+
+typedef struct _wsJsonLineJob {
+    const char* data;
+    size_t length;
+    size_t chunkSize;
+    size_t chunkCount;
+    atomic_size_t nextChunk;
+    atomic_bool stop;
+    uint32_t parseFlags;
+    int32_t logLevel; // workers log like the calling thread
+    wsJsonArena** arenas;
+    _wsJsonLineChunk* chunks; // batch mode
+    wsJsonLineFn callback;    // callback mode
+    void* user;
+    _Atomic int32_t result; // workers only ever store WS_ERROR, read after the join
+} _wsJsonLineJob;
+
+static int32_t _wsJsonLineChunkPush(_wsJsonLineChunk* chunk, wsJson* record, size_t offset) {
+    if (chunk->recordCount == chunk->recordCapacity) {
+        size_t capacity = chunk->recordCapacity ? chunk->recordCapacity * 2 : 256;
+        wsJson** records = _wsJsonRealloc(chunk->records, sizeof(wsJson*) * capacity);
+        if (!records) return WS_ERROR;
+        chunk->records = records;
+        size_t* offsets = _wsJsonRealloc(chunk->offsets, sizeof(size_t) * capacity);
+        if (!offsets) return WS_ERROR;
+        chunk->offsets = offsets;
+        chunk->recordCapacity = capacity;
+    }
+    chunk->records[chunk->recordCount] = record;
+    chunk->offsets[chunk->recordCount] = offset;
+    chunk->recordCount++;
+    if (!record) chunk->errorCount++;
+    return WS_OK;
+}
+
+// A line belongs to the chunk its first byte is in, so chunks can start in the middle of a line
+static void _wsJsonLineTask(void* context, int32_t worker) {
+    _wsJsonLineJob* job = context;
+    wsJsonArena* arena = job->arenas[worker];
+    wsJsonArena* previous = wsJsonSetArena(arena);
+    int32_t logLevel = _wsJsonLogLevel;
+    _wsJsonLogLevel = job->logLevel;
+    const char* end = job->data + job->length;
+
+    while (!atomic_load_explicit(&job->stop, memory_order_relaxed)) {
+        size_t index = atomic_fetch_add_explicit(&job->nextChunk, 1, memory_order_relaxed);
+        if (index >= job->chunkCount) break;
+
+        const char* line = job->data + index * job->chunkSize;
+        const char* chunkEnd = job->length - index * job->chunkSize > job->chunkSize ? line + job->chunkSize : end;
+        if (index > 0 && line[-1] != '\n') {
+            line = memchr(line, '\n', end - line);
+            line = line ? line + 1 : end;
+        }
+
+        while (line < chunkEnd) {
+            const char* lineEnd = memchr(line, '\n', end - line);
+            if (!lineEnd) lineEnd = end;
+
+            if (skipWhitespaces(line, lineEnd) != lineEnd) {
+                wsJson* record = wsJsonParse(line, lineEnd - line, job->parseFlags);
+                size_t offset = line - job->data;
+                if (job->callback) {
+                    int32_t result = job->callback(job->user, record, offset, worker);
+                    wsJsonArenaReset(arena);
+                    if (result != WS_OK) {
+                        atomic_store_explicit(&job->result, WS_ERROR, memory_order_relaxed);
+                        atomic_store(&job->stop, true);
+                        break;
+                    }
+                } else if (_wsJsonLineChunkPush(&job->chunks[index], record, offset) != WS_OK) {
+                    WS_JSON_LOG_ERROR("Failed to allocate batch records\n");
+                    atomic_store_explicit(&job->result, WS_ERROR, memory_order_relaxed);
+                    atomic_store(&job->stop, true);
+                    break;
+                }
+            }
+            if (lineEnd == end) break;
+            line = lineEnd + 1;
+        }
+    }
+    wsJsonSetArena(previous);
+    _wsJsonLogLevel = logLevel;
+}
+
+static void _wsJsonLineJobInit(_wsJsonLineJob* job, wsJsonPool* pool, const char* data, size_t length, uint32_t parseFlags) {
+    memset(job, 0, sizeof(_wsJsonLineJob));
+    job->data = data;
+    job->length = length;
+    job->parseFlags = parseFlags & ~_WS_JSON_PARSE_IN_SITU;
+    job->logLevel = _wsJsonLogLevel;
+    atomic_init(&job->result, WS_OK);
+    atomic_init(&job->nextChunk, 0);
+    atomic_init(&job->stop, false);
+
+    // Several chunks per worker so a slow chunk doesn't hold up the others
+    size_t chunkSize = length / ((size_t)_wsJsonPoolThreadCount(pool) * 16);
+    if (chunkSize < WS_JSON_LINE_CHUNK_MIN) chunkSize = WS_JSON_LINE_CHUNK_MIN;
+    if (chunkSize > WS_JSON_LINE_CHUNK_MAX) chunkSize = WS_JSON_LINE_CHUNK_MAX;
+    job->chunkSize = chunkSize;
+    job->chunkCount = (length + chunkSize - 1) / chunkSize;
+}
+
+static wsJsonArena** _wsJsonLineArenasInit(int32_t count) {
+    wsJsonArena** arenas = _wsJsonMalloc(sizeof(wsJsonArena*) * count);
+    if (!arenas) return NULL;
+    for (int32_t i = 0; i < count; i++) {
+        arenas[i] = wsJsonArenaInit(0);
+        if (!arenas[i]) {
+            for (int32_t j = 0; j < i; j++) wsJsonArenaFree(arenas[j]);
+            _wsJsonFree(arenas);
+            return NULL;
+        }
+    }
+    return arenas;
+}
+
+static void _wsJsonLineArenasFree(wsJsonArena** arenas, int32_t count) {
+    if (!arenas) return;
+    for (int32_t i = 0; i < count; i++) wsJsonArenaFree(arenas[i]);
+    _wsJsonFree(arenas);
+}
+
+wsJsonBatch* wsJsonParseLines(wsJsonPool* pool, const char* data, size_t length, uint32_t parseFlags) {
+    if (!data && length > 0) {
+        WS_JSON_LOG_ERROR("Invalid input paramerter is NULL\n");
+        return NULL;
+    }
+
+    wsJsonBatch* batch = _wsJsonMalloc(sizeof(wsJsonBatch));
+    if (!batch) {
+        WS_JSON_LOG_ERROR("Failed to allocate json batch\n");
+        return NULL;
+    }
+    memset(batch, 0, sizeof(wsJsonBatch));
+    batch->arenaCount = _wsJsonPoolThreadCount(pool);
+    batch->arenas = _wsJsonLineArenasInit(batch->arenaCount);
+    if (!batch->arenas) {
+        WS_JSON_LOG_ERROR("Failed to allocate json batch arenas\n");
+        _wsJsonFree(batch);
+        return NULL;
+    }
+
+    _wsJsonLineJob job;
+    _wsJsonLineJobInit(&job, pool, data, length, parseFlags);
+    job.arenas = batch->arenas;
+    job.chunks = _wsJsonMalloc(sizeof(_wsJsonLineChunk) * (job.chunkCount ? job.chunkCount : 1));
+    if (!job.chunks) {
+        WS_JSON_LOG_ERROR("Failed to allocate json batch chunks\n");
+        wsJsonBatchFree(batch);
+        return NULL;
+    }
+    memset(job.chunks, 0, sizeof(_wsJsonLineChunk) * job.chunkCount);
+
+    if (job.chunkCount > 0) _wsJsonPoolRun(pool, _wsJsonLineTask, &job);
+    int32_t result = atomic_load_explicit(&job.result, memory_order_relaxed);
+
+    // Chunks are in input order, so concatenating them keeps the records in order
+    size_t recordCount = 0;
+    for (size_t i = 0; i < job.chunkCount; i++) recordCount += job.chunks[i].recordCount;
+    if (result == WS_OK && recordCount > 0) {
+        batch->records = _wsJsonMalloc(sizeof(wsJson*) * recordCount);
+        batch->offsets = _wsJsonMalloc(sizeof(size_t) * recordCount);
+        if (!batch->records || !batch->offsets) {
+            WS_JSON_LOG_ERROR("Failed to allocate batch records\n");
+            result = WS_ERROR;
+        }
+    }
+    for (size_t i = 0; i < job.chunkCount; i++) {
+        _wsJsonLineChunk* chunk = &job.chunks[i];
+        if (result == WS_OK && chunk->recordCount > 0) {
+            memcpy(batch->records + batch->recordCount, chunk->records, sizeof(wsJson*) * chunk->recordCount);
+            memcpy(batch->offsets + batch->recordCount, chunk->offsets, sizeof(size_t) * chunk->recordCount);
+            batch->recordCount += chunk->recordCount;
+            batch->errorCount += chunk->errorCount;
+        }
+        _wsJsonFree(chunk->records);
+        _wsJsonFree(chunk->offsets);
+    }
+    _wsJsonFree(job.chunks);
+
+    if (result != WS_OK) {
+        wsJsonBatchFree(batch);
+        return NULL;
+    }
+    return batch;
+}
+
+void wsJsonBatchFree(wsJsonBatch* batch) {
+    if (!batch) return;
+    _wsJsonLineArenasFree(batch->arenas, batch->arenaCount);
+    _wsJsonFree(batch->records);
+    _wsJsonFree(batch->offsets);
+#if defined(__unix__) || defined(__APPLE__)
+    if (batch->data) munmap((void*)batch->data, batch->length);
+#endif
+    _wsJsonFree(batch);
+}
+
+int32_t wsJsonEachLine(wsJsonPool* pool, const char* data, size_t length, uint32_t parseFlags, wsJsonLineFn callback, void* user) {
+    if ((!data && length > 0) || !callback) {
+        WS_JSON_LOG_ERROR("Invalid input paramerter is NULL\n");
+        return WS_ERROR;
+    }
+
+    _wsJsonLineJob job;
+    _wsJsonLineJobInit(&job, pool, data, length, parseFlags);
+    job.callback = callback;
+    job.user = user;
+    int32_t arenaCount = _wsJsonPoolThreadCount(pool);
+    job.arenas = _wsJsonLineArenasInit(arenaCount);
+    if (!job.arenas) {
+        WS_JSON_LOG_ERROR("Failed to allocate json batch arenas\n");
+        return WS_ERROR;
+    }
+
+    if (job.chunkCount > 0) _wsJsonPoolRun(pool, _wsJsonLineTask, &job);
+    _wsJsonLineArenasFree(job.arenas, arenaCount);
+    return atomic_load_explicit(&job.result, memory_order_relaxed);
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+wsJsonBatch* wsJsonParseLinesFile(wsJsonPool* pool, const char* path, uint32_t parseFlags) {
+    if (!path) {
+        WS_JSON_LOG_ERROR("Invalid input paramerter is NULL\n");
+        return NULL;
+    }
+    size_t length;
+    void* data = _wsJsonMapFile(path, &length);
+    if (!data) return NULL;
+
+    wsJsonBatch* batch = wsJsonParseLines(pool, data, length, parseFlags);
+    if (!batch || !(parseFlags & WS_JSON_PARSE_VIEWS)) {
+        munmap(data, length);
+        return batch;
+    }
+    // Views point into the mapping, it goes away with the batch
+    batch->data = data;
+    batch->length = length;
+    return batch;
+}
+
+int32_t wsJsonEachLineFile(wsJsonPool* pool, const char* path, uint32_t parseFlags, wsJsonLineFn callback, void* user) {
+    if (!path) {
+        WS_JSON_LOG_ERROR("Invalid input paramerter is NULL\n");
+        return WS_ERROR;
+    }
+    size_t length;
+    void* data = _wsJsonMapFile(path, &length);
+    if (!data) return WS_ERROR;
+
+    int32_t result = wsJsonEachLine(pool, data, length, parseFlags, callback, user);
+    munmap(data, length);
+    return result;
+}
+#endif
+
+/* Parallel serialization */
+typedef struct _wsJsonPiece {
+    wsJson* container; // children first..last-1 of it, NULL for text written by the planner
+    int32_t first;
+    int32_t last;
+    int32_t indent;    // indent of the container
+    char* data;        // worker output
+    size_t offset;     // planner text in the glue buffer
+    size_t size;
+} _wsJsonPiece;
+
+typedef struct _wsJsonPlan {
+    _wsJsonPiece* pieces;
+    size_t pieceCount;
+    size_t pieceCapacity;
+    wsJsonWriter glue; // brackets, keys and indents around the ranges
+    size_t glueStart;  // planner text that has no piece yet starts here
+    bool pretty;
+    int32_t threadCount;
+    atomic_size_t nextPiece;
+    atomic_bool failed;
+} _wsJsonPlan;
+
+static bool _wsJsonPlanSplits(wsJson* obj) {
+    if (obj->type == WS_JSON_OBJECT) return obj->object.childCount >= WS_JSON_PARALLEL_THRESHOLD;
+    if (obj->type == WS_JSON_ARRAY) return obj->array.elementCount >= WS_JSON_PARALLEL_THRESHOLD;
+    return false;
+}
+
+// Everything the serializer writes in front of child index of container
+static void _wsJsonWriteItemPrefix(wsJsonWriter* writer, wsJson* container, int32_t index, int32_t indent, bool pretty) {
+    if (pretty) {
+        if (index > 0) _wsJsonWriterPut(writer, ",\n", 2);
+        _wsJsonWriterIndent(writer, indent + 4);
+    } else if (index > 0) {
+        _wsJsonWriterPutChar(writer, ',');
+    }
+    if (container->type == WS_JSON_OBJECT) _wsJsonWriteKey(writer, container->object.children[index]);
+}
+
+static int32_t _wsJsonPlanPush(_wsJsonPlan* plan, wsJson* container, int32_t first, int32_t last, int32_t indent) {
+    // Flush the pending planner text into its own piece first
+    if (container && plan->glue.used > plan->glueStart) {
+        if (_wsJsonPlanPush(plan, NULL, 0, 0, 0) != WS_OK) return WS_ERROR;
+    }
+    if (plan->pieceCount == plan->pieceCapacity) {
+        size_t capacity = plan->pieceCapacity ? plan->pieceCapacity * 2 : 64;
+        _wsJsonPiece* pieces = _wsJsonRealloc(plan->pieces, sizeof(_wsJsonPiece) * capacity);
+        if (!pieces) {
+            WS_JSON_LOG_ERROR("Failed to allocate serializer pieces\n");
+            return WS_ERROR;
+        }
+        plan->pieces = pieces;
+        plan->pieceCapacity = capacity;
+    }
+
+    _wsJsonPiece* piece = &plan->pieces[plan->pieceCount++];
+    memset(piece, 0, sizeof(_wsJsonPiece));
+    piece->container = container;
+    piece->first = first;
+    piece->last = last;
+    piece->indent = indent;
+    if (!container) {
+        piece->offset = plan->glueStart;
+        piece->size = plan->glue.used - plan->glueStart;
+        plan->glueStart = plan->glue.used;
+    }
+    return WS_OK;
+}
+
+// Same output as the serializer loop, children that are big enough are split up recursively
+static int32_t _wsJsonPlanValue(_wsJsonPlan* plan, wsJson* obj, int32_t indent) {
+    bool object = obj->type == WS_JSON_OBJECT;
+    wsJson** children = object ? obj->object.children : obj->array.elements;
+    int32_t count = object ? obj->object.childCount : obj->array.elementCount;
+    wsJsonWriter* glue = &plan->glue;
+
+    if (plan->pretty) _wsJsonWriterPut(glue, object ? "{\n" : "[\n", 2);
+    else _wsJsonWriterPutChar(glue, object ? '{' : '[');
+
+    // Several ranges per worker so uneven children don't leave workers idle
+    int32_t rangeSize = count / (plan->threadCount * 8);
+    if (rangeSize < 64) rangeSize = 64;
+
+    int32_t first = 0;
+    for (int32_t i = 0; i < count; i++) {
+        if (_wsJsonPlanSplits(children[i])) {
+            if (first < i && _wsJsonPlanPush(plan, obj, first, i, indent) != WS_OK) return WS_ERROR;
+            _wsJsonWriteItemPrefix(glue, obj, i, indent, plan->pretty);
+            if (_wsJsonPlanValue(plan, children[i], indent + 4) != WS_OK) return WS_ERROR;
+            first = i + 1;
+        } else if (i + 1 - first == rangeSize) {
+            if (_wsJsonPlanPush(plan, obj, first, i + 1, indent) != WS_OK) return WS_ERROR;
+            first = i + 1;
+        }
+    }
+    if (first < count && _wsJsonPlanPush(plan, obj, first, count, indent) != WS_OK) return WS_ERROR;
+
+    if (plan->pretty) {
+        _wsJsonWriterPutChar(glue, '\n');
+        _wsJsonWriterIndent(glue, indent);
+    }
+    _wsJsonWriterPutChar(glue, object ? '}' : ']');
+    return glue->error ? WS_ERROR : WS_OK;
+}
+
+static void _wsJsonPlanTask(void* context, int32_t worker) {
+    (void)worker;
+    _wsJsonPlan* plan = context;
+    for (;;) {
+        size_t index = atomic_fetch_add_explicit(&plan->nextPiece, 1, memory_order_relaxed);
+        if (index >= plan->pieceCount) break;
+        _wsJsonPiece* piece = &plan->pieces[index];
+        if (!piece->container) continue;
+
+        wsJsonWriter writer;
+        if (wsJsonWriterInitGrowable(&writer, 16 * 1024) != WS_OK) {
+            atomic_store(&plan->failed, true);
+            continue;
+        }
+        wsJson* container = piece->container;
+        wsJson** children = container->type == WS_JSON_OBJECT ? container->object.children : container->array.elements;
+        int32_t result = WS_OK;
+        for (int32_t i = piece->first; i < piece->last && result == WS_OK; i++) {
+            _wsJsonWriteItemPrefix(&writer, container, i, piece->indent, plan->pretty);
+            if (plan->pretty) result = _wsJsonWritePrettyValue(&writer, children[i], piece->indent + 4);
+            else result = _wsJsonWriteValue(&writer, children[i]);
+        }
+        if (result != WS_OK || writer.error) atomic_store(&plan->failed, true);
+        piece->data = writer.buffer;
+        piece->size = writer.used;
+    }
+}
+
+static void _wsJsonPlanFree(_wsJsonPlan* plan) {
+    for (size_t i = 0; i < plan->pieceCount; i++) _wsJsonFree(plan->pieces[i].data);
+    _wsJsonFree(plan->pieces);
+    wsJsonWriterFree(&plan->glue);
+}
+
+// Plans obj and lets the pool write it, the pieces stay in plan until _wsJsonPlanFree
+static int32_t _wsJsonPlanRun(_wsJsonPlan* plan, wsJsonPool* pool, wsJson* obj, bool pretty) {
+    memset(plan, 0, sizeof(_wsJsonPlan));
+    plan->pretty = pretty;
+    plan->threadCount = pool ? pool->threadCount : 1;
+    atomic_init(&plan->nextPiece, 0);
+    atomic_init(&plan->failed, false);
+    if (wsJsonWriterInitGrowable(&plan->glue, 0) != WS_OK) return WS_ERROR;
+
+    if (_wsJsonPlanValue(plan, obj, 0) != WS_OK) return WS_ERROR;
+    if (plan->glue.used > plan->glueStart && _wsJsonPlanPush(plan, NULL, 0, 0, 0) != WS_OK) return WS_ERROR;
+
+    _wsJsonPoolRun(pool, _wsJsonPlanTask, plan);
+    if (atomic_load(&plan->failed)) {
+        WS_JSON_LOG_ERROR("Failed to serialize json in parallel\n");
+        return WS_ERROR;
+    }
+    return WS_OK;
+}
+
+static const char* _wsJsonPieceData(const _wsJsonPlan* plan, const _wsJsonPiece* piece) {
+    return piece->container ? piece->data : plan->glue.buffer + piece->offset;
+}
+
+static int32_t _wsJsonWriteParallel(wsJsonPool* pool, wsJsonWriter* writer, wsJson* obj, bool pretty) {
+    if (!writer || !obj) {
+        WS_JSON_LOG_ERROR("Invalid JSON or writer\n");
+        return WS_ERROR;
+    }
+    _WS_JSON_STATS_START(start);
+    size_t length = writer->length;
+    if (!_wsJsonPlanSplits(obj)) {
+        int32_t result = _wsJsonWriterFinish(writer, pretty ? _wsJsonWritePrettyValue(writer, obj, 0) : _wsJsonWriteValue(writer, obj));
+        _WS_JSON_STATS_TIME(serialize, start, writer->length - length);
+        return result;
+    }
+
+    _wsJsonPlan plan;
+    int32_t result = _wsJsonPlanRun(&plan, pool, obj, pretty);
+    for (size_t i = 0; i < plan.pieceCount && result == WS_OK; i++) {
+        const char* data = _wsJsonPieceData(&plan, &plan.pieces[i]);
+        size_t size = plan.pieces[i].size;
+        if (writer->type == WS_JSON_WRITER_SINK && size >= writer->capacity) {
+            // Big pieces go straight to the sink instead of through its buffer
+            _wsJsonWriterFlush(writer);
+            if (!writer->error && writer->sink(writer->user, data, size) != WS_OK) {
+                WS_JSON_LOG_ERROR("Json writer sink failed\n");
+                writer->error = WS_ERROR;
+            }
+            writer->length += size;
+        } else {
+            _wsJsonWriterPut(writer, data, size);
+        }
+    }
+    _wsJsonPlanFree(&plan);
+    result = _wsJsonWriterFinish(writer, result);
+    _WS_JSON_STATS_TIME(serialize, start, writer->length - length);
+    return result;
+}
+
+int32_t wsJsonWriteParallel(wsJsonPool* pool, wsJsonWriter* writer, wsJson* obj) {
+    return _wsJsonWriteParallel(pool, writer, obj, false);
+}
+
+int32_t wsJsonWritePrettyParallel(wsJsonPool* pool, wsJsonWriter* writer, wsJson* obj) {
+    return _wsJsonWriteParallel(pool, writer, obj, true);
+}
+
+int32_t wsJsonWriteVec(wsJsonPool* pool, wsJson* obj, bool pretty, wsJsonWriteVecFn fn, void* user) {
+    if (!obj || !fn) {
+        WS_JSON_LOG_ERROR("Invalid JSON or callback\n");
+        return WS_ERROR;
+    }
+    if (!_wsJsonPlanSplits(obj)) {
+        wsJsonWriter writer;
+        if (wsJsonWriterInitGrowable(&writer, 0) != WS_OK) return WS_ERROR;
+        int32_t result = pretty ? wsJsonWritePretty(&writer, obj) : wsJsonWrite(&writer, obj);
+        wsJsonSlice slice = { writer.buffer, writer.used };
+        if (result == WS_OK) result = fn(user, &slice, 1);
+        wsJsonWriterFree(&writer);
+        return result;
+    }
+
+    _WS_JSON_STATS_START(start);
+    _wsJsonPlan plan;
+    int32_t result = _wsJsonPlanRun(&plan, pool, obj, pretty);
+    wsJsonSlice* slices = NULL;
+    if (result == WS_OK) {
+        slices = _wsJsonMalloc(sizeof(wsJsonSlice) * plan.pieceCount);
+        if (!slices) {
+            WS_JSON_LOG_ERROR("Failed to allocate json slices\n");
+            result = WS_ERROR;
+        }
+    }
+    if (result == WS_OK) {
+        size_t length = 0;
+        for (size_t i = 0; i < plan.pieceCount; i++) {
+            slices[i].data = _wsJsonPieceData(&plan, &plan.pieces[i]);
+            slices[i].size = plan.pieces[i].size;
+            length += slices[i].size;
+        }
+        _WS_JSON_STATS_TIME(serialize, start, length);
+        result = fn(user, slices, plan.pieceCount);
+    }
+    _wsJsonFree(slices);
+    _wsJsonPlanFree(&plan);
+    return result;
+}
+
+/* 
+ *  Shared documents
+ *  Readers announce themselves in the counter of the current epoch while 
+ *  they load the slot and take their reference. A publisher swaps the 
+ *  document first and then flips the epoch twice, each time waiting for 
+ *  the counter it left to drain, so every reader that could still have 
+ *  loaded the old document has taken its reference before it gets 
+ *  released. New readers always go to the other counter and never make 
+ *  the publisher wait longer.
+ */
+wsJsonShared* wsJsonShare(wsJson* root, wsJsonArena* arena) {
+    if (!root) {
+        WS_JSON_LOG_ERROR("Invalid input paramerter is NULL\n");
+        return NULL;
+    }
+    if (!_wsJsonMutable(root)) return NULL;
+
+    // Collect the containers first, nothing gets marked if that fails
+    size_t count = 0, capacity = 64;
+    wsJson** containers = _wsJsonMalloc(sizeof(wsJson*) * capacity);
+    wsJsonShared* doc = _wsJsonMalloc(sizeof(wsJsonShared));
+    if (!containers || !doc) {
+        WS_JSON_LOG_ERROR("Failed to allocate shared json document\n");
+        _wsJsonFree(containers);
+        _wsJsonFree(doc);
+        return NULL;
+    }
+    if (root->type == WS_JSON_OBJECT || root->type == WS_JSON_ARRAY) containers[count++] = root;
+    for (size_t i = 0; i < count; i++) {
+        wsJson* node = containers[i];
+        bool object = node->type == WS_JSON_OBJECT;
+        int32_t childCount = object ? node->object.childCount : node->array.elementCount;
+        for (int32_t c = 0; c < childCount; c++) {
+            wsJson* child = object ? node->object.children[c] : node->array.elements[c];
+            if (child->type != WS_JSON_OBJECT && child->type != WS_JSON_ARRAY) continue;
+            if (count == capacity) {
+                wsJson** grown = _wsJsonRealloc(containers, sizeof(wsJson*) * capacity * 2);
+                if (!grown) {
+                    WS_JSON_LOG_ERROR("Failed to allocate shared json document\n");
+                    _wsJsonFree(containers);
+                    _wsJsonFree(doc);
+                    return NULL;
+                }
+                containers = grown;
+                capacity *= 2;
+            }
+            containers[count++] = child;
+        }
+    }
+
+    // Objects whose index failed to allocate when they grew get it now, a shared tree can't change later
+    wsJsonArena* previous = arena ? wsJsonSetArena(arena) : NULL;
+    int32_t result = WS_OK;
+    for (size_t i = 0; i < count && result == WS_OK; i++) {
+        wsJson* node = containers[i];
+        if (node->type == WS_JSON_OBJECT && WS_JSON_INDEX_THRESHOLD > 0 && 
+            node->object.childCount >= WS_JSON_INDEX_THRESHOLD) {
+            result = wsJsonIndexObject(node);
+        }
+    }
+    if (arena) wsJsonSetArena(previous);
+    if (result != WS_OK) {
+        _wsJsonFree(containers);
+        _wsJsonFree(doc);
+        return NULL;
+    }
+
+    root->flags |= WS_JSON_FLAG_SHARED;
+    for (size_t i = 0; i < count; i++) {
+        wsJson* node = containers[i];
+        bool object = node->type == WS_JSON_OBJECT;
+        int32_t childCount = object ? node->object.childCount : node->array.elementCount;
+        for (int32_t c = 0; c < childCount; c++) {
+            (object ? node->object.children[c] : node->array.elements[c])->flags |= WS_JSON_FLAG_SHARED;
+        }
+    }
+    _wsJsonFree(containers);
+
+    doc->root = root;
+    doc->arena = arena;
+    atomic_init(&doc->refs, 1);
+    return doc;
+}
+
+wsJsonShared* wsJsonSharedRetain(wsJsonShared* doc) {
+    if (doc) atomic_fetch_add_explicit(&doc->refs, 1, memory_order_relaxed);
+    return doc;
+}
+
+void wsJsonSharedRelease(wsJsonShared* doc) {
+    if (!doc || atomic_fetch_sub_explicit(&doc->refs, 1, memory_order_acq_rel) != 1) return;
+
+    // Only the root is checked by wsJsonFree, the rest of the tree goes with it
+    doc->root->flags &= ~WS_JSON_FLAG_SHARED;
+    wsJsonFree(doc->root);
+    if (doc->arena) wsJsonArenaFree(doc->arena);
+    _wsJsonFree(doc);
+}
+
+int32_t wsJsonSharedSlotInit(wsJsonSharedSlot* slot, wsJsonShared* doc) {
+    if (!slot) {
+        WS_JSON_LOG_ERROR("Invalid input paramerter is NULL\n");
+        return WS_ERROR;
+    }
+    if (mtx_init(&slot->lock, mtx_plain) != thrd_success) {
+        WS_JSON_LOG_ERROR("Failed to create shared json slot lock\n");
+        return WS_ERROR;
+    }
+    atomic_init(&slot->current, doc);
+    atomic_init(&slot->epoch, 0);
+    atomic_init(&slot->readers[0], 0);
+    atomic_init(&slot->readers[1], 0);
+    return WS_OK;
+}
+
+void wsJsonSharedSlotFree(wsJsonSharedSlot* slot) {
+    if (!slot) return;
+    wsJsonSharedRelease(atomic_exchange(&slot->current, NULL));
+    mtx_destroy(&slot->lock);
+}
+
+wsJsonShared* wsJsonSharedSlotAcquire(wsJsonSharedSlot* slot) {
+    if (!slot) {
+        WS_JSON_LOG_ERROR("Invalid input paramerter is NULL\n");
+        return NULL;
+    }
+    uint32_t epoch = atomic_load(&slot->epoch);
+    atomic_fetch_add(&slot->readers[epoch], 1);
+    wsJsonShared* doc = wsJsonSharedRetain(atomic_load(&slot->current));
+    atomic_fetch_sub(&slot->readers[epoch], 1);
+    return doc;
+}
+
+int32_t wsJsonSharedSlotPublish(wsJsonSharedSlot* slot, wsJsonShared* doc) {
+    if (!slot) {
+        WS_JSON_LOG_ERROR("Invalid input paramerter is NULL\n");
+        return WS_ERROR;
+    }
+    mtx_lock(&slot->lock);
+    wsJsonShared* old = atomic_exchange(&slot->current, doc);
+    for (int32_t flip = 0; flip < 2; flip++) {
+        uint32_t epoch = atomic_load(&slot->epoch);
+        atomic_store(&slot->epoch, epoch ^ 1);
+        while (atomic_load(&slot->readers[epoch]) != 0) thrd_yield();
+    }
+    mtx_unlock(&slot->lock);
+    wsJsonSharedRelease(old);
+    return WS_OK;
+}
+
+/* Push parser */
+enum {
+    _WS_JSON_STATE_VALUE,
+    _WS_JSON_STATE_FIRST_VALUE, // after '[', value or ']'
+    _WS_JSON_STATE_FIRST_KEY,   // after '{', key or '}'
+    _WS_JSON_STATE_KEY,
+    _WS_JSON_STATE_COLON,
+    _WS_JSON_STATE_AFTER_VALUE,
+    _WS_JSON_STATE_STRING,
+    _WS_JSON_STATE_NUMBER,
+    _WS_JSON_STATE_LITERAL,
+    _WS_JSON_STATE_DONE,
+    _WS_JSON_STATE_ERROR
+};
+
+static int32_t _wsJsonParserBuildTree(void* user, const wsJsonEvent* event);
+
+static wsJsonParser* _wsJsonParserAlloc(wsJsonEventFn callback, void* user) {
+    wsJsonParser* parser = _wsJsonMalloc(sizeof(wsJsonParser));
+    if (!parser) {
+        WS_JSON_LOG_ERROR("Failed to allocate json parser\n");
+        return NULL;
+    }
+    memset(parser, 0, sizeof(wsJsonParser));
+    parser->callback = callback;
+    parser->user = user;
+    return parser;
+}
+
+wsJsonParser* wsJsonParserInit(void) {
+    wsJsonParser* parser = _wsJsonParserAlloc(_wsJsonParserBuildTree, NULL);
+    if (parser) parser->user = parser;
+    return parser;
+}
+
+wsJsonParser* wsJsonParserInitEvents(wsJsonEventFn callback, void* user) {
+    if (!callback) {
+        WS_JSON_LOG_ERROR("Event callback is NULL\n");
+        return NULL;
+    }
+    return _wsJsonParserAlloc(callback, user);
+}
+
+static int32_t _wsJsonParserAppend(char** buffer, size_t* length, size_t* capacity, const char* data, size_t size) {
+    if (*length + size + 1 > *capacity) {
+        size_t newCap = *capacity ? *capacity * 2 : 64;
+        while (newCap < *length + size + 1) newCap *= 2;
+        char* grown = _wsJsonRealloc(*buffer, newCap);
+        if (!grown) {
+            WS_JSON_LOG_ERROR("Failed to grow json parser buffer\n");
+            return WS_ERROR;
+        }
+        *buffer = grown;
+        *capacity = newCap;
+    }
+    memcpy(*buffer + *length, data, size);
+    *length += size;
+    (*buffer)[*length] = '\0';
+    return WS_OK;
+}
+
+// Tree mode is just another event consumer
+static int32_t _wsJsonParserBuildTree(void* user, const wsJsonEvent* event) {
+    wsJsonParser* parser = user;
+    wsJson* parent = parser->depth > 0 ? parser->nodes[parser->depth - 1] : NULL;
+    wsJson* node = NULL;
+
+    switch (event->type) {
+        case WS_JSON_EVENT_OBJECT_END:
+        case WS_JSON_EVENT_ARRAY_END:
+            return WS_OK;
+        case WS_JSON_EVENT_OBJECT_START:
+            node = _wsJsonAllocNode(WS_JSON_OBJECT, event->key, event->keyLength);
+            break;
+        case WS_JSON_EVENT_ARRAY_START:
+            node = _wsJsonAllocNode(WS_JSON_ARRAY, event->key, event->keyLength);
+            break;
+        case WS_JSON_EVENT_STRING:
+            node = _wsJsonAllocNode(WS_JSON_STRING, event->key, event->keyLength);
+            if (node) {
+                node->stringValue = _wsJsonNodeStrndup(node, event->stringValue, event->stringLength);
+                node->stringLength = (uint32_t)event->stringLength;
+                if (!node->stringValue) {
+                    wsJsonFree(node);
+                    node = NULL;
+                }
+            }
+            break;
+        case WS_JSON_EVENT_NUMBER:
+            node = _wsJsonAllocNode(WS_JSON_NUMBER, event->key, event->keyLength);
+            if (node) {
+                node->numberValue = event->numberValue;
+                if (event->isInteger) {
+                    node->flags |= WS_JSON_FLAG_INTEGER;
+                    node->integerValue = event->integerValue;
+                }
+            }
+            break;
+        case WS_JSON_EVENT_BOOL:
+            node = _wsJsonAllocNode(WS_JSON_BOOL, event->key, event->keyLength);
+            if (node) node->boolValue = event->boolValue;
+            break;
+        case WS_JSON_EVENT_NULL:
+            node = _wsJsonAllocNode(WS_JSON_NULL, event->key, event->keyLength);
+            break;
+    }
+    if (!node) {
+        WS_JSON_LOG_ERROR("Failed to allocate json node in push parser\n");
+        return WS_ERROR;
+    }
+
+    if (!parent) {
+        parser->root = node;
+    }
+    else {
+        int32_t count = parent->object.childCount; // same layout for arrays
+        if (parent->type == WS_JSON_OBJECT) wsJsonAddField(parent, node);
+        else wsJsonAddElement(parent, node);
+        if (parent->object.childCount == count) {
+            wsJsonFree(node);
+            return WS_ERROR;
+        }
+    }
+
+    // The container stack is pushed right after this event
+    if (event->type == WS_JSON_EVENT_OBJECT_START || event->type == WS_JSON_EVENT_ARRAY_START) {
+        parser->nodes[parser->depth] = node;
+    }
+    return WS_OK;
+}
+
+static int32_t _wsJsonParserEmit(wsJsonParser* parser, wsJsonEvent* event) {
+    bool inObject = parser->depth > 0 && parser->types[parser->depth - 1] == WS_JSON_OBJECT;
+    bool closing = event->type == WS_JSON_EVENT_OBJECT_END || event->type == WS_JSON_EVENT_ARRAY_END;
+    event->key = inObject && !closing ? parser->key : NULL;
+    event->keyLength = inObject && !closing ? parser->keyLength : 0;
+    return parser->callback(parser->user, event);
+}
+
+static int32_t _wsJsonParserOpen(wsJsonParser* parser, wsJsonType type) {
+    if (parser->depth >= WS_JSON_MAX_DEPTH) {
+        WS_JSON_LOG_ERROR("Json nesting is deeper than WS_JSON_MAX_DEPTH (%d)\n", WS_JSON_MAX_DEPTH);
+        return WS_ERROR;
+    }
+    if (parser->depth >= parser->stackCapacity) {
+        int32_t newCap = parser->stackCapacity ? parser->stackCapacity * 2 : 16;
+        uint8_t* types = _wsJsonRealloc(parser->types, newCap);
+        if (!types) return WS_ERROR;
+        parser->types = types;
+        wsJson** nodes = _wsJsonRealloc(parser->nodes, sizeof(wsJson*) * newCap);
+        if (!nodes) return WS_ERROR;
+        parser->nodes = nodes;
+        parser->stackCapacity = newCap;
+    }
+
+    wsJsonEvent event = {0};
+    event.type = type == WS_JSON_OBJECT ? WS_JSON_EVENT_OBJECT_START : WS_JSON_EVENT_ARRAY_START;
+    if (_wsJsonParserEmit(parser, &event) != WS_OK) return WS_ERROR;
+
+    parser->types[parser->depth++] = (uint8_t)type;
+    parser->state = type == WS_JSON_OBJECT ? _WS_JSON_STATE_FIRST_KEY : _WS_JSON_STATE_FIRST_VALUE;
+    return WS_OK;
+}
+
+static int32_t _wsJsonParserClose(wsJsonParser* parser, char bracket) {
+    wsJsonType type = bracket == '}' ? WS_JSON_OBJECT : WS_JSON_ARRAY;
+    if (parser->depth == 0 || parser->types[parser->depth - 1] != type) {
+        WS_JSON_LOG_ERROR("Unexpected '%c' in json\n", bracket);
+        return WS_ERROR;
+    }
+    parser->depth--;
+
+    wsJsonEvent event = {0};
+    event.type = type == WS_JSON_OBJECT ? WS_JSON_EVENT_OBJECT_END : WS_JSON_EVENT_ARRAY_END;
+    if (_wsJsonParserEmit(parser, &event) != WS_OK) return WS_ERROR;
+
+    parser->state = parser->depth == 0 ? _WS_JSON_STATE_DONE : _WS_JSON_STATE_AFTER_VALUE;
+    return WS_OK;
+}
+
+static int32_t _wsJsonParserFinishToken(wsJsonParser* parser) {
+    wsJsonEvent event = {0};
+
+    switch (parser->state) {
+        case _WS_JSON_STATE_STRING:
+            if (parser->stringIsKey) {
+                // Swap buffers, the key has to stay around until its value is done
+                char* key = parser->key;
+                size_t keyCapacity = parser->keyCapacity;
+                parser->key = parser->scratch;
+                parser->keyLength = parser->scratchLength;
+                parser->keyCapacity = parser->scratchCapacity;
+                parser->scratch = key;
+                parser->scratchCapacity = keyCapacity;
+                parser->scratchLength = 0;
+                parser->state = _WS_JSON_STATE_COLON;
+                return WS_OK;
+            }
+            event.type = WS_JSON_EVENT_STRING;
+            event.stringValue = parser->scratch ? parser->scratch : "";
+            event.stringLength = parser->scratchLength;
+            break;
+        case _WS_JSON_STATE_NUMBER: {
+            event.type = WS_JSON_EVENT_NUMBER;
+            const char* tokenEnd = parser->scratch + parser->scratchLength;
+            const char* end = _wsJsonParseNumber(parser->scratch, tokenEnd, &event.numberValue, &event.integerValue, &event.isInteger);
+            if (end != tokenEnd) {
+                WS_JSON_LOG_ERROR("Invalid json number: %s\n", parser->scratch);
+                return WS_ERROR;
+            }
+            break;
+        }
+        case _WS_JSON_STATE_LITERAL:
+            event.type = parser->literal[0] == 'n' ? WS_JSON_EVENT_NULL : WS_JSON_EVENT_BOOL;
+            event.boolValue = parser->literal[0] == 't';
+            break;
+        default:
+            return WS_ERROR;
+    }
+
+    parser->scratchLength = 0;
+    parser->state = _WS_JSON_STATE_AFTER_VALUE;
+    return _wsJsonParserEmit(parser, &event);
+}
+
+static inline bool _wsJsonIsNumberChar(char c) {
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+static int32_t _wsJsonParserBeginValue(wsJsonParser* parser, char c) {
+    if (parser->depth == 0 && c != '{' && c != '[') {
+        WS_JSON_LOG_ERROR("Json root has to be an object or an array\n");
+        return WS_ERROR;
+    }
+
+    switch (c) {
+        case '{': return _wsJsonParserOpen(parser, WS_JSON_OBJECT);
+        case '[': return _wsJsonParserOpen(parser, WS_JSON_ARRAY);
+        case '"':
+            parser->state = _WS_JSON_STATE_STRING;
+            parser->stringIsKey = false;
+            return WS_OK;
+        case 't': parser->literal = "true"; break;
+        case 'f': parser->literal = "false"; break;
+        case 'n': parser->literal = "null"; break;
+        default:
+            if (c == '-' || (c >= '0' && c <= '9')) {
+                parser->state = _WS_JSON_STATE_NUMBER;
+                return WS_OK;
+            }
+            WS_JSON_LOG_ERROR("Unexpected '%c' in json\n", c);
+            return WS_ERROR;
+    }
+    parser->state = _WS_JSON_STATE_LITERAL;
+    parser->literalLength = (uint8_t)strlen(parser->literal);
+    parser->literalMatched = 0;
+    return WS_OK;
+}
+
+int32_t wsJsonParserFeed(wsJsonParser* parser, const char* chunk, size_t length) {
+    if (!parser || (!chunk && length)) {
+        WS_JSON_LOG_ERROR("Invalid input is NULL\n");
+        return WS_ERROR;
+    }
+    if (parser->state == _WS_JSON_STATE_ERROR) return WS_ERROR;
+
+    const char* cursor = chunk;
+    const char* end = chunk + length;
+
+    while (cursor < end) {
+        // Tokens that can span chunks consume as much as they can
+        if (parser->state == _WS_JSON_STATE_STRING) {
+            const char* start = cursor;
+            while (cursor < end) {
+                if (parser->escape) parser->escape = false;
+                else if (*cursor == '\\') parser->escape = true;
+                else if (*cursor == '"') break;
+                cursor++;
+            }
+            if (_wsJsonParserAppend(&parser->scratch, &parser->scratchLength, &parser->scratchCapacity, 
+                                    start, cursor - start) != WS_OK) goto error;
+            if (cursor == end) break;
+            cursor++; // closing "
+            if (_wsJsonParserFinishToken(parser) != WS_OK) goto error;
+            continue;
+        }
+        if (parser->state == _WS_JSON_STATE_NUMBER) {
+            const char* start = cursor;
+            while (cursor < end && _wsJsonIsNumberChar(*cursor)) cursor++;
+            if (_wsJsonParserAppend(&parser->scratch, &parser->scratchLength, &parser->scratchCapacity, 
+                                    start, cursor - start) != WS_OK) goto error;
+            if (cursor == end) break;
+            if (_wsJsonParserFinishToken(parser) != WS_OK) goto error;
+            continue;
+        }
+        if (parser->state == _WS_JSON_STATE_LITERAL) {
+            while (cursor < end && parser->literalMatched < parser->literalLength) {
+                if (*cursor != parser->literal[parser->literalMatched]) {
+                    WS_JSON_LOG_ERROR("Invalid json literal, expected %s\n", parser->literal);
+                    goto error;
+                }
+                parser->literalMatched++;
+                cursor++;
+            }
+            if (parser->literalMatched < parser->literalLength) break;
+            if (_wsJsonParserFinishToken(parser) != WS_OK) goto error;
+            continue;
+        }
+
+        char c = *cursor++;
+        if (_wsJsonIsSpace(c)) continue;
+
+        switch (parser->state) {
+            case _WS_JSON_STATE_FIRST_VALUE:
+                if (c == ']') {
+                    if (_wsJsonParserClose(parser, c) != WS_OK) goto error;
+                    break;
+                }
+                // fallthrough
+            case _WS_JSON_STATE_VALUE:
+                if (_wsJsonParserBeginValue(parser, c) != WS_OK) goto error;
+                // numbers start with the character that was just read
+                if (parser->state == _WS_JSON_STATE_NUMBER) cursor--;
+                else if (parser->state == _WS_JSON_STATE_LITERAL) cursor--;
+                break;
+            case _WS_JSON_STATE_FIRST_KEY:
+                if (c == '}') {
+                    if (_wsJsonParserClose(parser, c) != WS_OK) goto error;
+                    break;
+                }
+                // fallthrough
+            case _WS_JSON_STATE_KEY:
+                if (c != '"') {
+                    WS_JSON_LOG_ERROR("Expected json key but got '%c'\n", c);
+                    goto error;
+                }
+                parser->state = _WS_JSON_STATE_STRING;
+                parser->stringIsKey = true;
+                break;
+            case _WS_JSON_STATE_COLON:
+                if (c != ':') {
+                    WS_JSON_LOG_ERROR("Expected ':' but got '%c'\n", c);
+                    goto error;
+                }
+                parser->state = _WS_JSON_STATE_VALUE;
+                break;
+            case _WS_JSON_STATE_AFTER_VALUE:
+                if (c == ',') {
+                    parser->state = parser->types[parser->depth - 1] == WS_JSON_OBJECT ? _WS_JSON_STATE_KEY : _WS_JSON_STATE_VALUE;
+                }
+                else if (c == '}' || c == ']') {
+                    if (_wsJsonParserClose(parser, c) != WS_OK) goto error;
+                }
+                else {
+                    WS_JSON_LOG_ERROR("Expected ',' or closing bracket but got '%c'\n", c);
+                    goto error;
+                }
+                break;
+            case _WS_JSON_STATE_DONE:
+                WS_JSON_LOG_ERROR("Unexpected '%c' after the end of the json document\n", c);
+                goto error;
+            default:
+                goto error;
+        }
+    }
+
+    return parser->state == _WS_JSON_STATE_DONE ? WS_OK : WS_JSON_NEED_MORE;
+
+error:
+    parser->state = _WS_JSON_STATE_ERROR;
+    if (parser->root) {
+        wsJsonFree(parser->root);
+        parser->root = NULL;
+    }
+    return WS_ERROR;
+}
+
+wsJson* wsJsonParserGetRoot(wsJsonParser* parser) {
+    if (!parser || parser->state != _WS_JSON_STATE_DONE) {
+        WS_JSON_LOG_ERROR("Json parser has no finished document\n");
+        return NULL;
+    }
+    wsJson* root = parser->root;
+    parser->root = NULL;
+    return root;
+}
+
+void wsJsonParserReset(wsJsonParser* parser) {
+    if (!parser) return;
+    if (parser->root) wsJsonFree(parser->root);
+    parser->root = NULL;
+    parser->state = _WS_JSON_STATE_VALUE;
+    parser->depth = 0;
+    parser->escape = false;
+    parser->scratchLength = 0;
+    parser->keyLength = 0;
+}
+
+void wsJsonParserFree(wsJsonParser* parser) {
+    if (!parser) return;
+    if (parser->root) wsJsonFree(parser->root);
+    _wsJsonFree(parser->types);
+    _wsJsonFree(parser->nodes);
+    _wsJsonFree(parser->scratch);
+    _wsJsonFree(parser->key);
+    _wsJsonFree(parser);
+}
+
+// hash can be NULL, it is only needed once the object is indexed
+static wsJson* _wsJsonGetFieldHashed(wsJson* obj, const char* key, size_t keyLen, const uint32_t* hash) {
+    if (obj->type != WS_JSON_OBJECT) {
+        WS_JSON_LOG_ERROR("Obj is not from type WS_JSON_OBJECT\n");
+        return NULL;
+    }
+
+    // Large objects carry a hash index, small ones stay on the cheap linear scan
+    if (obj->flags & WS_JSON_FLAG_INDEXED) {
+        return _wsJsonIndexFind(obj, key, keyLen, hash ? *hash : _wsJsonHashKey(key, keyLen));
+    }
+
+    for (int32_t i = 0; i < obj->object.childCount; i++) {
+        wsJson* child = obj->object.children[i];
+        if (child->keyLength == keyLen && memcmp(child->key, key, keyLen) == 0) {
+            return child;
+        }
+    }
+    return NULL;
+}
+
+static inline wsJson* _wsJsonGetField(wsJson* obj, const char* key, size_t keyLen) {
+    return _wsJsonGetFieldHashed(obj, key, keyLen, NULL);
+}
+
+wsJson* wsJsonGetNonPath(wsJson* obj, const char* key) {
+    if (!obj || !key) {
+        WS_JSON_LOG_ERROR("Invalid input is NULL\n");
+        return NULL;
+    } 
+    return _wsJsonGetField(obj, key, strlen(key));
+}
+
+// holder (if not NULL) gets the container the value was found in
+static wsJson* _wsJsonGetKey(wsJson* obj, const char* key, wsJson** holder) {
+    if (!obj || !key) {
+        WS_JSON_LOG_ERROR("Invalid input is NULL\n");
+        return NULL;
+    } 
+    if (obj->type != WS_JSON_OBJECT) {
+        WS_JSON_LOG_ERROR("Obj is not from type WS_JSON_OBJECT\n");
+        return NULL;
+    }
+
+    const char* start = key;
+    const char* dot;
+    wsJson* current = obj;
+    wsJson* parent = obj;
+
+    while (current && (dot = strchr(start, '.'))) {
+        parent = current;
+        current = _wsJsonGetField(current, start, (size_t)(dot - start));
+        start = dot + 1;
+    }
+
+    if (current && *start) {
+        parent = current;
+        current = _wsJsonGetField(current, start, strlen(start));
+    }
+
+    if (holder) *holder = parent;
+    return current;
+}
+
+wsJson* wsJsonGet(wsJson* obj, const char* key) {
+    return _wsJsonGetKey(obj, key, NULL);
+}
+
+wsJsonPath* wsJsonPathInit(const char* string) {
+    if (!string) {
+        WS_JSON_LOG_ERROR("Invalid input is NULL\n");
+        return NULL;
+    }
+
+    size_t length = strlen(string);
+    int32_t maxSegments = 1;
+    for (size_t i = 0; i < length; i++) {
+        if (string[i] == '.' || string[i] == '[') maxSegments++;
+    }
+
+    // Path, segments and the copy of the string share one allocation
+    wsJsonPath* path = _wsJsonMalloc(sizeof(wsJsonPath) + sizeof(wsJsonPathSegment) * maxSegments + length + 1);
+    if (!path) {
+        WS_JSON_LOG_ERROR("Failed to allocate json path: %s\n", string);
+        return NULL;
+    }
+    path->segments = (wsJsonPathSegment*)(path + 1);
+    path->segmentCount = 0;
+    char* cursor = (char*)(path->segments + maxSegments);
+    memcpy(cursor, string, length + 1);
+
+    while (*cursor) {
+        wsJsonPathSegment* segment = &path->segments[path->segmentCount++];
+        if (*cursor == '[') {
+            cursor++;
+            int64_t index = 0;
+            const char* digits = cursor;
+            while (*cursor >= '0' && *cursor <= '9' && index <= INT32_MAX) {
+                index = index * 10 + (*cursor++ - '0');
+            }
+            if (cursor == digits || *cursor != ']' || index > INT32_MAX) {
+                WS_JSON_LOG_ERROR("Invalid array index in json path: %s\n", string);
+                _wsJsonFree(path);
+                return NULL;
+            }
+            cursor++;
+            segment->key = NULL;
+            segment->keyLength = 0;
+            segment->hash = 0;
+            segment->index = (int32_t)index;
+        }
+        else {
+            const char* start = cursor;
+            while (*cursor && *cursor != '.' && *cursor != '[') cursor++;
+            segment->key = start;
+            segment->keyLength = (uint32_t)(cursor - start);
+            segment->hash = _wsJsonHashKey(start, segment->keyLength);
+            segment->index = -1;
+        }
+        if (*cursor == '.') cursor++;
+    }
+    return path;
+}
+
+void wsJsonPathFree(wsJsonPath* path) {
+    if (path) _wsJsonFree(path);
+}
+
+static wsJson* _wsJsonGetPath(wsJson* obj, const wsJsonPath* path, wsJson** holder) {
+    if (!obj || !path) {
+        WS_JSON_LOG_ERROR("Invalid input is NULL\n");
+        return NULL;
+    }
+
+    wsJson* current = obj;
+    if (holder) *holder = obj;
+    for (int32_t i = 0; i < path->segmentCount && current; i++) {
+        const wsJsonPathSegment* segment = &path->segments[i];
+        if (holder) *holder = current;
+        if (segment->index >= 0) {
+            if (current->type != WS_JSON_ARRAY) {
+                WS_JSON_LOG_ERROR("Obj is not from type WS_JSON_ARRAY\n");
+                return NULL;
+            }
+            if (segment->index >= current->array.elementCount) return NULL;
+            current = current->array.elements[segment->index];
+        }
+        else {
+            current = _wsJsonGetFieldHashed(current, segment->key, segment->keyLength, &segment->hash);
+        }
+    }
+    return current;
+}
+
+wsJson* wsJsonGetPath(wsJson* obj, const wsJsonPath* path) {
+    return _wsJsonGetPath(obj, path, NULL);
+}
+
+/* Node getters, shared by the key and the compiled path functions */
+static char* _wsJsonNodeGetString(wsJson* child) {
+    if (child && child->type == WS_JSON_STRING) {
+        if ((child->flags & WS_JSON_FLAG_STRING_VIEW) && (child->flags & WS_JSON_FLAG_NO_TERMINATOR)) {
+            WS_JSON_LOG_ERROR("String is an unterminated view, use wsJsonGetStringView\n");
+            return NULL;
+        }
+        return child->stringValue;
+    }
+    return NULL;
+}
+
+static const char* _wsJsonNodeGetStringView(wsJson* child, size_t* length) {
+    if (child && child->type == WS_JSON_STRING) {
+        if (length) *length = child->stringLength;
+        return child->stringValue;
+    }
+    if (length) *length = 0;
+    return NULL;
+}
+
+static int32_t _wsJsonNodeGetStringEx(wsJson* child, char* out, size_t size) {
+    if (child && child->type == WS_JSON_STRING && size > 0) {
+        size_t length = child->stringLength < size - 1 ? child->stringLength : size - 1;
+        memcpy(out, child->stringValue, length);
+        out[length] = '\0';
+        return WS_OK;
+    }
+    return WS_ERROR;
+}
+
+static double _wsJsonNodeGetNumber(wsJson* child) {
+    if (child && child->type == WS_JSON_NUMBER) {
+        return child->numberValue;
+    }
+    return WS_ERROR;
+}
+
+static int64_t _wsJsonNodeGetInteger(wsJson* child) {
+    if (child && child->type == WS_JSON_NUMBER) {
+        if (child->flags & WS_JSON_FLAG_INTEGER) return child->integerValue;
+        double value = child->numberValue;
+        if (value != value) return 0;
+        if (value <= -9223372036854775808.0) return INT64_MIN;
+        if (value >= 9223372036854775808.0) return INT64_MAX;
+        return (int64_t)value;
+    }
+    return WS_ERROR;
+}
+
+static bool _wsJsonNodeGetBool(wsJson* child) {
+    if (child && child->type == WS_JSON_BOOL) {
+        return child->boolValue;
+    }
+    return WS_ERROR;
+}
+
+static int32_t _wsJsonNodeGetArrayLen(wsJson* child) {
+    if (child && child->type == WS_JSON_ARRAY) {
+        return child->array.elementCount;
+    }
+    return WS_ERROR;
+}
+
+static wsJson* _wsJsonNodeGetArrayAt(wsJson* child, int32_t index) {
+    if (child && child->type == WS_JSON_ARRAY) {
+        if (index < 0 || index >= child->array.elementCount) return NULL;
+        return child->array.elements[index];
+    }
+    return NULL;
+}
+
+char* wsJsonGetString(wsJson* obj, const char* key) {
+    return _wsJsonNodeGetString(wsJsonGet(obj, key));
+}
+
+const char* wsJsonGetStringView(wsJson* obj, const char* key, size_t* length) {
+    return _wsJsonNodeGetStringView(wsJsonGet(obj, key), length);
+}
+
+int32_t wsJsonGetStringEx(wsJson *obj, const char *key, char *out, size_t size) {
+    return _wsJsonNodeGetStringEx(wsJsonGet(obj, key), out, size);
+}
+
+double wsJsonGetNumber(wsJson *obj, const char *key) {
+    return _wsJsonNodeGetNumber(wsJsonGet(obj, key));
+}
+
+int64_t wsJsonGetInteger(wsJson* obj, const char* key) {
+    return _wsJsonNodeGetInteger(wsJsonGet(obj, key));
+}
+
+bool wsJsonGetBool(wsJson* obj, const char* key) {
+    return _wsJsonNodeGetBool(wsJsonGet(obj, key));
+}
+
+int32_t wsJsonGetArrayLen(wsJson* obj, const char* key) {
+    return _wsJsonNodeGetArrayLen(wsJsonGet(obj, key));
+}
+
+wsJson* wsJsonGetArrayAt(wsJson* obj, const char* key, int32_t index) {
+    return _wsJsonNodeGetArrayAt(wsJsonGet(obj, key), index);
+}
+
+char* wsJsonGetStringPath(wsJson* obj, const wsJsonPath* path) {
+    return _wsJsonNodeGetString(wsJsonGetPath(obj, path));
+}
+
+const char* wsJsonGetStringViewPath(wsJson* obj, const wsJsonPath* path, size_t* length) {
+    return _wsJsonNodeGetStringView(wsJsonGetPath(obj, path), length);
+}
+
+int32_t wsJsonGetStringExPath(wsJson* obj, const wsJsonPath* path, char* out, size_t size) {
+    return _wsJsonNodeGetStringEx(wsJsonGetPath(obj, path), out, size);
+}
+
+double wsJsonGetNumberPath(wsJson* obj, const wsJsonPath* path) {
+    return _wsJsonNodeGetNumber(wsJsonGetPath(obj, path));
+}
+
+int64_t wsJsonGetIntegerPath(wsJson* obj, const wsJsonPath* path) {
+    return _wsJsonNodeGetInteger(wsJsonGetPath(obj, path));
+}
+
+bool wsJsonGetBoolPath(wsJson* obj, const wsJsonPath* path) {
+    return _wsJsonNodeGetBool(wsJsonGetPath(obj, path));
+}
+
+int32_t wsJsonGetArrayLenPath(wsJson* obj, const wsJsonPath* path) {
+    return _wsJsonNodeGetArrayLen(wsJsonGetPath(obj, path));
+}
+
+wsJson* wsJsonGetArrayAtPath(wsJson* obj, const wsJsonPath* path, int32_t index) {
+    return _wsJsonNodeGetArrayAt(wsJsonGetPath(obj, path), index);
+}
+
+/* Node setters, the public setters resolve the path once and then call these */
+
+// Bytes an owned string buffer has room for, including the terminator
+static inline size_t _wsJsonStringCapacity(const wsJson* node) {
+    if (node->flags & WS_JSON_FLAG_POOLED) return _wsJsonBlockCapacity(node->stringValue);
+    if (node->stringCapacity) return node->stringCapacity;
+    return (size_t)node->stringLength + 1;
+}
+
+static int32_t _wsJsonNodeSetStringExplicit(wsJson* child, const char* val) {
+    if (child && child->type == WS_JSON_STRING) {
+        size_t length = strlen(val);
+        bool owned = child->stringValue && !(child->flags & WS_JSON_FLAG_STRING_VIEW);
+        size_t capacity = owned ? _wsJsonStringCapacity(child) : 0;
+        // An owned string that is big enough gets overwritten (val may point into it), 
+        // the buffer keeps its size when the string shrinks
+        if (length < capacity) {
+            memmove(child->stringValue, val, length);
+            child->stringValue[length] = '\0';
+            child->stringLength = (uint32_t)length;
+            child->stringCapacity = (uint32_t)capacity;
+            return WS_OK;
+        }
+
+        // A string that outgrows its buffer gets half its length as slack for the next values
+        capacity = length + 1;
+        if (owned && length / 2 < UINT32_MAX - capacity) capacity += length / 2;
+        char* string = _wsJsonNodeAlloc(child, capacity);
+        if (!string) return WS_ERROR;
+        memcpy(string, val, length);
+        string[length] = '\0';
+
+        if (owned) _wsJsonNodeFree(child, child->stringValue);
+        child->flags &= ~(WS_JSON_FLAG_STRING_VIEW | WS_JSON_FLAG_NO_TERMINATOR);
+        child->stringValue = string;
+        child->stringLength = (uint32_t)length;
+        child->stringCapacity = (uint32_t)capacity;
+        return WS_OK;
+    }
+    return WS_ERROR;
+}
+
+static int32_t _wsJsonNodeSetNumberExplicit(wsJson* child, double val) {
+    if (child && child->type == WS_JSON_NUMBER) {
+        child->flags &= ~WS_JSON_FLAG_INTEGER;
+        child->numberValue = val;
+        return WS_OK;
+    }
+    return WS_ERROR;
+}
+
+static int32_t _wsJsonNodeSetBoolExplicit(wsJson* child, bool val) {
+    if (child && child->type == WS_JSON_BOOL) {
+        child->boolValue = val;
+        return WS_OK;
+    }
+    return WS_ERROR;
+}
+
+// Moves a child array from src to dst, copying it when both nodes use different allocators
+static int32_t _wsJsonAdoptChildren(wsJson* dst, wsJson* src, wsJson** children, int32_t count, int32_t capacity) {
+    dst->flags |= src->flags & WS_JSON_FLAG_INDEXED;
+    if (_wsJsonSameAllocator(dst, src) || !children) {
+        dst->object.children = children;
+        return WS_OK;
+    }
+
+    // Index slots hold child positions, so the copy takes them along as they are
+    size_t size = _wsJsonChildrenSize(capacity, src->flags & WS_JSON_FLAG_INDEXED);
+    wsJson** copy = _wsJsonNodeAlloc(dst, size);
+    if (!copy) {
+        WS_JSON_LOG_ERROR("Failed to allocate json children\n");
+        return WS_ERROR;
+    }
+    memcpy(copy, children, sizeof(wsJson*) * count);
+    if (src->flags & WS_JSON_FLAG_INDEXED) {
+        memcpy(copy + capacity, children + capacity, size - sizeof(wsJson*) * capacity);
+    }
+    _wsJsonNodeFree(src, children);
+    dst->object.children = copy;
+    return WS_OK;
+}
+
+static int32_t _wsJsonNodeSetNullToObject(wsJson* child, wsJson* fields) {
+    if (child && child->type == WS_JSON_NULL) {
+        if (_wsJsonAdoptChildren(child, fields, fields->object.children, 
+                                 fields->object.childCount, fields->object.childCapacity) != WS_OK) {
+            return WS_ERROR;
+        }
+        child->type = WS_JSON_OBJECT;
+        child->object.childCount = fields->object.childCount;
+        child->object.childCapacity = fields->object.childCapacity;
+
+        fields->object.children = NULL;
+        fields->object.childCount = 0;
+        fields->object.childCapacity = 0;
+        _wsJsonNodeFree(fields, fields);
+        return WS_OK;
+    }
+    return WS_ERROR;
+}
+
+static int32_t _wsJsonNodeSetNullToString(wsJson* child, const char* val) {
+    if (child && child->type == WS_JSON_NULL) {
+        size_t length = strlen(val);
+        char* string = _wsJsonNodeStrndup(child, val, length);
+        if (!string) return WS_ERROR;
+
+        child->type = WS_JSON_STRING;
+        child->stringValue = string;
+        child->stringLength = (uint32_t)length;
+        child->stringCapacity = (uint32_t)(length + 1);
+        return WS_OK;
+    }
+    return WS_ERROR;
+}
+
+static int32_t _wsJsonNodeSetNullToNumber(wsJson* child, double val) {
+    if (child && child->type == WS_JSON_NULL) {
+        child->type = WS_JSON_NUMBER;
+        child->numberValue = val;
+        return WS_OK;
+    }
+    return WS_ERROR;
+}
+
+static int32_t _wsJsonNodeSetNullToBool(wsJson* child, bool val) {
+    if (child && child->type == WS_JSON_NULL) {
+        child->type = WS_JSON_BOOL;
+        child->boolValue = val;
+        return WS_OK;
+    }
+    return WS_ERROR;
+}
+
+static int32_t _wsJsonNodeSetNullToArray(wsJson* child, wsJson* array) {
+    if (child && child->type == WS_JSON_NULL) {
+        if (_wsJsonAdoptChildren(child, array, array->array.elements, 
+                                 array->array.elementCount, array->array.elementCapacity) != WS_OK) {
+            return WS_ERROR;
+        }
+        child->type = WS_JSON_ARRAY;
+        child->array.elementCount = array->array.elementCount;
+        child->array.elementCapacity = array->array.elementCapacity;
+
+        array->array.elements = NULL;
+        array->array.elementCount = 0;
+        array->array.elementCapacity = 0;
+        _wsJsonNodeFree(array, array);
+        return WS_OK;
+    }
+    return WS_ERROR;
+}
+
+static int32_t _wsJsonNodeSetString(wsJson* child, const char* val) {
+    if (child) {
+        if (child->type == WS_JSON_STRING) return _wsJsonNodeSetStringExplicit(child, val);
+        else if (child->type == WS_JSON_NULL) return _wsJsonNodeSetNullToString(child, val);
+        return WS_ERROR;
+    }
+    return WS_ERROR;
+}
+
+static int32_t _wsJsonNodeSetNumber(wsJson* child, double val) {
+    if (child) {
+        if (child->type == WS_JSON_NUMBER) return _wsJsonNodeSetNumberExplicit(child, val);
+        else if (child->type == WS_JSON_NULL) return _wsJsonNodeSetNullToNumber(child, val);
+        return WS_ERROR;
+    }
+    return WS_ERROR;
+}
+
+// Null nodes are turned into numbers
+static int32_t _wsJsonNodeSetInteger(wsJson* child, int64_t val) {
+    if (child && (child->type == WS_JSON_NUMBER || child->type == WS_JSON_NULL)) {
+        child->type = WS_JSON_NUMBER;
+        child->flags |= WS_JSON_FLAG_INTEGER;
+        child->integerValue = val;
+        child->numberValue = (double)val;
+        return WS_OK;
+    }
+    return WS_ERROR;
+}
+
+static int32_t _wsJsonNodeSetBool(wsJson* child, bool val) {
+    if (child) {
+        if (child->type == WS_JSON_BOOL) return _wsJsonNodeSetBoolExplicit(child, val);
+        else if (child->type == WS_JSON_NULL) return _wsJsonNodeSetNullToBool(child, val);
+        return WS_ERROR;
+    }
+    return WS_ERROR;
+}
+
+static int32_t _wsJsonNodeSetElement(wsJson* child, int32_t index, wsJson* element) {
+    if (child && child->type == WS_JSON_ARRAY && element) {
+        if (index < 0 || index >= child->array.elementCount) return WS_ERROR;
+        wsJson* old = child->array.elements[index];
+        child->array.elements[index] = element;
+        _wsJsonTouch(child);
+        if (old != element) wsJsonFree(old);
+        return WS_OK;
+    }
+    return WS_ERROR;
+}
+
+// Target of a setter, the container holding it gets marked for cached serialization
+static wsJson* _wsJsonMutableAt(wsJson* obj, const char* key) {
+    wsJson* holder = NULL;
+    wsJson* node = _wsJsonMutable(_wsJsonGetKey(obj, key, &holder));
+    if (node) _wsJsonTouch(holder);
+    return node;
+}
+
+static wsJson* _wsJsonMutableAtPath(wsJson* obj, const wsJsonPath* path) {
+    wsJson* holder = NULL;
+    wsJson* node = _wsJsonMutable(_wsJsonGetPath(obj, path, &holder));
+    if (node) _wsJsonTouch(holder);
+    return node;
+}
+
+int32_t wsJsonSetStringExplicit(wsJson *obj, const char *key, const char *val) {
+    return _wsJsonNodeSetStringExplicit(_wsJsonMutableAt(obj, key), val);
+}
+
+int32_t wsJsonSetNumberExplicit(wsJson *obj, const char *key, double val) {
+    return _wsJsonNodeSetNumberExplicit(_wsJsonMutableAt(obj, key), val);
+}
+
+int32_t wsJsonSetBoolExplicit(wsJson *obj, const char *key, bool val) {
+    return _wsJsonNodeSetBoolExplicit(_wsJsonMutableAt(obj, key), val);
+}
+
+int32_t wsJsonSetNullToObject(wsJson* obj, const char *key, wsJson *fields) {
+    return _wsJsonNodeSetNullToObject(_wsJsonMutableAt(obj, key), fields);
+}
+
+int32_t wsJsonSetNullToString(wsJson *obj, const char *key, const char *val) {
+    return _wsJsonNodeSetNullToString(_wsJsonMutableAt(obj, key), val);
+}
+
+int32_t wsJsonSetNullToNumber(wsJson *obj, const char *key, double val) {
+    return _wsJsonNodeSetNullToNumber(_wsJsonMutableAt(obj, key), val);
+}
+
+int32_t wsJsonSetNullToBool(wsJson *obj, const char *key, bool val) {
+    return _wsJsonNodeSetNullToBool(_wsJsonMutableAt(obj, key), val);
+}
+
+int32_t wsJsonSetNullToArray(wsJson *obj, const char *key, wsJson *array) {
+    return _wsJsonNodeSetNullToArray(_wsJsonMutableAt(obj, key), array);
+}
+
+int32_t wsJsonSetString(wsJson *obj, const char *key, const char *val) {
+    return _wsJsonNodeSetString(_wsJsonMutableAt(obj, key), val);
+}
+
+int32_t wsJsonSetNumber(wsJson *obj, const char *key, double val) {
+    return _wsJsonNodeSetNumber(_wsJsonMutableAt(obj, key), val);
+}
+
+int32_t wsJsonSetInteger(wsJson* obj, const char* key, int64_t val) {
+    return _wsJsonNodeSetInteger(_wsJsonMutableAt(obj, key), val);
+}
+
+int32_t wsJsonSetBool(wsJson *obj, const char *key, bool val) {
+    return _wsJsonNodeSetBool(_wsJsonMutableAt(obj, key), val);
+}
+
+int32_t wsJsonSetElement(wsJson *obj, const char *key, int32_t index, wsJson *element) {
+    return _wsJsonNodeSetElement(_wsJsonMutableAt(obj, key), index, element);
+}
+
+int32_t wsJsonSetStringExplicitPath(wsJson* obj, const wsJsonPath* path, const char* val) {
+    return _wsJsonNodeSetStringExplicit(_wsJsonMutableAtPath(obj, path), val);
+}
+
+int32_t wsJsonSetNumberExplicitPath(wsJson* obj, const wsJsonPath* path, double val) {
+    return _wsJsonNodeSetNumberExplicit(_wsJsonMutableAtPath(obj, path), val);
+}
+
+int32_t wsJsonSetBoolExplicitPath(wsJson* obj, const wsJsonPath* path, bool val) {
+    return _wsJsonNodeSetBoolExplicit(_wsJsonMutableAtPath(obj, path), val);
+}
+
+int32_t wsJsonSetStringPath(wsJson* obj, const wsJsonPath* path, const char* val) {
+    return _wsJsonNodeSetString(_wsJsonMutableAtPath(obj, path), val);
+}
+
+int32_t wsJsonSetNumberPath(wsJson* obj, const wsJsonPath* path, double val) {
+    return _wsJsonNodeSetNumber(_wsJsonMutableAtPath(obj, path), val);
+}
+
+int32_t wsJsonSetIntegerPath(wsJson* obj, const wsJsonPath* path, int64_t val) {
+    return _wsJsonNodeSetInteger(_wsJsonMutableAtPath(obj, path), val);
+}
+
+int32_t wsJsonSetBoolPath(wsJson* obj, const wsJsonPath* path, bool val) {
+    return _wsJsonNodeSetBool(_wsJsonMutableAtPath(obj, path), val);
+}
+
+int32_t wsJsonSetElementPath(wsJson* obj, const wsJsonPath* path, int32_t index, wsJson* element) {
+    return _wsJsonNodeSetElement(_wsJsonMutableAtPath(obj, path), index, element);
+}
+
+int32_t wsJsonSetNullToObjectPath(wsJson* obj, const wsJsonPath* path, wsJson* fields) {
+    return _wsJsonNodeSetNullToObject(_wsJsonMutableAtPath(obj, path), fields);
+}
+
+int32_t wsJsonSetNullToStringPath(wsJson* obj, const wsJsonPath* path, const char* val) {
+    return _wsJsonNodeSetNullToString(_wsJsonMutableAtPath(obj, path), val);
+}
+
+int32_t wsJsonSetNullToNumberPath(wsJson* obj, const wsJsonPath* path, double val) {
+    return _wsJsonNodeSetNullToNumber(_wsJsonMutableAtPath(obj, path), val);
+}
+
+int32_t wsJsonSetNullToBoolPath(wsJson* obj, const wsJsonPath* path, bool val) {
+    return _wsJsonNodeSetNullToBool(_wsJsonMutableAtPath(obj, path), val);
+}
+
+int32_t wsJsonSetNullToArrayPath(wsJson* obj, const wsJsonPath* path, wsJson* array) {
+    return _wsJsonNodeSetNullToArray(_wsJsonMutableAtPath(obj, path), array);
+}
+
+/* 
+ *  Clone and patch
+ *  Clones are built in one pass with an explicit stack and every children 
+ *  array gets its final size right away. Patches replace object members at 
+ *  their position so the key index stays valid, removing one fixes up the 
+ *  index slots instead of hashing all keys again.
+ */
+// Copies src without its children, the children array is allocated with room for all of them
+static wsJson* _wsJsonCloneShell(const wsJson* src, const char* key, size_t keyLength) {
+    wsJson* dst = _wsJsonAllocNode(src->type, key, keyLength);
+    if (!dst) {
+        WS_JSON_LOG_ERROR("Failed to allocate json clone\n");
+        return NULL;
+    }
+    dst->flags |= src->flags & WS_JSON_FLAG_INTEGER;
+    switch (src->type) {
+        case WS_JSON_STRING:
+            dst->stringValue = _wsJsonNodeStrndup(dst, src->stringValue ? src->stringValue : "", src->stringLength);
+            dst->stringLength = src->stringLength;
+            if (!dst->stringValue) break;
+            return dst;
+        case WS_JSON_OBJECT:
+        case WS_JSON_ARRAY: { // same layout for arrays
+            if (src->object.childCount == 0) return dst;
+            // Children get inserted into the index as they are copied
+            bool indexed = src->type == WS_JSON_OBJECT && (src->flags & WS_JSON_FLAG_INDEXED);
+            size_t size = _wsJsonChildrenSize(src->object.childCount, indexed);
+            dst->object.children = _wsJsonNodeAlloc(dst, size);
+            dst->object.childCapacity = src->object.childCount;
+            if (!dst->object.children) break;
+            if (indexed) {
+                dst->flags |= WS_JSON_FLAG_INDEXED;
+                memset(_wsJsonIndexSlots(dst), 0, size - sizeof(wsJson*) * src->object.childCount);
+            }
+            return dst;
+        }
+        case WS_JSON_NUMBER:
+            dst->numberValue = src->numberValue;
+            dst->integerValue = src->integerValue;
+            return dst;
+        case WS_JSON_BOOL:
+            dst->boolValue = src->boolValue;
+            return dst;
+        default:
+            return dst;
+    }
+    WS_JSON_LOG_ERROR("Failed to allocate json clone\n");
+    _wsJsonNodeFree(dst, dst);
+    return NULL;
+}
+
+typedef struct _wsJsonCloneFrame {
+    const wsJson* src;
+    wsJson* dst; // its child count is the next child to copy
+} _wsJsonCloneFrame;
+
+static wsJson* _wsJsonCloneAs(const wsJson* src, const char* key, size_t keyLength) {
+    wsJson* root = _wsJsonCloneShell(src, key, keyLength);
+    if (!root || root->object.childCapacity == 0 || (root->type != WS_JSON_OBJECT && root->type != WS_JSON_ARRAY)) {
+        return root;
+    }
+
+    _wsJsonCloneFrame inlineStack[_WS_JSON_INLINE_DEPTH];
+    _wsJsonCloneFrame* stack = inlineStack;
+    int32_t capacity = _WS_JSON_INLINE_DEPTH;
+    int32_t depth = 1;
+    int32_t result = WS_OK;
+    stack[0].src = src;
+    stack[0].dst = root;
+
+    while (depth > 0) {
+        _wsJsonCloneFrame* frame = &stack[depth - 1];
+        wsJson* copy = frame->dst;
+        if (copy->object.childCount == frame->src->object.childCount) {
+            depth--;
+            continue;
+        }
+
+        const wsJson* child = frame->src->object.children[copy->object.childCount];
+        wsJson* childCopy = _wsJsonCloneShell(child, child->keyLength ? child->key : NULL, child->keyLength);
+        if (!childCopy) {
+            result = WS_ERROR;
+            break;
+        }
+        copy->object.children[copy->object.childCount++] = childCopy;
+        if (copy->flags & WS_JSON_FLAG_INDEXED) _wsJsonIndexInsert(copy, copy->object.childCount - 1);
+        if (childCopy->type != WS_JSON_OBJECT && childCopy->type != WS_JSON_ARRAY) continue;
+        if (childCopy->object.childCapacity == 0) continue;
+
+        if (depth == capacity && _wsJsonStackGrow((void**)&stack, inlineStack, &capacity, sizeof(_wsJsonCloneFrame)) != WS_OK) {
+            result = WS_ERROR;
+            break;
+        }
+        stack[depth].src = child;
+        stack[depth].dst = childCopy;
+        depth++;
     }
-    array->array.elements[array->array.elementCount++] = element;
+
+    if (stack != inlineStack) _wsJsonFree(stack);
+    if (result != WS_OK) {
+        wsJsonFree(root);
+        return NULL;
+    }
+    return root;
 }
 
-int32_t wsJsonToString(wsJson *obj, char *out, size_t size) {
+wsJson* wsJsonClone(const wsJson* obj) {
     if (!obj) {
-        WS_JSON_LOG_ERROR("Input json obj is NULL\n");
-        return WS_ERROR;
-    }
-    if (!out) {
-        WS_JSON_LOG_ERROR("Input buffer for output is NULL\n");
-        return WS_ERROR;
+        WS_JSON_LOG_ERROR("Invalid input paramerter is NULL\n");
+        return NULL;
     }
-    
-    size_t used = 0;
+    return _wsJsonCloneAs(obj, obj->keyLength ? obj->key : NULL, obj->keyLength);
+}
 
-    switch (obj->type) {
+// Compares everything but the children of arrays and objects
+static bool _wsJsonShallowEqual(const wsJson* a, const wsJson* b) {
+    if (a->type != b->type) return false;
+    switch (a->type) {
         case WS_JSON_STRING:
-            used += snprintf(out + used, size - used, "\"%s\"", obj->stringValue);
-            break;
+            return a->stringLength == b->stringLength && memcmp(a->stringValue, b->stringValue, a->stringLength) == 0;
         case WS_JSON_NUMBER:
-            used += snprintf(out + used, size - used, "%g", obj->numberValue);
-            break;
+            if (a->flags & b->flags & WS_JSON_FLAG_INTEGER) return a->integerValue == b->integerValue;
+            return a->numberValue == b->numberValue;
         case WS_JSON_BOOL:
-            used += snprintf(out + used, size - used, "%s", obj->boolValue ? "true" : "false");
-            break;
-        case WS_JSON_NULL:
-            used += snprintf(out + used, size - used, "null");
-            break;
+            return a->boolValue == b->boolValue;
         case WS_JSON_OBJECT:
-            used += snprintf(out + used, size - used, "{");
-            for (int32_t i = 0; i < obj->object.childCount; i++) {
-                wsJson* child = obj->object.children[i];
-                if (i > 0) {
-                    used += snprintf(out + used, size - used, ",");
-                }
-                used += snprintf(out + used, size - used, "\"%s\": ", child->key);
-                wsJsonToString(child, out + used, size - used);
-                used = strlen(out);
-            }
-            used += snprintf(out + used, size - used, "}");
-            break;
         case WS_JSON_ARRAY:
-            used += snprintf(out + used, size - used, "[");
-            for (int32_t i = 0; i < obj->array.elementCount; i++) {
-                wsJson* element = obj->array.elements[i];
-                if (i > 0) {
-                    used += snprintf(out + used, size - used, ",");
-                }
-                wsJsonToString(element, out + used, size - used);
-                used = strlen(out);
-            }
-            used += snprintf(out + used, size - used, "]");
-            break;
+            return a->object.childCount == b->object.childCount;
         default:
-            WS_JSON_LOG_ERROR("Failed to parse json into string\n");
-            return WS_ERROR;
+            return true;
+    }
+}
+
+typedef struct _wsJsonEqualFrame {
+    wsJson* a;
+    wsJson* b;
+    int32_t index;
+} _wsJsonEqualFrame;
+
+bool wsJsonEqual(wsJson* a, wsJson* b) {
+    if (!a || !b) return a == b;
+    if (!_wsJsonShallowEqual(a, b)) return false;
+    if (a->type != WS_JSON_OBJECT && a->type != WS_JSON_ARRAY) return true;
+
+    _wsJsonEqualFrame inlineStack[_WS_JSON_INLINE_DEPTH];
+    _wsJsonEqualFrame* stack = inlineStack;
+    int32_t capacity = _WS_JSON_INLINE_DEPTH;
+    int32_t depth = 1;
+    bool equal = true;
+    stack[0].a = a;
+    stack[0].b = b;
+    stack[0].index = 0;
+
+    while (depth > 0) {
+        _wsJsonEqualFrame* frame = &stack[depth - 1];
+        if (frame->index == frame->a->object.childCount) {
+            depth--;
+            continue;
+        }
+
+        wsJson* childA = frame->a->object.children[frame->index];
+        wsJson* childB;
+        if (frame->a->type == WS_JSON_OBJECT) {
+            childB = _wsJsonGetFieldHashed(frame->b, childA->key, childA->keyLength, NULL);
+        }
+        else {
+            childB = frame->b->array.elements[frame->index];
+        }
+        frame->index++;
+        if (!childB || !_wsJsonShallowEqual(childA, childB)) {
+            equal = false;
+            break;
+        }
+        if (childA->type != WS_JSON_OBJECT && childA->type != WS_JSON_ARRAY) continue;
+
+        if (depth == capacity && _wsJsonStackGrow((void**)&stack, inlineStack, &capacity, sizeof(_wsJsonEqualFrame)) != WS_OK) {
+            equal = false;
+            break;
+        }
+        stack[depth].a = childA;
+        stack[depth].b = childB;
+        stack[depth].index = 0;
+        depth++;
+    }
+
+    if (stack != inlineStack) _wsJsonFree(stack);
+    return equal;
+}
+
+// Position of the member in the children array or -1, through the index for large objects
+static int32_t _wsJsonFieldPosition(wsJson* obj, const char* key, size_t keyLength) {
+    if (obj->flags & WS_JSON_FLAG_INDEXED) {
+        _wsJsonIndexSlot* slots = _wsJsonIndexSlots(obj);
+        size_t mask = _wsJsonIndexSlotCount(obj->object.childCapacity) - 1;
+        uint32_t hash = _wsJsonHashKey(key, keyLength);
+        for (size_t i = hash & mask; slots[i].index; i = (i + 1) & mask) {
+            if (slots[i].hash != hash) continue;
+            wsJson* child = obj->object.children[slots[i].index - 1];
+            if (child->keyLength == keyLength && memcmp(child->key, key, keyLength) == 0) return (int32_t)slots[i].index - 1;
+        }
+        return -1;
     }
 
-    return used;
+    for (int32_t i = 0; i < obj->object.childCount; i++) {
+        wsJson* child = obj->object.children[i];
+        if (child->keyLength == keyLength && memcmp(child->key, key, keyLength) == 0) return i;
+    }
+    return -1;
 }
 
-size_t addIndent(char* out, size_t size, int32_t indent) {
-    size_t used = 0;
-    for (int32_t i = 0; i < indent; i++) {
-        if (used < size - 1) out[used++] = ' ';
+// Drops the slot of child position and moves the slots of the children behind it one down. 
+// A later child with the same key (only the first one is indexed) stays out of the index.
+static void _wsJsonIndexRemove(wsJson* obj, int32_t position) {
+    _wsJsonIndexSlot* slots = _wsJsonIndexSlots(obj);
+    size_t count = _wsJsonIndexSlotCount(obj->object.childCapacity);
+    size_t mask = count - 1;
+    size_t hole = count;
+    for (size_t i = 0; i < count; i++) {
+        if (slots[i].index == (uint32_t)position + 1) hole = i;
+        else if (slots[i].index > (uint32_t)position + 1) slots[i].index--;
+    }
+    if (hole == count) return;
+
+    // Backward shift deletion keeps every probe chain without a gap
+    for (size_t j = (hole + 1) & mask; slots[j].index; j = (j + 1) & mask) {
+        size_t home = slots[j].hash & mask;
+        bool movable = hole <= j ? (home <= hole || home > j) : (home <= hole && home > j);
+        if (movable) {
+            slots[hole] = slots[j];
+            hole = j;
+        }
     }
-    return used;
+    slots[hole].hash = 0;
+    slots[hole].index = 0;
 }
 
-int32_t wsJsonToStringPrettyInternal(wsJson *obj, char *out, size_t size, int32_t indent) {
-    if (!obj) {
-        WS_JSON_LOG_ERROR("Input json obj is NULL\n");
-        return WS_ERROR;
+// Takes the child out of the array or object without freeing it, the order of the rest stays
+static wsJson* _wsJsonDetachChild(wsJson* parent, int32_t position) {
+    wsJson** children = parent->object.children; // same layout for arrays
+    wsJson* child = children[position];
+    _wsJsonTouch(parent);
+    child->flags &= ~WS_JSON_FLAG_TRACKED; // its place in the cached output is gone
+    if (parent->type == WS_JSON_OBJECT && (parent->flags & WS_JSON_FLAG_INDEXED)) _wsJsonIndexRemove(parent, position);
+    memmove(children + position, children + position + 1, sizeof(wsJson*) * (parent->object.childCount - position - 1));
+    parent->object.childCount--;
+    return child;
+}
+
+// Puts value at position of an array, position == count appends
+static int32_t _wsJsonInsertElement(wsJson* array, int32_t position, wsJson* value) {
+    int32_t count = array->array.elementCount;
+    wsJsonAddElement(array, value);
+    if (array->array.elementCount == count) return WS_ERROR;
+    memmove(array->array.elements + position + 1, array->array.elements + position, sizeof(wsJson*) * (count - position));
+    array->array.elements[position] = value;
+    return WS_OK;
+}
+
+// Replaces the member at position (or adds it for -1), value needs the key of the member
+static int32_t _wsJsonPlaceField(wsJson* obj, int32_t position, wsJson* value) {
+    if (position >= 0) {
+        wsJson* old = obj->object.children[position];
+        obj->object.children[position] = value;
+        _wsJsonTouch(obj);
+        wsJsonFree(old);
+        return WS_OK;
     }
-    if (!out) {
-        WS_JSON_LOG_ERROR("Input buffer for output is NULL\n");
+    int32_t count = obj->object.childCount;
+    wsJsonAddField(obj, value);
+    if (obj->object.childCount == count) {
+        wsJsonFree(value);
         return WS_ERROR;
     }
-    
-    size_t used = 0;
+    return WS_OK;
+}
 
-    switch (obj->type) {
-        case WS_JSON_STRING:
-            used += snprintf(out + used, size - used, "\"%s\"", obj->stringValue);
-            break;
-        case WS_JSON_NUMBER:
-            used += snprintf(out + used, size - used, "%g", obj->numberValue);
-            break;
-        case WS_JSON_BOOL:
-            used += snprintf(out + used, size - used, "%s", obj->boolValue ? "true" : "false");
-            break;
-        case WS_JSON_NULL:
-            used += snprintf(out + used, size - used, "null");
-            break;
-        case WS_JSON_OBJECT:
-            used += snprintf(out + used, size - used, "{\n");
-            for (int32_t i = 0; i < obj->object.childCount; i++) {
-                wsJson* child = obj->object.children[i];
-                if (i > 0) {
-                    used += snprintf(out + used, size - used, ",\n");
-                }
-                used += addIndent(out + used, size - used, indent + 4);
-                used += snprintf(out + used, size - used, "\"%s\": ", child->key);
-                int32_t written = wsJsonToStringPrettyInternal(child, out + used, size - used, indent + 4);
-                if (written < 0) return WS_ERROR;
-                used += written;
-            }
-            used += snprintf(out + used, size - used, "\n");
-            used += addIndent(out + used, size - used, indent);
-            used += snprintf(out + used, size - used, "}");
-            break;
-        case WS_JSON_ARRAY:
-            used += snprintf(out + used, size - used, "[\n");
-            for (int32_t i = 0; i < obj->array.elementCount; i++) {
-                wsJson* element = obj->array.elements[i];
-                if (i > 0) {
-                    used += snprintf(out + used, size - used, ",\n");
-                }
-                used += addIndent(out + used, size - used, indent + 4);
-                int32_t written = wsJsonToStringPrettyInternal(element, out + used, size - used, indent + 4);
-                if (written < 0) return WS_ERROR;
-                used += written;
-            }
-            used += snprintf(out + used, size - used, "\n");
-            used += addIndent(out + used, size - used, indent);
-            used += snprintf(out + used, size - used, "]");
-            break;
-        default:
-            WS_JSON_LOG_ERROR("Failed to parse json into string\n");
+// Frees what node owns besides itself
+static void _wsJsonFreeValue(wsJson* node) {
+    if (node->type == WS_JSON_STRING && !(node->flags & WS_JSON_FLAG_STRING_VIEW)) {
+        _wsJsonNodeFree(node, node->stringValue);
+    }
+    else if (node->type == WS_JSON_OBJECT || node->type == WS_JSON_ARRAY) {
+        for (int32_t i = 0; i < node->object.childCount; i++) wsJsonFree(node->object.children[i]);
+        _wsJsonNodeFree(node, node->object.children);
+    }
+}
+
+// Moves the value of src (a detached node) into dst, which keeps its key and its place in the tree
+static int32_t _wsJsonNodeAssign(wsJson* dst, wsJson* src) {
+    bool sameAllocator = _wsJsonSameAllocator(dst, src);
+    void* buffer = NULL; // string or children array dst takes over
+    if (src->type == WS_JSON_STRING) {
+        buffer = src->stringValue;
+        if (!sameAllocator && !(src->flags & WS_JSON_FLAG_STRING_VIEW)) {
+            buffer = _wsJsonNodeStrndup(dst, src->stringValue, src->stringLength);
+            if (!buffer) return WS_ERROR;
+            _wsJsonNodeFree(src, src->stringValue);
+        }
+    }
+    else if ((src->type == WS_JSON_OBJECT || src->type == WS_JSON_ARRAY) && src->object.children) {
+        // Adopted by a stand-in with the allocator of dst, dst keeps its value until nothing can fail
+        wsJson holder = { .flags = dst->flags & _WS_JSON_FLAG_ALLOCATOR, .arena = dst->arena };
+        if (_wsJsonAdoptChildren(&holder, src, src->object.children, 
+                                 src->object.childCount, src->object.childCapacity) != WS_OK) {
             return WS_ERROR;
+        }
+        buffer = holder.object.children;
     }
 
-    return used;
+    _wsJsonTouch(dst);
+    _wsJsonFreeValue(dst);
+    const char* key = dst->key;
+    uint32_t keyLength = dst->keyLength;
+    uint8_t allocator = dst->flags & _WS_JSON_FLAG_ALLOCATOR;
+    uint16_t arena = dst->arena;
+    *dst = *src;
+    dst->key = key;
+    dst->keyLength = keyLength;
+    dst->arena = arena;
+    dst->flags = (src->flags & ~(_WS_JSON_FLAG_ALLOCATOR | WS_JSON_FLAG_TRACKED)) | allocator;
+    if (src->type == WS_JSON_STRING) {
+        dst->stringValue = buffer;
+        if (!sameAllocator) dst->stringCapacity = 0; // the copy is exactly as long as the string
+    }
+    else if (src->type == WS_JSON_OBJECT || src->type == WS_JSON_ARRAY) dst->object.children = buffer;
+    _wsJsonNodeFree(src, src);
+    return WS_OK;
 }
 
-int32_t wsJsonToStringPretty(wsJson *obj, char *out, size_t size) {
-    if (!obj || !out) {
-        WS_JSON_LOG_ERROR("Invalid JSON or buffer\n");
-        return WS_ERROR;
+// Gives a detached node another key, keys live inside the node allocation so it moves
+static wsJson* _wsJsonRekey(wsJson* node, const char* key, size_t keyLength) {
+    if (node->keyLength == keyLength && memcmp(node->key, key, keyLength) == 0) return node;
+    wsJson* moved = _wsJsonNodeAlloc(node, sizeof(wsJson) + keyLength + 1);
+    if (!moved) {
+        WS_JSON_LOG_ERROR("Failed to allocate json node\n");
+        return NULL;
     }
-    size_t used = wsJsonToStringPrettyInternal(obj, out, size, 0);
-    out[used] = '\0';
-    return (int32_t)used;
+    *moved = *node;
+    moved->flags &= ~WS_JSON_FLAG_TRACKED; // records are kept per address
+    char* inlineKey = (char*)(moved + 1);
+    memcpy(inlineKey, key, keyLength);
+    inlineKey[keyLength] = '\0';
+    moved->key = inlineKey;
+    moved->keyLength = (uint32_t)keyLength;
+    _wsJsonNodeFree(node, node);
+    return moved;
 }
 
-static char* skipWhitespaces(const char* string) {
-    while (*string && isspace((unsigned char)*string)) string++;
-    return (char*)string;
+int32_t wsJsonRemove(wsJson* obj, const char* key) {
+    if (!obj || !key) {
+        WS_JSON_LOG_ERROR("Invalid input is NULL\n");
+        return WS_ERROR;
+    }
+    wsJson* parent = obj;
+    const char* start = key;
+    const char* dot;
+    while (parent && (dot = strchr(start, '.'))) {
+        parent = _wsJsonGetField(parent, start, (size_t)(dot - start));
+        start = dot + 1;
+    }
+    if (!_wsJsonMutable(parent) || parent->type != WS_JSON_OBJECT) return WS_ERROR;
+
+    int32_t position = _wsJsonFieldPosition(parent, start, strlen(start));
+    if (position < 0) return WS_ERROR;
+    wsJsonFree(_wsJsonDetachChild(parent, position));
+    return WS_OK;
 }
 
-static char* parseString(const char** string) {
-    (*string)++; // skip "
-    const char* start = *string;
+/* Merge patch */
+typedef struct _wsJsonMergeFrame {
+    wsJson* target;
+    wsJson* patch;
+    int32_t index;
+} _wsJsonMergeFrame;
 
-    // Find end (also handle escape sequences)
-    while (**string) {
-        if (**string == '\\') {
-            (*string)++;
-            if (**string) (*string)++;
+int32_t wsJsonMergePatch(wsJson* target, wsJson* patch) {
+    if (!target || !patch) {
+        WS_JSON_LOG_ERROR("Invalid input paramerter is NULL\n");
+        return WS_ERROR;
+    }
+    if (!_wsJsonMutable(target)) return WS_ERROR;
+
+    wsJson* value = patch->type == WS_JSON_OBJECT ? NULL : _wsJsonCloneAs(patch, NULL, 0);
+    if (!value && patch->type != WS_JSON_OBJECT) return WS_ERROR;
+    if (!value && target->type != WS_JSON_OBJECT) {
+        value = _wsJsonAllocNode(WS_JSON_OBJECT, NULL, 0);
+        if (!value) {
+            WS_JSON_LOG_ERROR("Failed to allocate json object\n");
+            return WS_ERROR;
         }
-        else if (**string == '"') {
-            break;
+    }
+    if (value && _wsJsonNodeAssign(target, value) != WS_OK) {
+        wsJsonFree(value);
+        return WS_ERROR;
+    }
+    if (patch->type != WS_JSON_OBJECT) return WS_OK;
+
+    _wsJsonMergeFrame inlineStack[_WS_JSON_INLINE_DEPTH];
+    _wsJsonMergeFrame* stack = inlineStack;
+    int32_t capacity = _WS_JSON_INLINE_DEPTH;
+    int32_t depth = 1;
+    int32_t result = WS_OK;
+    stack[0].target = target;
+    stack[0].patch = patch;
+    stack[0].index = 0;
+
+    while (depth > 0 && result == WS_OK) {
+        _wsJsonMergeFrame* frame = &stack[depth - 1];
+        if (frame->index == frame->patch->object.childCount) {
+            depth--;
+            continue;
         }
-        else {
-            (*string)++;
+
+        wsJson* member = frame->patch->object.children[frame->index++];
+        wsJson* object = frame->target;
+        int32_t position = _wsJsonFieldPosition(object, member->key, member->keyLength);
+        if (member->type == WS_JSON_NULL) {
+            if (position >= 0) wsJsonFree(_wsJsonDetachChild(object, position));
+            continue;
+        }
+        if (member->type != WS_JSON_OBJECT) {
+            value = _wsJsonCloneAs(member, member->key, member->keyLength);
+            result = value ? _wsJsonPlaceField(object, position, value) : WS_ERROR;
+            continue;
         }
-    }
-    //while (**string && **string != '"') (*string)++;
-    size_t len = *string - start;
 
-    char* out = WS_JSON_MALLOC(len + 1);
-    if (!out) {
-        WS_JSON_LOG_ERROR("Failed to allocate for parsing json key\n");
-        return NULL;
+        // Objects merge into the member, which becomes an empty object first if it isn't one
+        wsJson* child = position >= 0 ? object->object.children[position] : NULL;
+        if (!child || child->type != WS_JSON_OBJECT) {
+            child = _wsJsonAllocNode(WS_JSON_OBJECT, member->key, member->keyLength);
+            if (!child || _wsJsonPlaceField(object, position, child) != WS_OK) {
+                WS_JSON_LOG_ERROR("Failed to allocate json object\n");
+                result = WS_ERROR;
+                break;
+            }
+        }
+        if (depth == capacity && _wsJsonStackGrow((void**)&stack, inlineStack, &capacity, sizeof(_wsJsonMergeFrame)) != WS_OK) {
+            result = WS_ERROR;
+            break;
+        }
+        stack[depth].target = child;
+        stack[depth].patch = member;
+        stack[depth].index = 0;
+        depth++;
     }
-    strncpy(out, start, len);
-    out[len] = '\0';
-    if (**string == '"') (*string)++; // skip closing " 
-    return out;
+
+    if (stack != inlineStack) _wsJsonFree(stack);
+    return result;
 }
 
-static wsJson* parseValue(const char** string);
+/* 
+ *  JSON Patch
+ *  Paths are JSON Pointers (RFC 6901). A pointer resolves to the parent of 
+ *  its last reference token, which stays unescaped in the pointer buffer.
+ */
+typedef struct _wsJsonPointer {
+    wsJson* parent; // NULL for the whole document
+    const char* token;
+    size_t tokenLength;
+    char* buffer;
+    char inlineBuffer[128];
+} _wsJsonPointer;
+
+static void _wsJsonPointerFree(_wsJsonPointer* pointer) {
+    if (pointer->buffer != pointer->inlineBuffer) _wsJsonFree(pointer->buffer);
+}
 
-static wsJson* parseArray(const char** string) {
-    wsJson* array = wsJsonInitArray(NULL);
-    if (!array) {
-        WS_JSON_LOG_ERROR("Failed to allocate json array\n");
-        return NULL;
+// Array index of a reference token, -1 if it isn't one. "-" is the end of the array.
+static int32_t _wsJsonPointerIndex(const wsJson* array, const char* token, size_t length) {
+    if (length == 1 && token[0] == '-') return array->array.elementCount;
+    if (length == 0 || length > 10 || (token[0] == '0' && length > 1)) return -1;
+    int64_t index = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (token[i] < '0' || token[i] > '9') return -1;
+        index = index * 10 + (token[i] - '0');
     }
+    return index > INT32_MAX ? -1 : (int32_t)index;
+}
 
-    *string = skipWhitespaces(*string);
-    if (**string != '[') {
-        WS_JSON_LOG_ERROR("Failed to parse array: missing '['\n");
-        wsJsonFree(array);
-        return NULL;
+// Child named by a reference token or NULL
+static wsJson* _wsJsonPointerChild(wsJson* node, const char* token, size_t length) {
+    if (node->type == WS_JSON_OBJECT) {
+        int32_t position = _wsJsonFieldPosition(node, token, length);
+        return position >= 0 ? node->object.children[position] : NULL;
     }
-    (*string)++;
+    if (node->type == WS_JSON_ARRAY) {
+        int32_t index = _wsJsonPointerIndex(node, token, length);
+        return index >= 0 && index < node->array.elementCount ? node->array.elements[index] : NULL;
+    }
+    return NULL;
+}
 
-    while (**string) {
-        *string = skipWhitespaces(*string);
-        if (**string == ']') {
-            (*string)++;
-            break;
+static int32_t _wsJsonPointerResolve(_wsJsonPointer* pointer, wsJson* root, const char* path, size_t length) {
+    pointer->parent = NULL;
+    pointer->token = NULL;
+    pointer->tokenLength = 0;
+    pointer->buffer = pointer->inlineBuffer;
+    if (length == 0) return WS_OK;
+    if (path[0] != '/') {
+        WS_JSON_LOG_ERROR("Json pointer has to start with '/'\n");
+        return WS_ERROR;
+    }
+    if (length > sizeof(pointer->inlineBuffer)) {
+        pointer->buffer = _wsJsonMalloc(length);
+        if (!pointer->buffer) {
+            WS_JSON_LOG_ERROR("Failed to allocate json pointer\n");
+            pointer->buffer = pointer->inlineBuffer;
+            return WS_ERROR;
         }
+    }
 
-        wsJson* element = parseValue(string);
-        if (!element) {
-            WS_JSON_LOG_ERROR("Failed to parse array element\n");
-            wsJsonFree(array);
-            return NULL;
+    wsJson* current = root;
+    size_t i = 1;
+    for (;;) {
+        // Unescapes the next token into the buffer, ~0 is '~' and ~1 is '/'
+        char* token = pointer->buffer;
+        size_t tokenLength = 0;
+        for (; i < length && path[i] != '/'; i++) {
+            char c = path[i];
+            if (c == '~') {
+                char next = i + 1 < length ? path[i + 1] : '\0';
+                if (next != '0' && next != '1') {
+                    WS_JSON_LOG_ERROR("Invalid escape in json pointer\n");
+                    return WS_ERROR;
+                }
+                c = next == '0' ? '~' : '/';
+                i++;
+            }
+            token[tokenLength++] = c;
+        }
+        if (i == length) {
+            pointer->parent = current;
+            pointer->token = token;
+            pointer->tokenLength = tokenLength;
+            return WS_OK;
+        }
+        current = _wsJsonPointerChild(current, token, tokenLength);
+        if (!current) {
+            WS_JSON_LOG_ERROR("Json pointer %.*s does not exist\n", (int)length, path);
+            return WS_ERROR;
         }
+        i++;
+    }
+}
+
+static wsJson* _wsJsonPointerGet(const _wsJsonPointer* pointer, wsJson* root) {
+    if (!pointer->parent) return root;
+    return _wsJsonPointerChild(pointer->parent, pointer->token, pointer->tokenLength);
+}
 
-        wsJsonAddElement(array, element);
+// Puts value (a detached node) at the pointer, with replace the location has to exist already
+static int32_t _wsJsonPointerPut(const _wsJsonPointer* pointer, wsJson* root, wsJson* value, bool replace) {
+    wsJson* parent = pointer->parent;
+    if (!parent) {
+        if (_wsJsonNodeAssign(root, value) == WS_OK) return WS_OK;
+    }
+    else if (parent->type == WS_JSON_OBJECT) {
+        int32_t position = _wsJsonFieldPosition(parent, pointer->token, pointer->tokenLength);
+        if (position >= 0 || !replace) {
+            wsJson* member = _wsJsonRekey(value, pointer->token, pointer->tokenLength);
+            if (member) return _wsJsonPlaceField(parent, position, member);
+        }
+    }
+    else if (parent->type == WS_JSON_ARRAY) {
+        int32_t index = _wsJsonPointerIndex(parent, pointer->token, pointer->tokenLength);
+        int32_t count = parent->array.elementCount;
+        value->key = "";
+        value->keyLength = 0;
+        if (replace && index >= 0 && index < count) {
+            wsJson* old = parent->array.elements[index];
+            parent->array.elements[index] = value;
+            _wsJsonTouch(parent);
+            wsJsonFree(old);
+            return WS_OK;
+        }
+        if (!replace && index >= 0 && index <= count && _wsJsonInsertElement(parent, index, value) == WS_OK) return WS_OK;
+    }
+    WS_JSON_LOG_ERROR("Json patch target does not exist\n");
+    wsJsonFree(value);
+    return WS_ERROR;
+}
 
-        *string = skipWhitespaces(*string);
-        if (**string == ',') (*string)++;
+// Takes the value at the pointer out of the tree without freeing it
+static wsJson* _wsJsonPointerDetach(const _wsJsonPointer* pointer) {
+    wsJson* parent = pointer->parent;
+    int32_t position = -1;
+    if (parent && parent->type == WS_JSON_OBJECT) {
+        position = _wsJsonFieldPosition(parent, pointer->token, pointer->tokenLength);
+    }
+    else if (parent && parent->type == WS_JSON_ARRAY) {
+        position = _wsJsonPointerIndex(parent, pointer->token, pointer->tokenLength);
+        if (position >= parent->array.elementCount) position = -1;
     }
+    if (position < 0) {
+        WS_JSON_LOG_ERROR("Json patch target does not exist\n");
+        return NULL;
+    }
+    return _wsJsonDetachChild(parent, position);
+}
 
-    return array;
+static bool _wsJsonViewEquals(const char* view, size_t length, const char* string) {
+    return strlen(string) == length && memcmp(view, string, length) == 0;
 }
 
-static wsJson* parseValue(const char** string) {
-    (*string) = skipWhitespaces(*string);
+static int32_t _wsJsonApplyOperation(wsJson* target, wsJson* operation) {
+    size_t opLength, pathLength, fromLength = 0;
+    const char* op = operation->type == WS_JSON_OBJECT ? wsJsonGetStringView(operation, "op", &opLength) : NULL;
+    const char* path = op ? wsJsonGetStringView(operation, "path", &pathLength) : NULL;
+    if (!path) {
+        WS_JSON_LOG_ERROR("Json patch operation needs an op and a path\n");
+        return WS_ERROR;
+    }
+    bool add = _wsJsonViewEquals(op, opLength, "add");
+    bool replace = _wsJsonViewEquals(op, opLength, "replace");
+    bool test = _wsJsonViewEquals(op, opLength, "test");
+    bool move = _wsJsonViewEquals(op, opLength, "move");
+    bool copy = _wsJsonViewEquals(op, opLength, "copy");
+    bool remove = _wsJsonViewEquals(op, opLength, "remove");
+    wsJson* value = add || replace || test ? _wsJsonGetField(operation, "value", 5) : NULL;
+    const char* from = move || copy ? wsJsonGetStringView(operation, "from", &fromLength) : NULL;
+    if (!(add || replace || test || move || copy || remove) || ((add || replace || test) && !value) || ((move || copy) && !from)) {
+        WS_JSON_LOG_ERROR("Invalid json patch operation %.*s\n", (int)opLength, op);
+        return WS_ERROR;
+    }
 
-    // Is String 
-    if (**string == '"') {
-        char* val = parseString(string);
-        if (!val) {
-            WS_JSON_LOG_ERROR("Failed to parse json value when parsing string\n");
-            return NULL;
+    _wsJsonPointer pointer;
+    int32_t result = WS_ERROR;
+    if (move) {
+        // A value can't be moved into itself, moving it onto itself changes nothing
+        if (fromLength == pathLength && memcmp(from, path, pathLength) == 0) return WS_OK;
+        if (fromLength < pathLength && memcmp(from, path, fromLength) == 0 && path[fromLength] == '/') {
+            WS_JSON_LOG_ERROR("Json patch can't move a value into itself\n");
+            return WS_ERROR;
         }
-        wsJson* node = WS_JSON_CALLOC(1, sizeof(wsJson));
-        if (!node) {
-            WS_JSON_LOG_ERROR("Failed to allocate json node when parsing string\n");
-            WS_JSON_FREE(val);
-            return NULL;
+        wsJson* moved = NULL;
+        if (_wsJsonPointerResolve(&pointer, target, from, fromLength) == WS_OK) moved = _wsJsonPointerDetach(&pointer);
+        _wsJsonPointerFree(&pointer);
+        if (!moved) return WS_ERROR;
+        if (_wsJsonPointerResolve(&pointer, target, path, pathLength) == WS_OK) {
+            result = _wsJsonPointerPut(&pointer, target, moved, false);
+        }
+        else {
+            wsJsonFree(moved);
         }
-        node->type = WS_JSON_STRING;
+        _wsJsonPointerFree(&pointer);
+        return result;
+    }
 
-        size_t valLen = strlen(val);
-        node->stringValue = WS_JSON_MALLOC(valLen + 1);
-        strncpy(node->stringValue, val, valLen);
-        node->stringValue[valLen] = '\0';
-        WS_JSON_FREE(val);
-        return node;
+    if (copy) {
+        wsJson* source = NULL;
+        if (_wsJsonPointerResolve(&pointer, target, from, fromLength) == WS_OK) source = _wsJsonPointerGet(&pointer, target);
+        _wsJsonPointerFree(&pointer);
+        if (!source) {
+            WS_JSON_LOG_ERROR("Json patch copy source does not exist\n");
+            return WS_ERROR;
+        }
+        value = source;
     }
-    
-    // Is Field/Object 
-    else if (**string == '{') {
-        return wsStringToJson(string);
+
+    if (_wsJsonPointerResolve(&pointer, target, path, pathLength) != WS_OK) {
+        _wsJsonPointerFree(&pointer);
+        return WS_ERROR;
+    }
+    if (test) {
+        result = wsJsonEqual(_wsJsonPointerGet(&pointer, target), value) ? WS_OK : WS_ERROR;
+    }
+    else if (remove) {
+        wsJson* removed = pointer.parent ? _wsJsonPointerDetach(&pointer) : NULL;
+        if (!pointer.parent) WS_JSON_LOG_ERROR("Json patch can't remove the whole document\n");
+        if (removed) {
+            wsJsonFree(removed);
+            result = WS_OK;
+        }
+    }
+    else {
+        bool member = pointer.parent && pointer.parent->type == WS_JSON_OBJECT;
+        wsJson* clone = _wsJsonCloneAs(value, member ? pointer.token : NULL, member ? pointer.tokenLength : 0);
+        if (clone) result = _wsJsonPointerPut(&pointer, target, clone, replace);
+    }
+    _wsJsonPointerFree(&pointer);
+    return result;
+}
+
+int32_t wsJsonApplyPatch(wsJson* target, wsJson* operations) {
+    if (!target || !operations) {
+        WS_JSON_LOG_ERROR("Invalid input paramerter is NULL\n");
+        return WS_ERROR;
     }
+    if (operations->type != WS_JSON_ARRAY) {
+        WS_JSON_LOG_ERROR("Json patch has to be an array of operations\n");
+        return WS_ERROR;
+    }
+    if (!_wsJsonMutable(target)) return WS_ERROR;
 
-    // Is Digit 
-    else if (isdigit(**string) || **string == '-') {
-        char* endPtr;
-        double num = strtod(*string, &endPtr);
-        wsJson* node = WS_JSON_CALLOC(1, sizeof(wsJson));
-        if (!node) {
-            WS_JSON_LOG_ERROR("Failed to allocate json node when parsing string\n");
-            return NULL;
+    for (int32_t i = 0; i < operations->array.elementCount; i++) {
+        if (_wsJsonApplyOperation(target, operations->array.elements[i]) != WS_OK) {
+            WS_JSON_LOG_ERROR("Json patch operation %d failed\n", i);
+            return WS_ERROR;
         }
-        node->type = WS_JSON_NUMBER;
-        node->numberValue = num;
-        *string = endPtr;
-        return node;
     }
+    return WS_OK;
+}
 
-    // Is Bool (true)
-    else if (strncmp(*string, "true", 4) == 0) {
-        wsJson* node = WS_JSON_CALLOC(1, sizeof(wsJson));
-        if (!node) {
-            WS_JSON_LOG_ERROR("Failed to allocate json node when parsing string\n");
-            return NULL;
+/* 
+ *  Diff
+ *  Both trees get hashed bottom up first, the hashes of arrays and objects 
+ *  are kept in a table keyed by node. The diff then walks both trees at 
+ *  once and skips every pair of subtrees with the same hash without looking 
+ *  into it (64 bit hashes, a collision would hide a change). Object members 
+ *  are paired through the key index, arrays are walked side by side and 
+ *  look a few elements ahead to tell inserts and removals from changes.
+ */
+static inline uint64_t _wsJsonMix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+static uint64_t _wsJsonHashBytes(const char* data, size_t length, uint64_t seed) {
+    uint64_t hash = seed ^ (length * 0x9e3779b97f4a7c15ull);
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+        hash ^= hash >> 32;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, data + i, length - i);
+    return _wsJsonMix64(hash ^ tail);
+}
+
+// Equal scalars (by wsJsonEqual) get equal hashes
+static uint64_t _wsJsonHashScalar(const wsJson* node) {
+    switch (node->type) {
+        case WS_JSON_STRING:
+            return _wsJsonHashBytes(node->stringValue, node->stringLength, WS_JSON_STRING);
+        case WS_JSON_NUMBER: {
+            int64_t integer = node->integerValue;
+            double value = node->numberValue;
+            if (!(node->flags & WS_JSON_FLAG_INTEGER)) {
+                if (!(value >= -9.2e18 && value <= 9.2e18) || (double)(int64_t)value != value) {
+                    if (value == 0) value = 0; // -0.0
+                    uint64_t bits;
+                    memcpy(&bits, &value, 8);
+                    return _wsJsonMix64(bits ^ 0x5bd1e995ull);
+                }
+                integer = (int64_t)value;
+            }
+            return _wsJsonMix64((uint64_t)integer ^ WS_JSON_NUMBER);
         }
-        node->type = WS_JSON_BOOL;
-        node->boolValue = true;
-        *string += 4;
-        return node;
+        case WS_JSON_BOOL:
+            return _wsJsonMix64(WS_JSON_BOOL << 1 | node->boolValue);
+        default:
+            return _wsJsonMix64(WS_JSON_NULL);
     }
+}
 
-    // Is Bool (false)
-    else if (strncmp(*string, "false", 5) == 0) {
-        wsJson* node = WS_JSON_CALLOC(1, sizeof(wsJson));
-        if (!node) {
-            WS_JSON_LOG_ERROR("Failed to allocate json node when parsing string\n");
-            return NULL;
+typedef struct _wsJsonHashEntry {
+    const wsJson* node;
+    uint64_t hash;
+} _wsJsonHashEntry;
+
+typedef struct _wsJsonHashTable {
+    _wsJsonHashEntry* entries;
+    size_t count;
+    size_t mask;
+} _wsJsonHashTable;
+
+// Nodes are mostly allocated in tree order, so neighbours in the tree get neighbouring slots
+static inline size_t _wsJsonPointerSlot(const wsJson* node, size_t mask) {
+    return ((uintptr_t)node >> 4) & mask;
+}
+
+static int32_t _wsJsonHashTablePut(_wsJsonHashTable* table, const wsJson* node, uint64_t hash) {
+    if ((table->count + 1) * 2 > table->mask + 1) {
+        size_t capacity = table->entries ? (table->mask + 1) * 2 : 1024;
+        _wsJsonHashEntry* entries = _wsJsonMalloc(sizeof(_wsJsonHashEntry) * capacity);
+        if (!entries) {
+            WS_JSON_LOG_ERROR("Failed to allocate json hash table\n");
+            return WS_ERROR;
         }
-        node->type = WS_JSON_BOOL;
-        node->boolValue = false;
-        *string += 5;
-        return node;
+        memset(entries, 0, sizeof(_wsJsonHashEntry) * capacity);
+        for (size_t i = 0; table->entries && i <= table->mask; i++) {
+            if (!table->entries[i].node) continue;
+            size_t slot = _wsJsonPointerSlot(table->entries[i].node, capacity - 1);
+            while (entries[slot].node) slot = (slot + 1) & (capacity - 1);
+            entries[slot] = table->entries[i];
+        }
+        _wsJsonFree(table->entries);
+        table->entries = entries;
+        table->mask = capacity - 1;
     }
+    size_t slot = _wsJsonPointerSlot(node, table->mask);
+    while (table->entries[slot].node) slot = (slot + 1) & table->mask;
+    table->entries[slot].node = node;
+    table->entries[slot].hash = hash;
+    table->count++;
+    return WS_OK;
+}
 
-    // Is Null
-    else if (strncmp(*string, "null", 4) == 0) {
-        wsJson* node = WS_JSON_CALLOC(1, sizeof(wsJson));
-        if (!node) {
-            WS_JSON_LOG_ERROR("Failed to allocate json node when parsing null\n");
-            return NULL;
+static uint64_t _wsJsonHashOf(const _wsJsonHashTable* table, const wsJson* node) {
+    if (node->type != WS_JSON_OBJECT && node->type != WS_JSON_ARRAY) return _wsJsonHashScalar(node);
+    size_t slot = _wsJsonPointerSlot(node, table->mask);
+    while (table->entries[slot].node != node) slot = (slot + 1) & table->mask;
+    return table->entries[slot].hash;
+}
+
+typedef struct _wsJsonHashFrame {
+    const wsJson* node;
+    int32_t index;
+    uint64_t hash;
+} _wsJsonHashFrame;
+
+// Member hashes are summed up so objects with the same members in another order hash the same
+static inline void _wsJsonHashFold(_wsJsonHashFrame* frame, const wsJson* child, uint64_t hash) {
+    if (frame->node->type == WS_JSON_OBJECT) {
+        frame->hash += _wsJsonMix64(_wsJsonHashBytes(child->key, child->keyLength, 0) ^ hash * 0x9e3779b97f4a7c15ull);
+    }
+    else {
+        frame->hash = _wsJsonMix64(frame->hash * 31 + hash);
+    }
+}
+
+static int32_t _wsJsonHashTree(_wsJsonHashTable* table, const wsJson* root) {
+    if (root->type != WS_JSON_OBJECT && root->type != WS_JSON_ARRAY) return WS_OK;
+
+    _wsJsonHashFrame inlineStack[_WS_JSON_INLINE_DEPTH];
+    _wsJsonHashFrame* stack = inlineStack;
+    int32_t capacity = _WS_JSON_INLINE_DEPTH;
+    int32_t depth = 1;
+    int32_t result = WS_OK;
+    stack[0].node = root;
+    stack[0].index = 0;
+    stack[0].hash = root->type;
+
+    while (depth > 0) {
+        _wsJsonHashFrame* frame = &stack[depth - 1];
+        if (frame->index == frame->node->object.childCount) { // same layout for arrays
+            uint64_t hash = _wsJsonMix64(frame->hash ^ (uint64_t)frame->node->object.childCount << 32);
+            if (_wsJsonHashTablePut(table, frame->node, hash) != WS_OK) {
+                result = WS_ERROR;
+                break;
+            }
+            depth--;
+            if (depth > 0) _wsJsonHashFold(&stack[depth - 1], frame->node, hash);
+            continue;
+        }
+
+        const wsJson* child = frame->node->object.children[frame->index++];
+        if (child->type != WS_JSON_OBJECT && child->type != WS_JSON_ARRAY) {
+            _wsJsonHashFold(frame, child, _wsJsonHashScalar(child));
+            continue;
         }
-        node->type = WS_JSON_NULL;
-        *string += 4;
-        return node;
+        if (depth == capacity && _wsJsonStackGrow((void**)&stack, inlineStack, &capacity, sizeof(_wsJsonHashFrame)) != WS_OK) {
+            result = WS_ERROR;
+            break;
+        }
+        stack[depth].node = child;
+        stack[depth].index = 0;
+        stack[depth].hash = child->type;
+        depth++;
     }
 
-    // Is Array
-    else if (**string == '[') {
-        return parseArray(string);
-    }
+    if (stack != inlineStack) _wsJsonFree(stack);
+    return result;
+}
 
-    return NULL;
+static bool _wsJsonDiffSame(const _wsJsonHashTable* table, const wsJson* a, const wsJson* b) {
+    if (!_wsJsonShallowEqual(a, b)) return false;
+    if (a->type != WS_JSON_OBJECT && a->type != WS_JSON_ARRAY) return true;
+    return _wsJsonHashOf(table, a) == _wsJsonHashOf(table, b);
 }
 
-wsJson* wsStringToJson(const char** string) {
-    if (!string) {
-        WS_JSON_LOG_ERROR("Invalid input paramerter is NULL\n");
-        return NULL;
+static inline bool _wsJsonDiffContainers(const wsJson* a, const wsJson* b) {
+    return a->type == b->type && (a->type == WS_JSON_OBJECT || a->type == WS_JSON_ARRAY);
+}
+
+typedef struct _wsJsonDiff {
+    _wsJsonHashTable table;
+    wsJsonWriter path; // JSON pointer of the current frame
+    wsJson* patch;
+    int32_t result;
+} _wsJsonDiff;
+
+static int32_t _wsJsonDiffInit(_wsJsonDiff* diff, wsJson* a, wsJson* b, wsJsonType patchType) {
+    memset(diff, 0, sizeof(*diff));
+    diff->result = WS_OK;
+    if (wsJsonWriterInitGrowable(&diff->path, 0) != WS_OK) return WS_ERROR;
+    diff->patch = patchType == WS_JSON_ARRAY ? wsJsonInitArray(NULL) : wsJsonInitObject(NULL);
+    if (!diff->patch || _wsJsonHashTree(&diff->table, a) != WS_OK || _wsJsonHashTree(&diff->table, b) != WS_OK) {
+        diff->result = WS_ERROR;
     }
+    return diff->result;
+}
 
-    wsJson* root = wsJsonInitObject(NULL);
-    if (!root) {
-        WS_JSON_LOG_ERROR("Failed to allocate json object\n");
-        return NULL;
+static wsJson* _wsJsonDiffFinish(_wsJsonDiff* diff) {
+    _wsJsonFree(diff->table.entries);
+    wsJsonWriterFree(&diff->path);
+    if (diff->result != WS_OK && diff->patch) {
+        wsJsonFree(diff->patch);
+        diff->patch = NULL;
     }
+    return diff->patch;
+}
 
-    *string = skipWhitespaces(*string);
-    if (**string != '{') {
-        WS_JSON_LOG_ERROR("Failed to convert string to json\n");
-        wsJsonFree(root);
-        return NULL;
+// Appends a key to the path as a JSON pointer token ('~' is "~0", '/' is "~1")
+static void _wsJsonDiffPathKey(wsJsonWriter* path, const char* key, size_t length) {
+    _wsJsonWriterPutChar(path, '/');
+    size_t start = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (key[i] != '~' && key[i] != '/') continue;
+        _wsJsonWriterPut(path, key + start, i - start);
+        _wsJsonWriterPut(path, key[i] == '~' ? "~0" : "~1", 2);
+        start = i + 1;
     }
-    (*string)++;
+    _wsJsonWriterPut(path, key + start, length - start);
+}
 
-    while (**string) {
-        *string = skipWhitespaces(*string);
-        if (**string == '}') {
-            (*string)++;
-            break;
-        }
+static void _wsJsonDiffPathIndex(wsJsonWriter* path, int32_t index) {
+    char digits[16];
+    int32_t length = snprintf(digits, sizeof(digits), "/%d", index);
+    _wsJsonWriterPut(path, digits, (size_t)length);
+}
 
-        // read key
-        char* key = parseString(string);
-        if (!key) {
-            WS_JSON_LOG_ERROR("Failed to parse json key\n");
-            wsJsonFree(root);
-            return NULL;
-        }
+// Appends {"op": op, "path": path, "value": value} to the patch, value gets cloned
+static void _wsJsonDiffEmit(_wsJsonDiff* diff, const char* op, const wsJson* value) {
+    if (diff->result != WS_OK) return;
+    if (diff->path.error) {
+        diff->result = WS_ERROR;
+        return;
+    }
+    wsJson* operation = wsJsonInitObject(NULL);
+    wsJson* name = wsJsonInitString("op", op);
+    wsJson* path = _wsJsonAllocNode(WS_JSON_STRING, "path", 4);
+    wsJson* clone = value ? _wsJsonCloneAs(value, "value", 5) : NULL;
+    if (path) path->stringValue = _wsJsonNodeStrndup(path, diff->path.used ? diff->path.buffer : "", diff->path.used);
+    if (!operation || !name || !name->stringValue || !path || !path->stringValue || (value && !clone)) {
+        WS_JSON_LOG_ERROR("Failed to allocate json patch operation\n");
+        if (operation) wsJsonFree(operation);
+        if (name) wsJsonFree(name);
+        if (path) wsJsonFree(path);
+        if (clone) wsJsonFree(clone);
+        diff->result = WS_ERROR;
+        return;
+    }
+    path->stringLength = (uint32_t)diff->path.used;
 
-        *string = skipWhitespaces(*string);
-        if (**string != ':') {
-            WS_JSON_FREE(key);
-            return NULL;
-        }
-        (*string)++;
+    // A member that can't be added is freed by _wsJsonPlaceField, the rest still belong to us
+    wsJson* members[3] = { name, path, clone };
+    int32_t memberCount = clone ? 3 : 2;
+    int32_t added = 0;
+    while (added < memberCount && _wsJsonPlaceField(operation, -1, members[added]) == WS_OK) added++;
+    int32_t count = diff->patch->array.elementCount;
+    if (added == memberCount) wsJsonAddElement(diff->patch, operation);
+    if (diff->patch->array.elementCount == count) {
+        WS_JSON_LOG_ERROR("Failed to add json patch operation\n");
+        for (int32_t i = added + 1; i < memberCount; i++) wsJsonFree(members[i]);
+        wsJsonFree(operation);
+        diff->result = WS_ERROR;
+    }
+}
 
-        // Read value
-        *string = skipWhitespaces(*string);
-        wsJson* val = parseValue(string);
-        if (!val) {
-            WS_JSON_LOG_ERROR("Failed to parse json value\n");
-            WS_JSON_FREE(key);
-            wsJsonFree(root);
-            return NULL;
-        }
+typedef struct _wsJsonDiffFrame {
+    wsJson* a;
+    wsJson* b;
+    int32_t indexA; // objects: members of a, then members of b
+    int32_t indexB; // arrays: position in b, which is also the position in the patched array
+    int32_t endA;
+    int32_t endB;
+    size_t pathLength;
+} _wsJsonDiffFrame;
 
-        size_t keyLen = strlen(key);
-        if (keyLen + 1 > WS_JSON_MAX_KEY_SIZE) {
-            WS_JSON_LOG_ERROR("Json key Size is too long\n");
-            WS_JSON_FREE(key);
-            wsJsonFree(val);
-            wsJsonFree(root);
-            return NULL;
-        }
-        strncpy(val->key, key, keyLen);
-        val->key[keyLen] = '\0';
-        wsJsonAddField(root, val);
+// How far array diffs look ahead for an element that got inserted or removed
+#define _WS_JSON_DIFF_WINDOW 8
 
-        *string = skipWhitespaces(*string);
-        if (**string == ',') (*string)++;
+static void _wsJsonDiffEnter(_wsJsonDiff* diff, _wsJsonDiffFrame* frame, wsJson* a, wsJson* b) {
+    frame->a = a;
+    frame->b = b;
+    frame->indexA = 0;
+    frame->indexB = 0;
+    frame->pathLength = diff->path.used;
+    if (a->type == WS_JSON_OBJECT) {
+        frame->endA = a->object.childCount + b->object.childCount;
+        frame->endB = 0;
+        return;
+    }
+    // The common end is left alone, the walk only covers what is in front of it
+    int32_t endA = a->array.elementCount, endB = b->array.elementCount;
+    while (endA > 0 && endB > 0 && _wsJsonDiffSame(&diff->table, a->array.elements[endA - 1], b->array.elements[endB - 1])) {
+        endA--;
+        endB--;
+    }
+    frame->endA = endA;
+    frame->endB = endB;
+}
 
-        WS_JSON_FREE(key);
+// Distance to the next element of list that is the same as value, 0 if none is within the window
+static int32_t _wsJsonDiffLookahead(const _wsJsonDiff* diff, const wsJson* value, wsJson** list, int32_t count) {
+    for (int32_t k = 1; k <= _WS_JSON_DIFF_WINDOW && k < count; k++) {
+        if (_wsJsonDiffSame(&diff->table, value, list[k])) return k;
     }
+    return 0;
+}
 
-    return root;
+// Next step of an array walk, everything in front of indexB already matches b. Returns the pair
+// to compare next or false when the step emitted an operation (or skipped equal elements).
+static bool _wsJsonDiffArrayStep(_wsJsonDiff* diff, _wsJsonDiffFrame* frame, wsJson** childA, wsJson** childB) {
+    wsJson** elementsA = frame->a->array.elements + frame->indexA;
+    wsJson** elementsB = frame->b->array.elements + frame->indexB;
+    int32_t leftA = frame->endA - frame->indexA, leftB = frame->endB - frame->indexB;
+    _wsJsonDiffPathIndex(&diff->path, frame->indexB);
+    if (leftB == 0 || (leftA > 0 && _wsJsonDiffSame(&diff->table, elementsA[0], elementsB[0]))) {
+        if (leftB == 0) {
+            _wsJsonDiffEmit(diff, "remove", NULL);
+        }
+        else {
+            frame->indexB++;
+        }
+        frame->indexA++;
+        return false;
+    }
+    if (leftA == 0) {
+        _wsJsonDiffEmit(diff, "add", elementsB[0]);
+        frame->indexB++;
+        return false;
+    }
+
+    int32_t inserted = _wsJsonDiffLookahead(diff, elementsA[0], elementsB, leftB);
+    int32_t removed = _wsJsonDiffLookahead(diff, elementsB[0], elementsA, leftA);
+    if (inserted && (!removed || inserted <= removed)) {
+        _wsJsonDiffEmit(diff, "add", elementsB[0]);
+        frame->indexB++;
+        return false;
+    }
+    if (removed) {
+        _wsJsonDiffEmit(diff, "remove", NULL);
+        frame->indexA++;
+        return false;
+    }
+    *childA = elementsA[0];
+    *childB = elementsB[0];
+    frame->indexA++;
+    frame->indexB++;
+    return true;
 }
 
-wsJson* wsJsonGetNonPath(wsJson* obj, const char* key) {
-    if (!obj || !key) {
-        WS_JSON_LOG_ERROR("Invalid input is NULL\n");
-        return NULL;
-    } 
-    if (obj->type != WS_JSON_OBJECT) {
-        WS_JSON_LOG_ERROR("Obj is not from type WS_JSON_OBJECT\n");
+wsJson* wsJsonDiff(wsJson* a, wsJson* b) {
+    if (!a || !b) {
+        WS_JSON_LOG_ERROR("Invalid input paramerter is NULL\n");
         return NULL;
     }
+    _wsJsonDiff diff;
+    if (_wsJsonDiffInit(&diff, a, b, WS_JSON_ARRAY) != WS_OK) return _wsJsonDiffFinish(&diff);
+    if (_wsJsonDiffSame(&diff.table, a, b)) return _wsJsonDiffFinish(&diff);
+    if (!_wsJsonDiffContainers(a, b)) {
+        _wsJsonDiffEmit(&diff, "replace", b);
+        return _wsJsonDiffFinish(&diff);
+    }
 
-    for (int32_t i = 0; i < obj->object.childCount; i++) {
-        wsJson* child = obj->object.children[i];
-        if (strcmp(child->key, key) == 0) {
-            return child;
+    _wsJsonDiffFrame inlineStack[_WS_JSON_INLINE_DEPTH];
+    _wsJsonDiffFrame* stack = inlineStack;
+    int32_t capacity = _WS_JSON_INLINE_DEPTH;
+    int32_t depth = 1;
+    _wsJsonDiffEnter(&diff, &stack[0], a, b);
+
+    while (depth > 0 && diff.result == WS_OK) {
+        _wsJsonDiffFrame* frame = &stack[depth - 1];
+        diff.path.used = frame->pathLength;
+        wsJson* childA;
+        wsJson* childB;
+        if (frame->a->type == WS_JSON_ARRAY) {
+            if (frame->indexA == frame->endA && frame->indexB == frame->endB) {
+                depth--;
+                continue;
+            }
+            if (!_wsJsonDiffArrayStep(&diff, frame, &childA, &childB)) continue;
+        }
+        else {
+            if (frame->indexA == frame->endA) {
+                depth--;
+                continue;
+            }
+            int32_t index = frame->indexA++;
+            int32_t countA = frame->a->object.childCount;
+            if (index < countA) {
+                childA = frame->a->object.children[index];
+                childB = _wsJsonGetFieldHashed(frame->b, childA->key, childA->keyLength, NULL);
+                _wsJsonDiffPathKey(&diff.path, childA->key, childA->keyLength);
+                if (!childB) {
+                    _wsJsonDiffEmit(&diff, "remove", NULL);
+                    continue;
+                }
+            }
+            else {
+                childB = frame->b->object.children[index - countA];
+                if (_wsJsonGetFieldHashed(frame->a, childB->key, childB->keyLength, NULL)) continue;
+                _wsJsonDiffPathKey(&diff.path, childB->key, childB->keyLength);
+                _wsJsonDiffEmit(&diff, "add", childB);
+                continue;
+            }
+        }
+
+        if (_wsJsonDiffSame(&diff.table, childA, childB)) continue;
+        if (!_wsJsonDiffContainers(childA, childB)) {
+            _wsJsonDiffEmit(&diff, "replace", childB);
+            continue;
+        }
+        if (depth == capacity && _wsJsonStackGrow((void**)&stack, inlineStack, &capacity, sizeof(_wsJsonDiffFrame)) != WS_OK) {
+            diff.result = WS_ERROR;
+            break;
         }
+        _wsJsonDiffEnter(&diff, &stack[depth], childA, childB);
+        depth++;
     }
-    return NULL;
+
+    if (stack != inlineStack) _wsJsonFree(stack);
+    return _wsJsonDiffFinish(&diff);
 }
 
-wsJson* wsJsonGet(wsJson* obj, const char* key) {
-    if (!obj || !key) {
-        WS_JSON_LOG_ERROR("Invalid input is NULL\n");
-        return NULL;
-    } 
-    if (obj->type != WS_JSON_OBJECT) {
-        WS_JSON_LOG_ERROR("Obj is not from type WS_JSON_OBJECT\n");
+typedef struct _wsJsonMergeDiffFrame {
+    wsJson* a;
+    wsJson* b;
+    wsJson* patch; // member of the parent patch, dropped again if nothing changed
+    int32_t index;
+} _wsJsonMergeDiffFrame;
+
+wsJson* wsJsonDiffMerge(wsJson* a, wsJson* b) {
+    if (!a || !b) {
+        WS_JSON_LOG_ERROR("Invalid input paramerter is NULL\n");
         return NULL;
     }
+    if (a->type != WS_JSON_OBJECT || b->type != WS_JSON_OBJECT) return _wsJsonCloneAs(b, NULL, 0);
 
-    const char* start = key;
-    const char* dot;
-    wsJson* current = obj;
+    _wsJsonDiff diff;
+    if (_wsJsonDiffInit(&diff, a, b, WS_JSON_OBJECT) != WS_OK) return _wsJsonDiffFinish(&diff);
 
-    while (current && (dot = strchr(start, '.'))) {
-        size_t len = (size_t)(dot - start);
-        char path[WS_JSON_MAX_KEY_SIZE];
-        if (len >= sizeof(path)) len = sizeof(path) - 1;
-        memcpy(path, start, len);
-        path[len] = '\0';
+    _wsJsonMergeDiffFrame inlineStack[_WS_JSON_INLINE_DEPTH];
+    _wsJsonMergeDiffFrame* stack = inlineStack;
+    int32_t capacity = _WS_JSON_INLINE_DEPTH;
+    int32_t depth = 1;
+    stack[0].a = a;
+    stack[0].b = b;
+    stack[0].patch = diff.patch;
+    stack[0].index = 0;
 
-        current = wsJsonGetNonPath(current, path);
-        start = dot + 1;
-    }
+    while (depth > 0 && diff.result == WS_OK) {
+        _wsJsonMergeDiffFrame* frame = &stack[depth - 1];
+        wsJson* patch = frame->patch; // frame moves when the stack grows
+        int32_t countA = frame->a->object.childCount;
+        if (frame->index == countA + frame->b->object.childCount) {
+            // Nested patches are the last member of their parent while they get filled
+            if (depth > 1 && patch->object.childCount == 0) {
+                wsJson* parent = stack[depth - 2].patch;
+                wsJsonFree(_wsJsonDetachChild(parent, parent->object.childCount - 1));
+            }
+            depth--;
+            continue;
+        }
 
-    if (current && *start) {
-        current = wsJsonGetNonPath(current, start);
-    }
+        int32_t index = frame->index++;
+        wsJson* member = NULL;
+        wsJson* nestedA = NULL;
+        wsJson* nestedB = NULL;
+        if (index < countA) {
+            wsJson* childA = frame->a->object.children[index];
+            wsJson* childB = _wsJsonGetFieldHashed(frame->b, childA->key, childA->keyLength, NULL);
+            if (!childB) {
+                member = _wsJsonAllocNode(WS_JSON_NULL, childA->key, childA->keyLength);
+            }
+            else if (_wsJsonDiffSame(&diff.table, childA, childB)) {
+                continue;
+            }
+            else if (childA->type == WS_JSON_OBJECT && childB->type == WS_JSON_OBJECT) {
+                member = _wsJsonAllocNode(WS_JSON_OBJECT, childA->key, childA->keyLength);
+                nestedA = childA;
+                nestedB = childB;
+            }
+            else {
+                member = _wsJsonCloneAs(childB, childB->key, childB->keyLength);
+            }
+        }
+        else {
+            wsJson* childB = frame->b->object.children[index - countA];
+            if (_wsJsonGetFieldHashed(frame->a, childB->key, childB->keyLength, NULL)) continue;
+            member = _wsJsonCloneAs(childB, childB->key, childB->keyLength);
+        }
 
-    return current;
-}
+        if (!member) {
+            WS_JSON_LOG_ERROR("Failed to allocate json merge patch\n");
+            diff.result = WS_ERROR;
+            break;
+        }
+        if (_wsJsonPlaceField(patch, -1, member) != WS_OK) {
+            WS_JSON_LOG_ERROR("Failed to add json merge patch member\n");
+            diff.result = WS_ERROR;
+            break;
+        }
+        if (!nestedB) continue;
 
-char* wsJsonGetString(wsJson* obj, const char* key) {
-    wsJson* child = wsJsonGet(obj, key);
-    if (child && child->type == WS_JSON_STRING) {
-        return child->stringValue;
+        // Nested patches get filled in place, they are already part of the patch
+        if (depth == capacity && 
+            _wsJsonStackGrow((void**)&stack, inlineStack, &capacity, sizeof(_wsJsonMergeDiffFrame)) != WS_OK) {
+            diff.result = WS_ERROR;
+            break;
+        }
+        stack[depth].a = nestedA;
+        stack[depth].b = nestedB;
+        stack[depth].patch = member;
+        stack[depth].index = 0;
+        depth++;
     }
-    return NULL;
-}
 
-int32_t wsJsonGetStringEx(wsJson *obj, const char *key, char *out, size_t size) {
-    wsJson* child = wsJsonGet(obj, key);
-    if (child && child->type == WS_JSON_STRING) {
-        memcpy(out, child->stringValue, size);
-        return WS_OK;
-    }
-    return WS_ERROR;
+    if (stack != inlineStack) _wsJsonFree(stack);
+    return _wsJsonDiffFinish(&diff);
 }
 
-double wsJsonGetNumber(wsJson *obj, const char *key) {
-    wsJson* child = wsJsonGet(obj, key);
-    if (child && child->type == WS_JSON_NUMBER) {
-        return child->numberValue;
-    }
-    return WS_ERROR;
+/* 
+ *  Cached serialization
+ *  Records are kept per container address and point to their parent, so 
+ *  a change can mark everything up to the root without parent pointers in 
+ *  the nodes. Offsets are relative to the parent: a subtree that gets 
+ *  copied keeps the records below it valid and only the containers that 
+ *  get regenerated are written back. Only nodes with 
+ *  WS_JSON_FLAG_TRACKED use their record, the flag is set when a record 
+ *  is written and taken off when a node leaves its place, so records of 
+ *  freed or moved nodes are never used again. Marks from any thread go 
+ *  through the list of caches, each table has its own lock.
+ */
+static mtx_t _wsJsonCachesLock;
+static once_flag _wsJsonCachesOnce = ONCE_FLAG_INIT;
+static wsJsonCache* _wsJsonCaches;
+
+static void _wsJsonCachesInit(void) {
+    mtx_init(&_wsJsonCachesLock, mtx_plain);
 }
 
-bool wsJsonGetBool(wsJson* obj, const char* key) {
-    wsJson* child = wsJsonGet(obj, key);
-    if (child && child->type == WS_JSON_BOOL) {
-        return child->boolValue;
+static wsJsonCacheRecord* _wsJsonCacheFind(wsJsonCache* cache, const wsJson* node) {
+    if (!cache->records) return NULL;
+    size_t slot = _wsJsonPointerSlot(node, cache->recordMask);
+    while (cache->records[slot].node) {
+        if (cache->records[slot].node == node) return &cache->records[slot];
+        slot = (slot + 1) & cache->recordMask;
     }
-    return WS_ERROR;
+    return NULL;
 }
 
-int32_t wsJsonGetArrayLen(wsJson* obj, const char* key) {
-    wsJson* child = wsJsonGet(obj, key);
-    if (child && child->type == WS_JSON_ARRAY) {
-        return child->array.elementCount;
+// Record of node, a new one is zeroed
+static wsJsonCacheRecord* _wsJsonCachePut(wsJsonCache* cache, const wsJson* node) {
+    wsJsonCacheRecord* record = _wsJsonCacheFind(cache, node);
+    if (record) return record;
+
+    if ((cache->recordCount + 1) * 2 > cache->recordMask + 1) {
+        size_t capacity = cache->records ? (cache->recordMask + 1) * 2 : 256;
+        wsJsonCacheRecord* records = _wsJsonMalloc(sizeof(wsJsonCacheRecord) * capacity);
+        if (!records) {
+            WS_JSON_LOG_ERROR("Failed to grow json cache records\n");
+            return NULL;
+        }
+        memset(records, 0, sizeof(wsJsonCacheRecord) * capacity);
+        for (size_t i = 0; cache->records && i <= cache->recordMask; i++) {
+            if (!cache->records[i].node) continue;
+            size_t slot = _wsJsonPointerSlot(cache->records[i].node, capacity - 1);
+            while (records[slot].node) slot = (slot + 1) & (capacity - 1);
+            records[slot] = cache->records[i];
+        }
+        _wsJsonFree(cache->records);
+        cache->records = records;
+        cache->recordMask = capacity - 1;
     }
-    return WS_ERROR;
+    size_t slot = _wsJsonPointerSlot(node, cache->recordMask);
+    while (cache->records[slot].node) slot = (slot + 1) & cache->recordMask;
+    cache->records[slot].node = node;
+    cache->recordCount++;
+    return &cache->records[slot];
 }
 
-wsJson* wsJsonGetArrayAt(wsJson* obj, const char* key, int32_t index) {
-    wsJson* child = wsJsonGet(obj, key);
-    if (child && child->type == WS_JSON_ARRAY) {
-        if (index < 0 || index >= child->array.elementCount) return NULL;
-        return child->array.elements[index];
+static void _wsJsonCacheTouch(const wsJson* node) {
+    call_once(&_wsJsonCachesOnce, _wsJsonCachesInit);
+    mtx_lock(&_wsJsonCachesLock);
+    for (wsJsonCache* cache = _wsJsonCaches; cache; cache = cache->next) {
+        mtx_lock(&cache->lock);
+        wsJsonCacheRecord* record = _wsJsonCacheFind(cache, node);
+        // A dirty record has dirty parents already. Another cache can still hold a record 
+        // for the address from a node it lost, so all of them get asked
+        while (record && !record->dirty) {
+            record->dirty = true;
+            record = record->parent ? _wsJsonCacheFind(cache, record->parent) : NULL;
+        }
+        mtx_unlock(&cache->lock);
     }
-    return NULL;
+    mtx_unlock(&_wsJsonCachesLock);
 }
 
-int32_t wsJsonSetStringExplicit(wsJson *obj, const char *key, const char *val) {
-    size_t length = strlen(val);
-
-    wsJson* child = wsJsonGet(obj, key);
-    if (child && child->type == WS_JSON_STRING) {
-        if (child->stringValue) WS_JSON_FREE(child->stringValue);
+wsJsonCache* wsJsonCacheInit(wsJson* root) {
+    if (!root) {
+        WS_JSON_LOG_ERROR("Invalid input paramerter is NULL\n");
+        return NULL;
+    }
+    // Writing the output marks the nodes, which readers of a shared document must not see
+    if (!_wsJsonMutable(root)) return NULL;
 
-        child->stringValue = WS_JSON_MALLOC(length + 1);
-        strncpy(child->stringValue, val, length);
-        child->stringValue[length] = '\0';
-        return WS_OK;
+    wsJsonCache* cache = _wsJsonMalloc(sizeof(wsJsonCache));
+    if (!cache) {
+        WS_JSON_LOG_ERROR("Failed to allocate json cache\n");
+        return NULL;
     }
-    return WS_ERROR;
+    memset(cache, 0, sizeof(wsJsonCache));
+    cache->root = root;
+    if (mtx_init(&cache->lock, mtx_plain) != thrd_success) {
+        WS_JSON_LOG_ERROR("Failed to create json cache lock\n");
+        _wsJsonFree(cache);
+        return NULL;
+    }
+    if (wsJsonWriterInitGrowable(&cache->outputs[0], 0) != WS_OK || wsJsonWriterInitGrowable(&cache->outputs[1], 0) != WS_OK) {
+        wsJsonCacheFree(cache);
+        return NULL;
+    }
+
+    call_once(&_wsJsonCachesOnce, _wsJsonCachesInit);
+    mtx_lock(&_wsJsonCachesLock);
+    cache->next = _wsJsonCaches;
+    _wsJsonCaches = cache;
+    mtx_unlock(&_wsJsonCachesLock);
+    return cache;
 }
 
-int32_t wsJsonSetNumberExplicit(wsJson *obj, const char *key, double val) {
-    wsJson* child = wsJsonGet(obj, key);
-    if (child && child->type == WS_JSON_NUMBER) {
-        child->numberValue = val;
-        return WS_OK;
+void wsJsonCacheFree(wsJsonCache* cache) {
+    if (!cache) return;
+    call_once(&_wsJsonCachesOnce, _wsJsonCachesInit);
+    mtx_lock(&_wsJsonCachesLock);
+    for (wsJsonCache** link = &_wsJsonCaches; *link; link = &(*link)->next) {
+        if (*link != cache) continue;
+        *link = cache->next;
+        break;
     }
-    return WS_ERROR;
-}
+    mtx_unlock(&_wsJsonCachesLock);
 
-int32_t wsJsonSetBoolExplicit(wsJson *obj, const char *key, bool val) {
-    wsJson* child = wsJsonGet(obj, key);
-    if (child && child->type == WS_JSON_BOOL) {
-        child->boolValue = val;
-        return WS_OK;
+    if (cache->records && (cache->root->type == WS_JSON_OBJECT || cache->root->type == WS_JSON_ARRAY)) {
+        _wsJsonWriteFrame inlineStack[_WS_JSON_INLINE_DEPTH];
+        _wsJsonWriteFrame* stack = inlineStack;
+        int32_t capacity = _WS_JSON_INLINE_DEPTH;
+        int32_t depth = 1;
+        stack[0].node = cache->root;
+        stack[0].index = 0;
+        cache->root->flags &= ~WS_JSON_FLAG_TRACKED;
+        while (depth > 0) {
+            _wsJsonWriteFrame* frame = &stack[depth - 1];
+            if (frame->index == frame->node->object.childCount) { // same layout for arrays
+                depth--;
+                continue;
+            }
+            wsJson* child = frame->node->object.children[frame->index++];
+            if (child->type != WS_JSON_OBJECT && child->type != WS_JSON_ARRAY) continue;
+            child->flags &= ~WS_JSON_FLAG_TRACKED;
+            if (depth == capacity && _wsJsonStackGrow((void**)&stack, inlineStack, &capacity, sizeof(_wsJsonWriteFrame)) != WS_OK) break;
+            stack[depth].node = child;
+            stack[depth].index = 0;
+            depth++;
+        }
+        if (stack != inlineStack) _wsJsonFree(stack);
     }
-    return WS_ERROR;
+
+    _wsJsonFree(cache->records);
+    wsJsonWriterFree(&cache->outputs[0]);
+    wsJsonWriterFree(&cache->outputs[1]);
+    mtx_destroy(&cache->lock);
+    _wsJsonFree(cache);
 }
 
-int32_t wsJsonSetNullToObject(wsJson* obj, const char *key, wsJson *fields) {
-    wsJson* child = wsJsonGet(obj, key);
-    if (child && child->type == WS_JSON_NULL) {
-        child->type = WS_JSON_OBJECT;
+#define _WS_JSON_CACHE_UNKNOWN ((size_t)-1)
 
-        child->object.children = fields->object.children;
-        child->object.childCount = fields->object.childCount;
-        child->object.childCapacity = fields->object.childCapacity;
+typedef struct _wsJsonCacheFrame {
+    wsJson* node;
+    int32_t index;
+    uint32_t containers;
+    size_t oldStart; // in the last output, _WS_JSON_CACHE_UNKNOWN if it isn't there
+    size_t newStart;
+} _wsJsonCacheFrame;
 
-        fields->object.children = NULL;
-        fields->object.childCount = 0;
-        fields->object.childCapacity = 0;
-        WS_JSON_FREE(fields);
-        return WS_OK;
-    }
-    return WS_ERROR;
+// Where child starts in the last output, if its bytes there are still the current ones 
+// (copy is set) or at least its children can be found through it
+static size_t _wsJsonCacheLocate(wsJsonCache* cache, const _wsJsonCacheFrame* parent, wsJson* child, bool* copy) {
+    *copy = false;
+    if (!(child->flags & WS_JSON_FLAG_TRACKED) || parent->oldStart == _WS_JSON_CACHE_UNKNOWN) return _WS_JSON_CACHE_UNKNOWN;
+    wsJsonCacheRecord* record = _wsJsonCacheFind(cache, child);
+    if (!record || record->parent != parent->node) return _WS_JSON_CACHE_UNKNOWN;
+    *copy = !record->dirty;
+    return parent->oldStart + record->offset;
 }
 
-int32_t wsJsonSetNullToString(wsJson *obj, const char *key, const char *val) {
-    wsJson* child = wsJsonGet(obj, key);
-    if (child && child->type == WS_JSON_NULL) {
-        child->type = WS_JSON_STRING;
-        size_t length = strlen(val);
-        child->stringValue = WS_JSON_MALLOC(length + 1);
-        strncpy(child->stringValue, val, length);
-        child->stringValue[length] = '\0';
-        return WS_OK;
-    }
-    return WS_ERROR;
-}
+static int32_t _wsJsonCacheRender(wsJsonCache* cache) {
+    wsJsonWriter* old = &cache->outputs[cache->current];
+    wsJsonWriter* out = &cache->outputs[cache->current ^ 1];
+    wsJson* root = cache->root;
+    wsJsonCacheRecord* record = (root->flags & WS_JSON_FLAG_TRACKED) ? _wsJsonCacheFind(cache, root) : NULL;
+    if (cache->valid && record && !record->dirty && !record->parent) return WS_OK;
 
-int32_t wsJsonSetNullToNumber(wsJson *obj, const char *key, double val) {
-    wsJson* child = wsJsonGet(obj, key);
-    if (child && child->type == WS_JSON_NULL) {
-        child->type = WS_JSON_NUMBER;
-        child->numberValue = val;
-        return WS_OK;
+    // Records of nodes that left the document pile up, start over once they are the majority
+    uint32_t live = record ? record->containers : 0;
+    if (cache->recordCount > 1024 && cache->recordCount > (size_t)live * 2) {
+        memset(cache->records, 0, sizeof(wsJsonCacheRecord) * (cache->recordMask + 1));
+        cache->recordCount = 0;
+        cache->valid = false;
+        record = NULL;
     }
-    return WS_ERROR;
-}
 
-int32_t wsJsonSetNullToBool(wsJson *obj, const char *key, bool val) {
-    wsJson* child = wsJsonGet(obj, key);
-    if (child && child->type == WS_JSON_NULL) {
-        child->type = WS_JSON_BOOL;
-        child->boolValue = val;
-        return WS_OK;
+    out->used = 0;
+    out->length = 0;
+    out->error = 0;
+    if (_wsJsonWriteScalar(out, root)) {
+        cache->current ^= 1;
+        cache->valid = true;
+        return _wsJsonWriterFinish(out, WS_OK);
     }
-    return WS_ERROR;
-}
 
-int32_t wsJsonSetNullToArray(wsJson *obj, const char *key, wsJson *array) {
-    wsJson* child = wsJsonGet(obj, key);
-    if (child && child->type == WS_JSON_NULL) {
-        child->type = WS_JSON_ARRAY;
+    _wsJsonCacheFrame inlineStack[_WS_JSON_INLINE_DEPTH];
+    _wsJsonCacheFrame* stack = inlineStack;
+    int32_t capacity = _WS_JSON_INLINE_DEPTH;
+    int32_t depth = 1;
+    int32_t result = WS_OK;
+    stack[0].node = root;
+    stack[0].index = 0;
+    stack[0].containers = 1;
+    stack[0].oldStart = cache->valid && record && !record->parent ? 0 : _WS_JSON_CACHE_UNKNOWN;
+    stack[0].newStart = 0;
+    _wsJsonWriteOpen(out, root, false);
 
-        child->array.elements = array->array.elements;
-        child->array.elementCount = array->array.elementCount;
-        child->array.elementCapacity = array->array.elementCapacity;
+    while (depth > 0) {
+        _wsJsonCacheFrame* frame = &stack[depth - 1];
+        wsJson* node = frame->node;
+        bool object = node->type == WS_JSON_OBJECT;
+        if (frame->index == node->object.childCount) { // same layout for arrays
+            _wsJsonWriterPutChar(out, object ? '}' : ']');
+            _wsJsonCacheFrame* parent = depth > 1 ? &stack[depth - 2] : NULL;
+            record = _wsJsonCachePut(cache, node);
+            if (!record) {
+                result = WS_ERROR;
+                break;
+            }
+            record->parent = parent ? parent->node : NULL;
+            record->offset = frame->newStart - (parent ? parent->newStart : 0);
+            record->length = out->used - frame->newStart;
+            record->containers = frame->containers;
+            record->dirty = false;
+            node->flags |= WS_JSON_FLAG_TRACKED;
+            if (parent) parent->containers += frame->containers;
+            depth--;
+            continue;
+        }
 
-        array->array.elements = NULL;
-        array->array.elementCount = 0;
-        array->array.elementCapacity = 0;
-        WS_JSON_FREE(array);
-        return WS_OK;
+        wsJson* child = node->object.children[frame->index];
+        if (frame->index++ > 0) _wsJsonWriterPutChar(out, ',');
+        if (object) _wsJsonWriteKey(out, child);
+        if (_wsJsonWriteScalar(out, child)) continue;
+
+        bool copy;
+        size_t oldStart = _wsJsonCacheLocate(cache, frame, child, &copy);
+        if (copy) {
+            record = _wsJsonCacheFind(cache, child);
+            record->offset = out->used - frame->newStart;
+            frame->containers += record->containers;
+            _wsJsonWriterPut(out, old->buffer + oldStart, record->length);
+            continue;
+        }
+        if (depth == capacity && _wsJsonStackGrow((void**)&stack, inlineStack, &capacity, sizeof(_wsJsonCacheFrame)) != WS_OK) {
+            result = WS_ERROR;
+            break;
+        }
+        stack[depth].node = child;
+        stack[depth].index = 0;
+        stack[depth].containers = 1;
+        stack[depth].oldStart = oldStart;
+        stack[depth].newStart = out->used;
+        depth++;
+        _wsJsonWriteOpen(out, child, false);
     }
-    return WS_ERROR;
-}
 
-int32_t wsJsonSetString(wsJson *obj, const char *key, const char *val) {
-    wsJson* child = wsJsonGet(obj, key);
-    if (child) {
-        if (child->type == WS_JSON_STRING) return wsJsonSetStringExplicit(obj, key, val);
-        else if (child->type == WS_JSON_NULL) return wsJsonSetNullToString(obj, key, val);
+    if (stack != inlineStack) _wsJsonFree(stack);
+    result = _wsJsonWriterFinish(out, result);
+    if (result != WS_OK) {
+        // Records may already describe the new output, nothing of the old one can be trusted
+        cache->valid = false;
         return WS_ERROR;
     }
-    return WS_ERROR;
+    cache->current ^= 1;
+    cache->valid = true;
+    return WS_OK;
 }
 
-int32_t wsJsonSetNumber(wsJson *obj, const char *key, double val) {
-    wsJson* child = wsJsonGet(obj, key);
-    if (child) {
-        if (child->type == WS_JSON_NUMBER) return wsJsonSetNumberExplicit(obj, key, val);
-        else if (child->type == WS_JSON_NULL) return wsJsonSetNullToNumber(obj, key, val);
+int32_t wsJsonCacheUpdate(wsJsonCache* cache) {
+    if (!cache) {
+        WS_JSON_LOG_ERROR("Invalid input paramerter is NULL\n");
         return WS_ERROR;
     }
-    return WS_ERROR;
+    _WS_JSON_STATS_START(start);
+    mtx_lock(&cache->lock);
+    int32_t result = _wsJsonCacheRender(cache);
+    mtx_unlock(&cache->lock);
+    _WS_JSON_STATS_TIME(serialize, start, cache->outputs[cache->current].used);
+    return result;
 }
 
-int32_t wsJsonSetBool(wsJson *obj, const char *key, bool val) {
-    wsJson* child = wsJsonGet(obj, key);
-    if (child) {
-        if (child->type == WS_JSON_BOOL) return wsJsonSetBoolExplicit(obj, key, val);
-        else if (child->type == WS_JSON_NULL) return wsJsonSetNullToBool(obj, key, val);
+int32_t wsJsonCacheWrite(wsJsonCache* cache, wsJsonWriter* writer) {
+    if (!writer) {
+        WS_JSON_LOG_ERROR("Invalid JSON or writer\n");
         return WS_ERROR;
     }
-    return WS_ERROR;
+    if (wsJsonCacheUpdate(cache) != WS_OK) return WS_ERROR;
+    const wsJsonWriter* output = &cache->outputs[cache->current];
+    _wsJsonWriterPut(writer, output->buffer, output->used);
+    return _wsJsonWriterFinish(writer, WS_OK);
 }
 
-int32_t wsJsonSetElement(wsJson *obj, const char *key, int32_t index, wsJson *element) {
-    wsJson* child = wsJsonGet(obj, key);
-    if (child && child->type == WS_JSON_ARRAY) {
-        if (index < 0 || index >= child->array.elementCount) return WS_ERROR;
-        child->array.elements[index] = element;
+int32_t wsJsonCacheToString(wsJsonCache* cache, char* out, size_t size) {
+    wsJsonWriter writer;
+    wsJsonWriterInitFixed(&writer, out, size);
+    if (wsJsonCacheWrite(cache, &writer) != WS_OK) return WS_ERROR;
+    return (int32_t)writer.length;
+}
+
+static inline void _wsJsonFreeLeaf(wsJson* obj) {
+    if (obj->type == WS_JSON_STRING && !(obj->flags & WS_JSON_FLAG_STRING_VIEW)) {
+        _wsJsonNodeFree(obj, obj->stringValue);
     }
-    return WS_ERROR;
+    _wsJsonNodeFree(obj, obj);
 }
 
 void wsJsonFree(wsJson *obj) {
@@ -932,22 +9440,40 @@ void wsJsonFree(wsJson *obj) {
         WS_JSON_LOG_ERROR("JSON obj is NULL on free!\n");
         return;
     }
-    if (obj->type == WS_JSON_OBJECT) {
-        for (int32_t i = 0; i < obj->object.childCount; i++) {
-            wsJsonFree(obj->object.children[i]);
-        }
-        WS_JSON_FREE(obj->object.children);
-    } 
-    else if (obj->type == WS_JSON_ARRAY) {
-        for (int32_t i = 0; i < obj->array.elementCount; i++) {
-            wsJsonFree(obj->array.elements[i]);
-        }
-        WS_JSON_FREE(obj->array.elements);
+    if (!_wsJsonMutable(obj)) return;
+    // Arena memory is released by wsJsonArenaReset/wsJsonArenaFree, heap nodes 
+    // that were added to an arena tree still get freed here.
+    // Walks the tree without a stack: while a container is being freed its key 
+    // points back to the parent and its capacity counts the children done so far.
+    if (obj->type != WS_JSON_OBJECT && obj->type != WS_JSON_ARRAY) {
+        _wsJsonFreeLeaf(obj);
+        return;
     }
-    else if (obj->type == WS_JSON_STRING) {
-        WS_JSON_FREE(obj->stringValue);
+    wsJson* node = obj;
+    node->key = NULL;
+    node->object.childCapacity = 0; // same layout for arrays
+    for (;;) {
+        wsJson** children = node->type == WS_JSON_OBJECT ? node->object.children : node->array.elements;
+        int32_t count = node->type == WS_JSON_OBJECT ? node->object.childCount : node->array.elementCount;
+        if (node->object.childCapacity < count) {
+            wsJson* child = children[node->object.childCapacity++];
+            if (child->type == WS_JSON_OBJECT || child->type == WS_JSON_ARRAY) {
+                child->key = (const char*)node;
+                child->object.childCapacity = 0;
+                node = child;
+            }
+            else {
+                _wsJsonFreeLeaf(child);
+            }
+            continue;
+        }
+
+        wsJson* parent = (wsJson*)node->key;
+        _wsJsonNodeFree(node, children);
+        _wsJsonNodeFree(node, node);
+        if (!parent) return;
+        node = parent;
     }
-    WS_JSON_FREE(obj);
 }
 
 #endif // WS_JSON_IMPLEMENTATION